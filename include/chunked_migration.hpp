@@ -0,0 +1,257 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef GUARD_chunked_migration_hpp_5933280993416529
+#define GUARD_chunked_migration_hpp_5933280993416529
+
+#include "database_connection_fwd.hpp"
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace sqloxx
+{
+
+/**
+ * Governs the size of the chunks in which a ChunkedMigration proceeds,
+ * and the pauses between them.
+ */
+struct ChunkedMigrationPolicy
+{
+    ChunkedMigrationPolicy();
+
+    // The number of rows in the first chunk, and the bounds within which
+    // it is adjusted so that each chunk holds the write lock for about
+    // target_chunk_time.
+    std::size_t initial_chunk_rows;
+    std::size_t min_chunk_rows;
+    std::size_t max_chunk_rows;
+    std::chrono::steady_clock::duration target_chunk_time;
+
+    // After each chunk, ChunkedMigration::run pauses for this multiple of
+    // the time for which the chunk held the write lock, plus the time it
+    // spent waiting for the lock, so that other writers are not starved.
+    double pause_ratio;
+
+    // The longest single wait before retrying a chunk that failed because
+    // the database was locked by another connection. Waits start at one
+    // millisecond and double with each consecutive failure.
+    std::chrono::steady_clock::duration max_busy_wait;
+};
+
+
+/**
+ * Migrates the rows of a table in chunks, each in its own short
+ * DatabaseTransaction, so that the write lock on the database is never
+ * held for long, and other connections can go on writing while the
+ * migration proceeds. This suits backfilling a new column, or copying
+ * rows into a rebuilt table, where doing so in a single transaction would
+ * lock out other writers for too long.
+ *
+ * A migration proceeds in three phases:
+ *
+ * \e Setup: the setup step (if any) is executed, for example to add a
+ * column, or to create the new table together with triggers which apply
+ * to it any changes made to the rows of the old table by other
+ * connections while the migration proceeds.
+ *
+ * \e Backfill: the rows of the table are visited in ascending order of
+ * an integer key column, a chunk at a time. For each chunk, the SQL
+ * statement passed to the constructor is executed, with the exclusive
+ * lower bound and inclusive upper bound of the keys in the chunk bound
+ * to the parameters ":low" and ":high" respectively. For example:
+ * "update person set name_lower = lower(name) where person_id > :low and
+ * person_id <= :high".
+ *
+ * \e Cutover: once every row has been visited, the cutover step (if any)
+ * is executed, for example to drop the old table and rename the new one
+ * in its place. This should be quick, being a single transaction.
+ *
+ * Progress is checkpointed in the database itself, in the table
+ * "sqloxx_chunked_migrations", in the same transaction as each phase or
+ * chunk, keyed by the name of the migration. A migration interrupted, for
+ * example by a crash, therefore resumes where it left off when next
+ * stepped or run, by this or any other connection. Since each phase
+ * commits together with its checkpoint, neither the setup nor the
+ * cutover takes effect more than once.
+ *
+ * Rows with keys inserted below the last key visited, after the chunk
+ * that visited it, are not visited; a migration whose chunk statement
+ * must see every row should be accompanied by triggers, installed in
+ * the setup step, that take care of rows written concurrently.
+ *
+ * The table, key column and statement texts are incorporated into SQL
+ * as they are, and must therefore come from a trusted source.
+ */
+class ChunkedMigration
+{
+public:
+
+    typedef std::function<void(DatabaseConnection&)> Step;
+
+    struct Stats
+    {
+        Stats();
+
+        // Transactions committed, excluding those of setup and cutover.
+        std::size_t chunks;
+
+        // The current number of rows per chunk.
+        std::size_t chunk_rows;
+
+        // Chunks that failed because the database was locked by another
+        // connection, and were retried.
+        std::size_t busy_retries;
+
+        // Time spent acquiring the write lock (including waiting between
+        // retries), and holding it, summed over the chunks.
+        std::chrono::steady_clock::duration lock_wait;
+        std::chrono::steady_clock::duration lock_hold;
+
+        // Time spent pausing between chunks, in run().
+        std::chrono::steady_clock::duration paused;
+    };
+
+    /**
+     * @param p_name identifies the migration, and its checkpoint, in the
+     * database.
+     *
+     * @param p_table the table whose rows are visited.
+     *
+     * @param p_key_column an integer column of \e p_table, preferably its
+     * integer primary key, and in any case indexed, by which rows are
+     * visited in order. Only keys greater than the least 64-bit integer
+     * are visited.
+     *
+     * @param p_chunk_sql the text of a single SQL statement to be executed
+     * for each chunk, with ":low" and ":high" bound as described above.
+     *
+     * @throws LogicError if \e p_policy has a minimum chunk size of zero,
+     * or greater than its maximum.
+     */
+    ChunkedMigration
+    (   std::string const& p_name,
+        std::string const& p_table,
+        std::string const& p_key_column,
+        std::string const& p_chunk_sql,
+        ChunkedMigrationPolicy const& p_policy = ChunkedMigrationPolicy()
+    );
+
+    /**
+     * Sets the step executed, within the same transaction as the first
+     * checkpoint, before any chunk.
+     */
+    void set_setup(Step const& p_setup);
+
+    /**
+     * Sets the step executed, within the same transaction as the final
+     * checkpoint, after the last chunk.
+     */
+    void set_cutover(Step const& p_cutover);
+
+    /**
+     * Performs the next phase of the migration on the database to which
+     * \e p_connection is connected: the setup, the next chunk, or the
+     * cutover, in a single DatabaseTransaction. Does not pause; see
+     * next_pause().
+     *
+     * @returns \e true if and only if the migration is not yet complete.
+     *
+     * @throws LogicError if a DatabaseTransaction is already open on
+     * \e p_connection, since the chunk would otherwise be absorbed into
+     * that transaction, defeating the point.
+     *
+     * @throws SQLiteBusy if the database is locked by another connection.
+     * Nothing is changed in that case, and the step may simply be retried.
+     *
+     * @throws InvalidConnection if \e p_connection is invalid.
+     *
+     * @throws any exception thrown by a Step or by the database.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>, provided the
+     * steps affect nothing outside the database.
+     */
+    bool step(DatabaseConnection& p_connection);
+
+    /**
+     * Steps the migration on \e p_connection until it is complete,
+     * pausing between chunks for next_pause(), and retrying, after a
+     * growing wait, chunks that fail because the database is locked.
+     *
+     * @throws as for step(), except SQLiteBusy.
+     *
+     * <b>Exception safety</b>: <em>basic guarantee</em>. The migration
+     * can be resumed after an exception, by this or another
+     * ChunkedMigration of the same name.
+     */
+    void run(DatabaseConnection& p_connection);
+
+    /**
+     * @returns the time for which the caller should pause before the next
+     * step, given the time for which the last chunk waited for and held
+     * the write lock.
+     */
+    std::chrono::steady_clock::duration next_pause() const;
+
+    Stats stats() const;
+
+    /**
+     * @returns \e true if and only if a migration named \e p_name has been
+     * completed on the database to which \e p_connection is connected.
+     *
+     * @throws InvalidConnection if \e p_connection is invalid.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    static bool is_complete
+    (   DatabaseConnection& p_connection,
+        std::string const& p_name
+    );
+
+private:
+
+    // Sets p_high to the key of the last row of the chunk following
+    // p_low, returning false if there is no such row.
+    bool find_chunk_end
+    (   DatabaseConnection& p_connection,
+        long long p_low,
+        long long& p_high
+    ) const;
+
+    // Adjusts m_stats.chunk_rows and m_next_pause given the time for
+    // which the last chunk held the write lock, and waited for it.
+    void adapt
+    (   std::chrono::steady_clock::duration p_hold,
+        std::chrono::steady_clock::duration p_wait
+    );
+
+    std::string const m_name;
+    std::string const m_table;
+    std::string const m_key_column;
+    std::string const m_chunk_sql;
+    ChunkedMigrationPolicy const m_policy;
+    Step m_setup;
+    Step m_cutover;
+    std::chrono::steady_clock::duration m_next_pause;
+    Stats m_stats;
+
+};  // class ChunkedMigration
+
+}  // namespace sqloxx
+
+#endif  // GUARD_chunked_migration_hpp_5933280993416529
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef GUARD_codec_hpp_9093195618243942
+#define GUARD_codec_hpp_9093195618243942
+
+#include "fixed_point.hpp"
+#include <boost/uuid/uuid.hpp>
+#include <chrono>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace sqloxx
+{
+
+/**
+ * The contents of an SQLite blob, as bound by SQLStatement::bind and
+ * extracted by SQLStatement::extract.
+ */
+typedef std::vector<unsigned char> Blob;
+
+/**
+ * Describes how values of type \b T are stored in the database, so that
+ * they can be passed to SQLStatement::bind and SQLStatement::extract
+ * directly. A value is encoded as one of the types SQLStatement supports
+ * natively, and the encoding is selected at compile time, with no
+ * virtual calls.
+ *
+ * Client code may specialize Codec for its own types. Each
+ * specialization provides:
+ *
+ * <em>typedef ... \b Stored</em>;\n
+ * The type by which values are stored: one of <b>long long</b>,
+ * \b double, \b std::string and \b Blob.
+ *
+ * <em>static Stored \b encode(T const&)</em>;\n
+ * Converts a value to its stored form.
+ *
+ * <em>static T \b decode(Stored const&)</em>;\n
+ * Converts a value from its stored form. This may throw if the stored
+ * value is not a valid encoding.
+ *
+ * Specializations are provided here for boost::uuids::uuid (as a 16-byte
+ * blob), for std::chrono::time_point (as an integer count of ticks since
+ * the epoch of its clock) and for FixedPoint (as an integer count of
+ * units).
+ */
+template <typename T>
+struct Codec;
+
+
+template <>
+struct Codec<boost::uuids::uuid>
+{
+    typedef Blob Stored;
+
+    static Blob encode(boost::uuids::uuid const& p_value)
+    {
+        return Blob(p_value.begin(), p_value.end());
+    }
+
+    /**
+     * @throws ValueTypeException if \e p_stored is not 16 bytes long.
+     */
+    static boost::uuids::uuid decode(Blob const& p_stored);
+};
+
+
+/**
+ * Stores a time point as the count of ticks of \b Duration since the
+ * epoch of \b Clock. Since the epoch of a clock (and in particular of
+ * std::chrono::steady_clock) may differ between processes, time points
+ * to be read by other programs should use std::chrono::system_clock.
+ */
+template <typename Clock, typename Duration>
+struct Codec<std::chrono::time_point<Clock, Duration> >
+{
+    typedef std::chrono::time_point<Clock, Duration> TimePoint;
+    typedef long long Stored;
+
+    static_assert
+    (   std::is_integral<typename Duration::rep>::value,
+        "Codec supports only time points with an integral representation."
+    );
+
+    static long long encode(TimePoint const& p_value)
+    {
+        return p_value.time_since_epoch().count();
+    }
+
+    static TimePoint decode(long long p_stored)
+    {
+        return TimePoint(Duration(p_stored));
+    }
+};
+
+
+template <int Places>
+struct Codec<FixedPoint<Places> >
+{
+    typedef long long Stored;
+
+    static long long encode(FixedPoint<Places> const& p_value)
+    {
+        return p_value.units();
+    }
+
+    static FixedPoint<Places> decode(long long p_stored)
+    {
+        return FixedPoint<Places>(p_stored);
+    }
+};
+
+
+}  // namespace sqloxx
+
+#endif  // GUARD_codec_hpp_9093195618243942
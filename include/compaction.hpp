@@ -0,0 +1,123 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef GUARD_compaction_hpp_3290413447630031
+#define GUARD_compaction_hpp_3290413447630031
+
+#include "database_connection_fwd.hpp"
+#include <chrono>
+#include <cstddef>
+#include <functional>
+
+namespace sqloxx
+{
+
+/**
+ * Governs how compact_database obtains a copy of the database that is
+ * consistent with the database at the time the copy is swapped in.
+ */
+struct CompactionPolicy
+{
+    /**
+     * Sets \e max_online_attempts to 3, and leaves \e copy_callback
+     * empty.
+     */
+    CompactionPolicy();
+
+    // The number of copies made while other connections may continue to
+    // write to the database, before the database is instead vacuumed in
+    // place, holding the write lock throughout.
+    std::size_t max_online_attempts;
+
+    // If set, called with the number of copies made so far, once each
+    // such copy has been made and vacuumed, and before the write lock is
+    // taken; for example, to report progress.
+    std::function<void(std::size_t)> copy_callback;
+};
+
+
+/**
+ * Describes a call to compact_database.
+ */
+struct CompactionStats
+{
+    CompactionStats();
+
+    // The size of the database in pages, and the number of those pages on
+    // the free list, before and after compaction.
+    long long pages_before;
+    long long free_pages_before;
+    long long pages_after;
+    long long free_pages_after;
+
+    // Copies discarded because a transaction was committed to the
+    // database meanwhile.
+    std::size_t discarded_copies;
+
+    // Time spent copying and vacuuming, and time for which the write lock
+    // on the database was held.
+    std::chrono::steady_clock::duration copy_time;
+    std::chrono::steady_clock::duration lock_time;
+};
+
+
+/**
+ * Defragments the database to which \e p_connection is open, while
+ * permitting other connections to continue using it for most of the
+ * time taken. Unlike a plain "vacuum", which holds an exclusive lock
+ * throughout, this proceeds as follows.
+ *
+ * A consistent copy of the database is made, through \e p_connection,
+ * into a temporary file alongside it (with "-compact" appended to its
+ * name, and opened through the same VFS), and the copy is vacuumed, so
+ * that the rows of each table and index are stored contiguously and in
+ * order. Only then is the write lock on the database taken, by SQLite's
+ * online backup API, which, if nothing has been committed to the
+ * database since the copy was begun, writes the vacuumed copy back over
+ * it within a single transaction. Otherwise the copy is discarded and
+ * another is made, up to CompactionPolicy::max_online_attempts times;
+ * after that, the database is vacuumed in place, holding the write lock
+ * throughout. Finally the temporary file is removed.
+ *
+ * Other connections to the database, including those held in a
+ * ConnectionManager or ConnectionRouter, need not be reopened: they see
+ * the compacted database from their next transaction, as they would any
+ * other committed change.
+ *
+ * Commits made during the copy, by any connection, are detected by
+ * comparing DatabaseConnection::commit_marker as read before the copy
+ * with the marker as read once the write lock is held.
+ *
+ * @throws LogicError if a DatabaseTransaction is open on
+ * \e p_connection.
+ *
+ * @throws SQLiteBusy if the write lock could not be obtained, as where
+ * another connection is writing. No busy timeout is applied.
+ *
+ * @throws InvalidConnection if \e p_connection is invalid.
+ *
+ * <b>Exception safety</b>: <em>strong guarantee</em>, provided the
+ * temporary file can be removed.
+ */
+CompactionStats compact_database
+(   DatabaseConnection& p_connection,
+    CompactionPolicy const& p_policy = CompactionPolicy()
+);
+
+}  // namespace sqloxx
+
+#endif  // GUARD_compaction_hpp_3290413447630031
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_connection_manager_hpp_8583258917575624
+#define GUARD_connection_manager_hpp_8583258917575624
+
+#include "database_connection.hpp"
+#include "open_options.hpp"
+#include <boost/filesystem/path.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace sqloxx
+{
+
+/**
+ * Governs how many connections a ConnectionManager keeps open.
+ */
+struct ConnectionManagerPolicy
+{
+    /**
+     * Sets \e max_connections to 64, \e max_file_handles to 0 and
+     * \e file_handles_per_connection to 3.
+     */
+    ConnectionManagerPolicy();
+
+    // The most connections that may be open at once.
+    std::size_t max_connections;
+
+    // The most file handles the connections may use between them, or 0
+    // for no limit other than max_connections.
+    std::size_t max_file_handles;
+
+    // The number of file handles to allow for each connection: its
+    // database file, plus its journal, or WAL and shared memory files.
+    std::size_t file_handles_per_connection;
+};
+
+
+/**
+ * Keeps open a bounded number of DatabaseConnections to any number of
+ * database files, such as one file per tenant, so that a file used
+ * repeatedly need not be opened afresh each time, and its connection
+ * retains its cached statements and IdentityMaps.
+ *
+ * A connection is obtained by leasing it with lease(). While leased, a
+ * connection is used exclusively by the holder of the lease. When the
+ * number of open connections has reached the capacity allowed by the
+ * ConnectionManagerPolicy and a connection is needed for another file,
+ * the least recently used connection that is not leased is closed. If
+ * every open connection is leased, lease() waits until one is released.
+ *
+ * ConnectionManager is thread-safe. However, if SQLite has been built
+ * without mutexes (see Info::sqlite_is_thread_safe), the connections it
+ * leases must all be used on the same thread.
+ */
+class ConnectionManager
+{
+public:
+
+    typedef std::function<std::unique_ptr<DatabaseConnection>()> Factory;
+
+    struct Stats
+    {
+        Stats();
+
+        // Leases of an already open connection, and leases requiring a
+        // connection to be opened.
+        std::size_t hits;
+        std::size_t misses;
+
+        // Connections opened, and connections closed to make room.
+        std::size_t opens;
+        std::size_t evictions;
+
+        // Number of times lease() had to wait for a lease to be released.
+        std::size_t waits;
+
+        // Number of connections currently open.
+        std::size_t open_connections;
+
+        // Time taken by the last DatabaseConnection::open, and the
+        // longest any has taken.
+        std::chrono::steady_clock::duration last_open_latency;
+        std::chrono::steady_clock::duration max_open_latency;
+    };
+
+    /**
+     * Gives the holder exclusive use of an open connection, which is
+     * returned to the ConnectionManager when the Lease is destroyed.
+     */
+    class Lease
+    {
+    public:
+        friend class ConnectionManager;
+        Lease(Lease&& rhs);
+        Lease(Lease const&) = delete;
+        Lease& operator=(Lease const&) = delete;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease();
+
+        DatabaseConnection& connection() const;
+
+    private:
+        Lease
+        (   ConnectionManager& p_manager,
+            std::string const& p_key,
+            DatabaseConnection& p_connection
+        );
+        ConnectionManager* m_manager;
+        std::string m_key;
+        DatabaseConnection* m_connection;
+    };
+
+    /**
+     * @param p_policy limits the number of open connections.
+     *
+     * @param p_options the options with which each file is opened.
+     *
+     * @param p_factory creates each connection before it is opened. By
+     * default a plain DatabaseConnection is created; a factory creating
+     * an instance of a class derived from DatabaseConnection can be
+     * supplied, so that the derived class's \e do_setup() is called when
+     * the connection is opened.
+     *
+     * @throws LogicError if \e p_policy allows no connections to be open.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    explicit ConnectionManager
+    (   ConnectionManagerPolicy const& p_policy = ConnectionManagerPolicy(),
+        OpenOptions const& p_options = OpenOptions(),
+        Factory const& p_factory = Factory()
+    );
+
+    ConnectionManager(ConnectionManager const&) = delete;
+    ConnectionManager(ConnectionManager&&) = delete;
+    ConnectionManager& operator=(ConnectionManager const&) = delete;
+    ConnectionManager& operator=(ConnectionManager&&) = delete;
+
+    /**
+     * Closes the connections. No Lease may be outstanding.
+     */
+    ~ConnectionManager();
+
+    /**
+     * @returns a lease on a connection to the file at \e p_filepath,
+     * opening one, and closing the least recently used connection to
+     * make room for it, if necessary. Waits if the connection to
+     * \e p_filepath is already leased, or if a connection must be closed
+     * but every open connection is leased.
+     *
+     * @throws any exception thrown by the factory or by
+     * DatabaseConnection::open.
+     *
+     * <b>Exception safety</b>: <em>basic guarantee</em>. Another
+     * connection may have been closed even if this one could not be
+     * opened.
+     */
+    Lease lease(boost::filesystem::path const& p_filepath);
+
+    /**
+     * Closes the connection to the file at \e p_filepath, if one is open
+     * and not leased.
+     *
+     * @returns \e true if a connection was closed.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    bool close(boost::filesystem::path const& p_filepath);
+
+    /**
+     * @returns the greatest number of connections that may be open at
+     * once, as allowed by the ConnectionManagerPolicy.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    std::size_t capacity() const;
+
+    /**
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    Stats stats() const;
+
+private:
+
+    typedef std::list<std::string> Recency;
+
+    struct Entry
+    {
+        // Null while the connection is being opened.
+        std::unique_ptr<DatabaseConnection> connection;
+        bool is_leased;
+        Recency::iterator recency;
+    };
+
+    void release(std::string const& p_key) noexcept;
+
+    // Removes the least recently used entry that is not leased, if there
+    // is one, moving its connection into p_evicted. Caller must hold
+    // m_mutex, and should destroy p_evicted after releasing it.
+    bool evict_one(std::unique_ptr<DatabaseConnection>& p_evicted);
+
+    // Removes the entry at p_position, returning its connection. Caller
+    // must hold m_mutex, and should destroy the connection (so closing
+    // its database) after releasing it.
+    std::unique_ptr<DatabaseConnection> erase
+    (   std::unordered_map<std::string, Entry>::iterator p_position
+    );
+
+    std::size_t const m_capacity;
+    OpenOptions const m_options;
+    Factory const m_factory;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_released;
+    std::unordered_map<std::string, Entry> m_entries;
+
+    // Keys of m_entries, most recently leased first.
+    Recency m_recency;
+    Stats m_stats;
+
+};  // class ConnectionManager
+
+}  // namespace sqloxx
+
+#endif  // GUARD_connection_manager_hpp_8583258917575624
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_connection_router_hpp_9076839550698607
+#define GUARD_connection_router_hpp_9076839550698607
+
+#include "database_connection.hpp"
+#include "open_options.hpp"
+#include "sql_statement.hpp"
+#include <boost/filesystem/path.hpp>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace sqloxx
+{
+
+/**
+ * Routes work on a single database file between one writer connection
+ * and a pool of reader connections, so that reads may proceed on several
+ * threads at once while writes are made one at a time.
+ *
+ * The database is put into WAL mode, under which readers neither block
+ * nor are blocked by the writer. All writes are made by a dedicated
+ * thread, which owns the writer connection and executes the tasks
+ * submitted to it in the order they were submitted; since no other
+ * connection in the router writes, writes do not contend for the
+ * database lock. Reader connections are opened with the "query_only"
+ * pragma set, and are leased to one thread at a time.
+ *
+ * SQLStatements executed through execute() are dispatched according to
+ * SQLStatement::is_read_only. Transaction control statements are
+ * reported as read-only, and so should not be executed through
+ * execute(); a write task that needs a transaction should use a
+ * DatabaseTransaction on the writer connection.
+ *
+ * The member functions of ConnectionRouter may be called concurrently
+ * from any number of threads.
+ */
+class ConnectionRouter
+{
+public:
+
+    typedef std::function<void(DatabaseConnection&)> WriteTask;
+    typedef std::function<void(SQLStatement&)> StatementTask;
+
+    struct Stats
+    {
+        Stats();
+
+        // Number of statements executed on reader connections by
+        // execute().
+        std::size_t reads;
+
+        // Number of tasks submitted to the writer, including statements
+        // dispatched to it by execute().
+        std::size_t writes;
+
+        // Number of times a reader connection had to be waited for.
+        std::size_t reader_waits;
+
+        // Number of write tasks currently queued, and the greatest number
+        // there has been.
+        std::size_t backlog;
+        std::size_t peak_backlog;
+    };
+
+    /**
+     * Gives the holder exclusive use of a reader connection, which is
+     * returned to the pool when the ReaderLease is destroyed.
+     */
+    class ReaderLease
+    {
+    public:
+        friend class ConnectionRouter;
+        ReaderLease(ReaderLease&& rhs);
+        ReaderLease(ReaderLease const&) = delete;
+        ReaderLease& operator=(ReaderLease const&) = delete;
+        ReaderLease& operator=(ReaderLease&&) = delete;
+        ~ReaderLease();
+
+        DatabaseConnection& connection() const;
+
+    private:
+        ReaderLease
+        (   ConnectionRouter& p_router,
+            DatabaseConnection& p_connection
+        );
+        ConnectionRouter* m_router;
+        DatabaseConnection* m_connection;
+    };
+
+    /**
+     * Opens the writer connection and \e p_readers reader connections to
+     * the file at \e p_filepath, each with \e p_options, puts the
+     * database into WAL mode, and starts the writer thread.
+     *
+     * @throws LogicError if \e p_readers is zero, or if SQLite has been
+     * built without mutexes (see Info::sqlite_is_thread_safe).
+     *
+     * @throws DatabaseException if the database cannot be put into WAL
+     * mode (as is the case, for example, for an in-memory database).
+     *
+     * @throws any exception thrown by DatabaseConnection::open.
+     *
+     * <b>Exception safety</b>: <em>basic guarantee</em>. The file may
+     * have been created, and put into WAL mode.
+     */
+    ConnectionRouter
+    (   boost::filesystem::path const& p_filepath,
+        std::size_t p_readers,
+        OpenOptions const& p_options = OpenOptions()
+    );
+
+    ConnectionRouter(ConnectionRouter const&) = delete;
+    ConnectionRouter(ConnectionRouter&&) = delete;
+    ConnectionRouter& operator=(ConnectionRouter const&) = delete;
+    ConnectionRouter& operator=(ConnectionRouter&&) = delete;
+
+    /**
+     * Executes any write tasks still queued, then stops the writer
+     * thread and closes the connections. No ReaderLease may be
+     * outstanding.
+     */
+    ~ConnectionRouter();
+
+    /**
+     * @returns a lease on a reader connection, waiting for one to be
+     * returned to the pool if all are leased.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    ReaderLease lease_reader();
+
+    /**
+     * Queues \e p_task to be called, on the writer thread, with the
+     * writer connection.
+     *
+     * @returns a future that becomes ready once \e p_task has been
+     * called, and that holds any exception it threw.
+     *
+     * @throws std::bad_alloc in the unlikely event of memory allocation
+     * failure.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    std::future<void> submit_write(WriteTask p_task);
+
+    /**
+     * Prepares \e p_sql on a leased reader connection. If the resulting
+     * statement is read-only, calls \e p_task with it on the calling
+     * thread, before returning. Otherwise queues \e p_task to be called
+     * on the writer thread with the same statement prepared on the
+     * writer connection, as for submit_write. In either case \e p_task
+     * is expected to bind any parameters and step through the statement.
+     *
+     * @returns a future that becomes ready once \e p_task has been
+     * called, and that holds any exception it threw.
+     *
+     * @throws SQLiteException, or an exception derived therefrom, if
+     * \e p_sql cannot be prepared.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>, as far as the
+     * router itself is concerned.
+     */
+    std::future<void> execute
+    (   std::string const& p_sql,
+        StatementTask p_task
+    );
+
+    /**
+     * @returns the number of reader connections.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    std::size_t readers() const;
+
+    /**
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    Stats stats() const;
+
+private:
+
+    void release_reader(DatabaseConnection& p_connection) noexcept;
+
+    // Run by m_thread.
+    void run_writer();
+
+    std::unique_ptr<DatabaseConnection> m_writer;
+    std::vector<std::unique_ptr<DatabaseConnection> > m_readers;
+
+    // Protects m_idle_readers and the reader counts in m_stats.
+    mutable std::mutex m_readers_mutex;
+    std::condition_variable m_reader_returned;
+    std::vector<DatabaseConnection*> m_idle_readers;
+
+    // Protects m_queue, m_stopping and the writer counts in m_stats.
+    mutable std::mutex m_queue_mutex;
+    std::condition_variable m_queue_wake;
+    std::deque<std::packaged_task<void()> > m_queue;
+    bool m_stopping;
+
+    Stats m_stats;
+    std::thread m_thread;
+
+};  // class ConnectionRouter
+
+}  // namespace sqloxx
+
+#endif  // GUARD_connection_router_hpp_9076839550698607
@@ -17,23 +17,36 @@
 #ifndef GUARD_database_connection_hpp_4041979952734886
 #define GUARD_database_connection_hpp_4041979952734886
 
+#include "io_stats.hpp"
+#include "open_options.hpp"
+#include "schema.hpp"
 #include "sqloxx_exceptions.hpp"
+#include "statement_key.hpp"
+#include "wal_archive.hpp"
 #include <boost/filesystem/path.hpp>
 #include <boost/optional.hpp>
+#include <functional>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace sqloxx
 {
 
 // Forward declarations
 
+class ResultCache;
+class SecondLevelCache;
+class StatementSlot;
+
 namespace detail
 {
     class SQLiteDBConn;
     class SQLStatementImpl;
+    class WalArchiver;
 }  // namespace detail
 
 /**
@@ -46,9 +59,29 @@ class DatabaseConnection
 {
 public:
 
+    /**
+     * An entry in the statement cache. Where the statement was not
+     * provided via a static StatementKey, \e text holds the copy of its
+     * text to which the key of the entry points; otherwise \e text is
+     * null.
+     */
+    struct CachedStatement
+    {
+        std::unique_ptr<std::string const> text;
+        std::shared_ptr<detail::SQLStatementImpl> statement;
+    };
+
+    /**
+     * Statement structures are cached by StatementKey, so that
+     * looking up a statement compares (usually identical) pointers to
+     * statement text, rather than whole strings. Statement texts built at
+     * runtime are copied into the cache entry, and freed with it.
+     */
     typedef
         std::unordered_map
-        <    std::string, std::shared_ptr<detail::SQLStatementImpl>
+        <    StatementKey,
+            CachedStatement,
+            StatementKey::Hash
         >
         StatementCache;
     
@@ -96,16 +129,31 @@ public:
      * \e foreign_keys is always executed immediately the file is opened, to
      * enable foreign key constraints.
      *
+     * If a Schema has been set (see set_schema()), the database is then
+     * migrated to the current version of the Schema, if it is not already
+     * at that version (see Schema::migrate). Checking the version is
+     * cheap, so that creating tables and the like can be left to the
+     * Schema's migrations, and need not be repeated each time a database
+     * is opened.
+     *
      * As a final step in this function, \b do_setup() is called.
      * This is a private virtual function which by default does nothing.
      * Derived classes may override it to provide their own initialization
-     * code.
+     * code. As it is called each time a database is opened, it is best
+     * confined to initialization that is not persisted in the database,
+     * such as setting pragmas.
      *
      * @param p_filepath File to connect to. The is in the form of a
      * \c boost::filesystem::path to facilitate portability.
      *
+     * @param p_options governs how the file is opened, for example through
+     * which SQLite VFS.
+     *
      * @throws sqloxx::InvalidFilename if filename is an empty string.
      *
+     * @throws sqloxx::NoSuchVFS if \e p_options names a VFS that has not
+     * been registered.
+     *
      * @throws sqloxx::MultipleConnectionException if already connected to a
      * database (be it this or another database).
      *
@@ -113,13 +161,20 @@ public:
      * not guaranteed, to be SQLiteCantOpen) if for some other reason the
      * connection cannot be opened.
      *
+     * @throws SchemaMismatch, or any exception thrown by a migration, if
+     * the database cannot be migrated to the Schema. The connection is
+     * then left open, but the database is unchanged.
+     *
      * <b>Exception safety</b>: appears to offer the <em>basic guarantee</em>,
      * <em>however</em> this has not been properly tested. This wraps
      * a SQLite function for which the error-safety is not clear. If the
      * derived class overrides \b do_setup(), then this may affect exception
      * safety, since \b do_setup() is called by the open() function.
      */
-    void open(boost::filesystem::path const& p_filepath);
+    void open
+    (   boost::filesystem::path const& p_filepath,
+        OpenOptions const& p_options = OpenOptions()
+    );
 
     /**
      * Executes a string as an SQL command on the database connection.
@@ -178,6 +233,318 @@ public:
      */
     boost::filesystem::path filepath() const;
 
+    /**
+     * @returns the options with which the database connection was last
+     * opened.
+     *
+     * @throws InvalidConnection if the database connection
+     * has not been opened to a file, or if the database connection
+     * is otherwise invalid.
+     */
+    OpenOptions const& open_options() const;
+
+    /**
+     * @returns the number of DatabaseTransactions currently open on this
+     * connection (0 if none).
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    int transaction_nesting_level() const;
+
+    /**
+     * Attaches \e p_cache as the SecondLevelCache for this connection, in
+     * place of any previously attached. \e p_cache may be shared with other
+     * connections to the same database. Pass a null pointer to detach.
+     * Whenever a transaction that has written to the database is
+     * committed on this connection, the epoch of the attached cache is
+     * advanced, both as the commit begins and once it has completed.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    void set_second_level_cache(std::shared_ptr<SecondLevelCache> p_cache);
+
+    /**
+     * @returns a pointer to the SecondLevelCache attached to this
+     * connection, or a null pointer if none is attached.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    SecondLevelCache* second_level_cache() const;
+
+    /**
+     * Sets \e p_schema as the Schema to which databases are migrated when
+     * opened by this connection (see open()). This should be called before
+     * open(), typically by the constructor of a class derived from
+     * DatabaseConnection.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void set_schema(Schema const& p_schema);
+
+    /**
+     * @returns the ResultCache of this connection, used by SQLStatements
+     * for which SQLStatement::enable_result_cache has been called.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    ResultCache& result_cache();
+
+    /**
+     * Enables the ResultCache for this connection. Until this is called,
+     * SQLStatement::enable_result_cache has no effect; nor is the SQLite
+     * authorizer, by which the tables each statement reads and writes are
+     * recorded, installed, so connections that do not use the cache pay
+     * nothing for it. Statements already prepared on this connection are
+     * dropped from its statement cache, so as to be prepared afresh. If
+     * the ResultCache is already enabled, this has no effect beyond that.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    void enable_result_cache();
+
+    /**
+     * @returns counts of the I/O performed by SQLite on behalf of this
+     * connection since it was opened, by kind of file. These are counted
+     * only if the connection was opened with OpenOptions::io_stats set;
+     * otherwise the counts are all zero. To attribute I/O to a particular
+     * transaction, see DatabaseTransaction::io_stats.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    IoStats io_stats() const;
+
+    /**
+     * Replaces the contents of the database to which \e p_destination is
+     * open with a copy of the database to which this connection is open,
+     * using SQLite's online backup API. The copy is made within a single
+     * read transaction on this connection, and a single write transaction
+     * on \e p_destination, and so is consistent, and appears atomically
+     * to other connections to the destination.
+     *
+     * @throws SQLiteBusy if either database is locked by another
+     * connection.
+     *
+     * @throws InvalidConnection if either connection is invalid.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void backup_to(DatabaseConnection& p_destination);
+
+    /**
+     * @returns a marker of the state of the database to which this
+     * connection is open, which changes whenever a transaction is
+     * committed to the database, through any connection (whether or not
+     * change tracking is enabled on it). The marker is read from the
+     * database file header, or, in WAL mode, from the header of the WAL
+     * index. Markers read at different times may differ even where
+     * nothing has been committed in between (for example where the WAL
+     * has been reset), but never the reverse.
+     *
+     * @throws InvalidConnection if the connection is invalid.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    std::string commit_marker();
+
+    /**
+     * As backup_to, except that, once the write lock on the database of
+     * \e p_destination is held and before anything is copied, the
+     * commit_marker() of \e p_destination is compared with
+     * \e p_destination_marker. If they differ, the lock is released and
+     * nothing is copied. A copy of a database can thus be written back
+     * over it only if nothing has been committed to it since the marker
+     * was read. \e p_destination must not be in a transaction.
+     *
+     * @returns \e true if the copy was made, or \e false if
+     * \e p_destination was unchanged because the markers differed.
+     *
+     * @throws SQLiteBusy if either database is locked by another
+     * connection.
+     *
+     * @throws InvalidConnection if either connection is invalid.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    bool backup_to_if_unchanged
+    (   DatabaseConnection& p_destination,
+        std::string const& p_destination_marker
+    );
+
+    /**
+     * Starts archiving the WAL of the database into \e p_directory, so
+     * that the database can later be rebuilt as it stood after any
+     * archived commit, using restore_wal_archive. The database must be in
+     * WAL mode.
+     *
+     * A base snapshot of the database is first written into
+     * \e p_directory, which is created if necessary and must otherwise be
+     * empty, so that each archive records a single unbroken run of
+     * archiving. Thereafter, whenever a transaction is committed on this
+     * connection, the frames appended to the WAL since the last commit,
+     * including those of other connections, are appended to the archive,
+     * with their commit boundaries. Once the WAL holds
+     * WalArchivePolicy::checkpoint_frames frames, this connection
+     * takes the write lock (through a connection of its own, opened on
+     * the same VFS), archives every frame then in the WAL, and
+     * checkpoints it, in place of SQLite's automatic checkpoints, which
+     * are turned off on this connection. Archiving is
+     * thus incremental, writing only the pages changed by each commit.
+     *
+     * Frames checkpointed before they are archived are lost from the
+     * archive, as the WAL is restarted after a checkpoint. The archive
+     * is therefore complete only if no other connection checkpoints the
+     * WAL; this is so where this is the only connection writing to the
+     * database (as with the writer of a ConnectionRouter), or where every
+     * other writer has automatic checkpoints turned off.
+     *
+     * If appending to the archive fails, the failure is counted in
+     * wal_archive_stats(), and the WAL is not checkpointed, so that the
+     * frames are archived on a later commit instead.
+     *
+     * @throws LogicError if a DatabaseTransaction is open, if the
+     * database is not in WAL mode, if archiving has already been enabled,
+     * or if \e p_directory is not empty.
+     *
+     * @throws SQLiteBusy if another connection is writing to the
+     * database.
+     *
+     * @throws WalArchiveException if \e p_directory cannot be created, or
+     * the WAL cannot be read.
+     *
+     * <b>Exception safety</b>: <em>basic guarantee</em>. \e p_directory
+     * may have been created even if an exception is thrown.
+     */
+    void enable_wal_archiving
+    (   boost::filesystem::path const& p_directory,
+        WalArchivePolicy const& p_policy = WalArchivePolicy()
+    );
+
+    /**
+     * @returns counts of the work done by WAL archiving on this
+     * connection (see enable_wal_archiving()), which are all zero if it
+     * has not been enabled.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    WalArchiveStats wal_archive_stats() const;
+
+    typedef std::function<void(std::string const& p_table)> ChangeListener;
+
+    /**
+     * Turns on tracking of changes to the database made by other
+     * connections, including those in other processes, so that objects
+     * cached on this connection can be dropped when the rows they were
+     * loaded from may have changed.
+     *
+     * Changes are recorded in a change log table, "sqloxx_change_log",
+     * holding a version number for each table. When the outermost
+     * DatabaseTransaction that has written to a table commits on a
+     * tracking connection, the version of that table is advanced, within
+     * the same transaction. Beginning an outermost DatabaseTransaction
+     * on a tracking connection compares the versions with those last seen
+     * (as does check_for_changes()); for each table advanced meanwhile by
+     * another connection, the results read from it are dropped from the
+     * ResultCache, and each ChangeListener is called; and if any table
+     * has been advanced, the epoch of any attached SecondLevelCache is
+     * also advanced. An IdentityMap on this connection registers a
+     * ChangeListener, by which it uncaches objects in its table that are
+     * cached only by virtue of enable_caching.
+     *
+     * Only writes made within a DatabaseTransaction are recorded, and
+     * only by connections on which change tracking is on; writes by other
+     * means are not detected. Writes to "without rowid" tables, and
+     * deletions by "delete from" without a "where" clause, are not
+     * detected either, as SQLite does not report them to its update hook.
+     *
+     * This should be called after open(), typically by do_setup(). If
+     * tracking is already on, it has no effect.
+     *
+     * @throws InvalidConnection if the connection is invalid.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void enable_change_tracking();
+
+    /**
+     * Compares the versions in the change log with those last seen, and
+     * notifies changes made by other connections as described for
+     * enable_change_tracking(). This is done automatically on beginning
+     * each outermost DatabaseTransaction, and need be called only
+     * before reading outside any transaction.
+     *
+     * @returns \e true if and only if any table has been changed by
+     * another connection since the versions were last seen.
+     *
+     * @throws LogicError if change tracking is not on.
+     *
+     * @throws InvalidConnection if the connection is invalid.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>, provided the
+     * ChangeListeners do not throw.
+     */
+    bool check_for_changes();
+
+    /**
+     * Registers \e p_listener to be called with the name of each table
+     * changed by another connection, as detected by check_for_changes().
+     * Listeners must not throw.
+     *
+     * @returns an id by which the listener can be removed.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    int add_change_listener(ChangeListener const& p_listener);
+
+    /**
+     * Removes the ChangeListener with id \e p_id, if there is one.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    void remove_change_listener(int p_id) noexcept;
+
+    typedef std::function<void()> TransactionCallback;
+
+    /**
+     * Registers \e p_callback to be called once the changes made in the
+     * innermost DatabaseTransaction currently active on this connection
+     * are durably committed: that is, once the outermost
+     * DatabaseTransaction is committed. If the innermost transaction is
+     * nested, and is committed (releasing its savepoint), the callback
+     * passes to the enclosing transaction; if it, or any enclosing
+     * transaction, is cancelled, the callback is discarded. If no
+     * transaction is active, \e p_callback is called immediately.
+     *
+     * Callbacks are called in the order in which they were registered,
+     * after the commit is complete and the DatabaseTransaction has become
+     * inactive, so they may use this connection, including to begin
+     * further transactions. If a callback throws, the exception
+     * propagates from DatabaseTransaction::commit, and the remaining
+     * callbacks are discarded; the commit itself stands.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>, except where no
+     * transaction is active, in which case it is as for \e p_callback.
+     */
+    void on_commit(TransactionCallback const& p_callback);
+
+    /**
+     * Registers \e p_callback to be called if the changes made in the
+     * innermost DatabaseTransaction currently active on this connection
+     * are rolled back: that is, when that transaction, or any transaction
+     * enclosing it, is cancelled. The callback is discarded once the
+     * outermost DatabaseTransaction is committed. If no transaction is
+     * active, \e p_callback is discarded.
+     *
+     * Callbacks are called in the order in which they were registered,
+     * after the rollback is complete. If a callback throws, the exception
+     * propagates from DatabaseTransaction::cancel, and the remaining
+     * callbacks are discarded. (If the rollback was made by the
+     * destructor of DatabaseTransaction, the exception is instead logged
+     * and dropped.)
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void on_rollback(TransactionCallback const& p_callback);
+
     ///@cond
 
     /**
@@ -194,6 +561,16 @@ public:
             (   DatabaseConnection& p_database_connection,
                 std::string const& p_statement_text
             );
+        static std::shared_ptr<detail::SQLStatementImpl>
+            provide_sql_statement
+            (   DatabaseConnection& p_database_connection,
+                StatementSlot const& p_statement_slot
+            );
+        static std::shared_ptr<detail::SQLStatementImpl>
+            provide_sql_statement
+            (   DatabaseConnection& p_database_connection,
+                StatementKey const& p_statement_key
+            );
     };
 
     friend class StatementAttorney;
@@ -209,7 +586,8 @@ public:
         friend class DatabaseTransaction;
     private:
         static void begin_transaction
-        (   DatabaseConnection& p_database_connection
+        (   DatabaseConnection& p_database_connection,
+            bool p_is_immediate
         );
         static void end_transaction
         (   DatabaseConnection& p_database_connection
@@ -217,6 +595,9 @@ public:
         static void cancel_transaction
         (   DatabaseConnection& p_database_connection
         );
+        static void run_transaction_callbacks
+        (   DatabaseConnection& p_database_connection
+        );
     };
 
     friend class TransactionAttorney;
@@ -281,12 +662,58 @@ private:
     (   std::string const& statement_text
     );
 
+    /**
+     * As for provide_sql_statement(std::string const&), but the statement
+     * is looked up by a StatementKey, the hash of which has already been
+     * computed (possibly at compile time). \e p_statement_key must be
+     * either constructed from a string literal, or interned (see
+     * StatementKey).
+     *
+     * Exceptions and exception safety are as for
+     * provide_sql_statement(std::string const&).
+     */
+    std::shared_ptr<detail::SQLStatementImpl> provide_sql_statement
+    (   StatementKey const& p_statement_key
+    );
+
+    /**
+     * Implements the provide_sql_statement functions that use
+     * m_statement_cache. \e p_key is used for lookup. If \e p_text is
+     * non-null, then \e p_key is taken to refer to \e *p_text, which
+     * is copied into the cache entry if the statement is added to the
+     * cache; otherwise, \e p_key is itself stored in the cache.
+     */
+    std::shared_ptr<detail::SQLStatementImpl> provide_cached_sql_statement
+    (   StatementKey const& p_key,
+        std::string const* p_text
+    );
+
+    /**
+     * As for provide_sql_statement(std::string const&), but the statement
+     * structure is looked up by the index of \e p_statement_slot, in
+     * an array of statements kept by this DatabaseConnection,
+     * rather than by hashing the statement text. If the statement
+     * structure for \e p_statement_slot is currently locked (for example
+     * because the same StatementSlot is in use further up the call stack),
+     * this falls back on provide_sql_statement(std::string const&).
+     *
+     * Statements stored in slots do not count towards the capacity of
+     * the statement cache.
+     *
+     * Exceptions and exception safety are as for
+     * provide_sql_statement(std::string const&).
+     */
+    std::shared_ptr<detail::SQLStatementImpl> provide_sql_statement
+    (   StatementSlot const& p_statement_slot
+    );
+
     /**
      * Begins a SQL transaction. Transactions may be nested. Only the
      * outermost call to begin_transaction causes the "begin transaction"
      * SQL command to be executed. Inner calls instead cause a
      * transaction savepoint to be set (see SQLite documentation
-     * re. savepoints).
+     * re. savepoints). If \e p_is_immediate, the outermost call executes
+     * "begin immediate" instead, taking the write lock at once.
      *
      * SQL transactions should be controlled either solely through the
      * methods begin_transaction and end_transaction, \e or solely through
@@ -308,7 +735,7 @@ private:
      * canced_transaction(), rather than by executing the corresponding
      * SQL commands directly.
      */
-    void begin_transaction();
+    void begin_transaction(bool p_is_immediate = false);
 
     /**
      * Ends a SQL transaction. Transactions may be nested. Only the outermost
@@ -350,13 +777,50 @@ private:
      */
     void cancel_transaction();
 
-    void unchecked_begin_transaction();
+    void unchecked_begin_transaction(bool p_is_immediate = false);
     void unchecked_end_transaction();
     void unchecked_set_savepoint();
     void unchecked_release_savepoint();
     void unchecked_rollback_transaction();
     void unchecked_rollback_to_savepoint();
 
+    typedef std::map<std::string, long long> ChangeVersions;
+
+    // Reads the versions in the change log.
+    ChangeVersions read_change_versions();
+
+    // Returns the sum of m_change_versions.
+    long long sum_change_versions() const noexcept;
+
+    // Advances, in the change log, the versions of the tables written
+    // since the outermost transaction began, returning their new
+    // versions. Called before committing the outermost transaction.
+    ChangeVersions publish_changes();
+
+    // Calls m_page_count_handler if the database has newly reached
+    // m_page_count_threshold pages. Called before committing the
+    // outermost transaction.
+    void check_page_count();
+
+    // A callback registered by on_commit() or on_rollback(), with the
+    // nesting level of the transaction to which it belongs; or 0 once
+    // the transaction is resolved and the callback is due to be called.
+    struct PendingCallback
+    {
+        int level;
+        bool is_on_commit;
+        TransactionCallback callback;
+    };
+
+    // Updates m_pending_callbacks on the commit or cancellation of the
+    // transaction at nesting level p_level.
+    void resolve_transaction_callbacks(int p_level, bool p_is_committed)
+        noexcept;
+
+    // Calls, and removes, the callbacks that are due. Called by
+    // DatabaseTransaction once it has become inactive.
+    void run_transaction_callbacks();
+
     std::unique_ptr<detail::SQLiteDBConn> m_sqlite_dbconn;
 
     // s_max_nesting relies on m_transaction_nesting_level being an int
@@ -366,7 +830,44 @@ private:
     StatementCache m_statement_cache;
     StatementCache::size_type m_cache_capacity;
 
+    // Statements provided via StatementSlot, indexed by
+    // StatementSlot::index(). Null where not yet prepared.
+    std::vector<std::shared_ptr<detail::SQLStatementImpl> >
+        m_slot_statements;
+
     boost::optional<boost::filesystem::path> m_filepath;
+    OpenOptions m_open_options;
+
+    std::shared_ptr<SecondLevelCache> m_second_level_cache;
+
+    boost::optional<Schema> m_schema;
+
+    // Change tracking state. m_written_tables holds the tables written
+    // since the outermost transaction began; m_all_tables_written is set
+    // instead if recording a table failed for lack of memory.
+    // m_change_version_sum is the sum of m_change_versions, against which
+    // check_for_changes first compares the sum in the change log.
+    bool m_is_tracking_changes;
+    ChangeVersions m_change_versions;
+    long long m_change_version_sum;
+    std::set<std::string> m_written_tables;
+    bool m_all_tables_written;
+    std::map<int, ChangeListener> m_change_listeners;
+    int m_last_change_listener_id;
+
+    // Page count warning state (see OpenOptions::page_count_handler).
+    // m_is_page_count_warned is set while the database is at or above
+    // m_page_count_threshold.
+    OpenOptions::PageCountHandler m_page_count_handler;
+    long long m_max_page_count;
+    long long m_page_count_threshold;
+    bool m_is_page_count_warned;
+
+    std::vector<PendingCallback> m_pending_callbacks;
+
+    // Null unless enable_wal_archiving has been called. Declared after
+    // m_sqlite_dbconn, which it references, so as to be destroyed first.
+    std::unique_ptr<detail::WalArchiver> m_wal_archiver;
 };
 
 /// @cond
@@ -383,14 +884,39 @@ DatabaseConnection::StatementAttorney::provide_sql_statement
     );
 }
 
+inline
+std::shared_ptr<detail::SQLStatementImpl>
+DatabaseConnection::StatementAttorney::provide_sql_statement
+(   DatabaseConnection& p_database_connection,
+    StatementSlot const& p_statement_slot
+)
+{
+    return p_database_connection.provide_sql_statement
+    (   p_statement_slot
+    );
+}
+
+inline
+std::shared_ptr<detail::SQLStatementImpl>
+DatabaseConnection::StatementAttorney::provide_sql_statement
+(   DatabaseConnection& p_database_connection,
+    StatementKey const& p_statement_key
+)
+{
+    return p_database_connection.provide_sql_statement
+    (   p_statement_key
+    );
+}
+
 
 inline
 void
 DatabaseConnection::TransactionAttorney::begin_transaction
-(   DatabaseConnection& p_database_connection
+(   DatabaseConnection& p_database_connection,
+    bool p_is_immediate
 )
 {
-    p_database_connection.begin_transaction();
+    p_database_connection.begin_transaction(p_is_immediate);
     return;
 }
 
@@ -414,6 +940,16 @@ DatabaseConnection::TransactionAttorney::cancel_transaction
     return;
 }
 
+inline
+void
+DatabaseConnection::TransactionAttorney::run_transaction_callbacks
+(   DatabaseConnection& p_database_connection
+)
+{
+    p_database_connection.run_transaction_callbacks();
+    return;
+}
+
 /// @endcond
 
 }  // namespace sqloxx
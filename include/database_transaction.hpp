@@ -17,6 +17,9 @@
 #ifndef GUARD_database_transaction_hpp_3761349159181746
 #define GUARD_database_transaction_hpp_3761349159181746
 
+#include "io_stats.hpp"
+#include <boost/optional.hpp>
+#include <functional>
 
 namespace sqloxx
 {
@@ -109,6 +112,23 @@ class DatabaseTransaction
 {
 public:
 
+    /**
+     * The lock taken when an outermost transaction is begun. With
+     * \e deferred, no lock is taken until the database is first read,
+     * and the lock is upgraded for writing only when the database is
+     * first written, which fails with SQLiteBusy if another connection
+     * has written the database meanwhile. With \e immediate, the write
+     * lock is taken at once (waiting, as for any write, according to the
+     * connection's busy timeout), so that what is read within the
+     * transaction cannot be changed by another connection before it is
+     * committed.
+     */
+    enum class Lock
+    {
+        deferred,
+        immediate
+    };
+
     /**
      * <b>Preconditions</b>: see documentation for class.
      *
@@ -117,6 +137,9 @@ public:
      * is already an active transaction, a savepoint to be set. (See SQLite
      * documentation regarding the effect of setting a savepoint.)
      *
+     * @param p_lock determines the lock taken on beginning a transaction.
+     * It has no effect if a savepoint is set instead.
+     *
      * @throws TransactionNestingException in the extremely unlikely
      * event that the maximum
      * level of nesting has been reached. The maximum level of nesting is
@@ -134,7 +157,10 @@ public:
      * executing the SQL commands ("begin transaction", "end transaction"
      * etc.) directly.
      */
-    explicit DatabaseTransaction(DatabaseConnection& p_database_connection);
+    explicit DatabaseTransaction
+    (   DatabaseConnection& p_database_connection,
+        Lock p_lock = Lock::deferred
+    );
 
     DatabaseTransaction(DatabaseTransaction const&) = delete;
     DatabaseTransaction(DatabaseTransaction&&) = delete;
@@ -157,6 +183,10 @@ public:
      * client code should not rely on the destructor, but should call
      * cancel() explicitly. The destructor is rather a balwark against
      * the programmer forgetting to call cancel() manually.
+     * If a callback registered with on_rollback() (or
+     * DatabaseConnection::on_rollback) throws when called by the
+     * destructor, the exception is logged and dropped, and the remaining
+     * callbacks are discarded.
      *
      * <b>Exception safety</b>: <em>nothrow guarantee, but might call
      * std::terminate()</em>.
@@ -188,6 +218,10 @@ public:
      * (See SQLite documentation in relation
      * to the effect of releasing a savepoint.)
      *
+     * Once the transaction is committed and this DatabaseTransaction is
+     * inactive, any callbacks that have become due are called (see
+     * DatabaseConnection::on_commit).
+     *
      * @throws TransactionNestingException if called on an inactive
      * DatabaseTransaction (i.e. one on which cancel() or commit() has
      * already been called).
@@ -200,8 +234,11 @@ public:
      * the program exits without further SQL being executed on the
      * database connection.
      *
+     * Any exception thrown by a callback is propagated; the transaction
+     * nevertheless remains committed.
+     *
      * <b>Exception safety</b>: <em>strong guarantee</em>, provided the
-     * preconditions are met.
+     * preconditions are met and no callback throws.
      */
     void commit();
 
@@ -230,6 +267,12 @@ public:
      * (See SQLite documentation in relation
      * to the effect of releasing a savepoint.)
      *
+     * Once the transaction is cancelled and this DatabaseTransaction is
+     * inactive, any callbacks that have become due are called (see
+     * DatabaseConnection::on_rollback). Any exception thrown by a
+     * callback is propagated; the transaction nevertheless remains
+     * cancelled.
+     *
      * @throws TransactionNestingException if called on an inactive
      * DatabaseTransaction (i.e. one on which cancel() or commit() has
      * already been called).
@@ -247,10 +290,52 @@ public:
      */
     void cancel();
 
+    /**
+     * Equivalent to DatabaseConnection::on_commit, called on the
+     * connection on which this DatabaseTransaction was initialized.
+     * \e p_callback thus belongs to the innermost currently active
+     * DatabaseTransaction, which in practice is this one.
+     *
+     * @throws TransactionNestingException if this DatabaseTransaction is
+     * inactive.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void on_commit(std::function<void()> const& p_callback);
+
+    /**
+     * Equivalent to DatabaseConnection::on_rollback, called on the
+     * connection on which this DatabaseTransaction was initialized.
+     *
+     * @throws TransactionNestingException if this DatabaseTransaction is
+     * inactive.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void on_rollback(std::function<void()> const& p_callback);
+
+    /**
+     * @returns counts of the I/O performed on the database connection
+     * since this DatabaseTransaction was constructed (see
+     * DatabaseConnection::io_stats). If called after commit(), the
+     * counts include the I/O of the commit itself, which is where any
+     * syncs are made. Note the I/O of any other activity on the
+     * connection in the meantime, such as that of a nested
+     * DatabaseTransaction, is also included. The counts are all zero
+     * unless the connection was opened with OpenOptions::io_stats.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    IoStats io_stats() const;
+
 private:
     bool m_is_active;
     DatabaseConnection& m_database_connection;
 
+    // Uninitialized unless the connection was opened with
+    // OpenOptions::io_stats, so that other transactions take no snapshot.
+    boost::optional<IoStats> const m_io_stats_at_start;
+
 };  // DatabaseTransaction
 
 
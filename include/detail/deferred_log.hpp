@@ -0,0 +1,167 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_deferred_log_hpp_5530917246381624
+#define GUARD_deferred_log_hpp_5530917246381624
+
+// Hide from Doxygen
+/// @cond
+
+/** @file
+ *
+ * @brief Header file pertaining to DeferredLog class, and the
+ * SQLOXX_LOG_TRACE and SQLOXX_THROW macros.
+ */
+
+#include <jewel/exception.hpp>
+#include <jewel/log.hpp>
+#include <cstdint>
+#include <ostream>
+
+namespace sqloxx
+{
+namespace detail
+{
+
+/**
+ * @class DeferredLog
+ *
+ * This class is designed to be used only by other classes within
+ * the Sqloxx module, via the SQLOXX_LOG_TRACE and SQLOXX_THROW macros,
+ * and should not be accessed by external client code.
+ *
+ * Provides a low-overhead log for hot paths. Each call to record() copies
+ * a small, fixed-size entry into a ring buffer belonging to the calling
+ * thread. The ring buffer has a single producer (the owning thread) and a
+ * single consumer, and is lock-free. Formatting and writing of entries to
+ * the sink is deferred to a background thread, which is started on the
+ * first call to record(). If a ring buffer is full, entries are dropped
+ * rather than blocking the caller; the number of dropped entries is
+ * available via dropped_count().
+ *
+ * The file, function and exception type passed to record() are expected
+ * to be string literals (as supplied by the macros), and are stored by
+ * pointer. The message is copied, and truncated if necessary.
+ */
+class DeferredLog
+{
+public:
+
+    enum Kind
+    {
+        trace = 0,
+        exception
+    };
+
+    DeferredLog() = delete;
+
+    /**
+     * Records an entry in the calling thread's ring buffer.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>. (If
+     * resources cannot be obtained for the calling thread's ring buffer,
+     * the entry is dropped.)
+     */
+    static void record
+    (   Kind p_kind,
+        char const* p_file,
+        int p_line,
+        char const* p_function,
+        char const* p_type,
+        char const* p_message
+    ) noexcept;
+
+    /**
+     * Formats and writes all entries recorded so far (by any thread) to
+     * the sink, and flushes the sink, before returning.
+     *
+     * @throws any exception thrown by the sink.
+     */
+    static void flush();
+
+    /**
+     * Sets the stream to which entries are written. If \e p_sink is
+     * \e nullptr, entries are discarded. The default sink is std::clog.
+     *
+     * @returns the previous sink.
+     *
+     * @throws std::system_error if the lock guarding the sink cannot be
+     * acquired.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    static std::ostream* set_sink(std::ostream* p_sink);
+
+    /**
+     * @returns the number of entries dropped because a ring buffer was
+     * full (or could not be created).
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    static std::uint64_t dropped_count() noexcept;
+
+};  // class DeferredLog
+
+}  // namespace detail
+}  // namespace sqloxx
+
+
+#ifdef SQLOXX_ENABLE_DEFERRED_LOGGING
+
+#   define SQLOXX_LOG_TRACE() \
+        ::sqloxx::detail::DeferredLog::record \
+        (   ::sqloxx::detail::DeferredLog::trace, \
+            __FILE__, \
+            __LINE__, \
+            __func__, \
+            nullptr, \
+            nullptr \
+        )
+
+#   define SQLOXX_THROW(TYPE, MESSAGE) \
+        do \
+        { \
+            char const* const sqloxx_deferred_log_message_ = (MESSAGE); \
+            ::sqloxx::detail::DeferredLog::record \
+            (   ::sqloxx::detail::DeferredLog::exception, \
+                __FILE__, \
+                __LINE__, \
+                __func__, \
+                #TYPE, \
+                sqloxx_deferred_log_message_ \
+            ); \
+            throw TYPE \
+            (   sqloxx_deferred_log_message_, \
+                #TYPE, \
+                __func__, \
+                __FILE__, \
+                __LINE__ \
+            ); \
+        } \
+        while (false)
+
+#else
+
+#   define SQLOXX_LOG_TRACE() JEWEL_LOG_TRACE()
+#   define SQLOXX_THROW(TYPE, MESSAGE) JEWEL_THROW(TYPE, MESSAGE)
+
+#endif  // SQLOXX_ENABLE_DEFERRED_LOGGING
+
+
+/// @endcond
+// End hiding from Doxygen
+
+#endif  // GUARD_deferred_log_hpp_5530917246381624
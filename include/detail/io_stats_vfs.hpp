@@ -0,0 +1,103 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_io_stats_vfs_hpp_5775582479787826
+#define GUARD_io_stats_vfs_hpp_5775582479787826
+
+// Hide from Doxygen
+/// @cond
+
+#include "../io_stats.hpp"
+#include "sqlite3.h"  // Compiling directly into build
+#include <string>
+
+namespace sqloxx
+{
+namespace detail
+{
+
+/**
+ * A shim VFS (see shim_vfs.hpp) that counts, in an IoStats, the I/O
+ * performed on the files opened through it. An SQLiteDBConn opened with
+ * OpenOptions::io_stats set owns one of these, so that the counts are
+ * those of that connection alone. The counters are not synchronized;
+ * like the connection itself, they should be used on one thread at a
+ * time.
+ */
+class IoStatsVfs
+{
+public:
+
+    /**
+     * Registers a new VFS, with a name unique to this instance, wrapping
+     * the VFS named \e p_wrapped_vfs, or the default VFS if that is empty.
+     *
+     * @throws NoSuchVFS if there is no VFS named \e p_wrapped_vfs.
+     *
+     * @throws SQLiteException if the VFS cannot be registered.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    explicit IoStatsVfs(std::string const& p_wrapped_vfs);
+
+    IoStatsVfs(IoStatsVfs const&) = delete;
+    IoStatsVfs(IoStatsVfs&&) = delete;
+    IoStatsVfs& operator=(IoStatsVfs const&) = delete;
+    IoStatsVfs& operator=(IoStatsVfs&&) = delete;
+
+    /**
+     * Unregisters the VFS. No database connection may still be using it.
+     */
+    ~IoStatsVfs();
+
+    /**
+     * @returns the name under which the VFS is registered.
+     */
+    char const* name() const;
+
+    IoStats const& stats() const;
+
+private:
+
+    // As this is the first member of a standard-layout struct, the VFS
+    // methods can find the Registration, and so the stats, from the
+    // sqlite3_vfs SQLite passes them.
+    struct Registration
+    {
+        sqlite3_vfs vfs;
+        IoStats* stats;
+    };
+
+    static int on_open
+    (   sqlite3_vfs* p_vfs,
+        char const* p_name,
+        sqlite3_file* p_file,
+        int p_flags,
+        int* p_out_flags
+    );
+
+    std::string m_name;
+    IoStats m_stats;
+    Registration m_registration;
+};
+
+}  // namespace detail
+}  // namespace sqloxx
+
+/// @endcond
+// End hiding from Doxygen
+
+#endif  // GUARD_io_stats_vfs_hpp_5775582479787826
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_pragma_hpp_4410638217952093
+#define GUARD_pragma_hpp_4410638217952093
+
+// Hide from Doxygen
+/// @cond
+
+#include "../database_connection_fwd.hpp"
+
+namespace sqloxx
+{
+namespace detail
+{
+
+/**
+ * @returns the value of the integer-valued pragma named \e p_name (for
+ * example "page_count" or "user_version") of the main database of
+ * \e p_connection.
+ *
+ * @throws InvalidConnection if \e p_connection is invalid.
+ *
+ * <b>Exception safety</b>: <em>strong guarantee</em>.
+ */
+long long read_pragma(DatabaseConnection& p_connection, char const* p_name);
+
+}  // namespace detail
+}  // namespace sqloxx
+
+/// @endcond
+// End hiding from Doxygen
+
+#endif  // GUARD_pragma_hpp_4410638217952093
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_shim_vfs_hpp_6503360582161382
+#define GUARD_shim_vfs_hpp_6503360582161382
+
+// Hide from Doxygen
+/// @cond
+
+/** @file
+ *
+ * @brief Support for "shim" VFSs, which wrap another SQLite VFS,
+ * forwarding to it every call they do not themselves intercept.
+ *
+ * Note SQLite's VFS interface is synchronous: each \e xRead must return
+ * with its data filled in, and each \e xSync with the data durable. So
+ * an asynchronous VFS (over io_uring, say) could help only by reading
+ * ahead of a scan; and the kernel's own readahead already serves the
+ * mostly sequential reads of a scan, while a prefetch made from within
+ * \e xRead merely reads each page twice. Writes are already batched by
+ * SQLite, which syncs the journal or WAL once per commit.
+ */
+
+#include "sqlite3.h"  // Compiling directly into build
+#include <cstddef>
+
+namespace sqloxx
+{
+namespace detail
+{
+
+/**
+ * The start of the sqlite3_file structure of every file opened through
+ * a shim VFS. A shim defines its own file structure, beginning with a
+ * ShimFile, to hold any further state; the file of the wrapped VFS is
+ * placed in the same allocation, after the shim's structure.
+ *
+ * As SQLite allocates these structures, they must be trivial types.
+ */
+struct ShimFile
+{
+    sqlite3_file base;
+    sqlite3_file* real;
+};
+
+/**
+ * @returns the file of the wrapped VFS, behind \e p_file, which must have
+ * been opened through a shim VFS.
+ */
+inline
+sqlite3_file*
+real_file(sqlite3_file* p_file)
+{
+    return reinterpret_cast<ShimFile*>(p_file)->real;
+}
+
+/**
+ * @returns the VFS wrapped by \e p_vfs, which must have been initialized
+ * by init_shim_vfs.
+ */
+inline
+sqlite3_vfs*
+real_vfs(sqlite3_vfs* p_vfs)
+{
+    return static_cast<sqlite3_vfs*>(p_vfs->pAppData);
+}
+
+/**
+ * Initializes \e p_vfs as a shim named \e p_name, wrapping \e p_real,
+ * whose files begin with a structure of \e p_shim_file_size bytes
+ * (see ShimFile). Every method forwards to \e p_real, apart from
+ * \e xOpen, which should be set by the caller to a function that calls
+ * open_shim_file. The caller then registers \e p_vfs with SQLite.
+ */
+void init_shim_vfs
+(   sqlite3_vfs& p_vfs,
+    sqlite3_vfs& p_real,
+    char const* p_name,
+    std::size_t p_shim_file_size
+);
+
+/**
+ * The io methods of a shim, with one table for each version of io
+ * methods that the files of the wrapped VFS may have: \e versions[v - 1]
+ * is of version \e v, and has null slots for the methods added in later
+ * versions. A shim file thus offers SQLite no method that the wrapped
+ * file lacks. (The "unix-none", "unix-dotfile" and "unix-flock" VFSs, for
+ * example, provide io methods of version 1 only, and so support neither
+ * WAL mode nor memory-mapped I/O.)
+ */
+struct ShimIoMethods
+{
+    sqlite3_io_methods versions[3];
+};
+
+/**
+ * @returns a ShimIoMethods made from \e p_methods, which must be of
+ * version 3.
+ */
+ShimIoMethods make_shim_io_methods(sqlite3_io_methods const& p_methods);
+
+/**
+ * Opens the file of the wrapped VFS behind \e p_file, and, if it is
+ * opened, installs as the methods of \e p_file those in \e p_methods of
+ * the same version as the methods of the wrapped file. The shim's own
+ * state should be initialized (or cleaned up) by the caller.
+ *
+ * @returns the result of the wrapped VFS's \e xOpen.
+ */
+int open_shim_file
+(   sqlite3_vfs* p_vfs,
+    char const* p_name,
+    sqlite3_file* p_file,
+    int p_flags,
+    int* p_out_flags,
+    std::size_t p_shim_file_size,
+    ShimIoMethods const& p_methods
+);
+
+/**
+ * @returns io methods (of version 3) that forward every call to the
+ * file of the wrapped VFS. A shim copies these, replaces those it
+ * intercepts, and passes the result to make_shim_io_methods.
+ */
+sqlite3_io_methods pass_through_io_methods();
+
+}  // namespace detail
+}  // namespace sqloxx
+
+/// @endcond
+// End hiding from Doxygen
+
+#endif  // GUARD_shim_vfs_hpp_6503360582161382
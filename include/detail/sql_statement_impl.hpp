@@ -26,11 +26,15 @@
  */
 
 #include "sqlite3.h"  // Compiling directly into build
+#include "../codec.hpp"
+#include "../result_cache.hpp"
 #include "../sqloxx_exceptions.hpp"
 #include <boost/filesystem/path.hpp>
 #include <jewel/assert.hpp>
 #include <jewel/checked_arithmetic.hpp>
 #include <climits>
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <type_traits>
 #include <vector>
@@ -43,6 +47,21 @@ namespace detail
 // Forward declaration
 class SQLiteDBConn;
 
+/**
+ * The tables read and written by a statement, as recorded by the SQLite
+ * authorizer callback installed by SQLiteDBConn while the statement is
+ * being prepared.
+ */
+struct TableAccess
+{
+    TableAccess();
+    std::vector<std::string> read;
+    std::vector<std::string> written;
+
+    // True if the statement drops or alters a table or view.
+    bool alters_schema;
+};
+
 /**
  * Wrapper class for sqlite_stmt*. This class is should not be
  * used except internally by the Sqloxx library. SQLStatementImpl instances
@@ -94,7 +113,8 @@ public:
      * long long\n
      * double\n
      * std::string\n
-     * char const*
+     * char const*\n
+     * Blob
      *
      * <b>NOTE</b>
      * If x is of an integral type that is wider than 64 bits, then any
@@ -116,6 +136,7 @@ public:
      *    int\n
      *    double\n
      *    std::string\n
+     *    Blob\n
      * 
      * @param index is the column number (starting at 0) from which to
      * read the value.
@@ -172,6 +193,22 @@ public:
      */
     void clear_bindings();
 
+    /**
+     * Implements SQLStatement::enable_result_cache.
+     */
+    void enable_result_cache();
+
+    /**
+     * Stops the statement from using the ResultCache, and discards the
+     * record of its bindings kept for that purpose. Does not throw.
+     */
+    void disable_result_cache();
+
+    /**
+     * Implements SQLStatement::is_read_only.
+     */
+    bool is_read_only() const;
+
     /**
      * @returns true if and only if the statement is currently
      * in use by way of a SQLStatement. Does not throw.
@@ -230,10 +267,64 @@ private:
 
     template <typename T>
     void do_bind(std::string const& parameter_name, T x);
+    void do_bind(std::string const& parameter_name, Blob const& x);
+
+    // Record a bound value in m_recorded_bindings.
+    void record_binding(std::string const& parameter_name, long long x);
+    void record_binding(std::string const& parameter_name, double x);
+    void record_binding(std::string const& parameter_name, char const* x);
+    void record_binding(std::string const& parameter_name, Blob const& x);
+    void record_binding
+    (   std::string const& parameter_name,
+        char type,
+        void const* data,
+        std::size_t size
+    ) noexcept;
+
+    // Called on the first step of an execution with the result cache
+    // enabled. Returns true if a cached result is to be replayed;
+    // otherwise may begin capturing the result for the cache.
+    bool begin_cached_execution();
+
+    // Steps through m_replayed_result.
+    bool step_replayed();
+
+    // Appends the current row to m_captured_result, abandoning the
+    // capture if it grows too large or memory is exhausted.
+    void capture_row();
+
+    // Stores m_captured_result in the cache, once complete.
+    void finish_capture();
+
+    // Invalidates cached results of the tables written by this statement.
+    void invalidate_written_tables();
+
+    // Counterpart of check_column for a replayed result.
+    ResultCache::Result::Cell const& replayed_cell(int index, int value_type);
 
     sqlite3_stmt* m_statement;
     SQLiteDBConn& m_sqlite_dbconn;
     bool m_is_locked;
+
+    // As reported by sqlite3_stmt_readonly, for a statement yielding
+    // result columns.
+    bool m_is_cacheable;
+    TableAccess m_table_access;
+
+    // State pertaining to the result cache. m_recorded_bindings holds
+    // the value bound to each parameter while the cache was enabled, in
+    // the form in which it appears in the key. m_result_key is the
+    // statement text followed by those values; m_key_length is the length
+    // of the text part.
+    bool m_use_result_cache;
+    bool m_has_unrecorded_bindings;
+    std::vector<std::string> m_recorded_bindings;
+    std::string m_result_key;
+    std::string::size_type m_key_length;
+    std::shared_ptr<ResultCache::Result const> m_replayed_result;
+    std::size_t m_replayed_rows;
+    std::shared_ptr<ResultCache::Result> m_captured_result;
+    ResultCache::Generation m_capture_generation;
 };
 
 
@@ -255,6 +346,19 @@ SQLStatementImpl::bind(std::string const& parameter_name, T const& x)
         clear_bindings();
         throw;
     }
+    if (m_use_result_cache)
+    {
+        typedef typename std::conditional
+        <   std::is_integral<T>::value,
+            long long,
+            T
+        >::type Recorded;
+        record_binding(parameter_name, static_cast<Recorded const&>(x));
+    }
+    else
+    {
+        m_has_unrecorded_bindings = true;
+    }
     return;
 }
 
@@ -264,6 +368,10 @@ inline
 int
 SQLStatementImpl::extract<int>(int index)
 {
+    if (m_replayed_result)
+    {
+        return static_cast<int>(replayed_cell(index, SQLITE_INTEGER).integer);
+    }
     check_column(index, SQLITE_INTEGER);
     return sqlite3_column_int(m_statement, index);
 }
@@ -273,6 +381,10 @@ inline
 long
 SQLStatementImpl::extract<long>(int index)
 {
+    if (m_replayed_result)
+    {
+        return static_cast<long>(replayed_cell(index, SQLITE_INTEGER).integer);
+    }
     check_column(index, SQLITE_INTEGER);
     return sqlite3_column_int64(m_statement, index);
 }
@@ -282,6 +394,10 @@ inline
 long long
 SQLStatementImpl::extract<long long>(int index)
 {
+    if (m_replayed_result)
+    {
+        return replayed_cell(index, SQLITE_INTEGER).integer;
+    }
     check_column(index, SQLITE_INTEGER);
     return sqlite3_column_int64(m_statement, index);
 }
@@ -291,6 +407,10 @@ inline
 double
 SQLStatementImpl::extract<double>(int index)
 {
+    if (m_replayed_result)
+    {
+        return replayed_cell(index, SQLITE_FLOAT).real;
+    }
     check_column(index, SQLITE_FLOAT);
     return sqlite3_column_double(m_statement, index);
 }
@@ -300,6 +420,13 @@ inline
 std::string
 SQLStatementImpl::extract<std::string>(int index)
 {
+    if (m_replayed_result)
+    {
+        ResultCache::Result::Cell const& cell =
+            replayed_cell(index, SQLITE_TEXT);
+        char const* const begin = m_replayed_result->data(cell);
+        return std::string(begin, begin + cell.size);
+    }
     check_column(index, SQLITE_TEXT);
     const unsigned char* begin = sqlite3_column_text(m_statement, index);
     const unsigned char* end = begin;
@@ -307,6 +434,29 @@ SQLStatementImpl::extract<std::string>(int index)
     return std::string(begin, end);
 }
 
+template <>
+inline
+Blob
+SQLStatementImpl::extract<Blob>(int index)
+{
+    if (m_replayed_result)
+    {
+        ResultCache::Result::Cell const& cell =
+            replayed_cell(index, SQLITE_BLOB);
+        char const* const begin = m_replayed_result->data(cell);
+        return Blob(begin, begin + cell.size);
+    }
+    check_column(index, SQLITE_BLOB);
+
+    // Per the SQLite documentation, the data must be obtained before its
+    // size. The data of an empty blob is a null pointer.
+    unsigned char const* const begin = static_cast<unsigned char const*>
+    (   sqlite3_column_blob(m_statement, index)
+    );
+    int const size = sqlite3_column_bytes(m_statement, index);
+    return begin? Blob(begin, begin + size): Blob();
+}
+
 
 inline
 void
@@ -316,6 +466,8 @@ SQLStatementImpl::reset()
     {
         sqlite3_reset(m_statement);
     }
+    m_replayed_result.reset();
+    m_captured_result.reset();
     return;
 }
 
@@ -328,6 +480,11 @@ SQLStatementImpl::clear_bindings()
     {
         sqlite3_clear_bindings(m_statement);
     }
+    for (std::string& binding: m_recorded_bindings)
+    {
+        binding.clear();
+    }
+    m_has_unrecorded_bindings = false;
     return;
 }
 
@@ -467,6 +624,24 @@ SQLStatementImpl::do_bind(std::string const& parameter_name, char const* x)
     );
 }
 
+inline
+void
+SQLStatementImpl::do_bind(std::string const& parameter_name, Blob const& x)
+{
+    // A null pointer would bind NULL rather than an empty blob.
+    static unsigned char const empty = 0;
+    throw_on_failure
+    (   sqlite3_bind_blob
+        (   m_statement,
+            parameter_index(parameter_name),
+            x.empty()? &empty: x.data(),
+            static_cast<int>(x.size()),
+            SQLITE_TRANSIENT
+        )
+    );
+    return;
+}
+
 
 
 }  // namespace detail
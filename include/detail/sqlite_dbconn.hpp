@@ -25,12 +25,18 @@
  * @brief Header file pertaining to SQLiteDBConn class.
  */
 
+#include "../io_stats.hpp"
+#include "../open_options.hpp"
+#include "../result_cache.hpp"
 #include "../sqloxx_exceptions.hpp"
+#include "io_stats_vfs.hpp"
 #include "sql_statement_impl.hpp"
 #include <jewel/checked_arithmetic.hpp>
 #include "sqlite3.h"  // Compiling directly into build
 #include <boost/filesystem/path.hpp>
+#include <functional>
 #include <limits>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -98,13 +104,123 @@ public:
     /**
      * Implements DatabaseConnection::open.
      */
-    void open(boost::filesystem::path const& filepath);    
+    void open
+    (   boost::filesystem::path const& filepath,
+        OpenOptions const& p_options = OpenOptions()
+    );
 
     /**
      * Implements DatabaseConnection::execute_sql
      */
     void execute_sql(std::string const& str);
 
+    /**
+     * Registers \e p_listener to be called whenever a transaction that
+     * has written to the database is committed on this connection
+     * (including implicit transactions around single statements).
+     * Each listener is called twice for each such commit: first with
+     * \e false, from within SQLite's commit hook, before the commit is
+     * complete; and then with \e true, once the statement that committed
+     * has returned (see complete_commit()). Listeners must not throw or
+     * use this connection. Listeners may be registered before or after
+     * open() is called.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void add_commit_listener(std::function<void(bool)> const& p_listener);
+
+    /**
+     * Calls the commit listeners with \e true, if a commit has begun
+     * since this was last called. To be called whenever a call to
+     * sqlite3_step or sqlite3_exec on this connection has returned.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    void complete_commit() noexcept;
+
+    /**
+     * Registers \e p_listener to be called with the name of the table
+     * whenever a row is inserted, updated or deleted on this connection
+     * (including by triggers and foreign key actions). Listeners are
+     * called from within SQLite's update hook, and so must not throw or
+     * use this connection. Listeners may be registered before or after
+     * open() is called. The update hook is installed only once there is
+     * a listener, or the result cache is enabled.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void add_update_listener
+    (   std::function<void(char const*)> const& p_listener
+    );
+
+    /**
+     * Registers \e p_listener to be called, with the number of frames in
+     * the WAL, whenever a transaction is committed on this connection
+     * while the database is in WAL mode. This replaces SQLite's automatic
+     * checkpoints on this connection, so the listener should call
+     * checkpoint() as required. The listener is called from within
+     * SQLite's WAL hook, after the commit, and so must not throw. It may
+     * be registered only once open() has been called, and replaces any
+     * previously registered.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void set_wal_listener(std::function<void(int)> const& p_listener);
+
+    /**
+     * Runs a passive checkpoint of the WAL of the main database, copying
+     * into the database as many frames as can be copied without waiting
+     * for readers.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void checkpoint();
+
+    /**
+     * @returns the ResultCache of this connection. Writes made on this
+     * connection invalidate the affected results in it (see the
+     * documentation for ResultCache).
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    ResultCache& result_cache();
+
+    /**
+     * Installs the authorizer and update hook on which the ResultCache
+     * relies, so that statements prepared from now on record the tables
+     * they read and write. Until this is called, no statement is
+     * cacheable, and no per-statement callback is made. May be called
+     * before or after open().
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    void enable_result_cache();
+
+    /**
+     * Implements DatabaseConnection::io_stats.
+     */
+    IoStats io_stats() const;
+
+    /**
+     * Implements DatabaseConnection::backup_to.
+     */
+    void backup_to(SQLiteDBConn& p_destination);
+
+    /**
+     * Implements DatabaseConnection::commit_marker, reading the marker
+     * from the WAL-index header if \e p_is_wal, or otherwise from the
+     * database file header.
+     */
+    std::string commit_marker(bool p_is_wal);
+
+    /**
+     * Implements DatabaseConnection::backup_to_if_unchanged.
+     */
+    bool backup_to_if_unchanged
+    (   SQLiteDBConn& p_destination,
+        std::string const& p_destination_marker
+    );
+
     /**
      * At this point this function does not fully support SQLite extended
      * error codes; only the basic error codes. If errcode is an extended
@@ -144,6 +260,68 @@ public:
 
 private:
 
+    // Applies the chunk size, WAL persistence, journal size limit and
+    // maximum page count set in \e p_options to the open connection.
+    void apply_storage_options(OpenOptions const& p_options);
+
+    // Calls sqlite3_file_control on the main database, throwing on
+    // failure other than SQLITE_NOTFOUND.
+    void file_control(int p_op, void* p_arg);
+
+    // Installed by open() as the SQLite commit hook, with this
+    // SQLiteDBConn as \e p_self.
+    static int on_commit(void* p_self);
+
+    // Installs the update hook, and the authorizer, as required by the
+    // update listeners and m_is_result_cache_enabled, if connected.
+    void install_hooks();
+
+    // Installed by install_hooks() as the SQLite authorizer. Records the
+    // tables accessed into *m_table_access if a statement is being
+    // prepared by SQLStatementImpl; otherwise (as under execute_sql)
+    // invalidates the results of tables written immediately. Always
+    // permits the action.
+    static int on_authorize
+    (   void* p_self,
+        int p_action,
+        char const* p_arg1,
+        char const* p_arg2,
+        char const* p_database,
+        char const* p_trigger
+    );
+
+    // Installed by set_wal_listener() as the SQLite WAL hook.
+    static int on_wal
+    (   void* p_self,
+        sqlite3* p_connection,
+        char const* p_database,
+        int p_frames
+    );
+
+    // Installed by install_hooks() as the SQLite update hook.
+    static void on_update
+    (   void* p_self,
+        int p_operation,
+        char const* p_database,
+        char const* p_table,
+        sqlite3_int64 p_rowid
+    );
+
+    std::vector<std::function<void(bool)> > m_commit_listeners;
+
+    // Set by on_commit, and cleared by complete_commit.
+    bool m_is_commit_pending;
+    std::vector<std::function<void(char const*)> > m_update_listeners;
+    std::function<void(int)> m_wal_listener;
+    ResultCache m_result_cache;
+    bool m_is_result_cache_enabled;
+
+    // Set by SQLStatementImpl for the duration of sqlite3_prepare_v2.
+    TableAccess* m_table_access;
+
+    // The VFS through which the database was opened, if it was opened with
+    // OpenOptions::io_stats set. It must outlive m_connection.
+    std::unique_ptr<IoStatsVfs> m_io_stats_vfs;
     
     /**
      * A connection to a SQLite3 database file.
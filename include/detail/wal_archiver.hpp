@@ -0,0 +1,196 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef GUARD_wal_archiver_hpp_4173138397858628
+#define GUARD_wal_archiver_hpp_4173138397858628
+
+// Hide from Doxygen
+/// @cond
+
+#include "../wal_archive.hpp"
+#include <boost/filesystem/path.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+namespace sqloxx
+{
+namespace detail
+{
+
+class SQLiteDBConn;
+
+/**
+ * The format of a WAL archive, shared by WalArchiver and
+ * restore_wal_archive.
+ *
+ * The archive directory holds a base snapshot of the database, and a
+ * segment for each generation of the WAL (that is, for each time the WAL
+ * was restarted after a checkpoint), numbered from 1. Each segment
+ * begins with \e magic, followed by the page size. There follows a
+ * record for each commit: the time at which it was archived, in
+ * microseconds since the epoch of std::chrono::system_clock (8 bytes);
+ * the size of the database in pages after the commit (4 bytes); the
+ * number of pages written (4 bytes); and, for each page, its page number
+ * (4 bytes) followed by its contents. Integers are big-endian.
+ */
+struct WalArchiveFormat
+{
+    static char const magic[8];
+    static std::size_t const magic_size = 8;
+    static std::size_t const segment_header_size = 12;
+    static std::size_t const record_header_size = 16;
+
+    static boost::filesystem::path base
+    (   boost::filesystem::path const& p_directory
+    );
+    static boost::filesystem::path segment
+    (   boost::filesystem::path const& p_directory,
+        int p_generation
+    );
+
+    // Decodes a big-endian integer, as in the archive and in the WAL.
+    static std::uint32_t decode_uint32(unsigned char const* p_bytes);
+};
+
+
+/**
+ * Copies the frames appended to the WAL of a database into a WAL archive
+ * after each commit, and checkpoints the WAL once all its frames have
+ * been archived. A DatabaseConnection on which
+ * DatabaseConnection::enable_wal_archiving has been called owns one of
+ * these, which it calls from the WAL hook of its SQLiteDBConn.
+ */
+class WalArchiver
+{
+public:
+
+    /**
+     * Prepares to archive the WAL of the database at \e p_filepath, to
+     * which \e p_connection is open through the VFS named \e p_vfs (or
+     * the default VFS, if empty), into \e p_directory. The frames
+     * already committed to the WAL are taken to be included in the base
+     * snapshot; so \e p_connection should hold the write lock while both
+     * this and the snapshot are made.
+     *
+     * @throws WalArchiveException if the WAL cannot be read.
+     */
+    WalArchiver
+    (   SQLiteDBConn& p_connection,
+        boost::filesystem::path const& p_filepath,
+        std::string const& p_vfs,
+        boost::filesystem::path const& p_directory,
+        WalArchivePolicy const& p_policy
+    );
+
+    WalArchiver(WalArchiver const&) = delete;
+    WalArchiver(WalArchiver&&) = delete;
+    WalArchiver& operator=(WalArchiver const&) = delete;
+    WalArchiver& operator=(WalArchiver&&) = delete;
+    ~WalArchiver();
+
+    /**
+     * Archives the committed frames up to \e p_frames not yet archived,
+     * and checkpoints the WAL if it has reached
+     * WalArchivePolicy::checkpoint_frames. If archiving fails, it is
+     * counted in the stats, and the WAL is not checkpointed, so that the
+     * frames are archived on a later commit.
+     *
+     * SQLite calls the WAL hook only once the write lock of the commit
+     * has been released, so another writer may meanwhile have appended
+     * frames beyond \e p_frames. Before checkpointing, the write lock is
+     * therefore taken on an auxiliary connection, and every frame then
+     * committed is archived; the lock is held until the checkpoint is
+     * done. If another connection holds the write lock, the checkpoint is
+     * left to a later commit.
+     */
+    void on_commit(int p_frames) noexcept;
+
+    WalArchiveStats const& stats() const;
+
+private:
+
+    // Reads the WAL header, returning false if there is no WAL. On
+    // success, the page size and salts are set in the members named.
+    bool read_header
+    (   std::FILE* p_wal,
+        std::uint32_t& p_page_size,
+        std::uint32_t& p_salt1,
+        std::uint32_t& p_salt2
+    );
+
+    // Archives the committed frames from m_frames to p_frames.
+    void archive(int p_frames);
+
+    // Archives every frame committed to the WAL, and checkpoints it,
+    // holding the write lock on m_lock_connection meanwhile.
+    void archive_and_checkpoint();
+
+    // Returns the number of frames of the current generation of the WAL
+    // up to and including its last commit frame, reading from the frame
+    // header after the WAL header of p_wal; p_page_size and the salts
+    // are those read from that header.
+    static int committed_frames
+    (   std::FILE* p_wal,
+        std::uint32_t p_page_size,
+        std::uint32_t p_salt1,
+        std::uint32_t p_salt2
+    );
+
+    // Opens the segment for the current generation, creating it if
+    // m_segment_size is 0.
+    void open_segment(std::uint32_t p_page_size);
+
+    // Closes the segment, first truncating it to m_segment_size if
+    // p_discard_tail, so as to remove a partially written record.
+    void close_segment(bool p_discard_tail) noexcept;
+
+    SQLiteDBConn& m_connection;
+    boost::filesystem::path const m_filepath;
+    std::string const m_vfs;
+    boost::filesystem::path const m_wal_filepath;
+    boost::filesystem::path const m_directory;
+    WalArchivePolicy const m_policy;
+
+    // The generation of the WAL being archived, identified by its salts,
+    // the number of its frames archived, and the segment to which they
+    // are archived (null until the first is archived, or if it could not
+    // be written), with the size of its complete records.
+    bool m_has_generation;
+    std::uint32_t m_salt1;
+    std::uint32_t m_salt2;
+    int m_frames;
+    int m_generation;
+    std::FILE* m_segment;
+    long long m_segment_size;
+
+    // Opened on the first checkpoint, and used only to hold the write
+    // lock during checkpoints.
+    std::unique_ptr<SQLiteDBConn> m_lock_connection;
+
+    WalArchiveStats m_stats;
+};
+
+}  // namespace detail
+}  // namespace sqloxx
+
+/// @endcond
+// End hiding from Doxygen
+
+#endif  // GUARD_wal_archiver_hpp_4173138397858628
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef GUARD_fixed_point_hpp_9454776530191054
+#define GUARD_fixed_point_hpp_9454776530191054
+
+#include <jewel/decimal.hpp>
+
+namespace sqloxx
+{
+
+/**
+ * A decimal number with a fixed number, \b Places, of decimal places,
+ * represented exactly by a 64-bit count of units of 10^-Places. For
+ * example, FixedPoint<2>(12345) represents 123.45.
+ *
+ * FixedPoint is stored in the database as an integer (the count of
+ * units), by way of Codec, so that it is compact and compares and sums
+ * correctly in SQL. Arithmetic beyond comparison, and conversion to and
+ * from text, are left to client code, by way of conversion to and from
+ * jewel::Decimal.
+ */
+template <int Places>
+class FixedPoint
+{
+public:
+
+    static_assert
+    (   (Places >= 0) && (Places <= 18),
+        "FixedPoint supports between 0 and 18 decimal places."
+    );
+
+    static int const places = Places;
+
+    explicit FixedPoint(long long p_units = 0): m_units(p_units)
+    {
+    }
+
+    /**
+     * Creates a FixedPoint with the value of \e p_decimal. If \e p_decimal
+     * has more than \b Places decimal places, it is rounded to \b Places,
+     * as by jewel::Decimal::rescale.
+     *
+     * @throws jewel::DecimalRangeException if the value cannot be
+     * represented with \b Places decimal places in a jewel::Decimal.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    explicit FixedPoint(jewel::Decimal const& p_decimal):
+        m_units(rescaled_intval(p_decimal))
+    {
+    }
+
+    /**
+     * @returns the count of units of 10^-Places.
+     */
+    long long units() const
+    {
+        return m_units;
+    }
+
+    /**
+     * @returns the value as a jewel::Decimal with \b Places decimal
+     * places.
+     *
+     * @throws jewel::DecimalRangeException if jewel::Decimal cannot
+     * represent the value.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    jewel::Decimal to_decimal() const
+    {
+        return jewel::Decimal
+        (   m_units,
+            static_cast<jewel::Decimal::places_type>(Places)
+        );
+    }
+
+private:
+
+    static long long rescaled_intval(jewel::Decimal p_decimal)
+    {
+        p_decimal.rescale(static_cast<jewel::Decimal::places_type>(Places));
+        return p_decimal.intval();
+    }
+
+    long long m_units;
+};
+
+template <int Places>
+int const FixedPoint<Places>::places;
+
+template <int Places>
+inline
+bool
+operator==(FixedPoint<Places> p_lhs, FixedPoint<Places> p_rhs)
+{
+    return p_lhs.units() == p_rhs.units();
+}
+
+template <int Places>
+inline
+bool
+operator!=(FixedPoint<Places> p_lhs, FixedPoint<Places> p_rhs)
+{
+    return !(p_lhs == p_rhs);
+}
+
+template <int Places>
+inline
+bool
+operator<(FixedPoint<Places> p_lhs, FixedPoint<Places> p_rhs)
+{
+    return p_lhs.units() < p_rhs.units();
+}
+
+}  // namespace sqloxx
+
+#endif  // GUARD_fixed_point_hpp_9454776530191054
@@ -22,6 +22,7 @@
 #include "identity_map.hpp"
 #include "persistence_traits.hpp"
 #include "sqloxx_exceptions.hpp"
+#include "type_registry.hpp"
 #include <jewel/assert.hpp>
 #include <jewel/exception.hpp>
 #include <type_traits>
@@ -54,6 +55,7 @@ class Handle
 public:
 
     typedef typename T::Connection Connection;
+    typedef typename T::Id Id;
     typedef typename PersistenceTraits<T>::Base Base;
 
     template <typename L, typename R>
@@ -285,10 +287,13 @@ private:
 // NON-MEMBER FUNCTIONS
 
 /**
- * A dynamic_cast is attempted on the underlying pointer. If it
+ * A cast is attempted on the underlying pointer. If it
  * succeeds, then the returned \b Handle<L> will point to one and the
  * same object as rhs. If it fails, then the returned
- * \b Handle<L> will be null.
+ * \b Handle<L> will be null. Rather than using RTTI, the cast is checked
+ * against the TypeTag stored in the underlying object (see
+ * sqloxx::TypeRegistry); \b L must therefore not be a virtual base
+ * of \b R.
  *
  * In order successfully to instantiate this function template:
  *
@@ -307,6 +312,9 @@ private:
  * underlying instance of \b T is too large to be safely counted
  * by the type \b PersistentObject<T, Connection>::HandleCounter.
  *
+ * @throws std::bad_alloc in the unlikely event of memory allocation
+ * failure.
+ *
  * <b>Exception safety</b>: <em>strong guarantee</em>.
  */
 template <typename L, typename R>
@@ -387,6 +395,7 @@ Handle<T>::create_unchecked(Connection& p_connection, Id p_id)
 }
 
 template <typename T>
+inline
 Handle<T>::Handle(Handle const& rhs): m_pointer(rhs.m_pointer)
 {
     if (m_pointer) m_pointer->increment_handle_counter();
@@ -422,6 +431,11 @@ Handle<T>::operator=(Handle&& rhs) noexcept
 {
     if (this != &rhs)
     {
+        // Nothrow guarantee, provided preconditions met. The handle count
+        // is the only thing keeping the old object alive, so it must be
+        // released here, or the old object would never be uncached.
+        if (m_pointer) m_pointer->decrement_handle_counter();
+
         m_pointer = std::move(rhs.m_pointer);
         rhs.m_pointer = nullptr;
     }
@@ -509,9 +523,16 @@ handle_cast(Handle<R> const& rhs)
     Handle<L> ret;  // nothrow
     if (rhs.m_pointer)  // nothrow
     {
-        ret.m_pointer = dynamic_cast<L*>(rhs.m_pointer);  // nothrow
-        if (ret.m_pointer)
+        // Upcasts always succeed. Downcasts are checked against the
+        // type tag stored in the object, rather than by dynamic_cast.
+        // TypeRegistry<L>::tag() might throw std::bad_alloc on first
+        // call - strong guarantee.
+        if
+        (   std::is_base_of<L, R>::value ||
+            rhs.m_pointer->type_tag().is_a(TypeRegistry<L>::tag())
+        )
         {
+            ret.m_pointer = static_cast<L*>(rhs.m_pointer);  // nothrow
             // might throw sqloxx::OverflowException - strong guarantee
             ret.m_pointer->increment_handle_counter();
         }
@@ -17,18 +17,27 @@
 #ifndef GUARD_identity_map_hpp_41089441925794556
 #define GUARD_identity_map_hpp_41089441925794556
 
+#include "database_transaction.hpp"
 #include "handle_fwd.hpp"
 #include "id.hpp"
+#include "key_traits.hpp"
 #include "persistence_traits.hpp"
 #include "persistent_object_fwd.hpp"
 #include "sqloxx_exceptions.hpp"
+#include "type_registry.hpp"
+#include "write_behind.hpp"
 #include <boost/numeric/conversion/cast.hpp>
+#include <boost/optional.hpp>
 #include <jewel/assert.hpp>
 #include <jewel/exception.hpp>
 #include <jewel/log.hpp>
+#include <chrono>
+#include <exception>
 #include <map>
 #include <memory>
+#include <set>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
@@ -79,6 +88,7 @@ class IdentityMap
 public:
 
     typedef typename T::Connection Connection;
+    typedef typename T::Id Id;
     typedef sqloxx::Id CacheKey;
 
     class Signature
@@ -141,10 +151,14 @@ public:
      * references or Handles during the IdentityMap destruction
      * process.
      *
+     * If write-behind is enabled, any deferred saves are first flushed.
+     * Should the flush fail, an error message is written to standard error,
+     * and the unsaved changes are lost.
+     *
      * <b>Exception safety</b>: the <em>nothrow guarantee</em> is provided,
      * providing the destructor of \b T does not throw.
      */
-    ~IdentityMap() = default;
+    ~IdentityMap();
 
     /**
      * Turns caching on.
@@ -157,6 +171,10 @@ public:
      *
      * Caching is off by default.
      *
+     * Where the database may be changed through other connections,
+     * cached objects may become stale. See
+     * DatabaseConnection::enable_change_tracking and track_table().
+     *
      * <b>Exception safety</b>: <em>nothrow guarantee</em>.
      */
     void enable_caching();
@@ -187,6 +205,88 @@ public:
      */
     Connection& connection();
 
+    /**
+     * Turns on write-behind mode, in place of any policy previously set.
+     *
+     * In write-behind mode, calling save() on an object that has already
+     * been saved to the database, outside any DatabaseTransaction, does not
+     * write the object to the database, but records it as awaiting saving;
+     * the object is then kept in the IdentityMap, whether or not any Handle
+     * refers to it. The objects awaiting saving are written to the database
+     * together, in a single transaction, when flush() is called; or,
+     * if \e p_policy.max_backlog objects are awaiting saving or the oldest
+     * has waited \e p_policy.max_delay, by the next save() or
+     * flush_if_due(); or on destruction of the IdentityMap. Saving a new
+     * object, or saving within a DatabaseTransaction, is not deferred.
+     *
+     * IdentityMap does not create a thread to flush deferred saves. Where
+     * saves may cease for long periods, flush_if_due() should be called
+     * periodically so that \e p_policy.max_delay is respected.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    void enable_write_behind
+    (   WriteBehindPolicy const& p_policy = WriteBehindPolicy()
+    );
+
+    /**
+     * Flushes any deferred saves, then turns write-behind mode off.
+     *
+     * @throws as for flush(). Write-behind mode remains on if an exception
+     * is thrown.
+     *
+     * <b>Exception safety</b>: <em>basic guarantee</em>.
+     */
+    void disable_write_behind();
+
+    /**
+     * Writes all objects awaiting saving to the database, in a single
+     * transaction. Objects are saved by their \e do_save_existing()
+     * functions, in the same way as by save().
+     *
+     * @throws InvalidConnection if the database connection is invalid, in
+     * which case the objects remain awaiting saving.
+     *
+     * May also throw any exception thrown in the course of saving. If so,
+     * no objects are saved, and all the objects that were awaiting saving
+     * are ghostified, as for a failed save(), so that their unsaved
+     * changes are lost.
+     *
+     * <b>Exception safety</b>: <em>basic guarantee</em>.
+     */
+    void flush();
+
+    /**
+     * Calls flush() if write-behind is enabled and either limit in its
+     * WriteBehindPolicy has been reached.
+     *
+     * <b>Exception safety</b>: as for flush().
+     */
+    void flush_if_due();
+
+    /**
+     * @returns statistics on write-behind activity.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    WriteBehindStats write_behind_stats() const;
+
+    /**
+     * Adds \e p_table to the tables whose change by another connection
+     * causes this IdentityMap to uncache the objects it holds only by
+     * virtue of enable_caching(), where change tracking is on for its
+     * connection (see DatabaseConnection::enable_change_tracking).
+     * Objects that are instead held by a Handle at the time of the change
+     * are uncached once no Handle refers to them, so that they too are
+     * reloaded on next access. The
+     * table of \b T, T::primary_table_name(), is always tracked; the
+     * tables of classes derived from \b T, or of objects loaded with
+     * \b T, may be added by this function.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void track_table(std::string const& p_table);
+
     /// @cond
     /**
      * Control access to the provide_pointer functions, deliberately
@@ -225,7 +325,7 @@ public:
     class PersistentObjectAttorney
     {
     public:
-        friend class PersistentObject<T, Connection>;
+        friend class PersistentObject<T, Connection, Id>;
     private:
         static void register_id
         (   IdentityMap& p_identity_map,
@@ -268,6 +368,13 @@ public:
             p_identity_map.partially_uncache_object(p_cache_key);
             return;
         }
+        static bool defer_save
+        (   IdentityMap& p_identity_map,
+            CacheKey p_cache_key
+        )
+        {
+            return p_identity_map.defer_save(p_cache_key);
+        }
     };
 
     friend class PersistentObjectAttorney;
@@ -382,6 +489,10 @@ private:
      * If derived from \b T, then \b T must
      * be a polymorphic base class. If these conditions fail, compilation
      * will fail.
+     *
+     * @throws sqloxx::BadIdentifier if an object with id p_id is already
+     * cached, and its dynamic type is not, and does not derive from,
+     * \b DynamicT.
      */
     template <typename DynamicT>
     DynamicT* unchecked_provide_pointer(Id p_id);
@@ -479,18 +590,68 @@ private:
      */
     CacheKey provide_cache_key();
 
-    typedef typename std::shared_ptr<T> Record;
-    typedef std::unordered_map<Id, Record> IdMap;
+    /**
+     * This should only be called by PersistentObject<T, Connection>, on
+     * saving an object that has an id.
+     *
+     * If write-behind is enabled and no transaction is open, records the
+     * object with \e p_cache_key as awaiting saving, flushes if due,
+     * and returns \e true. Otherwise returns \e false, and the object
+     * should be saved immediately.
+     *
+     * <b>Exception safety</b>: <em>basic guarantee</em>.
+     */
+    bool defer_save(CacheKey p_cache_key);
+
+    /**
+     * Empties m_flushing, uncaching any objects that were retained only
+     * because they were awaiting saving.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>, provided the
+     * destructor of \b T does not throw.
+     */
+    void release_flushing();
+
+    /**
+     * Uncaches every object to which no Handle refers, other than those
+     * awaiting saving.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>, provided the
+     * destructor of \b T does not throw.
+     */
+    void uncache_orphans();
+
+    /**
+     * Registered as a ChangeListener with the connection. If \e p_table
+     * is tracked, uncaches orphaned objects, if caching is on, and
+     * records the other objects with an id in m_stale. Should m_stale
+     * not be able to grow, caching is turned off instead, which likewise
+     * ensures those objects are uncached when released.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>, provided the
+     * destructor of \b T does not throw.
+     */
+    void on_change(std::string const& p_table);
+
+    // Objects are owned solely by m_cache_key_map. Their lifetime beyond
+    // that is governed by the intrusive Handle count maintained in
+    // PersistentObject<T, Connection>, so there is no separate reference
+    // count (or control block) per object. Like the rest of IdentityMap,
+    // the Handle count is not atomic, and IdentityMap should not be
+    // shared between threads.
+    typedef std::unique_ptr<T> Record;
+    typedef std::unordered_map<Id, T*, typename KeyTraits<Id>::Hash> IdMap;
     typedef std::map<CacheKey, Record> CacheKeyMap;
 
     // Data members
 
     // Provides index to all cached objects, including those not as yet
-    // saved to the database.
+    // saved to the database. Owns the cached objects.
     CacheKeyMap m_cache_key_map;
 
     // Provides index to object that have been saved to the database,
-    // indexed by their primary key.
+    // indexed by their primary key. Does not own the objects; each
+    // object pointed to here is also in m_cache_key_map.
     IdMap m_id_map;
 
     // To database connection with which this IdentityMap is associated.
@@ -505,6 +666,26 @@ private:
     // it is clearing each object out when there are no longer
     // handles pointing to it (m_caching == false).
     bool m_is_caching;
+
+    // Write-behind state. m_write_behind_policy is uninitialized unless
+    // write-behind is enabled. m_dirty holds the cache keys of the objects
+    // awaiting saving, and m_dirty_since the time at which the first of
+    // them was deferred. m_flushing holds the cache keys of the objects
+    // being saved by flush(). Objects in either are retained in the cache.
+    boost::optional<WriteBehindPolicy> m_write_behind_policy;
+    std::set<CacheKey> m_dirty;
+    std::set<CacheKey> m_flushing;
+    std::chrono::steady_clock::time_point m_dirty_since;
+    WriteBehindStats m_write_behind_stats;
+
+    // Tables whose change by another connection invalidates the cache,
+    // and the id of the ChangeListener registered for them. m_stale holds
+    // the cache keys of objects that were held by Handles (or awaiting
+    // saving) when such a change was detected; each is uncached when
+    // released, rather than retained by virtue of caching.
+    std::set<std::string> m_tracked_tables;
+    std::set<CacheKey> m_stale;
+    int m_change_listener_id;
 };
 
 
@@ -513,7 +694,16 @@ inline
 IdentityMap<T>::IdentityMap(Connection& p_connection):
     m_connection(p_connection),
     m_last_cache_key(0),
-    m_is_caching(false)
+    m_is_caching(false),
+    m_tracked_tables{T::primary_table_name()},
+    m_change_listener_id
+    (   p_connection.add_change_listener
+        (   [this](std::string const& p_table)
+            {
+                on_change(p_table);
+            }
+        )
+    )
 {
     JEWEL_ASSERT (m_id_map.empty());
     JEWEL_ASSERT (m_cache_key_map.empty());
@@ -521,6 +711,29 @@ IdentityMap<T>::IdentityMap(Connection& p_connection):
     JEWEL_ASSERT (m_is_caching == false);
 }
 
+template <typename T>
+IdentityMap<T>::~IdentityMap()
+{
+    if (!m_dirty.empty())
+    {
+        try
+        {
+            flush();
+        }
+        catch (std::exception& e)
+        {
+            JEWEL_LOG_MESSAGE
+            (   jewel::Log::error,
+                "Exception caught flushing deferred saves in destructor of "
+                "IdentityMap; unsaved changes have been lost."
+            );
+            JEWEL_LOG_VALUE(jewel::Log::error, e.what());
+            (void)e;  // silence compiler re. unused variable.
+        }
+    }
+    m_connection.remove_change_listener(m_change_listener_id);
+}
+
 template <typename T>
 template <typename DynamicT>
 DynamicT*
@@ -541,28 +754,30 @@ IdentityMap<T>::provide_pointer()
     );
 
     // Comments here are to help ascertain exception-safety.
-    Record obj_ptr(new DynamicT(*this, Signature()));  // T-dependent exception safety
+    TypeTag const& type_tag = TypeRegistry<DynamicT>::tag(); // strong
+    std::unique_ptr<DynamicT> obj_ptr
+    (   new DynamicT(*this, Signature())  // T-dependent exception safety
+    );
     CacheKey const cache_key = provide_cache_key(); // strong guarantee
+    DynamicT* const ret = obj_ptr.get();  // nothrow
 
     // In the next statement:
-    // constructing the pair of CacheKeyMap::value_type is nothrow; and
-    // calling insert either (a) succeeds, or (b) fails completely and
-    // throws std::bad_alloc. If it throws, then obj_ptr
-    // will be deleted on exit (as it's a shared_ptr) - which amounts to
+    // constructing the pair of CacheKeyMap::value_type is nothrow, and
+    // takes ownership of the object; and calling insert either
+    // (a) succeeds, or (b) fails completely and throws std::bad_alloc. If
+    // it throws, then the object will be deleted on exit by the
+    // unique_ptr in the (temporary) pair - which amounts to
     // rollback of provide_pointer<DynamicT>().
     m_cache_key_map.insert
-    (   typename CacheKeyMap::value_type(cache_key, obj_ptr)
+    (   typename CacheKeyMap::value_type(cache_key, std::move(obj_ptr))
     );
-    // We could have done the following, but the above is more efficient and
-    // less "magical".
-    // m_cache_key_map[cache_key] = obj_ptr; 
 
     // Nothrow
-    PersistentObject<T, Connection>::
-        KeyAttorney::set_cache_key(*obj_ptr, cache_key);
+    PersistentObject<T, Connection, Id>::
+        KeyAttorney::set_cache_key(*ret, cache_key);
+    PersistentObject<T, Connection, Id>::
+        KeyAttorney::set_type_tag(*ret, type_tag);
 
-    // In the below, get() is nothrow.
-    DynamicT* const ret = dynamic_cast<DynamicT*>(obj_ptr.get());
     JEWEL_ASSERT (ret);
     return ret;
 }
@@ -586,7 +801,10 @@ IdentityMap<T>::provide_pointer(Id p_id)
         "Invalid instantiation of provide_pointer template."
     );
 
-    if (!PersistentObject<DynamicT, Connection>::exists(m_connection, p_id))
+    if
+    (   !PersistentObject<DynamicT, Connection, Id>::
+            exists(m_connection, p_id)
+    )
     {
         JEWEL_THROW
         (   BadIdentifier,
@@ -621,18 +839,30 @@ IdentityMap<T>::unchecked_provide_pointer(Id p_id)
     {
         // Then we need to create this object.
 
+        // atomic, possible std::bad_alloc
+        TypeTag const& type_tag = TypeRegistry<DynamicT>::tag();
+
         // Exception safety here depends on T.
-        Record obj_ptr(new DynamicT(*this, p_id, Signature()));
+        std::unique_ptr<DynamicT> obj_ptr
+        (   new DynamicT(*this, p_id, Signature())
+        );
+        DynamicT* const ret = obj_ptr.get();  // nothrow
 
         // atomic, possible sqloxx::OverflowException
         CacheKey const cache_key = provide_cache_key();
 
         // atomic, possible std::bad_alloc
-        m_id_map.insert(typename IdMap::value_type(p_id, obj_ptr));
+        m_id_map.insert(typename IdMap::value_type(p_id, ret));
         try
         {
+            // Ownership passes to m_cache_key_map. If insertion throws,
+            // the object is deleted by the unique_ptr in the temporary
+            // pair.
             m_cache_key_map.insert
-            (   typename IdMap::value_type(cache_key, obj_ptr)
+            (   typename CacheKeyMap::value_type
+                (   cache_key,
+                    std::move(obj_ptr)
+                )
             );
         }
         catch (std::bad_alloc&)
@@ -642,18 +872,19 @@ IdentityMap<T>::unchecked_provide_pointer(Id p_id)
         }
 
         // Nothrow
-        PersistentObject<T, Connection>::
-            KeyAttorney::set_cache_key(*obj_ptr, cache_key);
+        PersistentObject<T, Connection, Id>::
+            KeyAttorney::set_cache_key(*ret, cache_key);
+        PersistentObject<T, Connection, Id>::
+            KeyAttorney::set_type_tag(*ret, type_tag);
 
         // We know this won't throw sqloxx::OverflowError, as it's a
         // newly loaded object.
-        DynamicT* const ret = dynamic_cast<DynamicT*>(obj_ptr.get());
         JEWEL_ASSERT (ret);
         return ret;
     }
     JEWEL_ASSERT (it != m_id_map.end());
     if
-    (   PersistentObject<T, Connection>::HandleMonitorAttorney::
+    (   PersistentObject<T, Connection, Id>::HandleMonitorAttorney::
             has_high_handle_count(*(it->second))
     )
     {
@@ -662,7 +893,19 @@ IdentityMap<T>::unchecked_provide_pointer(Id p_id)
             "Handle count for has reached dangerous level. "
         );
     }
-    DynamicT* const ret = dynamic_cast<DynamicT*>(it->second.get());
+    // The stored type tag stands in for a dynamic_cast here.
+    TypeTag const& type_tag =
+        PersistentObject<T, Connection, Id>::KeyAttorney::
+            type_tag(*(it->second));
+    if (!type_tag.is_a(TypeRegistry<DynamicT>::tag()))
+    {
+        JEWEL_THROW
+        (   BadIdentifier,
+            "The object cached with the requested id is not of the "
+            "requested type."
+        );
+    }
+    DynamicT* const ret = static_cast<DynamicT*>(it->second);
     JEWEL_ASSERT (ret);
     return ret;
 }
@@ -677,7 +920,7 @@ IdentityMap<T>::register_id(CacheKey p_cache_key, Id p_id)
     typedef typename std::pair<typename IdMap::const_iterator, bool>
         InsertionResult;
     typedef typename IdMap::value_type Elem;
-    InsertionResult res = m_id_map.insert(Elem(p_id, finder->second));
+    InsertionResult res = m_id_map.insert(Elem(p_id, finder->second.get()));
     if (!res.second)
     {
         // There was already an object with this id. This could occur
@@ -690,10 +933,11 @@ IdentityMap<T>::register_id(CacheKey p_cache_key, Id p_id)
         // confusion between the two objects in client code.
         T& old_obj = *(res.first->second);
         partially_uncache_object
-        (   PersistentObject<T, Connection>::KeyAttorney::cache_key(old_obj)
+        (   PersistentObject<T, Connection, Id>::KeyAttorney::
+                cache_key(old_obj)
         );
-        PersistentObject<T, Connection>::KeyAttorney::clear_id(old_obj);
-        res = m_id_map.insert(Elem(p_id, finder->second));
+        PersistentObject<T, Connection, Id>::KeyAttorney::clear_id(old_obj);
+        res = m_id_map.insert(Elem(p_id, finder->second.get()));
         JEWEL_ASSERT (res.second);
     }
     return;
@@ -727,12 +971,14 @@ IdentityMap<T>::partially_uncache_object(CacheKey p_cache_key)
 {
     // Precondition
     JEWEL_ASSERT (m_cache_key_map.find(p_cache_key) != m_cache_key_map.end());
-    Record const& record = m_cache_key_map.find(p_cache_key)->second;
+    T const* const record = m_cache_key_map.find(p_cache_key)->second.get();
     if (record->has_id())
     {
         JEWEL_ASSERT (m_id_map.find(record->id()) != m_id_map.end());
         m_id_map.erase(record->id());
     }
+    m_dirty.erase(p_cache_key);
+    m_stale.erase(p_cache_key);
     return;
 }
 
@@ -743,7 +989,15 @@ IdentityMap<T>::notify_nil_handles(CacheKey p_cache_key)
     typename CacheKeyMap::const_iterator it =
         m_cache_key_map.find(p_cache_key);
     JEWEL_ASSERT (it != m_cache_key_map.end()); // Assert precondition
-    if ( !it->second->has_id()  ||  !m_is_caching )
+    if (m_dirty.count(p_cache_key) != 0 || m_flushing.count(p_cache_key) != 0)
+    {
+        return;  // Retained until flushed
+    }
+    if
+    (   !it->second->has_id() ||
+        !m_is_caching ||
+        (m_stale.count(p_cache_key) != 0)
+    )
     {
         uncache_object(p_cache_key);
     }
@@ -763,30 +1017,7 @@ IdentityMap<T>::disable_caching()
 {
     if (m_is_caching)
     {
-        auto it = m_cache_key_map.begin();
-        auto const end = m_cache_key_map.end();
-        while (it != end)
-        {
-            if
-            (   PersistentObject<T, Connection>::HandleMonitorAttorney::
-                    is_orphaned(*(it->second))
-            )
-            {
-                auto doomed_it = it;
-                ++it;
-
-                Record const& record = doomed_it->second;
-                if (record->has_id())
-                {
-                    JEWEL_ASSERT
-                    (   m_id_map.find(record->id()) !=
-                        m_id_map.end()
-                    );
-                    m_id_map.erase(record->id());
-                }
-                m_cache_key_map.erase(doomed_it);
-            }
-        }
+        uncache_orphans();
         m_is_caching = false;
     }
     return;
@@ -800,6 +1031,245 @@ IdentityMap<T>::connection()
     return m_connection;
 }
 
+template <typename T>
+void
+IdentityMap<T>::enable_write_behind(WriteBehindPolicy const& p_policy)
+{
+    m_write_behind_policy = p_policy;
+    return;
+}
+
+template <typename T>
+void
+IdentityMap<T>::disable_write_behind()
+{
+    flush();
+    m_write_behind_policy = boost::none;
+    return;
+}
+
+template <typename T>
+void
+IdentityMap<T>::flush()
+{
+    if (m_dirty.empty())
+    {
+        return;
+    }
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point const start = Clock::now();
+    std::size_t count = 0;
+    DatabaseTransaction transaction(m_connection);
+
+    // The objects are taken out of m_dirty before any is saved, as saving
+    // may alter m_dirty. They remain in m_flushing, which likewise
+    // retains them in the cache, until released.
+    JEWEL_ASSERT (m_flushing.empty());
+    m_flushing.swap(m_dirty);
+    try
+    {
+        for (CacheKey const cache_key: m_flushing)
+        {
+            auto const it = m_cache_key_map.find(cache_key);
+            if (it != m_cache_key_map.end() && it->second->has_id())
+            {
+                PersistentObject<T, Connection, Id>::WriteBehindAttorney::
+                    save_existing(*(it->second));
+                ++count;
+            }
+        }
+        transaction.commit();
+    }
+    catch (std::exception&)
+    {
+        for (CacheKey const cache_key: m_flushing)
+        {
+            auto const it = m_cache_key_map.find(cache_key);
+            if (it != m_cache_key_map.end())
+            {
+                it->second->ghostify();
+            }
+        }
+        ++m_write_behind_stats.failed_flushes;
+        m_write_behind_stats.objects_discarded += m_flushing.size();
+        transaction.cancel();
+        release_flushing();
+        throw;
+    }
+    Clock::time_point const finish = Clock::now();
+    WriteBehindStats& stats = m_write_behind_stats;
+    ++stats.flushes;
+    stats.objects_flushed += count;
+    stats.last_flush_latency = finish - start;
+    if (stats.last_flush_latency > stats.max_flush_latency)
+    {
+        stats.max_flush_latency = stats.last_flush_latency;
+    }
+    if (finish - m_dirty_since > stats.max_staleness)
+    {
+        stats.max_staleness = finish - m_dirty_since;
+    }
+    release_flushing();
+    return;
+}
+
+template <typename T>
+void
+IdentityMap<T>::flush_if_due()
+{
+    if (m_write_behind_policy && !m_dirty.empty())
+    {
+        WriteBehindPolicy const& policy = *m_write_behind_policy;
+        if
+        (   m_dirty.size() >= policy.max_backlog ||
+            std::chrono::steady_clock::now() - m_dirty_since >=
+                policy.max_delay
+        )
+        {
+            flush();
+        }
+    }
+    return;
+}
+
+template <typename T>
+WriteBehindStats
+IdentityMap<T>::write_behind_stats() const
+{
+    WriteBehindStats ret = m_write_behind_stats;
+    ret.backlog = m_dirty.size();
+    return ret;
+}
+
+template <typename T>
+bool
+IdentityMap<T>::defer_save(CacheKey p_cache_key)
+{
+    JEWEL_ASSERT (m_cache_key_map.find(p_cache_key) != m_cache_key_map.end());
+    if
+    (   !m_write_behind_policy ||
+        (m_connection.transaction_nesting_level() != 0)
+    )
+    {
+        // The object is about to be saved, so need not be saved again.
+        m_dirty.erase(p_cache_key);
+        return false;
+    }
+    if (m_dirty.empty())
+    {
+        m_dirty_since = std::chrono::steady_clock::now();
+    }
+    m_dirty.insert(p_cache_key);
+    ++m_write_behind_stats.deferred_saves;
+    if (m_dirty.size() > m_write_behind_stats.peak_backlog)
+    {
+        m_write_behind_stats.peak_backlog = m_dirty.size();
+    }
+    flush_if_due();
+    return true;
+}
+
+template <typename T>
+void
+IdentityMap<T>::release_flushing()
+{
+    std::set<CacheKey> released;
+    released.swap(m_flushing);
+    for (CacheKey const cache_key: released)
+    {
+        auto const it = m_cache_key_map.find(cache_key);
+        if
+        (   (it != m_cache_key_map.end()) &&
+            PersistentObject<T, Connection, Id>::HandleMonitorAttorney::
+                is_orphaned(*(it->second))
+        )
+        {
+            notify_nil_handles(cache_key);
+        }
+    }
+    return;
+}
+
+template <typename T>
+void
+IdentityMap<T>::track_table(std::string const& p_table)
+{
+    m_tracked_tables.insert(p_table);
+    return;
+}
+
+template <typename T>
+void
+IdentityMap<T>::uncache_orphans()
+{
+    auto it = m_cache_key_map.begin();
+    auto const end = m_cache_key_map.end();
+    while (it != end)
+    {
+        if
+        (   (m_dirty.count(it->first) == 0) &&
+            (m_flushing.count(it->first) == 0) &&
+            PersistentObject<T, Connection, Id>::HandleMonitorAttorney::
+                is_orphaned(*(it->second))
+        )
+        {
+            auto doomed_it = it;
+            ++it;
+
+            T const* const record = doomed_it->second.get();
+            if (record->has_id())
+            {
+                JEWEL_ASSERT
+                (   m_id_map.find(record->id()) !=
+                    m_id_map.end()
+                );
+                m_id_map.erase(record->id());
+            }
+            m_stale.erase(doomed_it->first);
+            m_cache_key_map.erase(doomed_it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return;
+}
+
+template <typename T>
+void
+IdentityMap<T>::on_change(std::string const& p_table)
+{
+    if (m_tracked_tables.count(p_table) == 0)
+    {
+        return;
+    }
+    if (m_is_caching)
+    {
+        uncache_orphans();
+    }
+    try
+    {
+        for (auto const& entry: m_cache_key_map)
+        {
+            if (entry.second->has_id())
+            {
+                m_stale.insert(entry.first);
+            }
+        }
+    }
+    catch (std::bad_alloc&)
+    {
+        JEWEL_LOG_MESSAGE
+        (   jewel::Log::error,
+            "Could not record objects made stale by another connection; "
+            "caching has been turned off."
+        );
+        m_is_caching = false;
+    }
+    return;
+}
+
 template <typename T>
 typename IdentityMap<T>::CacheKey
 IdentityMap<T>::provide_cache_key()
@@ -36,6 +36,25 @@ public:
      */
     static jewel::Version version();
 
+    /**
+     * @returns the name of the SQLITE_PROFILE with which the bundled
+     * SQLite was compiled: "default", "single-thread-fast" or
+     * "multi-thread-pooled". (See the README.)
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>
+     */
+    static char const* sqlite_profile();
+
+    /**
+     * @returns \e false if the bundled SQLite was compiled without
+     * mutexes (as in the "single-thread-fast" profile), in which case
+     * SQLite, across all connections, must not be used from more than one
+     * thread at a time; otherwise \e true.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>
+     */
+    static bool sqlite_is_thread_safe();
+
     Info() = delete;
     Info(Info const& rhs) = delete;
     Info(Info&& rhs) = delete;
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_io_stats_hpp_0705307806188318
+#define GUARD_io_stats_hpp_0705307806188318
+
+#include <chrono>
+#include <cstddef>
+
+namespace sqloxx
+{
+
+/**
+ * Counts the I/O performed by SQLite on one kind of file, on behalf of a
+ * DatabaseConnection opened with OpenOptions::io_stats set. Latencies are
+ * the total time spent in the underlying VFS in the calls concerned.
+ */
+struct FileIoStats
+{
+    FileIoStats();
+
+    std::size_t reads;
+    std::size_t bytes_read;
+    std::chrono::steady_clock::duration read_latency;
+
+    std::size_t writes;
+    std::size_t bytes_written;
+    std::chrono::steady_clock::duration write_latency;
+
+    // Calls to xSync, i.e. fsync or its equivalent.
+    std::size_t syncs;
+    std::chrono::steady_clock::duration sync_latency;
+
+    // Lock transitions (calls to xLock and xUnlock), and time spent in
+    // them, which includes time spent waiting for other connections.
+    std::size_t locks;
+    std::size_t unlocks;
+    std::chrono::steady_clock::duration lock_latency;
+
+    // Extensions of the file: writes beyond its end, and preallocations
+    // made in response to SQLite's size hints (see
+    // OpenOptions::chunk_size), with the bytes added and the time spent
+    // in the calls concerned.
+    std::size_t extends;
+    std::size_t bytes_extended;
+    std::chrono::steady_clock::duration extend_latency;
+};
+
+/**
+ * @returns the counts in \e p_lhs less those in \e p_rhs, such as the I/O
+ * between two readings of the same counters.
+ */
+FileIoStats operator-(FileIoStats const& p_lhs, FileIoStats const& p_rhs);
+
+
+/**
+ * Counts the I/O performed by SQLite on behalf of a DatabaseConnection,
+ * by kind of file.
+ *
+ * @see DatabaseConnection::io_stats, DatabaseTransaction::io_stats.
+ */
+struct IoStats
+{
+    // The database file itself.
+    FileIoStats main_db;
+
+    // The rollback journal.
+    FileIoStats journal;
+
+    // The write-ahead log.
+    FileIoStats wal;
+
+    // Any other files, such as temporary files and statement journals.
+    FileIoStats other;
+};
+
+/**
+ * @returns the counts in \e p_lhs less those in \e p_rhs.
+ */
+IoStats operator-(IoStats const& p_lhs, IoStats const& p_rhs);
+
+}  // namespace sqloxx
+
+#endif  // GUARD_io_stats_hpp_0705307806188318
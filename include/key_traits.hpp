@@ -0,0 +1,237 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_key_traits_hpp_2960318847715306
+#define GUARD_key_traits_hpp_2960318847715306
+
+#include "sql_statement.hpp"
+#include <boost/functional/hash.hpp>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+namespace sqloxx
+{
+
+/// @cond
+namespace detail
+{
+
+/**
+ * @returns the text of an SQL "where" condition matching each of the
+ * comma-separated columns in \e p_key_columns against the parameters
+ * ":p0", ":p1" etc., in order.
+ *
+ * @throws LogicError if \e p_key_columns does not name exactly
+ * \e p_num_columns columns.
+ *
+ * <b>Exception safety</b>: <em>strong guarantee</em>.
+ */
+std::string composite_key_condition
+(   std::string const& p_key_columns,
+    std::size_t p_num_columns
+);
+
+/**
+ * @returns the name of the parameter to which the \e p_index-th column of
+ * a composite key is bound, in the condition returned by
+ * composite_key_condition.
+ */
+std::string composite_key_parameter(std::size_t p_index);
+
+template <std::size_t I, std::size_t N>
+struct TupleKeyElements
+{
+    template <typename KeyT>
+    static void bind(SQLStatement& p_statement, KeyT const& p_key)
+    {
+        p_statement.bind(composite_key_parameter(I), std::get<I>(p_key));
+        TupleKeyElements<I + 1, N>::bind(p_statement, p_key);
+        return;
+    }
+    template <typename KeyT>
+    static void extract
+    (   SQLStatement& p_statement,
+        int p_first_column,
+        KeyT& p_key
+    )
+    {
+        typedef typename std::tuple_element<I, KeyT>::type Element;
+        std::get<I>(p_key) =
+            p_statement.extract<Element>(p_first_column + I);
+        TupleKeyElements<I + 1, N>::extract
+        (   p_statement,
+            p_first_column,
+            p_key
+        );
+        return;
+    }
+    template <typename KeyT>
+    static void hash(KeyT const& p_key, std::size_t& p_seed)
+    {
+        boost::hash_combine(p_seed, std::get<I>(p_key));
+        TupleKeyElements<I + 1, N>::hash(p_key, p_seed);
+        return;
+    }
+};
+
+template <std::size_t N>
+struct TupleKeyElements<N, N>
+{
+    template <typename KeyT>
+    static void bind(SQLStatement&, KeyT const&)
+    {
+        return;
+    }
+    template <typename KeyT>
+    static void extract(SQLStatement&, int, KeyT&)
+    {
+        return;
+    }
+    template <typename KeyT>
+    static void hash(KeyT const&, std::size_t&)
+    {
+        return;
+    }
+};
+
+}  // namespace detail
+/// @endcond
+
+
+/**
+ * Describes how a primary key of type \b KeyT is matched, bound and
+ * extracted in SQL, and hashed in IdentityMap. This is used by
+ * PersistentObject, IdentityMap and TableIterator for the key type \b IdT
+ * of a PersistentObject.
+ *
+ * The unspecialized KeyTraits caters for single-column integral keys,
+ * which are assumed to be autoincrementing, so that new keys are allocated
+ * by sqloxx::next_auto_key. A partial specialization caters for composite
+ * (or natural) keys, represented as a std::tuple with one element per key
+ * column, as for a "without rowid" table. For these, the
+ * \e primary_key_name() of the persistent class should return the
+ * comma-separated list of key columns, in the order in which they appear
+ * in the tuple; and the key of a new object is supplied by the persistent
+ * class, via PersistentObject::do_calculate_prospective_key.
+ *
+ * Each KeyTraits provides:
+ *
+ * <em>static bool const \b auto_increment</em>;\n
+ * Whether keys are allocated by the database.
+ *
+ * <em>static std::string \b condition(std::string const& p_key_columns)</em>;
+ * \n
+ * Returns the text of an SQL "where" condition, in terms of
+ * \e p_key_columns, to which a key can be bound by \e bind.
+ *
+ * <em>static void \b bind(SQLStatement&, KeyT const&)</em>;\n
+ * Binds a key to the parameters in the text returned by \e condition.
+ *
+ * <em>static KeyT \b extract(SQLStatement&, int p_first_column)</em>;\n
+ * Extracts a key from the current result row, starting at
+ * \e p_first_column.
+ *
+ * <em>struct \b Hash</em>;\n
+ * A function object hashing a key, for use in unordered containers.
+ */
+template <typename KeyT>
+struct KeyTraits
+{
+    static_assert
+    (   std::is_integral<KeyT>::value,
+        "KeyTraits must be specialized for non-integral key types."
+    );
+
+    static bool const auto_increment = true;
+
+    static std::string condition(std::string const& p_key_columns)
+    {
+        return p_key_columns + " = :p";
+    }
+
+    static void bind(SQLStatement& p_statement, KeyT p_key)
+    {
+        p_statement.bind(":p", p_key);
+        return;
+    }
+
+    static KeyT extract(SQLStatement& p_statement, int p_first_column)
+    {
+        return p_statement.extract<KeyT>(p_first_column);
+    }
+
+    typedef std::hash<KeyT> Hash;
+};
+
+template <typename KeyT>
+bool const KeyTraits<KeyT>::auto_increment;
+
+
+/**
+ * KeyTraits for a composite key, with one tuple element per key column.
+ * Each element type must be supported by SQLStatement::bind and
+ * SQLStatement::extract, and by boost::hash.
+ */
+template <typename... Elements>
+struct KeyTraits<std::tuple<Elements...> >
+{
+    typedef std::tuple<Elements...> Key;
+    typedef detail::TupleKeyElements<0, sizeof...(Elements)> Impl;
+
+    static bool const auto_increment = false;
+
+    static std::string condition(std::string const& p_key_columns)
+    {
+        return detail::composite_key_condition
+        (   p_key_columns,
+            sizeof...(Elements)
+        );
+    }
+
+    static void bind(SQLStatement& p_statement, Key const& p_key)
+    {
+        Impl::bind(p_statement, p_key);
+        return;
+    }
+
+    static Key extract(SQLStatement& p_statement, int p_first_column)
+    {
+        Key ret;
+        Impl::extract(p_statement, p_first_column, ret);
+        return ret;
+    }
+
+    struct Hash
+    {
+        std::size_t operator()(Key const& p_key) const
+        {
+            std::size_t ret = 0;
+            Impl::hash(p_key, ret);
+            return ret;
+        }
+    };
+};
+
+template <typename... Elements>
+bool const KeyTraits<std::tuple<Elements...> >::auto_increment;
+
+
+}  // namespace sqloxx
+
+#endif  // GUARD_key_traits_hpp_2960318847715306
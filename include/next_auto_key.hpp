@@ -19,6 +19,7 @@
 
 #include "sql_statement.hpp"
 #include "sqloxx_exceptions.hpp"
+#include "statement_key.hpp"
 #include <jewel/exception.hpp>
 #include <limits>
 #include <string>
@@ -53,9 +54,10 @@ namespace sqloxx
  * where a KeyType that is not accepted by SQLStatement::extract is
  * provided.
  * 
- * It is the caller's responsibility to ensure that KeyType is large
- * enough to accommodate the values that are \e already in the
- * primary key of the table - otherwise behaviour is undefined.
+ * KeyType may be any integral type up to \e long \e long. The
+ * sequence value is read at full width, so if the values \e already in
+ * the primary key of the table exceed the range of KeyType,
+ * sqloxx::TableSizeException is thrown (see below).
  *
  * This function should not be used if \c table_name is an untrusted
  * string.
@@ -68,7 +70,8 @@ namespace sqloxx
  * currently greatest value for the key (but see exceptions).
  * 
  * @throws sqloxx::TableSizeException if the greatest primary key value 
- * already in the table is the maximum value for \e KeyType, so that
+ * already in the table is (at least) the maximum value for \e KeyType,
+ * so that
  * another row could not be inserted without overflow.
  *
  * @throws sqloxx::DatabaseException, or a derivative therefrom, may
@@ -94,33 +97,35 @@ next_auto_key(Connection& dbc, std::string const& table_name)
 {
     try
     {
-        SQLStatement statement
-        (   dbc,
-            "select seq from sqlite_sequence where name = :p"
+        static constexpr StatementKey key
+        (   "select seq from sqlite_sequence where name = :p"
         );
+        SQLStatement statement(dbc, key);
         statement.bind(":p", table_name);
         if (!statement.step())
         {
             return 1;
         }
-        KeyType const max_key = statement.extract<KeyType>(0);
-        if (max_key == std::numeric_limits<KeyType>::max())
+        // Extract at full width, so that a sequence value that has
+        // outgrown KeyType is detected rather than truncated.
+        long long const max_key = statement.extract<long long>(0);
+        if (max_key >= std::numeric_limits<KeyType>::max())
         {
             JEWEL_THROW
             (   TableSizeException,
                 "Key cannot be safely incremented with given type."
             );
         }
-        return max_key + 1;
+        return static_cast<KeyType>(max_key + 1);
     }
     catch (SQLiteError&)
     {
         // Catches case where there is no sqlite_sequence table
-        SQLStatement sequence_finder
-        (   dbc,
-            "select name from sqlite_master where type = 'table' and "
+        static constexpr StatementKey key
+        (   "select name from sqlite_master where type = 'table' and "
             "name = 'sqlite_sequence';"
         );
+        SQLStatement sequence_finder(dbc, key);
         if (!sequence_finder.step())
         {
             return 1;
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_open_options_hpp_4293653085938426
+#define GUARD_open_options_hpp_4293653085938426
+
+#include <functional>
+#include <string>
+
+namespace sqloxx
+{
+
+/**
+ * Options governing how DatabaseConnection::open opens a database file.
+ * The default-constructed options open the file in the same way as
+ * DatabaseConnection::open always has.
+ */
+struct OpenOptions
+{
+    OpenOptions();
+
+    /**
+     * The name of the SQLite VFS through which the file is opened. If
+     * empty, the default VFS is used. The VFS must already be registered when the file is opened.
+     */
+    std::string vfs;
+
+    /**
+     * If \e true, the I/O performed by SQLite on behalf of the
+     * connection is counted, by interposing a further VFS in front of the
+     * one named by \e vfs. The counts are then available from
+     * DatabaseConnection::io_stats. Defaults to \e false.
+     */
+    bool io_stats;
+
+    /**
+     * The increment, in bytes, by which the database file is grown and
+     * shrunk (SQLITE_FCNTL_CHUNK_SIZE). Where a transaction
+     * extends the file, the VFS preallocates space to the next multiple of
+     * \e chunk_size, so that extensions, which are relatively costly, are
+     * fewer and larger. If 0 (the default), the file is grown only as far
+     * as each write requires. Extensions are counted in
+     * FileIoStats::extends where \e io_stats is set. Must not be
+     * negative.
+     */
+    int chunk_size;
+
+    /**
+     * If \e true, the WAL and WAL-index files are left in place, rather
+     * than deleted, when the last connection to the database closes
+     * (SQLITE_FCNTL_PERSIST_WAL), so that they need not be created and
+     * grown afresh on the next open. Defaults to \e false.
+     */
+    bool persist_wal;
+
+    /**
+     * The size, in bytes, to which a rollback journal or WAL file left
+     * behind by a transaction or checkpoint is truncated, as by
+     * "pragma journal_size_limit". If negative (the default), SQLite's
+     * default applies, under which such files are not truncated.
+     */
+    long long journal_size_limit;
+
+    /**
+     * The maximum number of pages in the database file, as by
+     * "pragma max_page_count". A transaction that would grow the file
+     * beyond this fails with SQLiteFull. If 0 (the default), SQLite's
+     * default limit applies.
+     */
+    long long max_page_count;
+
+    /**
+     * The function called by DatabaseConnection to warn that the database
+     * is approaching its maximum size. It is passed the number of pages in
+     * the database and the maximum number of pages.
+     */
+    typedef std::function<void(long long, long long)> PageCountHandler;
+
+    /**
+     * If set, this is called when the outermost transaction on the
+     * connection is about to be committed, if the database then occupies
+     * at least \e page_count_warning of its maximum number of pages, and
+     * did not do so when last checked. It is therefore called once as the
+     * threshold is crossed, and again only after the database has dropped
+     * back below it. If the handler throws, the commit fails and the
+     * transaction remains open, to be cancelled. Empty by default.
+     */
+    PageCountHandler page_count_handler;
+
+    /**
+     * The fraction of the maximum number of pages at which
+     * \e page_count_handler is called. Must be greater than 0 and no
+     * greater than 1. Defaults to 0.9.
+     */
+    double page_count_warning;
+};
+
+}  // namespace sqloxx
+
+#endif  // GUARD_open_options_hpp_4293653085938426
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef GUARD_page_cache_hpp_6875373906605935
+#define GUARD_page_cache_hpp_6875373906605935
+
+#include <cstddef>
+
+namespace sqloxx
+{
+
+/**
+ * Describes a pre-allocated arena from which SQLite takes the memory for
+ * its page cache, in place of allocating each page individually.
+ */
+struct PageCacheConfig
+{
+    PageCacheConfig();
+
+    // The page size of the databases to be cached (by default 1024, the
+    // default page size of the bundled SQLite). A slot in the arena
+    // holds one page together with SQLite's header for it. Pages larger
+    // than this, and pages for which the arena has no free slot, are
+    // allocated individually instead, and counted as overflow.
+    std::size_t page_size;
+
+    // The number of slots in the arena, shared by all connections.
+    std::size_t pages;
+
+    // Whether to ask the operating system to back the arena with
+    // transparent huge pages, where it supports them.
+    bool huge_pages;
+};
+
+/**
+ * Arranges for SQLite to take its page cache from an arena allocated
+ * according to \e p_config, when SQLite is initialized (on the
+ * construction of the first DatabaseConnection). The arena is mapped
+ * with \b mmap where available, and if \e p_config.huge_pages is set,
+ * advised with \b MADV_HUGEPAGE, so that the page cache is covered by
+ * few TLB entries; elsewhere it is allocated on the heap. The arena is
+ * never freed.
+ *
+ * This must be called before SQLite is used in any way; otherwise
+ * constructing the first
+ * DatabaseConnection throws SQLiteInitializationError.
+ *
+ * @throws LogicError if SQLite has already been initialized, or if
+ * \e p_config.page_size or \e p_config.pages is zero.
+ *
+ * <b>Exception safety</b>: <em>strong guarantee</em>.
+ */
+void configure_page_cache(PageCacheConfig const& p_config);
+
+/**
+ * Occupancy of the page cache arena, and overflow from it, across all
+ * connections, as reported by \b sqlite3_status.
+ */
+struct PageCacheStats
+{
+    PageCacheStats();
+
+    // The number of slots in the arena, and whether huge pages were
+    // advised for it (zero and false if no arena has been configured).
+    std::size_t arena_pages;
+    bool huge_pages;
+
+    // Slots currently in use, and the most ever in use.
+    std::size_t pages_used;
+    std::size_t peak_pages_used;
+
+    // Bytes of pages allocated outside the arena, currently and at most.
+    std::size_t overflow_bytes;
+    std::size_t peak_overflow_bytes;
+
+    // The largest allocation requested of the page cache, in bytes. If
+    // this exceeds the slot size, the slots are too small to be used.
+    std::size_t largest_request;
+    std::size_t slot_size;
+};
+
+/**
+ * @returns the current occupancy of the page cache arena, and overflow
+ * from it.
+ *
+ * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+ */
+PageCacheStats page_cache_stats();
+
+/// @cond
+namespace detail
+{
+
+/**
+ * Applies the configuration passed to configure_page_cache, if any. Called
+ * once only, before \b sqlite3_initialize.
+ *
+ * @throws SQLiteInitializationError if the arena cannot be allocated or
+ * SQLite rejects it.
+ */
+void initialize_page_cache();
+
+}  // namespace detail
+/// @endcond
+
+}  // namespace sqloxx
+
+#endif  // GUARD_page_cache_hpp_6875373906605935
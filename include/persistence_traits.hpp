@@ -68,6 +68,26 @@ struct PersistenceTraits
 
 };  // class PersistenceTraits
 
+
+/**
+ * Identifies the immediate parent of \b T within a hierarchy of
+ * persistent classes, for the purposes of sqloxx::TypeRegistry.
+ *
+ * By default, \b Parent is <b>PersistenceTraits<T>::Base</b>, which
+ * is correct where \b T is either the base of its hierarchy, or
+ * derives directly from it. Where a hierarchy is deeper than this (for
+ * example, where \b Sub2 derives from \b Sub, which derives from
+ * \b Super), this template should be specialized for each class below
+ * the second level, so that \b Parent is the class from which it
+ * immediately derives.
+ */
+template <typename T>
+struct PersistenceParent
+{
+    typedef typename PersistenceTraits<T>::Base Parent;
+
+};  // class PersistenceParent
+
 }  // namespace sqloxx
 
 #endif  // GUARD_persistence_traits_hpp_5478759168404508
@@ -22,22 +22,38 @@
 #include "handle_counter.hpp"
 #include "id.hpp"
 #include "identity_map.hpp"
+#include "key_traits.hpp"
 #include "next_auto_key.hpp"
 #include "persistence_traits.hpp"
+#include "persistent_object_fwd.hpp"
+#include "second_level_cache.hpp"
 #include "sql_statement.hpp"
 #include "sqloxx_exceptions.hpp"
+#include "statement_slot.hpp"
+#include "type_registry.hpp"
+#include <boost/any.hpp>
 #include <boost/optional.hpp>
 #include <jewel/assert.hpp>
 #include <jewel/exception.hpp>
 #include <jewel/log.hpp>
 #include <jewel/optional.hpp>
 #include <exception>
+#include <memory>
 #include <string>
 #include <type_traits>
+#include <utility>
 
 namespace sqloxx
 {
 
+/// @cond
+namespace detail
+{
+    template <typename T> class BatchLoader;  // fwd decl
+
+}  // namespace detail
+/// @endcond
+
 /**
  * Class template for creating objects persisted to a database. In client
  * code, this should be inherited by a derived class that defines certain
@@ -71,6 +87,11 @@ namespace sqloxx
  * that, for each record in the database, at most one object is loaded
  * into memory (i.e. cached in the IdentityMap). This prevents problems
  * with objects being edited across multiple instances.
+ *
+ * The count of Handles pointing to a given DerivedT instance is held
+ * intrusively, in the PersistentObject part of that instance, and is the
+ * only reference count maintained for it: the IdentityMap owns the object
+ * outright, and copying a Handle costs a single (non-atomic) increment.
  *    
  * See sqloxx::IdentityMap and sqloxx::Handle for further documentation
  * here.
@@ -131,7 +152,8 @@ namespace sqloxx
  * <em>static std::string \b primary_key_name();</em>\n
  * Should return, without side effects, the name of the primary
  * key column for DerivedT. This primary key column must appear in
- * the table named by \e exclusive_table_name(). The primary key
+ * the table named by \e exclusive_table_name(). Unless \e IdT is a
+ * composite key (see below), the primary key
  * must be a single-column integer primary key that is autoincrementing
  * (using the SQLite "autoincrement" key word).
  * If PersistentTraits<...> has been specialized for DerivedT, then it
@@ -159,16 +181,40 @@ namespace sqloxx
  * <em>virtual void \b do_ghostify()</em>;\n
  * See documentation for \e ghostify() function.
  *
+ * <em>virtual void \b do_load_row(SQLStatement&, int)</em>;\n
+ * See documentation for \e do_load_row(). This \e must be provided, along
+ * with <em>static std::string \b load_columns()</em>, for DerivedT to be
+ * loaded by sqloxx::prefetch.
+ *
+ * <em>virtual Id \b do_calculate_prospective_key() const</em>;\n
+ * See documentation for \e do_calculate_prospective_key(). This \e must
+ * be provided where \e IdT is a composite key.
+ *
  * <b>Template parameters</b>
  *
  * @param DerivedT The derived class. DerivedT should inherit publicly
- * from PersistentObject<DerivedT, ConnectionT> per the Curiously Recurring
+ * from PersistentObject<DerivedT, ConnectionT, IdT> per the Curiously Recurring
  * Template Pattern (CRTP).
  *
  * @param ConnectionT The type of the database connection through which
  * instances of DerivedT will be persisted to the database. ConnectionT
  * should be a class derived from sqloxx::DatabaseConnection.
  *
+ * @param IdT The type of the primary key of the table in which instances
+ * of DerivedT are stored. This defaults to sqloxx::Id (an \e int), but
+ * may be any integral type up to \e long \e long (the width of
+ * sqlite3_int64), for tables expected to exceed 2^31 rows. IdT is exposed
+ * as PersistentObject::Id, and is used as the key type by IdentityMap,
+ * Handle and TableIterator. Where the hierarchy has a Base other than
+ * DerivedT, DerivedT should inherit from PersistentObject with the same
+ * IdT as Base.
+ * \e IdT may also be a std::tuple, with one element per column of a
+ * composite (or other natural) primary key, as for a table created
+ * "without rowid". In that case \e primary_key_name() should return the
+ * comma-separated list of key columns, in tuple order, and the key of each
+ * new object is supplied by the derived class via
+ * \e do_calculate_prospective_key(). See sqloxx::KeyTraits.
+ *
  * @todo LOW PRIORITY Have a single location for documenting use of Sqloxx
  * holistically, perhaps with an extended example (but see "tests/example.hpp"
  * and "tests/example.cpp" already done).
@@ -179,11 +225,16 @@ namespace sqloxx
  * hold references or Handles to each other. For more on this issue, see the
  * documentation for IdentityMap::~IdentityMap.
  */
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 class PersistentObject
 {
+    // Cache keys are allocated by IdentityMap<Base>, independently of
+    // IdT, and are always of type sqloxx::Id.
+    typedef sqloxx::Id CacheKey;
+
 public:
 
+    typedef IdT Id;
     typedef ConnectionT Connection;
     typedef typename sqloxx::PersistenceTraits<DerivedT>::Base Base;
     typedef sqloxx::IdentityMap<Base> IdentityMap;
@@ -391,6 +442,12 @@ public:
      * May also throw exceptions from \b do_save_new() and/or \b do_save_exising(),
      * depending on how those functions are defined in the derived class.
      *
+     * If write-behind is enabled for the IdentityMap of an object that has
+     * an id, the object is not written to the database immediately, but
+     * when the IdentityMap is flushed (see
+     * IdentityMap::enable_write_behind). save() may then throw exceptions
+     * from flushing the IdentityMap.
+     *
      * <b>Exception safety</b>: <em>basic guarantee</em>. Possible outcomes
      * from calling save() are as follows -\n
      *  (a) Complete success;\n
@@ -515,7 +572,7 @@ public:
     /// @cond
     /**
      * Provides access to get m_cache_key, set m_cache_key,
-     * and clear m_id, only to
+     * get and set m_type_tag, and clear m_id, only to
      * to IdentityMap<Base>.
      */
     class KeyAttorney
@@ -523,12 +580,12 @@ public:
     public:
         friend class sqloxx::IdentityMap<Base>;
     private:
-        static void set_cache_key(DerivedT& p_obj, Id p_cache_key)
+        static void set_cache_key(DerivedT& p_obj, CacheKey p_cache_key)
         {
             p_obj.set_cache_key(p_cache_key);
             return;
         }
-        static Id cache_key(DerivedT& p_obj)
+        static CacheKey cache_key(DerivedT& p_obj)
         {
             return jewel::value(p_obj.m_cache_key);
         }
@@ -537,6 +594,15 @@ public:
             p_obj.clear_id();
             return;
         }
+        static void set_type_tag(DerivedT& p_obj, TypeTag const& p_tag)
+        {
+            p_obj.m_type_tag = &p_tag;
+            return;
+        }
+        static TypeTag const& type_tag(DerivedT const& p_obj)
+        {
+            return p_obj.type_tag();
+        }
     };
     
     friend class KeyAttorney;
@@ -564,6 +630,47 @@ public:
 
     friend class HandleMonitorAttorney;
 
+    /**
+     * Controls access to the loading of an object from a result row
+     * already selected by a batched query, deliberately restricting this
+     * access to detail::BatchLoader.
+     */
+    class RowLoadAttorney
+    {
+    public:
+        template <typename T> friend class sqloxx::detail::BatchLoader;
+    private:
+        static void load_row
+        (   DerivedT& p_obj,
+            SQLStatement& p_row,
+            int p_first_column
+        )
+        {
+            p_obj.load_row(p_row, p_first_column);
+            return;
+        }
+    };
+
+    friend class RowLoadAttorney;
+
+    /**
+     * Controls access to the saving of an object whose save() has been
+     * deferred, deliberately restricting this access to IdentityMap<Base>.
+     */
+    class WriteBehindAttorney
+    {
+    public:
+        friend class sqloxx::IdentityMap<Base>;
+    private:
+        static void save_existing(DerivedT& p_obj)
+        {
+            p_obj.save_deferred();
+            return;
+        }
+    };
+
+    friend class WriteBehindAttorney;
+
     /// @endcond
 
 protected:
@@ -635,6 +742,16 @@ protected:
      * DatabaseConnection::end_transaction().
      * This is taken care of by the base load() method.
      *
+     * If a SecondLevelCache is attached to the database connection, and
+     * no transaction is open on the connection when load() is called, then
+     * load() first looks in the SecondLevelCache for a snapshot of the
+     * object, and if one is found, restores the object from it via
+     * \b do_restore() rather than calling \b do_load(). Otherwise, once
+     * \b do_load() has succeeded, a snapshot taken via \b do_snapshot() is
+     * published to the SecondLevelCache. (Where a transaction is already
+     * open, the cache is bypassed, as the transaction may have written
+     * to the object's rows.)
+     *
      * The following exceptions may be thrown regardless of how
      * \b do_load() is defined:
      *
@@ -692,7 +809,8 @@ protected:
 
     /**
      * @returns the id that would be assigned to this instance of
-     * PersistentObject when saved to the database. This uses SQLite's
+     * PersistentObject when saved to the database, as calculated by
+     * do_calculate_prospective_key(). By default this uses SQLite's
      * built-in auto-incrementing primary key.
      *
      * @throws sqloxx::LogicError in the event this instance already has
@@ -721,6 +839,28 @@ protected:
      */
     Id prospective_key() const;
 
+    /**
+     * This function is called by prospective_key(), which is in turn
+     * called by save() when saving a new object.
+     *
+     * Where KeyTraits<Id>::auto_increment is \e true (as for integral
+     * keys), the default implementation returns the next key that SQLite
+     * will assign, via sqloxx::next_auto_key. Otherwise (as for composite
+     * keys) the key cannot be known to the database in advance, and
+     * DerivedT must override this function to return the key formed
+     * from the fields of this object.
+     *
+     * @throws sqloxx::LogicError if the default implementation is called
+     * where KeyTraits<Id>::auto_increment is \e false.
+     *
+     * See prospective_key() for other exceptions that may be thrown by
+     * the default implementation.
+     *
+     * <b>Exception safety</b>: the default implementation offers the
+     * <em>strong guarantee</em>.
+     */
+    virtual Id do_calculate_prospective_key() const;
+
     /**
      * This function is called by remove(). For that function, and the
      * role of \b do_remove() within that function, see the separate
@@ -753,6 +893,84 @@ private:
      */
     virtual void do_ghostify();
 
+    /**
+     * Called when the object is loaded as part of a batch by
+     * sqloxx::prefetch, to populate the object from the current row of
+     * \e p_row, in which the columns named by
+     * <em>DerivedT::load_columns()</em> start at \e p_first_column.
+     * This is only called on an object that is in a ghost state.
+     *
+     * Unless overridden, this throws sqloxx::LogicError, so that only
+     * classes that provide it can be prefetched.
+     */
+    virtual void do_load_row(SQLStatement& p_row, int p_first_column);
+
+    /**
+     * @returns a snapshot of the fields of this object loaded by
+     * do_load(), for publication to a SecondLevelCache. The snapshot must
+     * not share mutable state with the object. It should be restorable by
+     * do_restore() into a ghost of the same dynamic type.
+     *
+     * Unless overridden, this returns an empty boost::any, in which case
+     * the object is not published.
+     */
+    virtual boost::any do_snapshot() const;
+
+    /**
+     * Populates this object, which is in a ghost state, from
+     * \e p_snapshot, being a snapshot previously returned by
+     * do_snapshot() for an object of the same dynamic type and id.
+     *
+     * Unless overridden this does nothing (it is never called unless
+     * do_snapshot() has been overridden).
+     */
+    virtual void do_restore(boost::any const& p_snapshot);
+
+    /**
+     * If a SecondLevelCache is attached to the connection and holds a
+     * snapshot of this object, restores this object from it.
+     *
+     * @returns \e true if and only if the object was restored.
+     */
+    bool restore_from_second_level_cache(SecondLevelCache& p_cache);
+
+    /**
+     * Publishes a snapshot of this object (if do_snapshot() provides one)
+     * to \e p_cache, as loaded during \e p_epoch.
+     */
+    void publish_to_second_level_cache
+    (   SecondLevelCache& p_cache,
+        SecondLevelCache::Epoch p_epoch
+    ) const;
+
+    // Loads this object, which must be a ghost with an id. The
+    // std::true_type overload, used for integral ids, consults the
+    // SecondLevelCache of the connection, if there is one, outside any
+    // transaction. SecondLevelCache supports only integral keys, so the
+    // std::false_type overload simply loads from the database.
+    void load_ghost(std::true_type);
+    void load_ghost(std::false_type);
+
+    /**
+     * If the object is a ghost, loads it via do_load_row; otherwise does
+     * nothing.
+     *
+     * <b>Exception safety</b>: <em>basic guarantee</em>; if do_load_row
+     * throws, the object is returned to a ghost state.
+     */
+    void load_row(SQLStatement& p_row, int p_first_column);
+
+    /**
+     * Saves an existing object whose save() was deferred by its
+     * IdentityMap, within a transaction opened by the IdentityMap.
+     */
+    void save_deferred();
+
+    // Default implementations of do_calculate_prospective_key, selected by
+    // KeyTraits<Id>::auto_increment.
+    Id calculate_auto_key(std::true_type) const;
+    Id calculate_auto_key(std::false_type) const;
+
     /**
      * @returns \e true if and only if there are no Handle
      * instances pointing to this object.
@@ -808,13 +1026,21 @@ private:
      *
      * <b>Exception safety</b>: <em>nothrow guarantee</em>.
      */
-    void set_cache_key(Id p_cache_key);
+    void set_cache_key(CacheKey p_cache_key);
 
     /**
      * Clears m_id
      */
     void clear_id();
 
+    /**
+     * @returns the TypeTag for the dynamic type of this object, as
+     * stored by IdentityMap<Base> on creation of the object.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    TypeTag const& type_tag() const;
+
     enum LoadingStatus
     {
         ghost = 0,
@@ -842,7 +1068,11 @@ private:
     // by the IdentityMap, and so still need a means for the IdentityMap to
     // identify them in their internal cache. Hence the need for a cache_key
     // distinct from the id.
-    boost::optional<Id> m_cache_key;
+    boost::optional<CacheKey> m_cache_key;
+
+    // Identifies the dynamic type of the object, so that downcasts can
+    // be checked without RTTI. Set by IdentityMap after construction.
+    TypeTag const* m_type_tag;
 
     LoadingStatus m_loading_status;
     HandleCounter m_handle_counter;
@@ -851,87 +1081,91 @@ private:
 
 
 
-template <typename DerivedT, typename ConnectionT>
-PersistentObject<DerivedT, ConnectionT>::PersistentObject
+template <typename DerivedT, typename ConnectionT, typename IdT>
+PersistentObject<DerivedT, ConnectionT, IdT>::PersistentObject
 (   IdentityMap& p_identity_map,
     Id p_id
 ):
     m_identity_map(&p_identity_map),
     m_id(p_id),
+    m_type_tag(nullptr),
     m_loading_status(ghost),
     m_handle_counter(0)
 {
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 inline
-PersistentObject<DerivedT, ConnectionT>::PersistentObject
+PersistentObject<DerivedT, ConnectionT, IdT>::PersistentObject
 (   IdentityMap& p_identity_map    
 ):
     m_identity_map(&p_identity_map),
+    m_type_tag(nullptr),
     m_loading_status(ghost),
     m_handle_counter(0)
-    // Note m_cache_key is left unitialized. It is the responsibility
-    // of IdentityMap to call set_cache_key after construction,
-    // before providing a Handle to a newly created DerivedT instance.
+    // Note m_cache_key is left unitialized, and m_type_tag null. It is the
+    // responsibility of IdentityMap to call set_cache_key and set_type_tag
+    // after construction, before providing a Handle to a newly created
+    // DerivedT instance.
 {
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 inline
-PersistentObject<DerivedT, ConnectionT>::~PersistentObject()
+PersistentObject<DerivedT, ConnectionT, IdT>::~PersistentObject()
 {
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 inline
 std::string
-PersistentObject<DerivedT, ConnectionT>::primary_table_name()
+PersistentObject<DerivedT, ConnectionT, IdT>::primary_table_name()
 {
     return Base::exclusive_table_name();
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 bool
-PersistentObject<DerivedT, ConnectionT>::exists
+PersistentObject<DerivedT, ConnectionT, IdT>::exists
 (   ConnectionT& p_database_connection,
     Id p_id
 )
 {
     // Could throw std::bad_alloc
-    static std::string const text =
-        "select * from " +
+    static StatementSlot const slot
+    (   "select * from " +
         DerivedT::exclusive_table_name() +
         " where " +
-        Base::primary_key_name() +
-        " = :p";
+        KeyTraits<Id>::condition(Base::primary_key_name())
+    );
     // Could throw InvalidConnection or SQLiteException
-    SQLStatement statement(p_database_connection, text);
+    SQLStatement statement(p_database_connection, slot);
     // Could throw InvalidConnection or SQLiteException
-    statement.bind(":p", p_id);
+    KeyTraits<Id>::bind(statement, p_id);
     // Could throw InvalidConnection or SQLiteException
     return statement.step();
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 bool
-PersistentObject<DerivedT, ConnectionT>::none_saved
+PersistentObject<DerivedT, ConnectionT, IdT>::none_saved
 (   ConnectionT& p_database_connection
 )
 {
     // Could throw std::bad_alloc
-    static std::string const text =
-        "select * from " +
-        DerivedT::exclusive_table_name();
+    static StatementSlot const slot
+    (   "select * from " +
+        DerivedT::exclusive_table_name()
+    );
     // Could throw InvalidConnection or SQLiteException
-    SQLStatement statement(p_database_connection, text);
+    SQLStatement statement(p_database_connection, slot);
     // Could throw InvalidConnection or SQLiteException
     return !statement.step();
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 void
-PersistentObject<DerivedT, ConnectionT>::load()
+PersistentObject<DerivedT, ConnectionT, IdT>::load()
 {
     while (m_loading_status == loading)
     {
@@ -939,27 +1173,59 @@ PersistentObject<DerivedT, ConnectionT>::load()
     }
     if (m_loading_status == ghost && has_id())
     {
-        DatabaseTransaction transaction(database_connection());
-        m_loading_status = loading;
-        try
-        {
-            do_load();    
-            transaction.commit();
-        }
-        catch (std::exception&)
-        {
-            ghostify();
-            transaction.cancel();
-            throw;
-        }
-        m_loading_status = loaded;
+        load_ghost(std::is_integral<IdT>());
+    }
+    return;
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
+void
+PersistentObject<DerivedT, ConnectionT, IdT>::load_ghost(std::true_type)
+{
+    ConnectionT& connection = database_connection();
+    SecondLevelCache* const second_level_cache =
+        connection.second_level_cache();
+    if (!second_level_cache || connection.transaction_nesting_level() != 0)
+    {
+        load_ghost(std::false_type());
+        return;
+    }
+    if (restore_from_second_level_cache(*second_level_cache))
+    {
+        return;
+    }
+    // Read before loading, so that a commit made while we are loading
+    // causes our snapshot to be discarded.
+    SecondLevelCache::Epoch const epoch = second_level_cache->epoch();
+    load_ghost(std::false_type());
+    publish_to_second_level_cache(*second_level_cache, epoch);
+    return;
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
+void
+PersistentObject<DerivedT, ConnectionT, IdT>::load_ghost(std::false_type)
+{
+    DatabaseTransaction transaction(database_connection());
+    m_loading_status = loading;
+    try
+    {
+        do_load();    
+        transaction.commit();
+    }
+    catch (std::exception&)
+    {
+        ghostify();
+        transaction.cancel();
+        throw;
     }
+    m_loading_status = loaded;
     return;
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 void
-PersistentObject<DerivedT, ConnectionT>::save()
+PersistentObject<DerivedT, ConnectionT, IdT>::save()
 {
     JEWEL_ASSERT (m_cache_key);  // precondition
     if (has_id())  // nothrow
@@ -967,6 +1233,18 @@ PersistentObject<DerivedT, ConnectionT>::save()
         // basic guarantee, under preconditions of do_load (see load())
         load(); 
 
+        // basic guarantee; true if write-behind is enabled for the
+        // IdentityMap, in which case the IdentityMap will save the object
+        if
+        (   IdentityMap::PersistentObjectAttorney::defer_save
+            (   *m_identity_map,
+                *m_cache_key
+            )
+        )
+        {
+            return;
+        }
+
         // strong guarantee
         DatabaseTransaction transaction(database_connection());
         try
@@ -1021,9 +1299,9 @@ PersistentObject<DerivedT, ConnectionT>::save()
     return;
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 void
-PersistentObject<DerivedT, ConnectionT>::remove()
+PersistentObject<DerivedT, ConnectionT, IdT>::remove()
 {
     if (has_id())
     {
@@ -1050,36 +1328,49 @@ PersistentObject<DerivedT, ConnectionT>::remove()
     return;
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
+void
+PersistentObject<DerivedT, ConnectionT, IdT>::save_deferred()
+{
+    JEWEL_ASSERT (has_id());
+    load();
+    do_save_existing();
+    m_loading_status = loaded;
+    return;
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
 inline
-Id
-PersistentObject<DerivedT, ConnectionT>::id() const
+IdT
+PersistentObject<DerivedT, ConnectionT, IdT>::id() const
 {
     return jewel::value(m_id);
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 inline
 void
-PersistentObject<DerivedT, ConnectionT>::set_cache_key(Id p_cache_key)
+PersistentObject<DerivedT, ConnectionT, IdT>::set_cache_key
+(   CacheKey p_cache_key
+)
 {
     m_cache_key = p_cache_key;
     return;
 }
 
 template
-<typename DerivedT, typename ConnectionT>
+<typename DerivedT, typename ConnectionT, typename IdT>
 void
-PersistentObject<DerivedT, ConnectionT>::clear_id()
+PersistentObject<DerivedT, ConnectionT, IdT>::clear_id()
 {
     jewel::clear(m_id);
     return;
 }
 
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 void
-PersistentObject<DerivedT, ConnectionT>::increment_handle_counter()
+PersistentObject<DerivedT, ConnectionT, IdT>::increment_handle_counter()
 {
     if (m_handle_counter == std::numeric_limits<HandleCounter>::max())
     {
@@ -1093,9 +1384,9 @@ PersistentObject<DerivedT, ConnectionT>::increment_handle_counter()
     return;
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 void
-PersistentObject<DerivedT, ConnectionT>::decrement_handle_counter()
+PersistentObject<DerivedT, ConnectionT, IdT>::decrement_handle_counter()
 {
     switch (m_handle_counter)
     {
@@ -1122,18 +1413,18 @@ PersistentObject<DerivedT, ConnectionT>::decrement_handle_counter()
     return;
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 inline
 ConnectionT&
-PersistentObject<DerivedT, ConnectionT>::database_connection() const
+PersistentObject<DerivedT, ConnectionT, IdT>::database_connection() const
 {
     JEWEL_ASSERT (m_identity_map);
     return m_identity_map->connection();
 }
 
-template <typename DerivedT, typename ConnectionT>
-Id
-PersistentObject<DerivedT, ConnectionT>::prospective_key() const
+template <typename DerivedT, typename ConnectionT, typename IdT>
+IdT
+PersistentObject<DerivedT, ConnectionT, IdT>::prospective_key() const
 {
     if (has_id())
     {
@@ -1142,72 +1433,219 @@ PersistentObject<DerivedT, ConnectionT>::prospective_key() const
             "Object already has id so prospective_key does not apply."
         );
     }
+    return do_calculate_prospective_key();
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
+IdT
+PersistentObject<DerivedT, ConnectionT, IdT>::
+do_calculate_prospective_key() const
+{
+    return calculate_auto_key
+    (   std::integral_constant<bool, KeyTraits<Id>::auto_increment>()
+    );
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
+IdT
+PersistentObject<DerivedT, ConnectionT, IdT>::calculate_auto_key
+(   std::true_type
+) const
+{
     return next_auto_key<ConnectionT, Id>
     (   database_connection(),
         primary_table_name()
     );
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
+IdT
+PersistentObject<DerivedT, ConnectionT, IdT>::calculate_auto_key
+(   std::false_type
+) const
+{
+    JEWEL_THROW
+    (   LogicError,
+        "do_calculate_prospective_key must be overridden for a "
+        "composite key."
+    );
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
 void
-PersistentObject<DerivedT, ConnectionT>::do_remove()
+PersistentObject<DerivedT, ConnectionT, IdT>::do_remove()
 {
+    // The text is built only once per DerivedT.
     // primary_table_name() might throw std::bad_alloc (strong guar.).
     // primary_key_name() might throw might throw InvalidConnection or
     // std::bad_alloc.
-    std::string const statement_text =
-        "delete from " + primary_table_name() + " where " +
-        Base::primary_key_name() + " = :p";
+    static StatementSlot const slot
+    (   "delete from " + primary_table_name() + " where " +
+        KeyTraits<Id>::condition(Base::primary_key_name())
+    );
     
     // Might throw InvalidConnection or std::bad_alloc
-    SQLStatement statement(database_connection(), statement_text);
-    statement.bind(":p", id());  // Might throw InvalidConnection
+    SQLStatement statement(database_connection(), slot);
+    KeyTraits<Id>::bind(statement, id());  // Might throw InvalidConnection
     // throwing above this point will have no effect
 
     statement.step_final();  // Might throw InvalidConnection
     return;
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
+void
+PersistentObject<DerivedT, ConnectionT, IdT>::do_load_row
+(   SQLStatement& p_row,
+    int p_first_column
+)
+{
+    (void)p_row;  // silence compiler re. unused param.
+    (void)p_first_column;  // silence compiler re. unused param.
+    JEWEL_THROW
+    (   LogicError,
+        "do_load_row must be overridden for a class to be prefetched."
+    );
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
+boost::any
+PersistentObject<DerivedT, ConnectionT, IdT>::do_snapshot() const
+{
+    return boost::any();
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
+void
+PersistentObject<DerivedT, ConnectionT, IdT>::do_restore
+(   boost::any const& p_snapshot
+)
+{
+    (void)p_snapshot;  // silence compiler re. unused param.
+    return;
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
+bool
+PersistentObject<DerivedT, ConnectionT, IdT>::restore_from_second_level_cache
+(   SecondLevelCache& p_cache
+)
+{
+    SecondLevelCache::Snapshot const snapshot = p_cache.find
+    (   type_tag(),
+        static_cast<long long>(id())
+    );
+    if (!snapshot)
+    {
+        return false;
+    }
+    m_loading_status = loading;
+    try
+    {
+        do_restore(*snapshot);
+    }
+    catch (std::exception&)
+    {
+        ghostify();
+        throw;
+    }
+    m_loading_status = loaded;
+    return true;
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
+void
+PersistentObject<DerivedT, ConnectionT, IdT>::publish_to_second_level_cache
+(   SecondLevelCache& p_cache,
+    SecondLevelCache::Epoch p_epoch
+) const
+{
+    boost::any snapshot = do_snapshot();
+    if (!snapshot.empty())
+    {
+        p_cache.publish
+        (   type_tag(),
+            static_cast<long long>(id()),
+            p_epoch,
+            std::make_shared<boost::any const>(std::move(snapshot))
+        );
+    }
+    return;
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
+void
+PersistentObject<DerivedT, ConnectionT, IdT>::load_row
+(   SQLStatement& p_row,
+    int p_first_column
+)
+{
+    if (m_loading_status == ghost)
+    {
+        m_loading_status = loading;
+        try
+        {
+            do_load_row(p_row, p_first_column);
+        }
+        catch (std::exception&)
+        {
+            ghostify();
+            throw;
+        }
+        m_loading_status = loaded;
+    }
+    return;
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
 inline
 void
-PersistentObject<DerivedT, ConnectionT>::do_ghostify()
+PersistentObject<DerivedT, ConnectionT, IdT>::do_ghostify()
 {
     // do nothing
     return;
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 inline
 bool
-PersistentObject<DerivedT, ConnectionT>::has_id() const
+PersistentObject<DerivedT, ConnectionT, IdT>::has_id() const
 {
     // Relies on the fact that m_id is a boost::optional<Id>, and
     // will convert to true if and only if it has been initialized.
     return static_cast<bool>(m_id);
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
+inline
+TypeTag const&
+PersistentObject<DerivedT, ConnectionT, IdT>::type_tag() const
+{
+    JEWEL_ASSERT (m_type_tag);
+    return *m_type_tag;
+}
+
+template <typename DerivedT, typename ConnectionT, typename IdT>
 inline
 bool
-PersistentObject<DerivedT, ConnectionT>::is_orphaned() const
+PersistentObject<DerivedT, ConnectionT, IdT>::is_orphaned() const
 {
     return m_handle_counter == 0;
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 inline
 bool
-PersistentObject<DerivedT, ConnectionT>::has_high_handle_count() const
+PersistentObject<DerivedT, ConnectionT, IdT>::has_high_handle_count() const
 {
     static HandleCounter const safe_limit =
         std::numeric_limits<HandleCounter>::max() - 2;
     return m_handle_counter >= safe_limit;
 }
 
-template <typename DerivedT, typename ConnectionT>
+template <typename DerivedT, typename ConnectionT, typename IdT>
 void
-PersistentObject<DerivedT, ConnectionT>::
+PersistentObject<DerivedT, ConnectionT, IdT>::
 ghostify()
 {
     do_ghostify();
@@ -1216,15 +1654,15 @@ ghostify()
 }
         
 template
-<typename DerivedT, typename ConnectionT>
+<typename DerivedT, typename ConnectionT, typename IdT>
 void
-PersistentObject<DerivedT, ConnectionT>::swap
+PersistentObject<DerivedT, ConnectionT, IdT>::swap
 (   PersistentObject& rhs
 )
 {
     IdentityMap* const temp_id_map = rhs.m_identity_map;
     boost::optional<Id> const temp_id = rhs.m_id;
-    boost::optional<Id> const temp_cache_key = rhs.m_cache_key;
+    boost::optional<CacheKey> const temp_cache_key = rhs.m_cache_key;
     LoadingStatus const temp_loading_status = rhs.m_loading_status;
     HandleCounter const temp_handle_counter = rhs.m_handle_counter;
 
@@ -17,10 +17,12 @@
 #ifndef GUARD_persistent_object_fwd_hpp_4257712119378947
 #define GUARD_persistent_object_fwd_hpp_4257712119378947
 
+#include "id.hpp"
+
 namespace sqloxx
 {
 
-template <typename Derived, typename Connection>
+template <typename Derived, typename Connection, typename IdT = Id>
 class PersistentObject;
 
 }  // namespace sqloxx
@@ -0,0 +1,525 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_prefetch_hpp_5813094672201187
+#define GUARD_prefetch_hpp_5813094672201187
+
+#include "database_transaction.hpp"
+#include "handle.hpp"
+#include "key_traits.hpp"
+#include "sql_statement.hpp"
+#include "statement_slot.hpp"
+#include "type_registry.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sqloxx
+{
+
+/**
+ * Keeps alive the objects loaded by a call to sqloxx::prefetch.
+ *
+ * An object loaded by prefetch() remains in its IdentityMap, in a loaded
+ * state, for as long as there are Handles to it (or for as long as caching
+ * is enabled in the IdentityMap). PrefetchedObjects holds a Handle to every
+ * such object, so that they are not evicted before client code traverses
+ * them. Destroying the PrefetchedObjects releases these Handles.
+ */
+class PrefetchedObjects
+{
+public:
+
+    PrefetchedObjects();
+    PrefetchedObjects(PrefetchedObjects const&) = delete;
+    PrefetchedObjects(PrefetchedObjects&&) = default;
+    PrefetchedObjects& operator=(PrefetchedObjects const&) = delete;
+    PrefetchedObjects& operator=(PrefetchedObjects&&) = default;
+    ~PrefetchedObjects() = default;
+
+    /**
+     * @returns the number of objects held.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    std::size_t size() const;
+
+    /// @cond
+    template <typename T>
+    void retain(std::vector<Handle<T> >&& p_handles);
+    /// @endcond
+
+private:
+
+    // Each element is a std::vector<Handle<T> > for some T.
+    std::vector<std::shared_ptr<void> > m_batches;
+    std::size_t m_size;
+
+};  // class PrefetchedObjects
+
+
+/// @cond
+namespace detail
+{
+
+typedef std::deque<std::function<void()> > PrefetchQueue;
+
+/**
+ * The number of keys bound by each batched query. Shorter batches are
+ * padded by repeating a key, so that each statement text has exactly
+ * one prepared form.
+ */
+std::size_t const prefetch_chunk_size = 64;
+
+/**
+ * @returns ":p0, :p1, ..., :p63", being the parameters of a batched
+ * query, for use in an "in (...)" clause.
+ */
+std::string const& prefetch_parameter_list();
+
+/**
+ * @returns the name of the \e p_index-th parameter in
+ * prefetch_parameter_list().
+ */
+std::string const& prefetch_parameter(std::size_t p_index);
+
+/**
+ * Loads objects of type \b T, in batches, from rows of the tables
+ * of \b T selected by a condition on a list of keys.
+ */
+template <typename T>
+class BatchLoader
+{
+public:
+    typedef typename T::Connection Connection;
+    typedef typename T::Id Id;
+
+    static_assert
+    (   KeyTraits<Id>::auto_increment,
+        "Prefetching requires a single-column integral primary key."
+    );
+
+    /**
+     * @returns the text of a query selecting the primary key and
+     * <em>T::load_columns()</em> where the text
+     * <em>p_prefix + prefetch_parameter_list() + p_suffix</em> is
+     * satisfied.
+     */
+    static std::string select_text
+    (   std::string const& p_prefix,
+        std::string const& p_suffix
+    );
+
+    /**
+     * Executes the statement for \e p_slot, as returned by select_text,
+     * with the keys \e p_keys, and loads each object selected. Handles to
+     * the objects are retained in \e p_out.
+     *
+     * @returns the ids of the objects loaded.
+     */
+    template <typename KeyT>
+    static std::vector<Id> load
+    (   Connection& p_connection,
+        StatementSlot const& p_slot,
+        std::vector<KeyT> p_keys,
+        PrefetchedObjects& p_out
+    );
+};
+
+}  // namespace detail
+/// @endcond
+
+
+/**
+ * Declares a relationship from instances of \b From to instances of some
+ * other PersistentObject class, along which sqloxx::prefetch can load
+ * related objects in batches. See ToOne and ToMany.
+ *
+ * Relationships are intended to be declared once (e.g. as static
+ * objects), since each one owns a StatementSlot.
+ */
+template <typename From>
+class Relationship
+{
+public:
+    typedef typename From::Connection Connection;
+    typedef typename From::Id Id;
+
+    Relationship() = default;
+    Relationship(Relationship const&) = delete;
+    Relationship(Relationship&&) = delete;
+    Relationship& operator=(Relationship const&) = delete;
+    Relationship& operator=(Relationship&&) = delete;
+    virtual ~Relationship() = default;
+
+    /// @cond
+    void follow
+    (   Connection& p_connection,
+        std::vector<Id> const& p_from_ids,
+        PrefetchedObjects& p_out,
+        detail::PrefetchQueue& p_queue
+    ) const;
+    /// @endcond
+
+private:
+    virtual void do_follow
+    (   Connection& p_connection,
+        std::vector<Id> const& p_from_ids,
+        PrefetchedObjects& p_out,
+        detail::PrefetchQueue& p_queue
+    ) const = 0;
+
+};  // class Relationship
+
+
+/**
+ * Common base of ToOne and ToMany, which load objects of type \b To
+ * related to objects of type \b From. Further relationships from
+ * \b To can be chained with then(), to be followed at the next level of
+ * prefetching.
+ */
+template <typename From, typename To>
+class RelationshipTo: public Relationship<From>
+{
+public:
+    typedef typename From::Connection Connection;
+    typedef typename From::Id Id;
+
+    /**
+     * Adds a relationship to be followed from the objects loaded via this
+     * one.
+     *
+     * @returns a reference to this object, so that calls can be chained.
+     */
+    RelationshipTo& then(std::shared_ptr<Relationship<To> > p_next);
+
+protected:
+
+    /**
+     * @param p_prefix and \e p_suffix enclose the list of ids of \b From
+     * objects, to form the condition selecting the related \b To objects.
+     */
+    RelationshipTo(std::string const& p_prefix, std::string const& p_suffix);
+
+private:
+    void do_follow
+    (   Connection& p_connection,
+        std::vector<Id> const& p_from_ids,
+        PrefetchedObjects& p_out,
+        detail::PrefetchQueue& p_queue
+    ) const override;
+
+    StatementSlot m_slot;
+    std::vector<std::shared_ptr<Relationship<To> > > m_next;
+
+};  // class RelationshipTo
+
+
+/**
+ * Declares that each \b From is related to (at most) one \b To, by way of
+ * a foreign key column in <em>From::exclusive_table_name()</em>, which
+ * refers to the primary key of \b To.
+ */
+template <typename From, typename To>
+class ToOne: public RelationshipTo<From, To>
+{
+public:
+
+    /**
+     * @param p_foreign_key the name of the column in
+     * <em>From::exclusive_table_name()</em> that refers to \b To.
+     *
+     * @throws std::bad_alloc in the unlikely event of memory allocation
+     * failure.
+     */
+    explicit ToOne(std::string const& p_foreign_key);
+
+};  // class ToOne
+
+
+/**
+ * Declares that each \b From is related to any number of \b To, by way of
+ * a foreign key column in <em>To::exclusive_table_name()</em>, which
+ * refers to the primary key of \b From.
+ */
+template <typename From, typename To>
+class ToMany: public RelationshipTo<From, To>
+{
+public:
+
+    /**
+     * @param p_foreign_key the name of the column in
+     * <em>To::exclusive_table_name()</em> that refers to \b From.
+     *
+     * @throws std::bad_alloc in the unlikely event of memory allocation
+     * failure.
+     */
+    explicit ToMany(std::string const& p_foreign_key);
+
+};  // class ToMany
+
+
+/**
+ * Loads the objects of type \b T with the ids \e p_ids and then, breadth
+ * first, the objects related to them along \e p_relationships (and along
+ * the relationships chained from those). Each level of each relationship
+ * is loaded with one query per prefetch_chunk_size ids, rather than
+ * one query per object, avoiding the "N+1" pattern of loading related
+ * objects one at a time as they are traversed.
+ *
+ * Each class loaded must provide <em>static std::string
+ * load_columns()</em>, returning the comma-separated columns from which it
+ * is loaded (selectable from the join of its tables), and must override
+ * PersistentObject::do_load_row to read those columns. Objects already
+ * loaded in their IdentityMap are left untouched. Only objects whose
+ * dynamic type is the type named in the relationship should be loaded in
+ * this way.
+ *
+ * All loading is done within a single DatabaseTransaction.
+ *
+ * @returns a PrefetchedObjects holding Handles to every object loaded.
+ *
+ * @throws sqloxx::LogicError if a class loaded does not override
+ * do_load_row.
+ *
+ * @throws InvalidConnection if the connection is invalid, or
+ * sqloxx::DatabaseException (or a derivative) in the event of some other
+ * database error.
+ *
+ * <b>Exception safety</b>: <em>basic guarantee</em>. The transaction is
+ * cancelled, and any object partially loaded is left as a ghost.
+ */
+template <typename T>
+PrefetchedObjects prefetch
+(   typename T::Connection& p_connection,
+    std::vector<typename T::Id> const& p_ids,
+    std::vector<std::shared_ptr<Relationship<T> > > const&
+        p_relationships =
+            std::vector<std::shared_ptr<Relationship<T> > >()
+);
+
+
+// IMPLEMENTATION
+
+template <typename T>
+void
+PrefetchedObjects::retain(std::vector<Handle<T> >&& p_handles)
+{
+    m_size += p_handles.size();
+    m_batches.push_back
+    (   std::make_shared<std::vector<Handle<T> > >(std::move(p_handles))
+    );
+    return;
+}
+
+/// @cond
+namespace detail
+{
+
+template <typename T>
+std::string
+BatchLoader<T>::select_text
+(   std::string const& p_prefix,
+    std::string const& p_suffix
+)
+{
+    return
+        "select " + T::primary_key_name() + ", " + T::load_columns() +
+        " from " + TypeRegistry<T>::tag().join_text() +
+        " where " + p_prefix + prefetch_parameter_list() + p_suffix;
+}
+
+template <typename T>
+template <typename KeyT>
+std::vector<typename T::Id>
+BatchLoader<T>::load
+(   Connection& p_connection,
+    StatementSlot const& p_slot,
+    std::vector<KeyT> p_keys,
+    PrefetchedObjects& p_out
+)
+{
+    std::sort(p_keys.begin(), p_keys.end());
+    p_keys.erase(std::unique(p_keys.begin(), p_keys.end()), p_keys.end());
+    std::vector<Id> ids;
+    std::vector<Handle<T> > handles;
+    for
+    (   std::size_t begin = 0;
+        begin < p_keys.size();
+        begin += prefetch_chunk_size
+    )
+    {
+        SQLStatement statement(p_connection, p_slot);
+        for (std::size_t i = 0; i != prefetch_chunk_size; ++i)
+        {
+            std::size_t const j = std::min(begin + i, p_keys.size() - 1);
+            statement.bind(prefetch_parameter(i), p_keys[j]);
+        }
+        while (statement.step())
+        {
+            Id const id = KeyTraits<Id>::extract(statement, 0);
+            Handle<T> handle = Handle<T>::create_unchecked(p_connection, id);
+            T::RowLoadAttorney::load_row(*handle, statement, 1);
+            ids.push_back(id);
+            handles.push_back(std::move(handle));
+        }
+    }
+    p_out.retain(std::move(handles));
+    return ids;
+}
+
+}  // namespace detail
+/// @endcond
+
+template <typename From>
+void
+Relationship<From>::follow
+(   Connection& p_connection,
+    std::vector<Id> const& p_from_ids,
+    PrefetchedObjects& p_out,
+    detail::PrefetchQueue& p_queue
+) const
+{
+    do_follow(p_connection, p_from_ids, p_out, p_queue);
+    return;
+}
+
+template <typename From, typename To>
+RelationshipTo<From, To>::RelationshipTo
+(   std::string const& p_prefix,
+    std::string const& p_suffix
+):
+    m_slot(detail::BatchLoader<To>::select_text(p_prefix, p_suffix))
+{
+}
+
+template <typename From, typename To>
+RelationshipTo<From, To>&
+RelationshipTo<From, To>::then(std::shared_ptr<Relationship<To> > p_next)
+{
+    m_next.push_back(p_next);
+    return *this;
+}
+
+template <typename From, typename To>
+void
+RelationshipTo<From, To>::do_follow
+(   Connection& p_connection,
+    std::vector<Id> const& p_from_ids,
+    PrefetchedObjects& p_out,
+    detail::PrefetchQueue& p_queue
+) const
+{
+    typedef std::vector<typename To::Id> ToIds;
+    std::shared_ptr<ToIds> const to_ids = std::make_shared<ToIds>
+    (   detail::BatchLoader<To>::load
+        (   p_connection,
+            m_slot,
+            p_from_ids,
+            p_out
+        )
+    );
+    if (to_ids->empty())
+    {
+        return;
+    }
+    for (auto const& next: m_next)
+    {
+        p_queue.push_back
+        (   [&p_connection, &p_out, &p_queue, next, to_ids]()
+            {
+                next->follow(p_connection, *to_ids, p_out, p_queue);
+            }
+        );
+    }
+    return;
+}
+
+template <typename From, typename To>
+ToOne<From, To>::ToOne(std::string const& p_foreign_key):
+    RelationshipTo<From, To>
+    (   To::primary_key_name() + " in (select " + p_foreign_key +
+            " from " + From::exclusive_table_name() + " where " +
+            From::primary_key_name() + " in (",
+        "))"
+    )
+{
+}
+
+template <typename From, typename To>
+ToMany<From, To>::ToMany(std::string const& p_foreign_key):
+    RelationshipTo<From, To>(p_foreign_key + " in (", ")")
+{
+}
+
+template <typename T>
+PrefetchedObjects
+prefetch
+(   typename T::Connection& p_connection,
+    std::vector<typename T::Id> const& p_ids,
+    std::vector<std::shared_ptr<Relationship<T> > > const& p_relationships
+)
+{
+    static StatementSlot const slot
+    (   detail::BatchLoader<T>::select_text
+        (   T::primary_key_name() + " in (",
+            ")"
+        )
+    );
+    PrefetchedObjects ret;
+    DatabaseTransaction transaction(p_connection);
+    try
+    {
+        typedef std::vector<typename T::Id> Ids;
+        std::shared_ptr<Ids> const ids = std::make_shared<Ids>
+        (   detail::BatchLoader<T>::load(p_connection, slot, p_ids, ret)
+        );
+        detail::PrefetchQueue queue;
+        for (auto const& relationship: p_relationships)
+        {
+            queue.push_back
+            (   [&p_connection, &ret, &queue, relationship, ids]()
+                {
+                    relationship->follow(p_connection, *ids, ret, queue);
+                }
+            );
+        }
+        while (!queue.empty())
+        {
+            std::function<void()> const step = std::move(queue.front());
+            queue.pop_front();
+            step();
+        }
+        transaction.commit();
+    }
+    catch (std::exception&)
+    {
+        transaction.cancel();
+        throw;
+    }
+    return ret;
+}
+
+
+}  // namespace sqloxx
+
+#endif  // GUARD_prefetch_hpp_5813094672201187
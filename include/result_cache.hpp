@@ -0,0 +1,223 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_result_cache_hpp_6902592693824147
+#define GUARD_result_cache_hpp_6902592693824147
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace sqloxx
+{
+
+/**
+ * A cache of the complete result sets of read-only SQL statements,
+ * keyed by statement text and bound values. Each DatabaseConnection
+ * owns one ResultCache. Caching is enabled for the connection by
+ * DatabaseConnection::enable_result_cache, and then for individual
+ * statements by SQLStatement::enable_result_cache.
+ *
+ * While a statement is being prepared, the tables it reads (including
+ * through views) are recorded by an SQLite authorizer callback. A cached
+ * result is dropped as soon as any of those tables is written through the
+ * same connection, whether by an SQLStatement, by
+ * DatabaseConnection::execute_sql, or by a trigger or foreign key action
+ * (the last two being detected by the SQLite update hook). Dropping or
+ * altering a table or view clears the whole cache.
+ *
+ * Results are neither looked up nor stored while a transaction is open
+ * on the connection. A write made within a transaction drops the
+ * affected results immediately, so rolling the transaction back can
+ * never leave a stale result in the cache. Writes made through other
+ * connections, or by other processes, are \e not detected.
+ *
+ * Results are stored compactly: one fixed-size cell per value, with the
+ * contents of text and blob values held in a single buffer per result.
+ *
+ * ResultCache is not thread-safe; it is used only by the connection
+ * that owns it.
+ */
+class ResultCache
+{
+public:
+
+    struct Stats
+    {
+        Stats();
+        std::size_t hits;
+        std::size_t misses;
+        std::size_t stores;
+        std::size_t invalidations;
+    };
+
+    /**
+     * @param p_capacity the maximum number of bytes occupied by cached
+     * results (approximately). Once it is reached, further results are not
+     * stored until space is freed by invalidation.
+     */
+    explicit ResultCache(std::size_t p_capacity = 4 * 1024 * 1024);
+
+    ResultCache(ResultCache const&) = delete;
+    ResultCache(ResultCache&&) = delete;
+    ResultCache& operator=(ResultCache const&) = delete;
+    ResultCache& operator=(ResultCache&&) = delete;
+    ~ResultCache() = default;
+
+    /**
+     * Sets the capacity in bytes, clearing the cache if its current size
+     * exceeds \e p_capacity.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    void set_capacity(std::size_t p_capacity);
+
+    /**
+     * @returns the capacity in bytes.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    std::size_t capacity() const;
+
+    /**
+     * @returns the approximate number of bytes occupied by cached results.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    std::size_t size() const;
+
+    /**
+     * Discards all cached results.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    void clear();
+
+    /**
+     * @returns counts of lookups, stores and invalidated results.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    Stats stats() const;
+
+    /// @cond
+
+    /**
+     * The complete result set of a statement. \e type is an SQLite
+     * fundamental datatype code (SQLITE_INTEGER etc.).
+     */
+    class Result
+    {
+    public:
+        struct Cell
+        {
+            int type;
+            std::size_t size;
+            union
+            {
+                long long integer;
+                double real;
+                std::size_t offset;
+            };
+        };
+        explicit Result(int p_num_columns);
+        int num_columns() const;
+        std::size_t num_rows() const;
+        std::size_t bytes() const;
+        Cell const& cell(std::size_t p_row, int p_column) const;
+        char const* data(Cell const& p_cell) const;
+        void append_integer(long long p_value);
+        void append_real(double p_value);
+        void append_data(int p_type, void const* p_data, std::size_t p_size);
+        void append_null();
+    private:
+        int const m_num_columns;
+        std::vector<Cell> m_cells;
+        std::string m_buffer;
+    };
+
+    typedef std::uint64_t Generation;
+
+    /**
+     * @returns a counter that is advanced by every write and every
+     * clearing of the cache. A result should be stored only if the
+     * generation has not changed since its statement began executing.
+     */
+    Generation generation() const;
+
+    /**
+     * @returns the cached result for \e p_key, or a null pointer.
+     */
+    std::shared_ptr<Result const> find(std::string const& p_key);
+
+    /**
+     * Stores \e p_result for \e p_key, recording that it was read from
+     * \e p_tables, provided \e p_generation is still current and there is
+     * room.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>. A result that
+     * cannot be stored for lack of memory is simply not stored.
+     */
+    void store
+    (   std::string const& p_key,
+        std::vector<std::string> const& p_tables,
+        std::shared_ptr<Result const> const& p_result,
+        Generation p_generation
+    ) noexcept;
+
+    /**
+     * Discards every cached result read from table \e p_table.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    void invalidate(char const* p_table) noexcept;
+
+    /// @endcond
+
+private:
+
+    struct Entry
+    {
+        std::shared_ptr<Result const> result;
+        std::vector<std::string> tables;
+        std::size_t bytes;
+    };
+
+    typedef std::unordered_map<std::string, Entry> Map;
+
+    // Erases the entry at p_it, and its keys in m_readers.
+    void erase(Map::iterator p_it);
+
+    std::size_t m_capacity;
+    std::size_t m_size;
+    Generation m_generation;
+    Map m_entries;
+
+    // Maps each table name to the keys of the results that read it.
+    std::unordered_map<std::string, std::unordered_set<std::string> >
+        m_readers;
+
+    Stats m_stats;
+
+};  // class ResultCache
+
+}  // namespace sqloxx
+
+#endif  // GUARD_result_cache_hpp_6902592693824147
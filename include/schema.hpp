@@ -0,0 +1,121 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_schema_hpp_8971980032413651
+#define GUARD_schema_hpp_8971980032413651
+
+#include "database_connection_fwd.hpp"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace sqloxx
+{
+
+/**
+ * Describes the schema of a database as an ordered list of migrations,
+ * together with an application id identifying the kind of database.
+ *
+ * The i-th migration added (counting from zero) brings the schema from
+ * version i to version i + 1. The version of the schema of a database
+ * file, and its application id, are recorded in the file itself, in the
+ * SQLite "user_version" and "application_id" pragmas. Together these form
+ * a fingerprint which can be checked cheaply when the file is opened, so
+ * that the migrations are executed only when the file is not already at
+ * the current version.
+ *
+ * Once a version of an application has been released, its migrations
+ * should not be changed or reordered; changes to the schema should be
+ * made by adding further migrations. A database created before its
+ * application adopted Schema has version 0, so the first migration
+ * should tolerate the tables already existing (for example by using
+ * "create table if not exists").
+ *
+ * @see DatabaseConnection::set_schema.
+ */
+class Schema
+{
+public:
+
+    typedef std::function<void(DatabaseConnection&)> Migration;
+
+    /**
+     * @param p_application_id identifies the kind of database. If it is
+     * nonzero, it is recorded in each database migrated, and databases
+     * recording a different (nonzero) application id are rejected.
+     */
+    explicit Schema(std::int32_t p_application_id = 0);
+
+    /**
+     * Adds \e p_migration as the last migration, incrementing version().
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void add_migration(Migration const& p_migration);
+
+    std::int32_t application_id() const;
+
+    /**
+     * @returns the current version of the schema, being the number of
+     * migrations.
+     */
+    std::int32_t version() const;
+
+    /**
+     * @returns \e true if and only if the database to which
+     * \e p_connection is connected records the application id and
+     * version of this Schema.
+     *
+     * @throws InvalidConnection if \e p_connection is invalid.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    bool is_current(DatabaseConnection& p_connection) const;
+
+    /**
+     * Brings the database to which \e p_connection is connected to the
+     * current version, by executing, within a single DatabaseTransaction
+     * holding the write lock (see DatabaseTransaction::Lock), each
+     * migration from the version recorded in the database onwards,
+     * and then recording the application id and the current version.
+     * Does nothing if the database is already current.
+     *
+     * @returns the number of migrations executed.
+     *
+     * @throws SchemaMismatch if the database records a nonzero
+     * application id different from that of this Schema, or a version
+     * that is negative or greater than that of this Schema.
+     *
+     * @throws InvalidConnection if \e p_connection is invalid.
+     *
+     * @throws any exception thrown by a migration, or by the database
+     * in executing it.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>, provided the
+     * migrations affect nothing outside the database.
+     */
+    std::int32_t migrate(DatabaseConnection& p_connection) const;
+
+private:
+
+    std::int32_t m_application_id;
+    std::vector<Migration> m_migrations;
+
+};  // class Schema
+
+}  // namespace sqloxx
+
+#endif  // GUARD_schema_hpp_8971980032413651
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_second_level_cache_hpp_7302214956188431
+#define GUARD_second_level_cache_hpp_7302214956188431
+
+#include "type_registry.hpp"
+#include <boost/any.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace sqloxx
+{
+
+/**
+ * A cache of immutable snapshots of the fields of persistent objects,
+ * which may be shared by several DatabaseConnections (for example a pool
+ * of connections to the same database file), so that an object loaded
+ * through one connection need not be loaded from the database again
+ * through another.
+ *
+ * Each connection still has its own IdentityMaps and its own instances of
+ * PersistentObject. Where a SecondLevelCache is attached to a connection
+ * (see DatabaseConnection::set_second_level_cache), loading a ghost
+ * object first looks for a snapshot of it here, keyed by its TypeTag and
+ * its id, and falls back on \e do_load() only if there is none. Having
+ * been loaded from the database, the object publishes a snapshot here.
+ * Snapshots are taken and restored by PersistentObject::do_snapshot and
+ * PersistentObject::do_restore; classes which do not override these are
+ * not cached here.
+ *
+ * Entries are validated by a single write epoch, which is advanced
+ * whenever a transaction that has written to the database is committed
+ * on any attached connection. Advancing the epoch invalidates all
+ * entries. The cache is therefore suited to read-mostly data. Writes
+ * made through connections that are not attached, or by other processes,
+ * are \e not detected.
+ *
+ * SecondLevelCache is thread-safe.
+ */
+class SecondLevelCache
+{
+public:
+
+    typedef std::uint64_t Epoch;
+    typedef std::shared_ptr<boost::any const> Snapshot;
+
+    struct Stats
+    {
+        Stats();
+        std::size_t hits;
+        std::size_t misses;
+        std::size_t publications;
+        std::size_t invalidations;
+    };
+
+    /**
+     * @param p_capacity the maximum number of snapshots held. Once it is
+     * reached, further snapshots are not published until the next epoch.
+     */
+    explicit SecondLevelCache(std::size_t p_capacity = 10000);
+
+    SecondLevelCache(SecondLevelCache const&) = delete;
+    SecondLevelCache(SecondLevelCache&&) = delete;
+    SecondLevelCache& operator=(SecondLevelCache const&) = delete;
+    SecondLevelCache& operator=(SecondLevelCache&&) = delete;
+    ~SecondLevelCache() = default;
+
+    /**
+     * @returns the current write epoch.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    Epoch epoch() const;
+
+    /**
+     * Advances the write epoch, invalidating all snapshots.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    void advance_epoch();
+
+    /**
+     * @returns the current snapshot for the object with TypeTag
+     * \e p_type_tag and id \e p_id, or a null pointer if there is none.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    Snapshot find(TypeTag const& p_type_tag, long long p_id) const;
+
+    /**
+     * Stores \e p_snapshot for the object with TypeTag \e p_type_tag and id
+     * \e p_id, provided \e p_epoch is still the current epoch. \e p_epoch
+     * should be the epoch read \e before the object was loaded, so that a
+     * snapshot that may have been overtaken by a commit is discarded.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>. A snapshot that
+     * cannot be stored for lack of memory is simply not stored.
+     */
+    void publish
+    (   TypeTag const& p_type_tag,
+        long long p_id,
+        Epoch p_epoch,
+        Snapshot const& p_snapshot
+    ) noexcept;
+
+    /**
+     * @returns counts of lookups, publications and invalidations.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    Stats stats() const;
+
+private:
+
+    typedef std::pair<TypeTag const*, long long> Key;
+
+    struct KeyHash
+    {
+        std::size_t operator()(Key const& p_key) const;
+    };
+
+    typedef std::unordered_map<Key, Snapshot, KeyHash> Map;
+
+    // Discards the entries if they belong to an earlier epoch. Caller
+    // must hold m_mutex.
+    void synchronize_epoch() const;
+
+    std::size_t const m_capacity;
+    std::atomic<Epoch> m_epoch;
+    mutable std::mutex m_mutex;
+
+    // The epoch to which the entries in m_map belong.
+    mutable Epoch m_map_epoch;
+    mutable Map m_map;
+    mutable Stats m_stats;
+
+};  // class SecondLevelCache
+
+}  // namespace sqloxx
+
+#endif  // GUARD_second_level_cache_hpp_7302214956188431
@@ -17,7 +17,10 @@
 #ifndef GUARD_sql_statement_hpp_9859693450787893
 #define GUARD_sql_statement_hpp_9859693450787893
 
+#include "codec.hpp"
 #include "database_connection.hpp"
+#include "statement_key.hpp"
+#include "statement_slot.hpp"
 #include "detail/sql_statement_impl.hpp"
 #include <memory>
 #include <string>
@@ -64,6 +67,11 @@ namespace sqloxx
  * text. (The caching mechanism stores statement structures keyed by
  * their text as it is before any data is bound into the statement.) See
  * documentation for bind() for more detail.
+ *
+ * Where the statement text is known at compile time, or is built once at
+ * runtime and then reused, the SQLStatement may be constructed from a
+ * StatementKey, which avoids rehashing the text on each construction; or
+ * from a StatementSlot, which avoids the cache lookup altogether.
  */
 class SQLStatement
 {
@@ -105,6 +113,36 @@ public:
         std::string const& p_statement_text
     );
 
+    /**
+     * Creates an object representing the SQL statement with the
+     * text of \e p_statement_slot. The underlying statement structure is
+     * looked up directly by the index of \e p_statement_slot, rather than
+     * via the statement cache - see StatementSlot for details.
+     *
+     * Exceptions and exception safety are as for the constructor taking
+     * a std::string.
+     */
+    SQLStatement
+    (   DatabaseConnection& p_database_connection,
+        StatementSlot const& p_statement_slot
+    );
+
+    /**
+     * Creates an object representing the SQL statement with the text
+     * of \e p_statement_key. The statement cache is searched using the
+     * hash already held by \e p_statement_key, rather than by hashing
+     * the statement text anew. \e p_statement_key must have been created
+     * from a string literal, or via StatementKey::intern() - see
+     * StatementKey.
+     *
+     * Exceptions and exception safety are as for the constructor taking
+     * a std::string.
+     */
+    SQLStatement
+    (   DatabaseConnection& p_database_connection,
+        StatementKey const& p_statement_key
+    );
+
     // TODO LOW PRIORITY Provide a move constructor (even though
     // I don't want to provide a copy constructor)?
     SQLStatement(SQLStatement const&) = delete;
@@ -126,9 +164,11 @@ public:
      * Wrapper around SQLite "bind" functions for binding named
      * parameters with data.
      *
-     * This is only supported with the following types for \b T: \n
+     * This is supported natively with the following types for \b T: \n
      * \b int, \b long, <b>long long</b>, \b double,
-     * <b>std::string const&</b> and <b>char const*</b>.
+     * <b>std::string const&</b>, <b>char const*</b> and
+     * <b>Blob const&</b>; and with any other type for which Codec is
+     * specialized, the value being bound in its encoded form.
      *
      * Example usage: \n\n
      * <tt>
@@ -166,6 +206,7 @@ public:
     template <typename T>
     void bind(std::string const& parameter_name, T x);
     void bind(std::string const& parameter_name, std::string const& x);
+    void bind(std::string const& parameter_name, Blob const& x);
 
     /**
      * Where an SQLStatement has a result set available,
@@ -180,7 +221,10 @@ public:
      *    long long\n
      *    double\n
      *    std::string\n
+     *    Blob\n
      * </b>
+     * and any other type for which Codec is specialized, the value being
+     * decoded from the type Codec<T>::Stored.
      *
      * Example usage:\n\n
      * <tt>
@@ -274,6 +318,42 @@ public:
      */
     void clear_bindings();
 
+    /**
+     * Enables the ResultCache of the DatabaseConnection for this
+     * SQLStatement, if the statement is read-only (as reported by
+     * \b sqlite3_stmt_readonly), yields result columns, and reads from at
+     * least one table, and DatabaseConnection::enable_result_cache was
+     * called before the statement was prepared; otherwise this has no
+     * effect. Thereafter, each
+     * time the statement is executed outside any transaction, a cached
+     * result for the same statement text and bound values is replayed
+     * if one is available; otherwise the result is captured as it is
+     * stepped through, and stored once the last row has been passed.
+     * The cache remains enabled until the SQLStatement is destroyed.
+     *
+     * Statements should not be cached whose results depend on anything
+     * other than the contents of the tables they read, such as
+     * \b random() or the current time. See ResultCache for how cached
+     * results are invalidated.
+     *
+     * @throws LogicError if any parameter has been bound since the
+     * SQLStatement was created or its bindings last cleared. Enable the
+     * cache before binding.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    void enable_result_cache();
+
+    /**
+     * @returns \e true if and only if the statement makes no direct
+     * changes to the database, as reported by \b sqlite3_stmt_readonly.
+     * Note that transaction control statements, such as "begin", are
+     * reported as read-only.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    bool is_read_only() const;
+
 private:
 
     std::shared_ptr<detail::SQLStatementImpl> m_sql_statement;
@@ -294,7 +374,44 @@ SQLStatement::SQLStatement
     )
 {
 }
+
+inline
+SQLStatement::SQLStatement
+(   DatabaseConnection& p_database_connection,
+    StatementSlot const& p_statement_slot
+):
+    m_sql_statement
+    (   DatabaseConnection::StatementAttorney::provide_sql_statement
+        (   p_database_connection,
+            p_statement_slot
+        )
+    )
+{
+}
+
+inline
+SQLStatement::SQLStatement
+(   DatabaseConnection& p_database_connection,
+    StatementKey const& p_statement_key
+):
+    m_sql_statement
+    (   DatabaseConnection::StatementAttorney::provide_sql_statement
+        (   p_database_connection,
+            p_statement_key
+        )
+    )
+{
+}
         
+template <typename T>
+inline
+void
+SQLStatement::bind(std::string const& parameter_name, T x)
+{
+    bind(parameter_name, Codec<T>::encode(x));
+    return;
+}
+
 template <>
 inline
 void
@@ -348,6 +465,30 @@ SQLStatement::bind(std::string const& parameter_name, char const* x)
     return;
 }
 
+inline
+void
+SQLStatement::bind(std::string const& parameter_name, Blob const& x)
+{
+    m_sql_statement->bind(parameter_name, x);
+    return;
+}
+
+template <typename T>
+inline
+T
+SQLStatement::extract(int index)
+{
+    return Codec<T>::decode(extract<typename Codec<T>::Stored>(index));
+}
+
+// The extraction of the native types is defined in sql_statement.cpp.
+template <> int SQLStatement::extract<int>(int index);
+template <> long SQLStatement::extract<long>(int index);
+template <> long long SQLStatement::extract<long long>(int index);
+template <> double SQLStatement::extract<double>(int index);
+template <> std::string SQLStatement::extract<std::string>(int index);
+template <> Blob SQLStatement::extract<Blob>(int index);
+
 
 }  // namespace sqloxx
 
@@ -110,6 +110,24 @@ JEWEL_DERIVED_EXCEPTION(InvalidConnection, DatabaseException);
  */
 JEWEL_DERIVED_EXCEPTION(InvalidFilename, DatabaseException);
 
+/**
+ * Exception to be thrown when a database is to be opened through a
+ * SQLite VFS that has not been registered.
+ */
+JEWEL_DERIVED_EXCEPTION(NoSuchVFS, DatabaseException);
+
+/**
+ * Exception to be thrown when a database file records an application id
+ * or schema version that is incompatible with its Schema.
+ */
+JEWEL_DERIVED_EXCEPTION(SchemaMismatch, DatabaseException);
+
+/**
+ * Exception to be thrown when a WAL archive cannot be read or written, or
+ * is not in the expected format.
+ */
+JEWEL_DERIVED_EXCEPTION(WalArchiveException, DatabaseException);
+
 /*
  * Exception to be thrown when an operation to be performed on a Reader
  * object cannot be validly performed because the Reader is in some
@@ -0,0 +1,342 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_statement_key_hpp_6079214385516270
+#define GUARD_statement_key_hpp_6079214385516270
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace sqloxx
+{
+
+/**
+ * Identifies the text of an SQL statement, for the purpose of looking up
+ * the statement in the statement cache of a DatabaseConnection.
+ *
+ * A StatementKey holds a pointer to the statement text, its length, and
+ * a hash of the text. It does not own the text: the text must be of static
+ * storage duration, or else interned via intern(). A static StatementKey
+ * can therefore be stored in the statement cache without copying the
+ * text. (Statements provided by their text alone are copied into the
+ * cache entry, and freed with it.)
+ *
+ * Where the statement text is a string literal, the StatementKey can be
+ * constructed at compile time, in which case its hash is computed by the
+ * compiler:
+ *
+ * <tt>static constexpr StatementKey key("select x from y");\n
+ * SQLStatement statement(dbc, key);</tt>
+ *
+ * Where the statement text is built at runtime, but from a small, fixed
+ * set of texts, intern() may be used (once, with the result stored) -
+ * after which the text is not hashed again. Interned texts are never
+ * freed, so intern() is not suitable for arbitrary dynamic SQL, which
+ * should simply be passed as a std::string.
+ *
+ * Comparison of StatementKeys compares their hashes, and then their text
+ * pointers, before falling back on comparing the text itself. Since
+ * keys for a given text typically share a pointer, the fallback is
+ * rarely needed.
+ */
+class StatementKey
+{
+public:
+
+    typedef std::uint64_t HashValue;
+
+    /**
+     * Creates a StatementKey from a string literal (or other char array
+     * of static storage duration). This is usable in constant expressions.
+     *
+     * <b>Preconditions</b>:\n
+     * \e p_text must be of static storage duration, and
+     * null-terminated. Note that the hash is computed recursively, one
+     * level for every eight characters, and compilers place a limit on the
+     * depth of recursion in constant expressions (512 by default in GCC).
+     * Where the StatementKey is declared \e constexpr, a text longer than
+     * about 4000 characters is therefore a compile-time error, unless the
+     * limit is raised (with -fconstexpr-depth in GCC); where it is not,
+     * the compiler may compute the hash at runtime.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    template <std::size_t N>
+    explicit constexpr StatementKey(char const (&p_text)[N]);
+
+    /**
+     * @returns a StatementKey for \e p_text, the text being copied into a
+     * process-wide table of interned statement texts (if it is not already
+     * there). The text is hashed once, on the call to this function. The
+     * returned StatementKey remains valid for the life of the process.
+     *
+     * This function is safe to call from multiple threads.
+     *
+     * @throws std::bad_alloc in the unlikely event of memory allocation
+     * failure.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    static StatementKey intern(std::string const& p_text);
+
+    /**
+     * @returns a StatementKey pointing to \e p_text, with its hash
+     * computed at runtime, but \e without interning the text. The
+     * returned StatementKey is valid only for as long as \e p_text is
+     * unaltered and in existence; and so is suitable for looking up,
+     * but not for storing.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    static StatementKey lookup_key(std::string const& p_text);
+
+    /**
+     * @returns the statement text. This is null-terminated.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    constexpr char const* text() const;
+
+    /**
+     * @returns the length of the statement text, not including the
+     * terminating null.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    constexpr std::size_t length() const;
+
+    /**
+     * @returns the hash of the statement text.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    constexpr HashValue hash_value() const;
+
+    /**
+     * @returns the hash of the first \e p_length characters of \e p_text,
+     * as used by StatementKey. This is usable in constant expressions.
+     *
+     * The hash is a variant of 64-bit FNV-1a that takes eight characters
+     * at a time, as a little-endian word (the last word being padded with
+     * zeroes), and folds the high half of each product into the low half.
+     * Texts hashed at runtime are read a word at a time, so that hashing
+     * them costs no more than std::hash.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    static constexpr HashValue hash
+    (   char const* p_text,
+        std::size_t p_length,
+        HashValue p_seed = s_hash_offset
+    );
+
+    /**
+     * Function object for hashing StatementKey, for use in unordered
+     * containers.
+     */
+    struct Hash
+    {
+        std::size_t operator()(StatementKey const& p_key) const
+        {
+            return static_cast<std::size_t>(p_key.hash_value());
+        }
+    };
+
+    bool operator==(StatementKey const& rhs) const;
+    bool operator!=(StatementKey const& rhs) const;
+
+private:
+
+    constexpr StatementKey
+    (   char const* p_text,
+        std::size_t p_length,
+        HashValue p_hash
+    );
+
+    // Returns the p_length characters at p_text as a little-endian word.
+    static constexpr HashValue word(char const* p_text, std::size_t p_length);
+
+    static constexpr HashValue fold(HashValue p_value);
+
+    // Computes hash(p_text, p_length) with a loop, rather than by
+    // recursion, for texts hashed at runtime.
+    static HashValue runtime_hash(char const* p_text, std::size_t p_length);
+
+    // Returns word(p_text, 8), reading the characters with a single load
+    // where the machine is little-endian.
+    static HashValue runtime_word(char const* p_text);
+
+    static HashValue const s_hash_offset = 14695981039346656037ULL;
+    static HashValue const s_hash_prime = 1099511628211ULL;
+
+    char const* m_text;
+    std::size_t m_length;
+    HashValue m_hash;
+
+};  // class StatementKey
+
+
+// FUNCTION IMPLEMENTATIONS
+
+template <std::size_t N>
+inline
+constexpr StatementKey::StatementKey(char const (&p_text)[N]):
+    m_text(p_text),
+    m_length(N - 1),
+    m_hash(hash(p_text, N - 1))
+{
+}
+
+inline
+constexpr StatementKey::StatementKey
+(   char const* p_text,
+    std::size_t p_length,
+    HashValue p_hash
+):
+    m_text(p_text),
+    m_length(p_length),
+    m_hash(p_hash)
+{
+}
+
+inline
+StatementKey
+StatementKey::lookup_key(std::string const& p_text)
+{
+    return StatementKey
+    (   p_text.c_str(),
+        p_text.size(),
+        runtime_hash(p_text.data(), p_text.size())
+    );
+}
+
+inline
+constexpr char const*
+StatementKey::text() const
+{
+    return m_text;
+}
+
+inline
+constexpr std::size_t
+StatementKey::length() const
+{
+    return m_length;
+}
+
+inline
+constexpr StatementKey::HashValue
+StatementKey::hash_value() const
+{
+    return m_hash;
+}
+
+inline
+constexpr StatementKey::HashValue
+StatementKey::hash
+(   char const* p_text,
+    std::size_t p_length,
+    HashValue p_seed
+)
+{
+    return (p_length >= 8)?
+        hash
+        (   p_text + 8,
+            p_length - 8,
+            fold((p_seed ^ word(p_text, 8)) * s_hash_prime)
+        ):
+        (p_length == 0)?
+        p_seed:
+        fold((p_seed ^ word(p_text, p_length)) * s_hash_prime);
+}
+
+inline
+constexpr StatementKey::HashValue
+StatementKey::word(char const* p_text, std::size_t p_length)
+{
+    return (p_length == 0)?
+        0:
+        (   static_cast<unsigned char>(*p_text) |
+            (word(p_text + 1, p_length - 1) << 8)
+        );
+}
+
+inline
+constexpr StatementKey::HashValue
+StatementKey::fold(HashValue p_value)
+{
+    return p_value ^ (p_value >> 32);
+}
+
+inline
+StatementKey::HashValue
+StatementKey::runtime_word(char const* p_text)
+{
+#   if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+        HashValue ret;
+        std::memcpy(&ret, p_text, sizeof(ret));
+        return ret;
+#   else
+        return word(p_text, 8);
+#   endif
+}
+
+inline
+StatementKey::HashValue
+StatementKey::runtime_hash(char const* p_text, std::size_t p_length)
+{
+    HashValue ret = s_hash_offset;
+    for ( ; p_length >= 8; p_text += 8, p_length -= 8)
+    {
+        ret = fold((ret ^ runtime_word(p_text)) * s_hash_prime);
+    }
+    if (p_length != 0)
+    {
+        HashValue tail = 0;
+        for (std::size_t i = p_length; i != 0; --i)
+        {
+            tail = (tail << 8) | static_cast<unsigned char>(p_text[i - 1]);
+        }
+        ret = fold((ret ^ tail) * s_hash_prime);
+    }
+    return ret;
+}
+
+inline
+bool
+StatementKey::operator==(StatementKey const& rhs) const
+{
+    return
+        (m_hash == rhs.m_hash) &&
+        (m_length == rhs.m_length) &&
+        (   (m_text == rhs.m_text) ||
+            (std::memcmp(m_text, rhs.m_text, m_length) == 0)
+        );
+}
+
+inline
+bool
+StatementKey::operator!=(StatementKey const& rhs) const
+{
+    return !(*this == rhs);
+}
+
+
+}  // namespace sqloxx
+
+#endif  // GUARD_statement_key_hpp_6079214385516270
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_statement_slot_hpp_2264810937460153
+#define GUARD_statement_slot_hpp_2264810937460153
+
+#include <cstddef>
+#include <string>
+
+namespace sqloxx
+{
+
+/**
+ * Represents an SQL statement text that is declared once, and that is
+ * then executed repeatedly, typically on a hot path such as loading or
+ * saving a PersistentObject.
+ *
+ * On construction, each StatementSlot is allotted a small integer index,
+ * unique within the process. Each DatabaseConnection keeps the prepared
+ * statement for a given StatementSlot at that index in an array, so that
+ * constructing an SQLStatement from a StatementSlot involves only an
+ * array lookup, rather than hashing the statement text into the
+ * DatabaseConnection's statement cache (and, commonly, building the text
+ * by string concatenation beforehand).
+ *
+ * A StatementSlot should be declared as a static (for example, a
+ * function-local static), so that it is constructed once only. For
+ * example:
+ *
+ * <tt>static StatementSlot const slot("select x, y from example_as where
+ * example_a_id = :p");\n
+ * SQLStatement selector(database_connection(), slot);</tt>
+ *
+ * Since every StatementSlot claims a new index, StatementSlots should
+ * \e not be created on the fly for statements whose text varies.
+ * For those, construct the SQLStatement from a string in the usual way.
+ */
+class StatementSlot
+{
+public:
+
+    /**
+     * @param p_text is the text of a single SQL statement, as would be
+     * passed to the SQLStatement constructor.
+     *
+     * @throws std::bad_alloc in the unlikely event of memory allocation
+     * failure.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    explicit StatementSlot(std::string const& p_text);
+
+    StatementSlot(StatementSlot const&) = delete;
+    StatementSlot(StatementSlot&&) = delete;
+    StatementSlot& operator=(StatementSlot const&) = delete;
+    StatementSlot& operator=(StatementSlot&&) = delete;
+    ~StatementSlot() = default;
+
+    /**
+     * @returns the index allotted to this StatementSlot.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    std::size_t index() const;
+
+    /**
+     * @returns the statement text.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    std::string const& text() const;
+
+private:
+
+    std::size_t const m_index;
+    std::string const m_text;
+
+};  // class StatementSlot
+
+
+// FUNCTION IMPLEMENTATIONS
+
+inline
+std::size_t
+StatementSlot::index() const
+{
+    return m_index;
+}
+
+inline
+std::string const&
+StatementSlot::text() const
+{
+    return m_text;
+}
+
+
+}  // namespace sqloxx
+
+#endif  // GUARD_statement_slot_hpp_2264810937460153
@@ -17,7 +17,9 @@
 #ifndef GUARD_table_iterator_hpp_9025044682913015
 #define GUARD_table_iterator_hpp_9025044682913015
 
+#include "detail/deferred_log.hpp"
 #include "id.hpp"
+#include "key_traits.hpp"
 #include "sqloxx_exceptions.hpp"
 #include "sql_statement.hpp"
 #include <boost/optional.hpp>
@@ -70,6 +72,7 @@ class TableIterator:
 public:
 
     typedef typename T::Connection Connection;
+    typedef typename T::Id Id;
 
     /**
      * Creates a "null" TableIterator. If we are using a "begin" and "end"
@@ -90,7 +93,8 @@ public:
      * passes a custom statement to \e p_statement_text, it should be
      * a SELECT statement, and only the first column of results will
      * be relevant, where the first column should contain the primary
-     * key for \b T, of type sqloxx::Id. See class-level documentation of
+     * key for \b T, of type T::Id (or, for a composite key, the key
+     * columns in order). See class-level documentation of
      * TableIterator for further requirements on \b T.
      *
      * When first constructed, the TableIterator will be "pointing" to
@@ -121,12 +125,12 @@ public:
      * acceptable SQL statements after the first one.
      *
      * Might also throw any exception that might be thrown by the function
-     * <em>T::create_unchecked(Connection& T, sqloxx::Id)</em>, since this
+     * <em>T::create_unchecked(Connection& T, T::Id)</em>, since this
      * function is invoked to initialize the iterator's internal instance
      * of T from the first row of the SQL result set.
      *
      * <b>Exception safety</b>: <em>strong guarantee</em>, providing that the
-     * function <em>T::create_unchecked(Connection&, sqloxx::Id)</em> also
+     * function <em>T::create_unchecked(Connection&, T::Id)</em> also
      * offers at least the strong guarantee.
      */
     TableIterator
@@ -234,7 +238,7 @@ public:
      * corresponding exception class.
      *
      * Might also throw any exception that might be thrown by the function
-     * <em>T::create_unchecked(Connection& T, sqloxx::Id)</em>, since this
+     * <em>T::create_unchecked(Connection& T, T::Id)</em>, since this
      * function is invoked to construct the iterator's internal instance
      * of T from the next row of the SQL result set.
      *
@@ -245,7 +249,7 @@ public:
      * \b TableIterators may reference the same SQLStatement.)
      *
      * <b>Exception safety</b>: <em>basic guarantee</em>, providing that the
-     * function <em>T::create_unchecked(Connection&, sqloxx::Id)</em> also
+     * function <em>T::create_unchecked(Connection&, T::Id)</em> also
      * offers at least the basic guarantee.
      */
     TableIterator& operator++();
@@ -266,7 +270,7 @@ public:
      *
      * Exceptions are the same as for the previous
      * increment operator, however, this postfix operator, as well
-     * as calling <em>T::create_unchecked(Connection&, sqloxx::Id)</em>,
+     * as calling <em>T::create_unchecked(Connection&, T::Id)</em>,
      * also calls the copy constructor for \b T, so might also throw any
      * exceptions that are thrown by that copy constructor.
      *
@@ -277,7 +281,7 @@ public:
      * TableIterators may reference the same SQLStatement.)
      *
      * <b>Exception safety</b>: <em>basic guarantee</em>, providing that the
-     * function <em>T::create_unchecked(Connection&, sqloxx::Id)</em>, as
+     * function <em>T::create_unchecked(Connection&, T::Id)</em>, as
      * well as the copy constructor for \b T, also offer the basic
      * guarantee.
      */
@@ -348,7 +352,7 @@ TableIterator<T>::TableIterator
 ):
     m_impl(new Impl(p_connection, p_statement_text))
 {
-    JEWEL_LOG_TRACE();
+    SQLOXX_LOG_TRACE();
     advance();
 }
 
@@ -448,7 +452,7 @@ TableIterator<T>::Impl::next
     {
         out = T::create_unchecked
         (   m_connection,
-            m_sql_statement.template extract<Id>(0)
+            KeyTraits<Id>::extract(m_sql_statement, 0)
         );
     }
     else
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_type_registry_hpp_8410936275518342
+#define GUARD_type_registry_hpp_8410936275518342
+
+#include "persistence_traits.hpp"
+#include <string>
+#include <type_traits>
+
+namespace sqloxx
+{
+
+/**
+ * Describes one class in a hierarchy of persistent classes - that is,
+ * one class \b T deriving, directly or indirectly, from
+ * <b>PersistentObject<Base, Connection></b>, where \b Base is
+ * <b>PersistenceTraits<T>::Base</b>.
+ *
+ * Each such class has exactly one TypeTag, obtained via
+ * <b>TypeRegistry<T>::tag()</b>. Every instance of PersistentObject
+ * stores a pointer to the TypeTag for its dynamic type (this is set by
+ * IdentityMap when the object is created). This enables IdentityMap
+ * and sqloxx::handle_cast to perform checked downcasts without recourse
+ * to RTTI, by walking the chain of TypeTag parents.
+ *
+ * A TypeTag also knows the text of an SQL join that combines the
+ * exclusive tables of its class and of all its ancestors, so that
+ * a derived object can be loaded with a single select statement.
+ */
+class TypeTag
+{
+public:
+
+    /**
+     * @param p_parent pointer to the TypeTag of the parent class, or
+     * \e nullptr if this TypeTag describes the base of the hierarchy.
+     *
+     * @param p_exclusive_table_name name of the table that stores
+     * the columns exclusive to the class described.
+     *
+     * @param p_primary_key_name name of the primary key column of the
+     * exclusive table. For a derived class, this is the column on which
+     * the exclusive table is joined to the primary key column of the
+     * base table of the hierarchy.
+     *
+     * @throws std::bad_alloc in the unlikely event of memory allocation
+     * failure.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    TypeTag
+    (   TypeTag const* p_parent,
+        std::string const& p_exclusive_table_name,
+        std::string const& p_primary_key_name
+    );
+
+    TypeTag(TypeTag const&) = delete;
+    TypeTag(TypeTag&&) = delete;
+    TypeTag& operator=(TypeTag const&) = delete;
+    TypeTag& operator=(TypeTag&&) = delete;
+    ~TypeTag() = default;
+
+    /**
+     * @returns pointer to the TypeTag of the parent class, or \e nullptr
+     * if this TypeTag describes the base of its hierarchy.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    TypeTag const* parent() const;
+
+    /**
+     * @returns \e true if and only if the class described by this
+     * TypeTag is the same as, or derives from, the class described by
+     * \e p_other.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    bool is_a(TypeTag const& p_other) const;
+
+    /**
+     * @returns the name of the table that stores the columns exclusive
+     * to the class described.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    std::string const& exclusive_table_name() const;
+
+    /**
+     * @returns the name of the primary key column of the exclusive table
+     * of the class described.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    std::string const& primary_key_name() const;
+
+    /**
+     * @returns the text of a join clause combining the exclusive tables
+     * of the class described and of all its ancestors, suitable for
+     * placing after "from" in a select statement. For the base of a
+     * hierarchy, this is simply the name of the base table. For a class
+     * \b Sub with parent \b Super, this is the join text for \b Super,
+     * followed by "join", the exclusive table of \b Sub, and either a
+     * "using" clause on the primary key, if \b Sub names its primary key
+     * column as the base table does, or else an "on" clause matching the
+     * two columns.
+     *
+     * <b>Exception safety</b>: <em>nothrow guarantee</em>.
+     */
+    std::string const& join_text() const;
+
+private:
+
+    TypeTag const* m_parent;
+    std::string m_exclusive_table_name;
+    std::string m_primary_key_name;
+    std::string m_join_text;
+
+};  // class TypeTag
+
+
+/**
+ * Compile-time registry of persistent types. The single TypeTag for
+ * \b T is created on the first call to tag(), together with the
+ * TypeTags for the ancestors of \b T as given by PersistenceParent.
+ *
+ * \b T must have static functions exclusive_table_name() and
+ * primary_key_name(), as for PersistentObject. For a derived class,
+ * primary_key_name() may be inherited from the base class, where the
+ * exclusive table of the derived class names its primary key column in
+ * the same way.
+ */
+template <typename T>
+class TypeRegistry
+{
+public:
+
+    /**
+     * @returns the TypeTag for \b T.
+     *
+     * @throws std::bad_alloc in the unlikely event of memory allocation
+     * failure on the first call for a given \b T.
+     *
+     * <b>Exception safety</b>: <em>strong guarantee</em>.
+     */
+    static TypeTag const& tag();
+
+private:
+
+    typedef typename PersistenceParent<T>::Parent Parent;
+
+    static TypeTag const* parent_tag(std::true_type);
+    static TypeTag const* parent_tag(std::false_type);
+
+};  // class TypeRegistry
+
+
+// FUNCTION IMPLEMENTATIONS
+
+inline
+TypeTag const*
+TypeTag::parent() const
+{
+    return m_parent;
+}
+
+inline
+bool
+TypeTag::is_a(TypeTag const& p_other) const
+{
+    for (TypeTag const* t = this; t; t = t->m_parent)
+    {
+        if (t == &p_other) return true;
+    }
+    return false;
+}
+
+inline
+std::string const&
+TypeTag::exclusive_table_name() const
+{
+    return m_exclusive_table_name;
+}
+
+inline
+std::string const&
+TypeTag::primary_key_name() const
+{
+    return m_primary_key_name;
+}
+
+inline
+std::string const&
+TypeTag::join_text() const
+{
+    return m_join_text;
+}
+
+template <typename T>
+TypeTag const&
+TypeRegistry<T>::tag()
+{
+    static TypeTag const ret
+    (   parent_tag(std::is_same<Parent, T>()),
+        T::exclusive_table_name(),
+        T::primary_key_name()
+    );
+    return ret;
+}
+
+template <typename T>
+inline
+TypeTag const*
+TypeRegistry<T>::parent_tag(std::true_type)
+{
+    return nullptr;
+}
+
+template <typename T>
+inline
+TypeTag const*
+TypeRegistry<T>::parent_tag(std::false_type)
+{
+    static_assert
+    (   std::is_base_of<Parent, T>::value,
+        "PersistenceParent<T>::Parent must be a base class of T."
+    );
+    return &TypeRegistry<Parent>::tag();
+}
+
+
+}  // namespace sqloxx
+
+#endif  // GUARD_type_registry_hpp_8410936275518342
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef GUARD_wal_archive_hpp_2263600028793309
+#define GUARD_wal_archive_hpp_2263600028793309
+
+#include <boost/filesystem/path.hpp>
+#include <chrono>
+#include <cstddef>
+
+namespace sqloxx
+{
+
+/**
+ * Governs WAL archiving (see DatabaseConnection::enable_wal_archiving).
+ */
+struct WalArchivePolicy
+{
+    /**
+     * Sets \e checkpoint_frames to 1000.
+     */
+    WalArchivePolicy();
+
+    // Once the WAL holds this many frames, and they have all been
+    // archived, the archiving connection checkpoints the WAL after each
+    // commit, in place of SQLite's automatic checkpoints.
+    int checkpoint_frames;
+};
+
+
+/**
+ * Counts of the work done by WAL archiving on a DatabaseConnection.
+ */
+struct WalArchiveStats
+{
+    WalArchiveStats();
+
+    // Commits, WAL frames and bytes of page data appended to the archive.
+    std::size_t commits;
+    std::size_t frames;
+    std::size_t bytes;
+
+    // Checkpoints run by the archiving connection.
+    std::size_t checkpoints;
+
+    // Attempts to archive that failed, and so were deferred to the next
+    // commit.
+    std::size_t failures;
+
+    // Total time spent archiving.
+    std::chrono::steady_clock::duration latency;
+};
+
+
+/**
+ * Rebuilds, at \e p_target, a database archived by
+ * DatabaseConnection::enable_wal_archiving into \e p_directory, as it
+ * stood after the last archived commit at or before \e p_until. This
+ * copies the base snapshot in the archive, then applies to it, in order,
+ * the pages written by each archived commit up to that time.
+ *
+ * Commit times are as recorded when the commits were archived, which is
+ * when the archiving connection next committed, and so may be slightly
+ * later than the commits themselves. A commit that was only partially
+ * archived (for example because the system failed while it was being
+ * written) is ignored, as are any after it.
+ *
+ * @throws LogicError if \e p_target already exists.
+ *
+ * @throws WalArchiveException if \e p_directory does not hold a WAL
+ * archive, if the archive is corrupt, or if \e p_target cannot be
+ * written.
+ *
+ * <b>Exception safety</b>: <em>basic guarantee</em>. \e p_target may be
+ * left incomplete if an exception is thrown.
+ */
+void restore_wal_archive
+(   boost::filesystem::path const& p_directory,
+    boost::filesystem::path const& p_target,
+    std::chrono::system_clock::time_point p_until =
+        std::chrono::system_clock::time_point::max()
+);
+
+}  // namespace sqloxx
+
+#endif  // GUARD_wal_archive_hpp_2263600028793309
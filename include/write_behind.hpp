@@ -0,0 +1,92 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GUARD_write_behind_hpp_4832788866515819
+#define GUARD_write_behind_hpp_4832788866515819
+
+#include <chrono>
+#include <cstddef>
+
+namespace sqloxx
+{
+
+/**
+ * Governs the write-behind mode of an IdentityMap (see
+ * IdentityMap::enable_write_behind). The two limits bound the changes
+ * that may be lost should the process terminate without the IdentityMap
+ * being flushed.
+ */
+struct WriteBehindPolicy
+{
+    /**
+     * Sets \e max_delay to one second and \e max_backlog to 1000.
+     */
+    WriteBehindPolicy();
+
+    /**
+     * The longest that a deferred save may wait before the deferred saves
+     * are flushed, at the next save() or IdentityMap::flush_if_due().
+     * This is not enforced by any timer: no thread is created to flush
+     * deferred saves, so a deferred save may wait indefinitely longer
+     * than this if neither is called. Client code that needs a firm bound
+     * should call IdentityMap::flush_if_due() periodically.
+     */
+    std::chrono::steady_clock::duration max_delay;
+
+    /**
+     * The number of objects awaiting saving at which the deferred saves
+     * are flushed.
+     */
+    std::size_t max_backlog;
+};
+
+
+/**
+ * Reports on the write-behind activity of an IdentityMap.
+ */
+struct WriteBehindStats
+{
+    WriteBehindStats();
+
+    // Number of calls to save() that were deferred.
+    std::size_t deferred_saves;
+
+    // Number of flushes, and of objects saved by them.
+    std::size_t flushes;
+    std::size_t objects_flushed;
+
+    // Number of flushes that failed, and of objects whose changes were
+    // discarded as a result.
+    std::size_t failed_flushes;
+    std::size_t objects_discarded;
+
+    // Number of objects currently awaiting saving, and the greatest number
+    // there has been.
+    std::size_t backlog;
+    std::size_t peak_backlog;
+
+    // Time taken to execute the last flush, and the longest any flush has
+    // taken.
+    std::chrono::steady_clock::duration last_flush_latency;
+    std::chrono::steady_clock::duration max_flush_latency;
+
+    // The longest time for which a deferred save has waited to be flushed.
+    std::chrono::steady_clock::duration max_staleness;
+};
+
+}  // namespace sqloxx
+
+#endif  // GUARD_write_behind_hpp_4832788866515819
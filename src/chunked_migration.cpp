@@ -0,0 +1,341 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "chunked_migration.hpp"
+#include "database_connection.hpp"
+#include "database_transaction.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "detail/deferred_log.hpp"
+#include <jewel/exception.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <thread>
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+using std::max;
+using std::min;
+using std::numeric_limits;
+using std::size_t;
+using std::string;
+
+namespace chrono = std::chrono;
+namespace this_thread = std::this_thread;
+
+namespace sqloxx
+{
+
+namespace
+{
+    void create_checkpoint_table(DatabaseConnection& p_connection)
+    {
+        p_connection.execute_sql
+        (   "create table if not exists sqloxx_chunked_migrations"
+            "(name text primary key, last_key integer not null, "
+            "complete integer not null)"
+        );
+        return;
+    }
+
+}  // end anonymous namespace
+
+ChunkedMigrationPolicy::ChunkedMigrationPolicy():
+    initial_chunk_rows(1000),
+    min_chunk_rows(10),
+    max_chunk_rows(100000),
+    target_chunk_time(milliseconds(50)),
+    pause_ratio(1.0),
+    max_busy_wait(milliseconds(100))
+{
+}
+
+ChunkedMigration::Stats::Stats():
+    chunks(0),
+    chunk_rows(0),
+    busy_retries(0),
+    lock_wait(steady_clock::duration::zero()),
+    lock_hold(steady_clock::duration::zero()),
+    paused(steady_clock::duration::zero())
+{
+}
+
+ChunkedMigration::ChunkedMigration
+(   string const& p_name,
+    string const& p_table,
+    string const& p_key_column,
+    string const& p_chunk_sql,
+    ChunkedMigrationPolicy const& p_policy
+):
+    m_name(p_name),
+    m_table(p_table),
+    m_key_column(p_key_column),
+    m_chunk_sql(p_chunk_sql),
+    m_policy(p_policy),
+    m_next_pause(steady_clock::duration::zero())
+{
+    if
+    (   (p_policy.min_chunk_rows == 0) ||
+        (p_policy.min_chunk_rows > p_policy.max_chunk_rows)
+    )
+    {
+        SQLOXX_THROW(LogicError, "Invalid bounds on chunk size.");
+    }
+    m_stats.chunk_rows = min
+    (   max(p_policy.initial_chunk_rows, p_policy.min_chunk_rows),
+        p_policy.max_chunk_rows
+    );
+}
+
+void
+ChunkedMigration::set_setup(Step const& p_setup)
+{
+    m_setup = p_setup;
+    return;
+}
+
+void
+ChunkedMigration::set_cutover(Step const& p_cutover)
+{
+    m_cutover = p_cutover;
+    return;
+}
+
+bool
+ChunkedMigration::step(DatabaseConnection& p_connection)
+{
+    if (p_connection.transaction_nesting_level() != 0)
+    {
+        SQLOXX_THROW
+        (   LogicError,
+            "ChunkedMigration cannot be stepped within a transaction."
+        );
+    }
+    create_checkpoint_table(p_connection);
+    DatabaseTransaction transaction(p_connection);
+    SQLStatement checkpoint
+    (   p_connection,
+        "select last_key, complete from sqloxx_chunked_migrations "
+        "where name = :name"
+    );
+    checkpoint.bind(":name", m_name);
+    if (!checkpoint.step())
+    {
+        if (m_setup)
+        {
+            m_setup(p_connection);
+        }
+        SQLStatement insertion
+        (   p_connection,
+            "insert into sqloxx_chunked_migrations(name, last_key, complete) "
+            "values(:name, :last_key, 0)"
+        );
+        insertion.bind(":name", m_name);
+        insertion.bind(":last_key", numeric_limits<long long>::min());
+        insertion.step_final();
+        transaction.commit();
+        return true;
+    }
+    long long const low = checkpoint.extract<long long>(0);
+    bool const complete = (checkpoint.extract<int>(1) != 0);
+    checkpoint.reset();
+    if (complete)
+    {
+        transaction.commit();
+        return false;
+    }
+
+    long long high = 0;
+    if (!find_chunk_end(p_connection, low, high))
+    {
+        if (m_cutover)
+        {
+            m_cutover(p_connection);
+        }
+        SQLStatement completion
+        (   p_connection,
+            "update sqloxx_chunked_migrations set complete = 1 "
+            "where name = :name"
+        );
+        completion.bind(":name", m_name);
+        completion.step_final();
+        transaction.commit();
+        return false;
+    }
+
+    // The write lock is acquired by the first write, being that of the
+    // checkpoint; so the time this takes is the time spent waiting for
+    // the lock (if a busy timeout is set on the connection).
+    steady_clock::time_point const start = steady_clock::now();
+    SQLStatement advance
+    (   p_connection,
+        "update sqloxx_chunked_migrations set last_key = :last_key "
+        "where name = :name"
+    );
+    advance.bind(":last_key", high);
+    advance.bind(":name", m_name);
+    advance.step_final();
+    steady_clock::time_point const locked = steady_clock::now();
+    SQLStatement chunk(p_connection, m_chunk_sql);
+    chunk.bind(":low", low);
+    chunk.bind(":high", high);
+    chunk.step_final();
+    transaction.commit();
+    adapt(steady_clock::now() - locked, locked - start);
+    return true;
+}
+
+void
+ChunkedMigration::run(DatabaseConnection& p_connection)
+{
+    steady_clock::duration busy_wait = steady_clock::duration::zero();
+    while (true)
+    {
+        bool more = false;
+        try
+        {
+            more = step(p_connection);
+        }
+        catch (SQLiteBusy&)
+        {
+            busy_wait =
+            (   busy_wait == steady_clock::duration::zero()?
+                duration_cast<steady_clock::duration>(milliseconds(1)):
+                min(busy_wait * 2, m_policy.max_busy_wait)
+            );
+            this_thread::sleep_for(busy_wait);
+            ++m_stats.busy_retries;
+            m_stats.lock_wait += busy_wait;
+            continue;
+        }
+        busy_wait = steady_clock::duration::zero();
+        if (!more)
+        {
+            return;
+        }
+        this_thread::sleep_for(m_next_pause);
+        m_stats.paused += m_next_pause;
+    }
+}
+
+steady_clock::duration
+ChunkedMigration::next_pause() const
+{
+    return m_next_pause;
+}
+
+ChunkedMigration::Stats
+ChunkedMigration::stats() const
+{
+    return m_stats;
+}
+
+bool
+ChunkedMigration::is_complete
+(   DatabaseConnection& p_connection,
+    string const& p_name
+)
+{
+    SQLStatement existence
+    (   p_connection,
+        "select name from sqlite_master where type = 'table' and "
+        "name = 'sqloxx_chunked_migrations'"
+    );
+    bool const exists = existence.step();
+    existence.reset();
+    if (!exists)
+    {
+        return false;
+    }
+    SQLStatement statement
+    (   p_connection,
+        "select complete from sqloxx_chunked_migrations where name = :name"
+    );
+    statement.bind(":name", p_name);
+    bool const ret = statement.step() && (statement.extract<int>(0) != 0);
+    statement.reset();
+    return ret;
+}
+
+bool
+ChunkedMigration::find_chunk_end
+(   DatabaseConnection& p_connection,
+    long long p_low,
+    long long& p_high
+) const
+{
+    // The end of the chunk is the row at the chunk size beyond the
+    // checkpoint, or failing that, the last row of all.
+    string const rows =
+        "select " + m_key_column + " from " + m_table + " where " +
+        m_key_column + " > :low order by " + m_key_column;
+    SQLStatement bound(p_connection, rows + " limit 1 offset :offset");
+    bound.bind(":low", p_low);
+    bound.bind(":offset", static_cast<long long>(m_stats.chunk_rows - 1));
+    bool found = bound.step();
+    if (found)
+    {
+        p_high = bound.extract<long long>(0);
+    }
+    bound.reset();
+    if (!found)
+    {
+        SQLStatement last(p_connection, rows + " desc limit 1");
+        last.bind(":low", p_low);
+        found = last.step();
+        if (found)
+        {
+            p_high = last.extract<long long>(0);
+        }
+        last.reset();
+    }
+    return found;
+}
+
+void
+ChunkedMigration::adapt
+(   steady_clock::duration p_hold,
+    steady_clock::duration p_wait
+)
+{
+    ++m_stats.chunks;
+    m_stats.lock_hold += p_hold;
+    m_stats.lock_wait += p_wait;
+    if (p_hold > m_policy.target_chunk_time)
+    {
+        m_stats.chunk_rows =
+            max(m_stats.chunk_rows / 2, m_policy.min_chunk_rows);
+    }
+    else if (p_hold * 2 < m_policy.target_chunk_time)
+    {
+        m_stats.chunk_rows =
+            min(m_stats.chunk_rows * 2, m_policy.max_chunk_rows);
+    }
+    m_next_pause =
+        duration_cast<steady_clock::duration>
+        (   chrono::duration<double, steady_clock::period>(p_hold) *
+            m_policy.pause_ratio
+        ) +
+        p_wait;
+    return;
+}
+
+}  // namespace sqloxx
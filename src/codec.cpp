@@ -0,0 +1,43 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "codec.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "detail/deferred_log.hpp"
+#include <boost/uuid/uuid.hpp>
+#include <jewel/exception.hpp>
+#include <algorithm>
+
+using boost::uuids::uuid;
+using std::copy;
+
+namespace sqloxx
+{
+
+uuid
+Codec<uuid>::decode(Blob const& p_stored)
+{
+    uuid ret;
+    if (p_stored.size() != ret.size())
+    {
+        SQLOXX_THROW(ValueTypeException, "Stored UUID is not 16 bytes.");
+    }
+    copy(p_stored.begin(), p_stored.end(), ret.begin());
+    return ret;
+}
+
+}  // namespace sqloxx
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "compaction.hpp"
+#include "database_connection.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "detail/deferred_log.hpp"
+#include "detail/pragma.hpp"
+#include <boost/filesystem.hpp>
+#include <jewel/exception.hpp>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+using std::chrono::steady_clock;
+using std::size_t;
+using std::string;
+
+namespace sqloxx
+{
+
+namespace
+{
+    void remove_copy(boost::filesystem::path const& p_filepath) noexcept
+    {
+        boost::system::error_code ignored;
+        boost::filesystem::remove(p_filepath, ignored);
+        boost::filesystem::remove(p_filepath.string() + "-journal", ignored);
+        return;
+    }
+
+    // Copies the database of p_connection into p_copy, vacuums the copy,
+    // and writes it back over the database, provided nothing has been
+    // committed to the database since the copy was begun; otherwise
+    // discards the copy, returning false. Adds the time taken to p_stats.
+    bool swap_in_copy
+    (   DatabaseConnection& p_connection,
+        DatabaseConnection& p_copy,
+        CompactionPolicy const& p_policy,
+        CompactionStats& p_stats
+    )
+    {
+        steady_clock::time_point const copy_start = steady_clock::now();
+
+        // Read before the copy's read transaction is begun, so that the
+        // copy is at least as recent as the marker.
+        string const marker = p_connection.commit_marker();
+        p_connection.backup_to(p_copy);
+        p_copy.execute_sql("vacuum");
+        p_stats.copy_time += steady_clock::now() - copy_start;
+        if (p_policy.copy_callback)
+        {
+            p_policy.copy_callback(p_stats.discarded_copies + 1);
+        }
+        steady_clock::time_point const lock_start = steady_clock::now();
+        bool const ret = p_copy.backup_to_if_unchanged(p_connection, marker);
+        p_stats.lock_time += steady_clock::now() - lock_start;
+        return ret;
+    }
+
+    // Vacuums the database of p_connection in place, holding the write
+    // lock throughout. Adds the time taken to p_stats.
+    void vacuum_in_place
+    (   DatabaseConnection& p_connection,
+        CompactionStats& p_stats
+    )
+    {
+        steady_clock::time_point const lock_start = steady_clock::now();
+        p_connection.execute_sql("vacuum");
+        p_stats.lock_time += steady_clock::now() - lock_start;
+        return;
+    }
+
+}  // end anonymous namespace
+
+CompactionPolicy::CompactionPolicy():
+    max_online_attempts(3)
+{
+}
+
+CompactionStats::CompactionStats():
+    pages_before(0),
+    free_pages_before(0),
+    pages_after(0),
+    free_pages_after(0),
+    discarded_copies(0),
+    copy_time(0),
+    lock_time(0)
+{
+}
+
+CompactionStats
+compact_database
+(   DatabaseConnection& p_connection,
+    CompactionPolicy const& p_policy
+)
+{
+    if (p_connection.transaction_nesting_level() != 0)
+    {
+        SQLOXX_THROW
+        (   LogicError,
+            "Cannot compact database while a transaction is open."
+        );
+    }
+    boost::filesystem::path const copy_filepath =
+        p_connection.filepath().string() + "-compact";
+    CompactionStats ret;
+    ret.pages_before = detail::read_pragma(p_connection, "page_count");
+    ret.free_pages_before =
+        detail::read_pragma(p_connection, "freelist_count");
+    remove_copy(copy_filepath);
+    try
+    {
+        // The copy is opened through the same VFS as the database, which
+        // may, for example, encrypt what it stores.
+        OpenOptions copy_options;
+        copy_options.vfs = p_connection.open_options().vfs;
+        DatabaseConnection copy;
+        copy.open(copy_filepath, copy_options);
+        for (size_t attempt = 0; ; ++attempt)
+        {
+            if (attempt >= p_policy.max_online_attempts)
+            {
+                vacuum_in_place(p_connection, ret);
+                break;
+            }
+            if (swap_in_copy(p_connection, copy, p_policy, ret))
+            {
+                break;
+            }
+            ++ret.discarded_copies;
+        }
+    }
+    catch (...)
+    {
+        remove_copy(copy_filepath);
+        throw;
+    }
+    remove_copy(copy_filepath);
+    ret.pages_after = detail::read_pragma(p_connection, "page_count");
+    ret.free_pages_after =
+        detail::read_pragma(p_connection, "freelist_count");
+    return ret;
+}
+
+}  // namespace sqloxx
@@ -0,0 +1,315 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "connection_manager.hpp"
+#include "database_connection.hpp"
+#include "open_options.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "detail/deferred_log.hpp"
+#include <boost/filesystem.hpp>
+#include <jewel/assert.hpp>
+#include <jewel/exception.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+using std::chrono::steady_clock;
+using std::lock_guard;
+using std::max;
+using std::min;
+using std::move;
+using std::mutex;
+using std::none_of;
+using std::pair;
+using std::size_t;
+using std::string;
+using std::unique_lock;
+using std::unique_ptr;
+using std::unordered_map;
+
+namespace sqloxx
+{
+
+namespace
+{
+    size_t capacity_of(ConnectionManagerPolicy const& p_policy)
+    {
+        if (p_policy.max_file_handles == 0)
+        {
+            return p_policy.max_connections;
+        }
+        size_t const per_connection =
+            max<size_t>(p_policy.file_handles_per_connection, 1);
+        return min
+        (   p_policy.max_connections,
+            p_policy.max_file_handles / per_connection
+        );
+    }
+
+}  // end anonymous namespace
+
+ConnectionManagerPolicy::ConnectionManagerPolicy():
+    max_connections(64),
+    max_file_handles(0),
+    file_handles_per_connection(3)
+{
+}
+
+ConnectionManager::Stats::Stats():
+    hits(0),
+    misses(0),
+    opens(0),
+    evictions(0),
+    waits(0),
+    open_connections(0),
+    last_open_latency(0),
+    max_open_latency(0)
+{
+}
+
+ConnectionManager::Lease::Lease
+(   ConnectionManager& p_manager,
+    string const& p_key,
+    DatabaseConnection& p_connection
+):
+    m_manager(&p_manager),
+    m_key(p_key),
+    m_connection(&p_connection)
+{
+}
+
+ConnectionManager::Lease::Lease(Lease&& rhs):
+    m_manager(rhs.m_manager),
+    m_key(move(rhs.m_key)),
+    m_connection(rhs.m_connection)
+{
+    rhs.m_connection = nullptr;
+}
+
+ConnectionManager::Lease::~Lease()
+{
+    if (m_connection)
+    {
+        m_manager->release(m_key);
+    }
+}
+
+DatabaseConnection&
+ConnectionManager::Lease::connection() const
+{
+    JEWEL_ASSERT (m_connection);
+    return *m_connection;
+}
+
+ConnectionManager::ConnectionManager
+(   ConnectionManagerPolicy const& p_policy,
+    OpenOptions const& p_options,
+    Factory const& p_factory
+):
+    m_capacity(capacity_of(p_policy)),
+    m_options(p_options),
+    m_factory(p_factory)
+{
+    if (m_capacity == 0)
+    {
+        SQLOXX_THROW
+        (   LogicError,
+            "ConnectionManagerPolicy allows no connections to be open."
+        );
+    }
+}
+
+ConnectionManager::~ConnectionManager()
+{
+    JEWEL_ASSERT
+    (   none_of
+        (   m_entries.begin(),
+            m_entries.end(),
+            [](pair<string const, Entry> const& p_entry)
+            {
+                return p_entry.second.is_leased;
+            }
+        )
+    );
+}
+
+ConnectionManager::Lease
+ConnectionManager::lease(boost::filesystem::path const& p_filepath)
+{
+    string const key = boost::filesystem::absolute(p_filepath).string();
+    unique_ptr<DatabaseConnection> evicted;
+    unique_lock<mutex> lock(m_mutex);
+    while (true)
+    {
+        auto const it = m_entries.find(key);
+        if (it != m_entries.end())
+        {
+            Entry& entry = it->second;
+            if (!entry.is_leased)
+            {
+                entry.is_leased = true;
+                m_recency.splice(m_recency.begin(), m_recency, entry.recency);
+                ++m_stats.hits;
+                return Lease(*this, key, *entry.connection);
+            }
+        }
+        else if ((m_entries.size() < m_capacity) || evict_one(evicted))
+        {
+            break;
+        }
+        ++m_stats.waits;
+        m_released.wait(lock);
+    }
+
+    // Reserve the entry, leased, so that the connection can be opened
+    // without holding the lock. References to elements of m_entries
+    // remain valid while other elements are inserted and erased.
+    m_recency.push_front(key);
+    Entry* entry = nullptr;
+    try
+    {
+        entry = &m_entries[key];
+    }
+    catch (...)
+    {
+        m_recency.pop_front();
+        throw;
+    }
+    entry->is_leased = true;
+    entry->recency = m_recency.begin();
+    ++m_stats.misses;
+    lock.unlock();
+    evicted.reset();
+
+    unique_ptr<DatabaseConnection> connection;
+    steady_clock::time_point const start = steady_clock::now();
+    try
+    {
+        connection =
+        (   m_factory?
+            m_factory():
+            unique_ptr<DatabaseConnection>(new DatabaseConnection)
+        );
+        connection->open(p_filepath, m_options);
+    }
+    catch (...)
+    {
+        lock.lock();
+        erase(m_entries.find(key));
+        lock.unlock();
+        m_released.notify_all();
+        throw;
+    }
+    steady_clock::duration const latency = steady_clock::now() - start;
+
+    lock.lock();
+    entry->connection = move(connection);
+    ++m_stats.opens;
+    ++m_stats.open_connections;
+    m_stats.last_open_latency = latency;
+    m_stats.max_open_latency = max(m_stats.max_open_latency, latency);
+    return Lease(*this, key, *entry->connection);
+}
+
+bool
+ConnectionManager::close(boost::filesystem::path const& p_filepath)
+{
+    string key;
+    try
+    {
+        key = boost::filesystem::absolute(p_filepath).string();
+    }
+    catch (...)
+    {
+        return false;
+    }
+    unique_ptr<DatabaseConnection> closed;
+    {
+        lock_guard<mutex> const lock(m_mutex);
+        auto const it = m_entries.find(key);
+        if ((it == m_entries.end()) || it->second.is_leased)
+        {
+            return false;
+        }
+        closed = erase(it);
+    }
+    return true;
+}
+
+size_t
+ConnectionManager::capacity() const
+{
+    return m_capacity;
+}
+
+ConnectionManager::Stats
+ConnectionManager::stats() const
+{
+    lock_guard<mutex> const lock(m_mutex);
+    return m_stats;
+}
+
+void
+ConnectionManager::release(string const& p_key) noexcept
+{
+    {
+        lock_guard<mutex> const lock(m_mutex);
+        auto const it = m_entries.find(p_key);
+        JEWEL_ASSERT (it != m_entries.end());
+        it->second.is_leased = false;
+    }
+    m_released.notify_all();
+    return;
+}
+
+bool
+ConnectionManager::evict_one(unique_ptr<DatabaseConnection>& p_evicted)
+{
+    for (auto it = m_recency.rbegin(); it != m_recency.rend(); ++it)
+    {
+        auto const position = m_entries.find(*it);
+        JEWEL_ASSERT (position != m_entries.end());
+        if (!position->second.is_leased)
+        {
+            p_evicted = erase(position);
+            ++m_stats.evictions;
+            return true;
+        }
+    }
+    return false;
+}
+
+unique_ptr<DatabaseConnection>
+ConnectionManager::erase
+(   unordered_map<string, Entry>::iterator p_position
+)
+{
+    unique_ptr<DatabaseConnection> ret = move(p_position->second.connection);
+    if (ret)
+    {
+        --m_stats.open_connections;
+    }
+    m_recency.erase(p_position->second.recency);
+    m_entries.erase(p_position);
+    return ret;
+}
+
+}  // namespace sqloxx
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "connection_router.hpp"
+#include "database_connection.hpp"
+#include "info.hpp"
+#include "open_options.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "detail/deferred_log.hpp"
+#include <boost/filesystem/path.hpp>
+#include <jewel/assert.hpp>
+#include <jewel/exception.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+using std::current_exception;
+using std::future;
+using std::lock_guard;
+using std::max;
+using std::move;
+using std::mutex;
+using std::packaged_task;
+using std::promise;
+using std::size_t;
+using std::string;
+using std::thread;
+using std::unique_lock;
+using std::unique_ptr;
+
+namespace sqloxx
+{
+
+ConnectionRouter::Stats::Stats():
+    reads(0),
+    writes(0),
+    reader_waits(0),
+    backlog(0),
+    peak_backlog(0)
+{
+}
+
+ConnectionRouter::ReaderLease::ReaderLease
+(   ConnectionRouter& p_router,
+    DatabaseConnection& p_connection
+):
+    m_router(&p_router),
+    m_connection(&p_connection)
+{
+}
+
+ConnectionRouter::ReaderLease::ReaderLease(ReaderLease&& rhs):
+    m_router(rhs.m_router),
+    m_connection(rhs.m_connection)
+{
+    rhs.m_connection = nullptr;
+}
+
+ConnectionRouter::ReaderLease::~ReaderLease()
+{
+    if (m_connection)
+    {
+        m_router->release_reader(*m_connection);
+    }
+}
+
+DatabaseConnection&
+ConnectionRouter::ReaderLease::connection() const
+{
+    JEWEL_ASSERT (m_connection);
+    return *m_connection;
+}
+
+ConnectionRouter::ConnectionRouter
+(   boost::filesystem::path const& p_filepath,
+    size_t p_readers,
+    OpenOptions const& p_options
+):
+    m_writer(new DatabaseConnection),
+    m_stopping(false)
+{
+    if (p_readers == 0)
+    {
+        SQLOXX_THROW(LogicError, "ConnectionRouter requires a reader.");
+    }
+    if (!Info::sqlite_is_thread_safe())
+    {
+        SQLOXX_THROW
+        (   LogicError,
+            "ConnectionRouter requires SQLite to be built thread-safe."
+        );
+    }
+    m_writer->open(p_filepath, p_options);
+    {
+        SQLStatement statement(*m_writer, "pragma journal_mode = wal");
+        if (!statement.step() || (statement.extract<string>(0) != "wal"))
+        {
+            SQLOXX_THROW
+            (   DatabaseException,
+                "Could not put database into WAL mode."
+            );
+        }
+        statement.reset();
+    }
+    m_readers.reserve(p_readers);
+    m_idle_readers.reserve(p_readers);
+    for (size_t i = 0; i != p_readers; ++i)
+    {
+        unique_ptr<DatabaseConnection> reader(new DatabaseConnection);
+        reader->open(p_filepath, p_options);
+        reader->execute_sql("pragma query_only = on");
+        m_idle_readers.push_back(reader.get());
+        m_readers.push_back(move(reader));
+    }
+    m_thread = thread(&ConnectionRouter::run_writer, this);
+}
+
+ConnectionRouter::~ConnectionRouter()
+{
+    JEWEL_ASSERT (m_idle_readers.size() == m_readers.size());
+    {
+        lock_guard<mutex> const lock(m_queue_mutex);
+        m_stopping = true;
+    }
+    m_queue_wake.notify_one();
+    m_thread.join();
+}
+
+ConnectionRouter::ReaderLease
+ConnectionRouter::lease_reader()
+{
+    unique_lock<mutex> lock(m_readers_mutex);
+    if (m_idle_readers.empty())
+    {
+        ++m_stats.reader_waits;
+        m_reader_returned.wait
+        (   lock,
+            [this]() { return !m_idle_readers.empty(); }
+        );
+    }
+    DatabaseConnection* const connection = m_idle_readers.back();
+    m_idle_readers.pop_back();
+    return ReaderLease(*this, *connection);
+}
+
+future<void>
+ConnectionRouter::submit_write(WriteTask p_task)
+{
+    DatabaseConnection& writer = *m_writer;
+    packaged_task<void()> task
+    (   [p_task, &writer]() { p_task(writer); }
+    );
+    future<void> ret = task.get_future();
+    {
+        lock_guard<mutex> const lock(m_queue_mutex);
+        m_queue.push_back(move(task));
+        ++m_stats.writes;
+        m_stats.backlog = m_queue.size();
+        m_stats.peak_backlog = max(m_stats.peak_backlog, m_stats.backlog);
+    }
+    m_queue_wake.notify_one();
+    return ret;
+}
+
+future<void>
+ConnectionRouter::execute(string const& p_sql, StatementTask p_task)
+{
+    {
+        ReaderLease const lease = lease_reader();
+        SQLStatement statement(lease.connection(), p_sql);
+        if (statement.is_read_only())
+        {
+            promise<void> done;
+            try
+            {
+                p_task(statement);
+                done.set_value();
+            }
+            catch (...)
+            {
+                done.set_exception(current_exception());
+            }
+            lock_guard<mutex> const lock(m_readers_mutex);
+            ++m_stats.reads;
+            return done.get_future();
+        }
+    }
+    return submit_write
+    (   [p_sql, p_task](DatabaseConnection& p_writer)
+        {
+            SQLStatement statement(p_writer, p_sql);
+            p_task(statement);
+        }
+    );
+}
+
+size_t
+ConnectionRouter::readers() const
+{
+    return m_readers.size();
+}
+
+ConnectionRouter::Stats
+ConnectionRouter::stats() const
+{
+    lock_guard<mutex> const readers_lock(m_readers_mutex);
+    lock_guard<mutex> const queue_lock(m_queue_mutex);
+    return m_stats;
+}
+
+void
+ConnectionRouter::release_reader(DatabaseConnection& p_connection) noexcept
+{
+    {
+        lock_guard<mutex> const lock(m_readers_mutex);
+        // Cannot throw, as capacity for every reader was reserved.
+        m_idle_readers.push_back(&p_connection);
+    }
+    m_reader_returned.notify_one();
+    return;
+}
+
+void
+ConnectionRouter::run_writer()
+{
+    while (true)
+    {
+        packaged_task<void()> task;
+        {
+            unique_lock<mutex> lock(m_queue_mutex);
+            m_queue_wake.wait
+            (   lock,
+                [this]() { return m_stopping || !m_queue.empty(); }
+            );
+            if (m_queue.empty())
+            {
+                return;  // Stopping, and every task has been executed.
+            }
+            task = move(m_queue.front());
+            m_queue.pop_front();
+            m_stats.backlog = m_queue.size();
+        }
+        task();  // Any exception is stored in the task's future.
+    }
+}
+
+}  // namespace sqloxx
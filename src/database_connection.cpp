@@ -16,40 +16,76 @@
 
 #include "database_connection.hpp"
 #include "database_transaction.hpp"
+#include "detail/deferred_log.hpp"
+#include "detail/pragma.hpp"
 #include "detail/sqlite_dbconn.hpp"
+#include "result_cache.hpp"
+#include "schema.hpp"
+#include "second_level_cache.hpp"
 #include "sql_statement.hpp"
 #include "sqloxx_exceptions.hpp"
+#include "statement_key.hpp"
+#include "statement_slot.hpp"
 #include "detail/sql_statement_impl.hpp"
+#include "detail/wal_archiver.hpp"
 #include <boost/filesystem.hpp>
 #include <jewel/assert.hpp>
 #include <jewel/exception.hpp>
 #include <jewel/log.hpp>
 #include <jewel/optional.hpp>
 #include <iostream>
+#include <algorithm>
 #include <climits>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <limits>
 #include <memory>
 #include <set>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 using jewel::value;
 using std::bad_alloc;
+using std::ceil;
 using std::cout;
 using std::clog;
 using std::endl;
 using std::fprintf;
 using std::numeric_limits;
+using std::remove_if;
+using std::strcmp;
 using std::set;
 using std::shared_ptr;
 using std::string;
 using std::unordered_map;
+using std::vector;
 
 namespace sqloxx
 {
 
+namespace
+{
+    // Keys for transaction control statements, hashed at compile time.
+    constexpr StatementKey begin_key("begin");
+    constexpr StatementKey begin_immediate_key("begin immediate");
+    constexpr StatementKey end_key("end");
+    constexpr StatementKey set_savepoint_key("savepoint sp");
+    constexpr StatementKey release_savepoint_key("release sp");
+    constexpr StatementKey rollback_key("rollback");
+    constexpr StatementKey rollback_to_savepoint_key
+    (   "rollback to savepoint sp"
+    );
+
+    // The statements on the change log below spell out its name, so as
+    // to be provided via StatementSlot.
+    char const* const change_log_table = "sqloxx_change_log";
+
+}  // end anonymous namespace
+
 // Switch statement later relies on this being INT_MAX, and
 // won't compile if it's changed to std::numeric_limits<int>::max().
 int const
@@ -60,8 +96,25 @@ DatabaseConnection::DatabaseConnection
 ):
     m_sqlite_dbconn(new detail::SQLiteDBConn),
     m_transaction_nesting_level(0),
-    m_cache_capacity(p_cache_capacity)
+    m_cache_capacity(p_cache_capacity),
+    m_is_tracking_changes(false),
+    m_change_version_sum(0),
+    m_all_tables_written(false),
+    m_last_change_listener_id(0),
+    m_max_page_count(0),
+    m_page_count_threshold(0),
+    m_is_page_count_warned(false)
 {
+    // The epoch is advanced both before the commit becomes visible, so
+    // that loads begun earlier are not published, and after, so that
+    // loads that read the pre-commit state in the meantime are not
+    // published either.
+    m_sqlite_dbconn->add_commit_listener
+    (   [this](bool)
+        {
+            if (m_second_level_cache) m_second_level_cache->advance_epoch();
+        }
+    );
 }
 
 DatabaseConnection::~DatabaseConnection()
@@ -78,6 +131,7 @@ DatabaseConnection::~DatabaseConnection()
         );
     }
     m_statement_cache.clear();
+    m_slot_statements.clear();
 }
 
 bool
@@ -87,10 +141,26 @@ DatabaseConnection::is_valid() const
 }
 
 void
-DatabaseConnection::open(boost::filesystem::path const& p_filepath)
+DatabaseConnection::open
+(   boost::filesystem::path const& p_filepath,
+    OpenOptions const& p_options
+)
 {
-    m_sqlite_dbconn->open(p_filepath);
+    m_sqlite_dbconn->open(p_filepath, p_options);
     m_filepath = boost::filesystem::absolute(p_filepath);
+    m_open_options = p_options;
+    if (p_options.page_count_handler)
+    {
+        m_page_count_handler = p_options.page_count_handler;
+        m_max_page_count = detail::read_pragma(*this, "max_page_count");
+        m_page_count_threshold = static_cast<long long>
+        (   ceil(p_options.page_count_warning * m_max_page_count)
+        );
+    }
+    if (m_schema)
+    {
+        m_schema->migrate(*this);
+    }
     do_setup();
     return;
 }
@@ -124,12 +194,389 @@ DatabaseConnection::max_nesting()
     return s_max_nesting;
 }
 
+int
+DatabaseConnection::transaction_nesting_level() const
+{
+    return m_transaction_nesting_level;
+}
+
+void
+DatabaseConnection::set_second_level_cache
+(   shared_ptr<SecondLevelCache> p_cache
+)
+{
+    m_second_level_cache = std::move(p_cache);
+    return;
+}
+
+SecondLevelCache*
+DatabaseConnection::second_level_cache() const
+{
+    return m_second_level_cache.get();
+}
+
+void
+DatabaseConnection::set_schema(Schema const& p_schema)
+{
+    m_schema = p_schema;
+    return;
+}
+
+ResultCache&
+DatabaseConnection::result_cache()
+{
+    return m_sqlite_dbconn->result_cache();
+}
+
+void
+DatabaseConnection::enable_result_cache()
+{
+    m_sqlite_dbconn->enable_result_cache();
+    // Statements already prepared did not record the tables they read,
+    // and so could never be cached.
+    m_statement_cache.clear();
+    m_slot_statements.clear();
+    return;
+}
+
+IoStats
+DatabaseConnection::io_stats() const
+{
+    return m_sqlite_dbconn->io_stats();
+}
+
+void
+DatabaseConnection::backup_to(DatabaseConnection& p_destination)
+{
+    m_sqlite_dbconn->backup_to(*p_destination.m_sqlite_dbconn);
+    return;
+}
+
+string
+DatabaseConnection::commit_marker()
+{
+    SQLStatement journal_mode(*this, "pragma journal_mode");
+    journal_mode.step();
+    bool const is_wal = (journal_mode.extract<string>(0) == "wal");
+    journal_mode.reset();
+    return m_sqlite_dbconn->commit_marker(is_wal);
+}
+
+bool
+DatabaseConnection::backup_to_if_unchanged
+(   DatabaseConnection& p_destination,
+    string const& p_destination_marker
+)
+{
+    return m_sqlite_dbconn->backup_to_if_unchanged
+    (   *p_destination.m_sqlite_dbconn,
+        p_destination_marker
+    );
+}
+
+void
+DatabaseConnection::enable_wal_archiving
+(   boost::filesystem::path const& p_directory,
+    WalArchivePolicy const& p_policy
+)
+{
+    if (m_transaction_nesting_level != 0 || m_wal_archiver)
+    {
+        SQLOXX_THROW
+        (   LogicError,
+            "Cannot enable WAL archiving in a transaction, or twice."
+        );
+    }
+    SQLStatement journal_mode(*this, "pragma journal_mode");
+    journal_mode.step();
+    if (journal_mode.extract<string>(0) != "wal")
+    {
+        SQLOXX_THROW(LogicError, "Database is not in WAL mode.");
+    }
+    journal_mode.reset();
+    boost::system::error_code error;
+    if
+    (   boost::filesystem::exists(p_directory, error) &&
+        !boost::filesystem::is_empty(p_directory, error)
+    )
+    {
+        SQLOXX_THROW(LogicError, "WAL archive directory is not empty.");
+    }
+    boost::filesystem::create_directories(p_directory, error);
+    if (error)
+    {
+        SQLOXX_THROW
+        (   WalArchiveException,
+            "Could not create WAL archive directory."
+        );
+    }
+    boost::filesystem::path const base =
+        detail::WalArchiveFormat::base(p_directory);
+
+    // Holding the write lock, so that the snapshot includes exactly the
+    // frames now committed to the WAL. The snapshot is read through
+    // another connection, as the backup API cannot read from a
+    // connection with a write transaction open.
+    try
+    {
+        DatabaseTransaction transaction
+        (   *this,
+            DatabaseTransaction::Lock::immediate
+        );
+        {
+            OpenOptions source_options;
+            source_options.vfs = open_options().vfs;
+            DatabaseConnection source;
+            source.open(filepath(), source_options);
+            DatabaseConnection snapshot;
+            snapshot.open(base);
+            source.backup_to(snapshot);
+        }
+        m_wal_archiver.reset
+        (   new detail::WalArchiver
+            (   *m_sqlite_dbconn,
+                filepath(),
+                open_options().vfs,
+                p_directory,
+                p_policy
+            )
+        );
+        transaction.commit();
+    }
+    catch (...)
+    {
+        // The transaction, if begun, has been cancelled by now.
+        m_wal_archiver.reset();
+        boost::filesystem::remove(base, error);
+        throw;
+    }
+    detail::WalArchiver* const archiver = m_wal_archiver.get();
+    m_sqlite_dbconn->set_wal_listener
+    (   [archiver](int p_frames)
+        {
+            archiver->on_commit(p_frames);
+        }
+    );
+    return;
+}
+
+WalArchiveStats
+DatabaseConnection::wal_archive_stats() const
+{
+    return m_wal_archiver? m_wal_archiver->stats(): WalArchiveStats();
+}
+
+void
+DatabaseConnection::enable_change_tracking()
+{
+    if (m_is_tracking_changes)
+    {
+        return;
+    }
+    execute_sql
+    (   string("create table if not exists ") + change_log_table +
+        "(table_name text primary key, version integer not null)"
+    );
+    ChangeVersions versions = read_change_versions();
+    // The update hook is installed only now, so that connections that do
+    // not track changes make no per-row callback.
+    m_sqlite_dbconn->add_update_listener
+    (   [this](char const* p_table)
+        {
+            if (strcmp(p_table, change_log_table) == 0)
+            {
+                return;
+            }
+            try
+            {
+                m_written_tables.insert(p_table);
+            }
+            catch (bad_alloc&)
+            {
+                m_all_tables_written = true;
+            }
+        }
+    );
+    m_change_versions.swap(versions);
+    m_change_version_sum = sum_change_versions();
+    m_written_tables.clear();
+    m_all_tables_written = false;
+    m_is_tracking_changes = true;
+    return;
+}
+
+bool
+DatabaseConnection::check_for_changes()
+{
+    if (!m_is_tracking_changes)
+    {
+        SQLOXX_THROW(LogicError, "Change tracking is not on.");
+    }
+
+    // Versions only ever advance, so their sum is unchanged if and only
+    // if no table has been changed.
+    static StatementSlot const sum_slot
+    (   "select coalesce(sum(version), 0) from sqloxx_change_log"
+    );
+    SQLStatement sum(*this, sum_slot);
+    sum.step();
+    long long const version_sum = sum.extract<long long>(0);
+    sum.reset();
+    if (version_sum == m_change_version_sum)
+    {
+        return false;
+    }
+    ChangeVersions versions = read_change_versions();
+    vector<string> changed;
+    for (auto const& version: versions)
+    {
+        auto const it = m_change_versions.find(version.first);
+        if ((it == m_change_versions.end()) || (it->second != version.second))
+        {
+            changed.push_back(version.first);
+        }
+    }
+    m_change_versions.swap(versions);
+    m_change_version_sum = version_sum;
+    if (changed.empty())
+    {
+        return false;
+    }
+    if (m_second_level_cache)
+    {
+        m_second_level_cache->advance_epoch();
+    }
+    for (string const& table: changed)
+    {
+        result_cache().invalidate(table.c_str());
+        for (auto const& listener: m_change_listeners)
+        {
+            listener.second(table);
+        }
+    }
+    return true;
+}
+
+int
+DatabaseConnection::add_change_listener(ChangeListener const& p_listener)
+{
+    if (m_last_change_listener_id == numeric_limits<int>::max())
+    {
+        SQLOXX_THROW(OverflowException, "Too many change listeners.");
+    }
+    m_change_listeners[m_last_change_listener_id + 1] = p_listener;
+    return ++m_last_change_listener_id;
+}
+
+void
+DatabaseConnection::remove_change_listener(int p_id) noexcept
+{
+    m_change_listeners.erase(p_id);
+    return;
+}
+
+void
+DatabaseConnection::on_commit(TransactionCallback const& p_callback)
+{
+    if (m_transaction_nesting_level == 0)
+    {
+        p_callback();
+        return;
+    }
+    PendingCallback const pending =
+        { m_transaction_nesting_level, true, p_callback };
+    m_pending_callbacks.push_back(pending);
+    return;
+}
+
+void
+DatabaseConnection::on_rollback(TransactionCallback const& p_callback)
+{
+    if (m_transaction_nesting_level == 0)
+    {
+        return;
+    }
+    PendingCallback const pending =
+        { m_transaction_nesting_level, false, p_callback };
+    m_pending_callbacks.push_back(pending);
+    return;
+}
+
+DatabaseConnection::ChangeVersions
+DatabaseConnection::read_change_versions()
+{
+    static StatementSlot const slot
+    (   "select table_name, version from sqloxx_change_log"
+    );
+    ChangeVersions ret;
+    SQLStatement statement(*this, slot);
+    while (statement.step())
+    {
+        ret[statement.extract<string>(0)] = statement.extract<long long>(1);
+    }
+    return ret;
+}
+
+long long
+DatabaseConnection::sum_change_versions() const noexcept
+{
+    long long ret = 0;
+    for (auto const& version: m_change_versions)
+    {
+        ret += version.second;
+    }
+    return ret;
+}
+
+DatabaseConnection::ChangeVersions
+DatabaseConnection::publish_changes()
+{
+    if (m_all_tables_written)
+    {
+        // We do not know which tables were written, so advance them all.
+        static StatementSlot const advance_all_slot
+        (   "update sqloxx_change_log set version = version + 1"
+        );
+        SQLStatement advance_all(*this, advance_all_slot);
+        advance_all.step_final();
+        return read_change_versions();
+    }
+    static StatementSlot const insertion_slot
+    (   "insert or ignore into sqloxx_change_log(table_name, version) "
+        "values(:table_name, 0)"
+    );
+    static StatementSlot const advance_slot
+    (   "update sqloxx_change_log set version = version + 1 "
+        "where table_name = :table_name"
+    );
+    static StatementSlot const selection_slot
+    (   "select version from sqloxx_change_log "
+        "where table_name = :table_name"
+    );
+    ChangeVersions ret;
+    for (string const& table: m_written_tables)
+    {
+        SQLStatement insertion(*this, insertion_slot);
+        insertion.bind(":table_name", table);
+        insertion.step_final();
+        SQLStatement advance(*this, advance_slot);
+        advance.bind(":table_name", table);
+        advance.step_final();
+        SQLStatement selection(*this, selection_slot);
+        selection.bind(":table_name", table);
+        selection.step();
+        ret[table] = selection.extract<long long>(0);
+        selection.reset();
+    }
+    return ret;
+}
+
 boost::filesystem::path
 DatabaseConnection::filepath() const
 {
     if (!is_valid())
     {
-        JEWEL_THROW
+        SQLOXX_THROW
         (   InvalidConnection,
             "Cannot return filepath of invalid DatabaseConnection."
         );
@@ -145,16 +592,45 @@ DatabaseConnection::filepath() const
     return value(m_filepath);
 }
 
+OpenOptions const&
+DatabaseConnection::open_options() const
+{
+    if (!is_valid())
+    {
+        SQLOXX_THROW
+        (   InvalidConnection,
+            "Cannot return options of invalid DatabaseConnection."
+        );
+    }
+    return m_open_options;
+}
+
 void
-DatabaseConnection::begin_transaction()
+DatabaseConnection::begin_transaction(bool p_is_immediate)
 {
     switch (m_transaction_nesting_level)
     {
     case 0:
-        unchecked_begin_transaction();
+        unchecked_begin_transaction(p_is_immediate);
+        if (m_is_tracking_changes)
+        {
+            try
+            {
+                // Read within the transaction, so that what is read
+                // subsequently is at least as recent as the versions.
+                check_for_changes();
+            }
+            catch (...)
+            {
+                unchecked_rollback_transaction();
+                throw;
+            }
+            m_written_tables.clear();
+            m_all_tables_written = false;
+        }
         break;
     case s_max_nesting:
-        JEWEL_THROW
+        SQLOXX_THROW
         (   TransactionNestingException,
             "Maximum nesting level reached."
         );
@@ -174,10 +650,34 @@ DatabaseConnection::end_transaction()
     switch (m_transaction_nesting_level)
     {
     case 1:
-        unchecked_end_transaction();
+        check_page_count();
+        if (m_is_tracking_changes)
+        {
+            ChangeVersions const published = publish_changes();
+            unchecked_end_transaction();
+            m_written_tables.clear();
+            m_all_tables_written = false;
+            try
+            {
+                for (auto const& version: published)
+                {
+                    m_change_versions[version.first] = version.second;
+                }
+            }
+            catch (bad_alloc&)
+            {
+                // The commit has succeeded. At worst our own changes
+                // will be taken for those of another connection.
+            }
+            m_change_version_sum = sum_change_versions();
+        }
+        else
+        {
+            unchecked_end_transaction();
+        }
         break;
     case 0:
-        JEWEL_THROW
+        SQLOXX_THROW
         (   TransactionNestingException,
             "Cannot end SQL transaction when there in none open."
         );
@@ -188,10 +688,31 @@ DatabaseConnection::end_transaction()
         break;
     }
     JEWEL_ASSERT (m_transaction_nesting_level > 0);
+    resolve_transaction_callbacks(m_transaction_nesting_level, true);
     --m_transaction_nesting_level;
     return;
 }
 
+void
+DatabaseConnection::check_page_count()
+{
+    if (!m_page_count_handler)
+    {
+        return;
+    }
+    long long const page_count = detail::read_pragma(*this, "page_count");
+    if (page_count < m_page_count_threshold)
+    {
+        m_is_page_count_warned = false;
+    }
+    else if (!m_is_page_count_warned)
+    {
+        m_page_count_handler(page_count, m_max_page_count);
+        m_is_page_count_warned = true;
+    }
+    return;
+}
+
 void
 DatabaseConnection::cancel_transaction()
 {
@@ -201,7 +722,7 @@ DatabaseConnection::cancel_transaction()
         unchecked_rollback_transaction();
         break;
     case 0:
-        JEWEL_THROW
+        SQLOXX_THROW
         (   TransactionNestingException,
             "Cannot cancel SQL transaction when there is none open."
         );
@@ -212,40 +733,155 @@ DatabaseConnection::cancel_transaction()
         unchecked_release_savepoint();
         break;
     }
+    resolve_transaction_callbacks(m_transaction_nesting_level, false);
     --m_transaction_nesting_level;
     return;
 }
 
+void
+DatabaseConnection::resolve_transaction_callbacks
+(   int p_level,
+    bool p_is_committed
+) noexcept
+{
+    // Callbacks to be discarded are marked with level -1.
+    for (auto& pending: m_pending_callbacks)
+    {
+        if (pending.level < p_level)
+        {
+            continue;
+        }
+        if (!p_is_committed)
+        {
+            pending.level = (pending.is_on_commit? -1: 0);
+        }
+        else if (p_level > 1)
+        {
+            pending.level = p_level - 1;
+        }
+        else
+        {
+            pending.level = (pending.is_on_commit? 0: -1);
+        }
+    }
+    m_pending_callbacks.erase
+    (   remove_if
+        (   m_pending_callbacks.begin(),
+            m_pending_callbacks.end(),
+            [](PendingCallback const& p_pending)
+            {
+                return p_pending.level < 0;
+            }
+        ),
+        m_pending_callbacks.end()
+    );
+    return;
+}
+
+void
+DatabaseConnection::run_transaction_callbacks()
+{
+    // The due callbacks are moved out before any is called, so that
+    // callbacks may themselves open transactions and register callbacks.
+    vector<TransactionCallback> due;
+    for (auto const& pending: m_pending_callbacks)
+    {
+        if (pending.level == 0)
+        {
+            due.push_back(pending.callback);
+        }
+    }
+    m_pending_callbacks.erase
+    (   remove_if
+        (   m_pending_callbacks.begin(),
+            m_pending_callbacks.end(),
+            [](PendingCallback const& p_pending)
+            {
+                return p_pending.level == 0;
+            }
+        ),
+        m_pending_callbacks.end()
+    );
+    for (auto const& callback: due)
+    {
+        callback();
+    }
+    return;
+}
+
 shared_ptr<detail::SQLStatementImpl>
 DatabaseConnection::provide_sql_statement(string const& statement_text)
+{
+    return provide_cached_sql_statement
+    (   StatementKey::lookup_key(statement_text),
+        &statement_text
+    );
+}
+
+shared_ptr<detail::SQLStatementImpl>
+DatabaseConnection::provide_sql_statement
+(   StatementKey const& p_statement_key
+)
+{
+    return provide_cached_sql_statement(p_statement_key, nullptr);
+}
+
+shared_ptr<detail::SQLStatementImpl>
+DatabaseConnection::provide_cached_sql_statement
+(   StatementKey const& p_key,
+    string const* p_text
+)
 {
     if (!is_valid())
     {
-        JEWEL_THROW(InvalidConnection, "Invalid database connection.");
+        SQLOXX_THROW(InvalidConnection, "Invalid database connection.");
     }
-    StatementCache::const_iterator const it
-    (   m_statement_cache.find(statement_text)
-    );
+    StatementCache::iterator const it(m_statement_cache.find(p_key));
     if (it != m_statement_cache.end())
     {
-        shared_ptr<detail::SQLStatementImpl> existing_statement(it->second);
+        shared_ptr<detail::SQLStatementImpl> existing_statement
+        (   it->second.statement
+        );
         if (!(existing_statement->is_locked()))
         {
             existing_statement->lock();
             return existing_statement;
         }
     }
-    JEWEL_ASSERT (it == m_statement_cache.end() || it->second->is_locked());
+    JEWEL_ASSERT
+    (   it == m_statement_cache.end() ||
+        it->second.statement->is_locked()
+    );
     shared_ptr<detail::SQLStatementImpl> new_statement
-    (   new detail::SQLStatementImpl(*m_sqlite_dbconn, statement_text)
+    (   new detail::SQLStatementImpl
+        (   *m_sqlite_dbconn,
+            p_text? *p_text: string(p_key.text(), p_key.length())
+        )
     );
     new_statement->lock();
-    if (m_statement_cache.size() != m_cache_capacity)
+    if (it != m_statement_cache.end())
+    {
+        // The entry keeps its text, to which its key points.
+        it->second.statement = new_statement;
+    }
+    else if (m_statement_cache.size() != m_cache_capacity)
     {
         JEWEL_ASSERT (m_statement_cache.size() < m_cache_capacity);
         try
         {
-            m_statement_cache[statement_text] = new_statement;
+            CachedStatement entry;
+            entry.statement = new_statement;
+            StatementKey key = p_key;
+            if (p_text)
+            {
+                // The key points into the copy held by the entry, which
+                // stays put on the heap for as long as the entry exists.
+                entry.text.reset(new string(*p_text));
+                key = StatementKey::lookup_key(*entry.text);
+            }
+            m_statement_cache.insert
+            (   StatementCache::value_type(key, std::move(entry))
+            );
         }
         catch (bad_alloc&)
         {
@@ -263,10 +899,56 @@ DatabaseConnection::provide_sql_statement(string const& statement_text)
     return new_statement;
 }
 
+shared_ptr<detail::SQLStatementImpl>
+DatabaseConnection::provide_sql_statement
+(   StatementSlot const& p_statement_slot
+)
+{
+    if (!is_valid())
+    {
+        SQLOXX_THROW(InvalidConnection, "Invalid database connection.");
+    }
+    auto const index = p_statement_slot.index();
+    if (index < m_slot_statements.size())
+    {
+        shared_ptr<detail::SQLStatementImpl> const& existing_statement =
+            m_slot_statements[index];
+        if (existing_statement)
+        {
+            if (existing_statement->is_locked())
+            {
+                // Slot in use further up the call stack.
+                return provide_sql_statement(p_statement_slot.text());
+            }
+            existing_statement->lock();
+            return existing_statement;
+        }
+    }
+    else
+    {
+        // Might throw std::bad_alloc - strong guarantee.
+        m_slot_statements.resize(index + 1);
+    }
+    JEWEL_ASSERT (index < m_slot_statements.size());
+    JEWEL_ASSERT (!m_slot_statements[index]);
+    shared_ptr<detail::SQLStatementImpl> new_statement
+    (   new detail::SQLStatementImpl
+        (   *m_sqlite_dbconn,
+            p_statement_slot.text()
+        )
+    );
+    new_statement->lock();
+    m_slot_statements[index] = new_statement;  // nothrow
+    return new_statement;
+}
+
 void
-DatabaseConnection::unchecked_begin_transaction()
+DatabaseConnection::unchecked_begin_transaction(bool p_is_immediate)
 {
-    SQLStatement statement(*this, "begin");
+    SQLStatement statement
+    (   *this,
+        (p_is_immediate? begin_immediate_key: begin_key)
+    );
     statement.step();
     return;
 }
@@ -274,7 +956,7 @@ DatabaseConnection::unchecked_begin_transaction()
 void
 DatabaseConnection::unchecked_end_transaction()
 {
-    SQLStatement statement(*this, "end");
+    SQLStatement statement(*this, end_key);
     statement.step();
     return;
 }
@@ -282,7 +964,7 @@ DatabaseConnection::unchecked_end_transaction()
 void
 DatabaseConnection::unchecked_set_savepoint()
 {
-    SQLStatement statement(*this, "savepoint sp");
+    SQLStatement statement(*this, set_savepoint_key);
     statement.step();
     return;
 }
@@ -290,7 +972,7 @@ DatabaseConnection::unchecked_set_savepoint()
 void
 DatabaseConnection::unchecked_release_savepoint()
 {
-    SQLStatement statement(*this, "release sp");
+    SQLStatement statement(*this, release_savepoint_key);
     statement.step();
     return;
 }
@@ -298,7 +980,7 @@ DatabaseConnection::unchecked_release_savepoint()
 void
 DatabaseConnection::unchecked_rollback_transaction()
 {
-    SQLStatement statement(*this, "rollback");
+    SQLStatement statement(*this, rollback_key);
     statement.step();
     return;
 }
@@ -306,7 +988,7 @@ DatabaseConnection::unchecked_rollback_transaction()
 void
 DatabaseConnection::unchecked_rollback_to_savepoint()
 {
-    SQLStatement statement(*this, "rollback to savepoint sp");
+    SQLStatement statement(*this, rollback_to_savepoint_key);
     statement.step();
     return;
 }
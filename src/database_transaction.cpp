@@ -16,8 +16,12 @@
 
 #include "database_transaction.hpp"
 #include "database_connection.hpp"
+#include "open_options.hpp"
 #include "sqloxx_exceptions.hpp"
+#include <boost/optional.hpp>
+#include <jewel/log.hpp>
 #include <cstdio>
+#include <functional>
 #include <iostream>
 #include <stdexcept>
 
@@ -27,18 +31,39 @@ using std::endl;
 using std::fprintf;
 using std::bad_alloc;
 using std::exception;
+using std::function;
 
 namespace sqloxx
 {
 
+namespace
+{
+    boost::optional<IoStats>
+    io_stats_snapshot(DatabaseConnection& p_database_connection)
+    {
+        if
+        (   p_database_connection.is_valid() &&
+            p_database_connection.open_options().io_stats
+        )
+        {
+            return p_database_connection.io_stats();
+        }
+        return boost::none;
+    }
+
+}  // end anonymous namespace
+
 DatabaseTransaction::DatabaseTransaction
-(   DatabaseConnection& p_database_connection
+(   DatabaseConnection& p_database_connection,
+    Lock p_lock
 ):
     m_is_active(false),
-    m_database_connection(p_database_connection)
+    m_database_connection(p_database_connection),
+    m_io_stats_at_start(io_stats_snapshot(p_database_connection))
 {
     DatabaseConnection::TransactionAttorney::begin_transaction
-    (   m_database_connection
+    (   m_database_connection,
+        p_lock == Lock::immediate
     );
     m_is_active = true;
 }
@@ -68,6 +93,34 @@ DatabaseTransaction::~DatabaseTransaction()
             fprintf(stderr, "Program terminated.\n");
             terminate();
         }
+        // The rollback stands; a failing callback should not end the
+        // program, as this may be running during stack unwinding.
+        try
+        {
+            DatabaseConnection::TransactionAttorney::run_transaction_callbacks
+            (   m_database_connection
+            );
+        }
+        catch (exception& e)
+        {
+            JEWEL_LOG_MESSAGE
+            (   jewel::Log::error,
+                "Exception caught running on_rollback callbacks in "
+                "destructor of DatabaseTransaction; remaining callbacks "
+                "have been discarded."
+            );
+            JEWEL_LOG_VALUE(jewel::Log::error, e.what());
+            (void)e;  // silence compiler re. unused variable.
+        }
+        catch (...)
+        {
+            JEWEL_LOG_MESSAGE
+            (   jewel::Log::error,
+                "Unknown exception caught running on_rollback callbacks in "
+                "destructor of DatabaseTransaction; remaining callbacks "
+                "have been discarded."
+            );
+        }
     }
 }
 
@@ -92,6 +145,9 @@ DatabaseTransaction::commit()
                 "session may jeopardize data integrity."
             );
         }
+        DatabaseConnection::TransactionAttorney::run_transaction_callbacks
+        (   m_database_connection
+        );
     }
     else
     {
@@ -124,6 +180,9 @@ DatabaseTransaction::cancel()
                 "this situation."
             );
         }
+        DatabaseConnection::TransactionAttorney::run_transaction_callbacks
+        (   m_database_connection
+        );
     }
     else
     {
@@ -134,5 +193,41 @@ DatabaseTransaction::cancel()
     return;
 }
 
+void
+DatabaseTransaction::on_commit(function<void()> const& p_callback)
+{
+    if (!m_is_active)
+    {
+        throw TransactionNestingException
+        (   "Cannot register callback on inactive SQL transaction."
+        );
+    }
+    m_database_connection.on_commit(p_callback);
+    return;
+}
+
+void
+DatabaseTransaction::on_rollback(function<void()> const& p_callback)
+{
+    if (!m_is_active)
+    {
+        throw TransactionNestingException
+        (   "Cannot register callback on inactive SQL transaction."
+        );
+    }
+    m_database_connection.on_rollback(p_callback);
+    return;
+}
+
+IoStats
+DatabaseTransaction::io_stats() const
+{
+    if (!m_io_stats_at_start)
+    {
+        return IoStats();
+    }
+    return m_database_connection.io_stats() - *m_io_stats_at_start;
+}
+
 
 }  // namespace sqloxx
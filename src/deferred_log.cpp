@@ -0,0 +1,399 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "detail/deferred_log.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+using std::atomic;
+using std::clog;
+using std::condition_variable;
+using std::lock_guard;
+using std::make_shared;
+using std::memory_order_acquire;
+using std::memory_order_relaxed;
+using std::memory_order_release;
+using std::mutex;
+using std::ostream;
+using std::shared_ptr;
+using std::size_t;
+using std::strncpy;
+using std::thread;
+using std::uint64_t;
+using std::unique_lock;
+using std::vector;
+namespace chrono = std::chrono;
+
+namespace sqloxx
+{
+namespace detail
+{
+
+namespace
+{
+    // Set once the Logger has been destroyed, after which entries are
+    // dropped. This has constant initialization, so is safe to read
+    // during static destruction.
+    atomic<bool> s_shut_down(false);
+
+    atomic<uint64_t> s_dropped_count(0);
+
+    // Compact record of a single call to DeferredLog::record. Pointers
+    // are to string literals; the message is copied.
+    struct Entry
+    {
+        chrono::steady_clock::rep time;
+        char const* file;
+        char const* function;
+        char const* type;
+        int line;
+        unsigned char kind;
+        char message[87];
+    };
+
+    // Single-producer, single-consumer ring buffer of Entry. The producer
+    // is the owning thread; the consumer is whichever thread holds the
+    // Logger's drain mutex.
+    class Ring
+    {
+    public:
+        Ring(): m_head(0), m_tail(0), m_retired(false)
+        {
+        }
+        Ring(Ring const&) = delete;
+        Ring(Ring&&) = delete;
+        Ring& operator=(Ring const&) = delete;
+        Ring& operator=(Ring&&) = delete;
+        ~Ring() = default;
+
+        // Returns null if full.
+        Entry* prepare_push()
+        {
+            size_t const head = m_head.load(memory_order_relaxed);
+            if (head - m_tail.load(memory_order_acquire) == s_capacity)
+            {
+                return nullptr;
+            }
+            return &m_entries[head & (s_capacity - 1)];
+        }
+        void commit_push()
+        {
+            m_head.store
+            (   m_head.load(memory_order_relaxed) + 1,
+                memory_order_release
+            );
+            return;
+        }
+        // Returns null if empty.
+        Entry const* front() const
+        {
+            size_t const tail = m_tail.load(memory_order_relaxed);
+            if (tail == m_head.load(memory_order_acquire))
+            {
+                return nullptr;
+            }
+            return &m_entries[tail & (s_capacity - 1)];
+        }
+        void pop()
+        {
+            m_tail.store
+            (   m_tail.load(memory_order_relaxed) + 1,
+                memory_order_release
+            );
+            return;
+        }
+        void retire()
+        {
+            m_retired.store(true, memory_order_release);
+            return;
+        }
+        bool is_retired() const
+        {
+            return m_retired.load(memory_order_acquire);
+        }
+
+    private:
+        static size_t const s_capacity = 1024;  // must be a power of 2
+        Entry m_entries[s_capacity];
+        atomic<size_t> m_head;
+        atomic<size_t> m_tail;
+        atomic<bool> m_retired;
+    };
+
+    size_t const Ring::s_capacity;
+
+    class Logger
+    {
+    public:
+        static Logger& instance()
+        {
+            static Logger ret;
+            return ret;
+        }
+
+        Logger(Logger const&) = delete;
+        Logger(Logger&&) = delete;
+        Logger& operator=(Logger const&) = delete;
+        Logger& operator=(Logger&&) = delete;
+
+        ~Logger()
+        {
+            {
+                lock_guard<mutex> const lock(m_wake_mutex);
+                m_stopping = true;
+            }
+            m_wake.notify_one();
+            if (m_thread.joinable()) m_thread.join();
+            s_shut_down = true;
+            try
+            {
+                drain();
+            }
+            catch (...)
+            {
+                // Sink failure is of no further consequence here.
+            }
+        }
+
+        // Registers a new Ring for the calling thread, starting the
+        // background thread if it is not already running.
+        shared_ptr<Ring> register_ring()
+        {
+            shared_ptr<Ring> const ret = make_shared<Ring>();
+            lock_guard<mutex> const lock(m_rings_mutex);
+            m_rings.push_back(ret);
+            if (!m_thread.joinable())
+            {
+                m_thread = thread(&Logger::run, this);
+            }
+            return ret;
+        }
+
+        // Formats and writes all entries in all Rings. Removes Rings
+        // that are retired and empty.
+        void drain()
+        {
+            lock_guard<mutex> const drain_lock(m_drain_mutex);
+            vector<shared_ptr<Ring> > rings;
+            {
+                lock_guard<mutex> const lock(m_rings_mutex);
+                rings = m_rings;
+            }
+            bool found_retired = false;
+            for (auto const& ring: rings)
+            {
+                // Read before draining, so that a Ring is not removed
+                // while it may still contain entries.
+                bool const retired = ring->is_retired();
+                Entry const* entry = nullptr;
+                while ((entry = ring->front()))
+                {
+                    write(*entry);
+                    ring->pop();
+                }
+                found_retired = found_retired || retired;
+            }
+            if (m_sink) m_sink->flush();
+            if (found_retired)
+            {
+                lock_guard<mutex> const lock(m_rings_mutex);
+                vector<shared_ptr<Ring> > remaining;
+                for (auto const& ring: m_rings)
+                {
+                    if (!ring->is_retired() || ring->front())
+                    {
+                        remaining.push_back(ring);
+                    }
+                }
+                m_rings.swap(remaining);
+            }
+            return;
+        }
+
+        ostream* set_sink(ostream* p_sink)
+        {
+            lock_guard<mutex> const lock(m_drain_mutex);
+            ostream* const ret = m_sink;
+            m_sink = p_sink;
+            return ret;
+        }
+
+    private:
+        Logger():
+            m_sink(&clog),
+            m_stopping(false),
+            m_start(chrono::steady_clock::now())
+        {
+        }
+
+        void run()
+        {
+            unique_lock<mutex> lock(m_wake_mutex);
+            while (!m_stopping)
+            {
+                m_wake.wait_for(lock, chrono::milliseconds(50));
+                lock.unlock();
+                try
+                {
+                    drain();
+                }
+                catch (...)
+                {
+                    // Don't let a failing sink terminate the program.
+                }
+                lock.lock();
+            }
+            return;
+        }
+
+        void write(Entry const& p_entry)
+        {
+            if (!m_sink) return;
+            chrono::steady_clock::duration const since_start =
+                chrono::steady_clock::duration(p_entry.time) -
+                m_start.time_since_epoch();
+            *m_sink << "[sqloxx "
+                    << chrono::duration_cast<chrono::microseconds>
+                        (since_start).count()
+                    << "us] ";
+            if (p_entry.kind == DeferredLog::exception)
+            {
+                *m_sink << "EXCEPTION " << p_entry.type << ": "
+                        << p_entry.message << " ";
+            }
+            else
+            {
+                *m_sink << "TRACE ";
+            }
+            *m_sink << "(" << p_entry.function << ", " << p_entry.file
+                    << ":" << p_entry.line << ")\n";
+            return;
+        }
+
+        mutex m_rings_mutex;
+        vector<shared_ptr<Ring> > m_rings;
+        mutex m_drain_mutex;
+        ostream* m_sink;
+        mutex m_wake_mutex;
+        condition_variable m_wake;
+        bool m_stopping;
+        chrono::steady_clock::time_point const m_start;
+        thread m_thread;
+    };
+
+    // Owns the calling thread's reference to its Ring, and retires the
+    // Ring on thread exit (after which the Logger removes it once it
+    // has been drained).
+    class RingHolder
+    {
+    public:
+        RingHolder()
+        {
+            try
+            {
+                m_ring = Logger::instance().register_ring();
+            }
+            catch (...)
+            {
+                // Leave m_ring null; entries will be dropped.
+            }
+        }
+        RingHolder(RingHolder const&) = delete;
+        RingHolder(RingHolder&&) = delete;
+        RingHolder& operator=(RingHolder const&) = delete;
+        RingHolder& operator=(RingHolder&&) = delete;
+        ~RingHolder()
+        {
+            if (m_ring) m_ring->retire();
+        }
+        Ring* ring() const
+        {
+            return m_ring.get();
+        }
+    private:
+        shared_ptr<Ring> m_ring;
+    };
+
+}  // end anonymous namespace
+
+
+void
+DeferredLog::record
+(   Kind p_kind,
+    char const* p_file,
+    int p_line,
+    char const* p_function,
+    char const* p_type,
+    char const* p_message
+) noexcept
+{
+    if (s_shut_down)
+    {
+        ++s_dropped_count;
+        return;
+    }
+    thread_local RingHolder holder;
+    Ring* const ring = holder.ring();
+    Entry* const entry = (ring? ring->prepare_push(): nullptr);
+    if (!entry)
+    {
+        ++s_dropped_count;
+        return;
+    }
+    entry->time = chrono::steady_clock::now().time_since_epoch().count();
+    entry->file = p_file;
+    entry->function = p_function;
+    entry->type = (p_type? p_type: "");
+    entry->line = p_line;
+    entry->kind = static_cast<unsigned char>(p_kind);
+    size_t const message_capacity = sizeof(entry->message);
+    strncpy(entry->message, (p_message? p_message: ""), message_capacity);
+    entry->message[message_capacity - 1] = '\0';
+    ring->commit_push();
+    return;
+}
+
+void
+DeferredLog::flush()
+{
+    if (!s_shut_down) Logger::instance().drain();
+    return;
+}
+
+ostream*
+DeferredLog::set_sink(ostream* p_sink)
+{
+    return Logger::instance().set_sink(p_sink);
+}
+
+uint64_t
+DeferredLog::dropped_count() noexcept
+{
+    return s_dropped_count;
+}
+
+}  // namespace detail
+}  // namespace sqloxx
@@ -15,8 +15,14 @@
  */
 
 #include "info.hpp"
+#include "detail/sqlite3.h"  // Compiling directly into build
 #include <jewel/version.hpp>
 
+// Defined by the build according to SQLITE_PROFILE.
+#ifndef SQLOXX_SQLITE_PROFILE
+#   define SQLOXX_SQLITE_PROFILE "default"
+#endif
+
 using jewel::Version;
 
 namespace sqloxx
@@ -32,4 +38,16 @@ Info::version()
     );
 }
 
+char const*
+Info::sqlite_profile()
+{
+    return SQLOXX_SQLITE_PROFILE;
+}
+
+bool
+Info::sqlite_is_thread_safe()
+{
+    return sqlite3_threadsafe() != 0;
+}
+
 }  // namespace sqloxx
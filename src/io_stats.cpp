@@ -0,0 +1,72 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "io_stats.hpp"
+
+namespace sqloxx
+{
+
+FileIoStats::FileIoStats():
+    reads(0),
+    bytes_read(0),
+    read_latency(0),
+    writes(0),
+    bytes_written(0),
+    write_latency(0),
+    syncs(0),
+    sync_latency(0),
+    locks(0),
+    unlocks(0),
+    lock_latency(0),
+    extends(0),
+    bytes_extended(0),
+    extend_latency(0)
+{
+}
+
+FileIoStats
+operator-(FileIoStats const& p_lhs, FileIoStats const& p_rhs)
+{
+    FileIoStats ret;
+    ret.reads = p_lhs.reads - p_rhs.reads;
+    ret.bytes_read = p_lhs.bytes_read - p_rhs.bytes_read;
+    ret.read_latency = p_lhs.read_latency - p_rhs.read_latency;
+    ret.writes = p_lhs.writes - p_rhs.writes;
+    ret.bytes_written = p_lhs.bytes_written - p_rhs.bytes_written;
+    ret.write_latency = p_lhs.write_latency - p_rhs.write_latency;
+    ret.syncs = p_lhs.syncs - p_rhs.syncs;
+    ret.sync_latency = p_lhs.sync_latency - p_rhs.sync_latency;
+    ret.locks = p_lhs.locks - p_rhs.locks;
+    ret.unlocks = p_lhs.unlocks - p_rhs.unlocks;
+    ret.lock_latency = p_lhs.lock_latency - p_rhs.lock_latency;
+    ret.extends = p_lhs.extends - p_rhs.extends;
+    ret.bytes_extended = p_lhs.bytes_extended - p_rhs.bytes_extended;
+    ret.extend_latency = p_lhs.extend_latency - p_rhs.extend_latency;
+    return ret;
+}
+
+IoStats
+operator-(IoStats const& p_lhs, IoStats const& p_rhs)
+{
+    IoStats ret;
+    ret.main_db = p_lhs.main_db - p_rhs.main_db;
+    ret.journal = p_lhs.journal - p_rhs.journal;
+    ret.wal = p_lhs.wal - p_rhs.wal;
+    ret.other = p_lhs.other - p_rhs.other;
+    return ret;
+}
+
+}  // namespace sqloxx
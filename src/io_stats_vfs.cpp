@@ -0,0 +1,279 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "detail/io_stats_vfs.hpp"
+#include "io_stats.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "detail/deferred_log.hpp"
+#include "detail/shim_vfs.hpp"
+#include "detail/sqlite3.h"  // Compiling directly into build
+#include <jewel/exception.hpp>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+using std::atomic;
+using std::chrono::steady_clock;
+using std::string;
+using std::to_string;
+
+namespace sqloxx
+{
+namespace detail
+{
+
+namespace
+{
+    // The file structure of the VFS. size is the size of the file as
+    // last known, by which extensions are detected.
+    struct IoStatsFile
+    {
+        ShimFile shim;
+        FileIoStats* stats;
+        sqlite3_int64 size;
+    };
+
+    FileIoStats& stats_of(sqlite3_file* p_file)
+    {
+        return *reinterpret_cast<IoStatsFile*>(p_file)->stats;
+    }
+
+    sqlite3_io_methods const& pass_through()
+    {
+        static sqlite3_io_methods const ret = pass_through_io_methods();
+        return ret;
+    }
+
+    int counting_read
+    (   sqlite3_file* p_file,
+        void* p_buffer,
+        int p_amount,
+        sqlite3_int64 p_offset
+    )
+    {
+        steady_clock::time_point const start = steady_clock::now();
+        int const ret =
+            pass_through().xRead(p_file, p_buffer, p_amount, p_offset);
+        FileIoStats& stats = stats_of(p_file);
+        stats.read_latency += steady_clock::now() - start;
+        ++stats.reads;
+        stats.bytes_read += p_amount;
+        return ret;
+    }
+
+    int counting_write
+    (   sqlite3_file* p_file,
+        void const* p_buffer,
+        int p_amount,
+        sqlite3_int64 p_offset
+    )
+    {
+        steady_clock::time_point const start = steady_clock::now();
+        int const ret =
+            pass_through().xWrite(p_file, p_buffer, p_amount, p_offset);
+        steady_clock::duration const latency = steady_clock::now() - start;
+        IoStatsFile& file = *reinterpret_cast<IoStatsFile*>(p_file);
+        FileIoStats& stats = *file.stats;
+        stats.write_latency += latency;
+        ++stats.writes;
+        stats.bytes_written += p_amount;
+        if ((ret == SQLITE_OK) && (p_offset + p_amount > file.size))
+        {
+            ++stats.extends;
+            stats.bytes_extended += p_offset + p_amount - file.size;
+            stats.extend_latency += latency;
+            file.size = p_offset + p_amount;
+        }
+        return ret;
+    }
+
+    int counting_truncate(sqlite3_file* p_file, sqlite3_int64 p_size)
+    {
+        int const ret = pass_through().xTruncate(p_file, p_size);
+        if (ret == SQLITE_OK)
+        {
+            reinterpret_cast<IoStatsFile*>(p_file)->size = p_size;
+        }
+        return ret;
+    }
+
+    int counting_file_control(sqlite3_file* p_file, int p_op, void* p_arg)
+    {
+        if (p_op != SQLITE_FCNTL_SIZE_HINT)
+        {
+            return pass_through().xFileControl(p_file, p_op, p_arg);
+        }
+
+        // Where a chunk size is set, the VFS may preallocate in response.
+        steady_clock::time_point const start = steady_clock::now();
+        int const ret = pass_through().xFileControl(p_file, p_op, p_arg);
+        IoStatsFile& file = *reinterpret_cast<IoStatsFile*>(p_file);
+        sqlite3_int64 size = 0;
+        if
+        (   (pass_through().xFileSize(p_file, &size) == SQLITE_OK) &&
+            (size > file.size)
+        )
+        {
+            FileIoStats& stats = *file.stats;
+            ++stats.extends;
+            stats.bytes_extended += size - file.size;
+            stats.extend_latency += steady_clock::now() - start;
+            file.size = size;
+        }
+        return ret;
+    }
+
+    int counting_sync(sqlite3_file* p_file, int p_flags)
+    {
+        steady_clock::time_point const start = steady_clock::now();
+        int const ret = pass_through().xSync(p_file, p_flags);
+        FileIoStats& stats = stats_of(p_file);
+        stats.sync_latency += steady_clock::now() - start;
+        ++stats.syncs;
+        return ret;
+    }
+
+    int counting_lock(sqlite3_file* p_file, int p_level)
+    {
+        steady_clock::time_point const start = steady_clock::now();
+        int const ret = pass_through().xLock(p_file, p_level);
+        FileIoStats& stats = stats_of(p_file);
+        stats.lock_latency += steady_clock::now() - start;
+        ++stats.locks;
+        return ret;
+    }
+
+    int counting_unlock(sqlite3_file* p_file, int p_level)
+    {
+        steady_clock::time_point const start = steady_clock::now();
+        int const ret = pass_through().xUnlock(p_file, p_level);
+        FileIoStats& stats = stats_of(p_file);
+        stats.lock_latency += steady_clock::now() - start;
+        ++stats.unlocks;
+        return ret;
+    }
+
+    ShimIoMethods make_counting_methods()
+    {
+        sqlite3_io_methods ret = pass_through_io_methods();
+        ret.xRead = &counting_read;
+        ret.xWrite = &counting_write;
+        ret.xSync = &counting_sync;
+        ret.xLock = &counting_lock;
+        ret.xUnlock = &counting_unlock;
+        ret.xTruncate = &counting_truncate;
+        ret.xFileControl = &counting_file_control;
+        return make_shim_io_methods(ret);
+    }
+
+    ShimIoMethods const& counting_methods()
+    {
+        static ShimIoMethods const ret = make_counting_methods();
+        return ret;
+    }
+
+    // Used to give each instance of IoStatsVfs a distinct name.
+    atomic<unsigned long long> s_instances(0);
+
+}  // end anonymous namespace
+
+IoStatsVfs::IoStatsVfs(string const& p_wrapped_vfs):
+    m_name("sqloxx-io-stats-" + to_string(++s_instances))
+{
+    sqlite3_vfs* const wrapped = sqlite3_vfs_find
+    (   p_wrapped_vfs.empty()? nullptr: p_wrapped_vfs.c_str()
+    );
+    if (!wrapped)
+    {
+        SQLOXX_THROW(NoSuchVFS, "No SQLite VFS is registered by that name.");
+    }
+    init_shim_vfs
+    (   m_registration.vfs,
+        *wrapped,
+        m_name.c_str(),
+        sizeof(IoStatsFile)
+    );
+    m_registration.vfs.xOpen = &IoStatsVfs::on_open;
+    m_registration.stats = &m_stats;
+    if (sqlite3_vfs_register(&m_registration.vfs, 0) != SQLITE_OK)
+    {
+        SQLOXX_THROW(SQLiteException, "Could not register I/O stats VFS.");
+    }
+}
+
+IoStatsVfs::~IoStatsVfs()
+{
+    sqlite3_vfs_unregister(&m_registration.vfs);
+}
+
+char const*
+IoStatsVfs::name() const
+{
+    return m_name.c_str();
+}
+
+IoStats const&
+IoStatsVfs::stats() const
+{
+    return m_stats;
+}
+
+int
+IoStatsVfs::on_open
+(   sqlite3_vfs* p_vfs,
+    char const* p_name,
+    sqlite3_file* p_file,
+    int p_flags,
+    int* p_out_flags
+)
+{
+    IoStats& stats = *reinterpret_cast<Registration*>(p_vfs)->stats;
+    IoStatsFile& file = *reinterpret_cast<IoStatsFile*>(p_file);
+    if (p_flags & SQLITE_OPEN_MAIN_DB)
+    {
+        file.stats = &stats.main_db;
+    }
+    else if (p_flags & SQLITE_OPEN_MAIN_JOURNAL)
+    {
+        file.stats = &stats.journal;
+    }
+    else if (p_flags & SQLITE_OPEN_WAL)
+    {
+        file.stats = &stats.wal;
+    }
+    else
+    {
+        file.stats = &stats.other;
+    }
+    file.size = 0;
+    int const ret = open_shim_file
+    (   p_vfs,
+        p_name,
+        p_file,
+        p_flags,
+        p_out_flags,
+        sizeof(IoStatsFile),
+        counting_methods()
+    );
+    if (ret == SQLITE_OK)
+    {
+        pass_through().xFileSize(p_file, &file.size);
+    }
+    return ret;
+}
+
+}  // namespace detail
+}  // namespace sqloxx
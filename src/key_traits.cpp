@@ -0,0 +1,79 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "key_traits.hpp"
+#include "sqloxx_exceptions.hpp"
+#include <jewel/exception.hpp>
+#include <cstddef>
+#include <string>
+
+using std::size_t;
+using std::string;
+using std::to_string;
+
+namespace sqloxx
+{
+namespace detail
+{
+
+string
+composite_key_condition(string const& p_key_columns, size_t p_num_columns)
+{
+    string ret;
+    size_t index = 0;
+    string::size_type begin = 0;
+    while (begin <= p_key_columns.size())
+    {
+        string::size_type end = p_key_columns.find(',', begin);
+        if (end == string::npos)
+        {
+            end = p_key_columns.size();
+        }
+        string::size_type const first =
+            p_key_columns.find_first_not_of(' ', begin);
+        string::size_type const last =
+            p_key_columns.find_last_not_of(' ', end - 1);
+        if (first >= end || last == string::npos || last < first)
+        {
+            JEWEL_THROW(LogicError, "Empty column name in composite key.");
+        }
+        if (index != 0)
+        {
+            ret += " and ";
+        }
+        ret += p_key_columns.substr(first, last - first + 1);
+        ret += " = " + composite_key_parameter(index);
+        ++index;
+        begin = end + 1;
+    }
+    if (index != p_num_columns)
+    {
+        JEWEL_THROW
+        (   LogicError,
+            "Number of key columns does not match composite key type."
+        );
+    }
+    return ret;
+}
+
+string
+composite_key_parameter(size_t p_index)
+{
+    return ":p" + to_string(p_index);
+}
+
+}  // namespace detail
+}  // namespace sqloxx
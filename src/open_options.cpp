@@ -0,0 +1,32 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "open_options.hpp"
+
+namespace sqloxx
+{
+
+OpenOptions::OpenOptions():
+    io_stats(false),
+    chunk_size(0),
+    persist_wal(false),
+    journal_size_limit(-1),
+    max_page_count(0),
+    page_count_warning(0.9)
+{
+}
+
+}  // namespace sqloxx
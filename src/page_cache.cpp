@@ -0,0 +1,257 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "page_cache.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "detail/deferred_log.hpp"
+#include "detail/sqlite3.h"  // Compiling directly into build
+#include <boost/optional.hpp>
+#include <jewel/exception.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#   include <sys/mman.h>
+#endif
+
+using std::lock_guard;
+using std::mutex;
+using std::nothrow;
+using std::size_t;
+using std::uintptr_t;
+
+namespace sqloxx
+{
+
+namespace
+{
+    // Allowance, in each slot, for SQLite's header for the page, where
+    // SQLite cannot report the size of the header itself.
+    size_t const default_header_allowance = 256;
+
+    size_t const huge_page_size = 2 * 1024 * 1024;
+
+    struct PageCacheState
+    {
+        PageCacheState():
+            is_initialized(false),
+            arena_pages(0),
+            huge_pages(false),
+            slot_size(0)
+        {
+        }
+        bool is_initialized;
+        boost::optional<PageCacheConfig> config;
+        size_t arena_pages;
+        bool huge_pages;
+        size_t slot_size;
+    };
+
+    mutex& state_mutex()
+    {
+        static mutex ret;
+        return ret;
+    }
+
+    PageCacheState& state()
+    {
+        static PageCacheState ret;
+        return ret;
+    }
+
+    // Returns an arena of at least p_bytes, or a null pointer, setting
+    // p_huge_pages to whether huge pages were advised for it.
+    void* allocate_arena(size_t p_bytes, bool& p_huge_pages)
+    {
+#       if defined(__unix__) || defined(__APPLE__)
+            // Transparent huge pages can back only whole, aligned huge
+            // pages of the mapping; so over-allocate, and align.
+            size_t const extra = (p_huge_pages? huge_page_size: 0);
+            void* const mapping = mmap
+            (   nullptr,
+                p_bytes + extra,
+                PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS,
+                -1,
+                0
+            );
+            if (mapping == MAP_FAILED)
+            {
+                return nullptr;
+            }
+            if (!p_huge_pages)
+            {
+                return mapping;
+            }
+            uintptr_t const address = reinterpret_cast<uintptr_t>(mapping);
+            uintptr_t const aligned =
+                (address + huge_page_size - 1) & ~(huge_page_size - 1);
+            void* const ret = reinterpret_cast<void*>(aligned);
+#           ifdef MADV_HUGEPAGE
+                p_huge_pages = (madvise(ret, p_bytes, MADV_HUGEPAGE) == 0);
+#           else
+                p_huge_pages = false;
+#           endif
+            return ret;
+#       else
+            p_huge_pages = false;
+            return ::operator new(p_bytes, nothrow);
+#       endif
+    }
+
+    // Returns the size of SQLite's header for each page, as reported by
+    // SQLITE_CONFIG_PCACHE_HDRSZ where the SQLite in use provides it
+    // (from version 3.8.8), or otherwise default_header_allowance.
+    size_t header_allowance()
+    {
+#       ifdef SQLITE_CONFIG_PCACHE_HDRSZ
+            int ret = 0;
+            if
+            (   (sqlite3_config(SQLITE_CONFIG_PCACHE_HDRSZ, &ret) == SQLITE_OK)
+                && (ret > 0)
+            )
+            {
+                return static_cast<size_t>(ret);
+            }
+#       endif
+        return default_header_allowance;
+    }
+
+    size_t status(int p_op, bool p_peak)
+    {
+        int current = 0;
+        int peak = 0;
+        sqlite3_status(p_op, &current, &peak, 0);
+        return static_cast<size_t>(p_peak? peak: current);
+    }
+
+}  // end anonymous namespace
+
+PageCacheConfig::PageCacheConfig():
+    page_size(1024),  // The default page size of the bundled SQLite
+    pages(2000),
+    huge_pages(true)
+{
+}
+
+PageCacheStats::PageCacheStats():
+    arena_pages(0),
+    huge_pages(false),
+    pages_used(0),
+    peak_pages_used(0),
+    overflow_bytes(0),
+    peak_overflow_bytes(0),
+    largest_request(0),
+    slot_size(0)
+{
+}
+
+void
+configure_page_cache(PageCacheConfig const& p_config)
+{
+    if ((p_config.page_size == 0) || (p_config.pages == 0))
+    {
+        SQLOXX_THROW(LogicError, "Page cache arena would be empty.");
+    }
+    lock_guard<mutex> const lock(state_mutex());
+    if (state().is_initialized)
+    {
+        SQLOXX_THROW
+        (   LogicError,
+            "Page cache cannot be configured once SQLite is initialized."
+        );
+    }
+    state().config = p_config;
+    return;
+}
+
+PageCacheStats
+page_cache_stats()
+{
+    PageCacheStats ret;
+    {
+        lock_guard<mutex> const lock(state_mutex());
+        ret.arena_pages = state().arena_pages;
+        ret.huge_pages = state().huge_pages;
+        ret.slot_size = state().slot_size;
+    }
+    ret.pages_used = status(SQLITE_STATUS_PAGECACHE_USED, false);
+    ret.peak_pages_used = status(SQLITE_STATUS_PAGECACHE_USED, true);
+    ret.overflow_bytes = status(SQLITE_STATUS_PAGECACHE_OVERFLOW, false);
+    ret.peak_overflow_bytes = status(SQLITE_STATUS_PAGECACHE_OVERFLOW, true);
+    ret.largest_request = status(SQLITE_STATUS_PAGECACHE_SIZE, true);
+    return ret;
+}
+
+namespace detail
+{
+
+void
+initialize_page_cache()
+{
+    lock_guard<mutex> const lock(state_mutex());
+    PageCacheState& st = state();
+    if (st.is_initialized)
+    {
+        return;
+    }
+    if (st.config)
+    {
+        PageCacheConfig const& config = *st.config;
+
+        // Slots must be 8-byte aligned.
+        size_t const slot_size =
+            (config.page_size + header_allowance() + 7) & ~size_t(7);
+        bool huge_pages = config.huge_pages;
+        void* const arena =
+            allocate_arena(slot_size * config.pages, huge_pages);
+        if (!arena)
+        {
+            SQLOXX_THROW
+            (   SQLiteInitializationError,
+                "Could not allocate page cache arena."
+            );
+        }
+        if
+        (   sqlite3_config
+            (   SQLITE_CONFIG_PAGECACHE,
+                arena,
+                static_cast<int>(slot_size),
+                static_cast<int>(config.pages)
+            ) != SQLITE_OK
+        )
+        {
+            // The arena is leaked; this should happen only if SQLite was
+            // used before the first DatabaseConnection was constructed.
+            SQLOXX_THROW
+            (   SQLiteInitializationError,
+                "SQLite rejected the page cache arena."
+            );
+        }
+        st.arena_pages = config.pages;
+        st.huge_pages = huge_pages;
+        st.slot_size = slot_size;
+    }
+    st.is_initialized = true;
+    return;
+}
+
+}  // namespace detail
+
+}  // namespace sqloxx
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "detail/pragma.hpp"
+#include "database_connection.hpp"
+#include "sql_statement.hpp"
+#include <string>
+
+using std::string;
+
+namespace sqloxx
+{
+namespace detail
+{
+
+long long
+read_pragma(DatabaseConnection& p_connection, char const* p_name)
+{
+    SQLStatement statement(p_connection, string("pragma ") + p_name);
+    statement.step();
+    long long const ret = statement.extract<long long>(0);
+    statement.reset();
+    return ret;
+}
+
+}  // namespace detail
+}  // namespace sqloxx
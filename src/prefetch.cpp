@@ -0,0 +1,91 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "prefetch.hpp"
+#include <jewel/assert.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+using std::size_t;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace sqloxx
+{
+
+namespace
+{
+    vector<string> make_parameters()
+    {
+        vector<string> ret;
+        for (size_t i = 0; i != detail::prefetch_chunk_size; ++i)
+        {
+            ret.push_back(":p" + to_string(i));
+        }
+        return ret;
+    }
+
+    vector<string> const& parameters()
+    {
+        static vector<string> const ret = make_parameters();
+        return ret;
+    }
+
+    string make_parameter_list()
+    {
+        string ret;
+        for (size_t i = 0; i != detail::prefetch_chunk_size; ++i)
+        {
+            if (i != 0) ret += ", ";
+            ret += parameters()[i];
+        }
+        return ret;
+    }
+
+}  // end anonymous namespace
+
+PrefetchedObjects::PrefetchedObjects(): m_size(0)
+{
+}
+
+size_t
+PrefetchedObjects::size() const
+{
+    return m_size;
+}
+
+namespace detail
+{
+
+string const&
+prefetch_parameter_list()
+{
+    static string const ret = make_parameter_list();
+    return ret;
+}
+
+string const&
+prefetch_parameter(size_t p_index)
+{
+    JEWEL_ASSERT (p_index < prefetch_chunk_size);
+    return parameters()[p_index];
+}
+
+}  // namespace detail
+
+}  // namespace sqloxx
@@ -0,0 +1,311 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "result_cache.hpp"
+#include "detail/sqlite3.h"  // Compiling directly into build
+#include <jewel/assert.hpp>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using std::bad_alloc;
+using std::move;
+using std::shared_ptr;
+using std::size_t;
+using std::string;
+using std::unordered_set;
+using std::vector;
+
+namespace sqloxx
+{
+
+ResultCache::Stats::Stats():
+    hits(0),
+    misses(0),
+    stores(0),
+    invalidations(0)
+{
+}
+
+ResultCache::ResultCache(size_t p_capacity):
+    m_capacity(p_capacity),
+    m_size(0),
+    m_generation(0)
+{
+}
+
+void
+ResultCache::set_capacity(size_t p_capacity)
+{
+    m_capacity = p_capacity;
+    if (m_size > m_capacity)
+    {
+        clear();
+    }
+    return;
+}
+
+size_t
+ResultCache::capacity() const
+{
+    return m_capacity;
+}
+
+size_t
+ResultCache::size() const
+{
+    return m_size;
+}
+
+void
+ResultCache::clear()
+{
+    ++m_generation;
+    m_stats.invalidations += m_entries.size();
+    m_entries.clear();
+    m_readers.clear();
+    m_size = 0;
+    return;
+}
+
+ResultCache::Stats
+ResultCache::stats() const
+{
+    return m_stats;
+}
+
+ResultCache::Generation
+ResultCache::generation() const
+{
+    return m_generation;
+}
+
+shared_ptr<ResultCache::Result const>
+ResultCache::find(string const& p_key)
+{
+    Map::const_iterator const it = m_entries.find(p_key);
+    if (it == m_entries.end())
+    {
+        ++m_stats.misses;
+        return shared_ptr<Result const>();
+    }
+    ++m_stats.hits;
+    return it->second.result;
+}
+
+void
+ResultCache::store
+(   string const& p_key,
+    vector<string> const& p_tables,
+    shared_ptr<Result const> const& p_result,
+    Generation p_generation
+) noexcept
+{
+    if (p_generation != m_generation)
+    {
+        return;
+    }
+    size_t const bytes = p_result->bytes() + p_key.size();
+    Map::iterator const existing = m_entries.find(p_key);
+    if (existing != m_entries.end())
+    {
+        erase(existing);
+    }
+    if (bytes > m_capacity - m_size)
+    {
+        return;
+    }
+    try
+    {
+        Entry& entry = m_entries[p_key];
+        entry.result = p_result;
+        entry.bytes = bytes;
+        m_size += bytes;
+        try
+        {
+            entry.tables = p_tables;
+            for (string const& table: p_tables)
+            {
+                m_readers[table].insert(p_key);
+            }
+        }
+        catch (bad_alloc&)
+        {
+            erase(m_entries.find(p_key));
+            return;
+        }
+        ++m_stats.stores;
+    }
+    catch (bad_alloc&)
+    {
+    }
+    return;
+}
+
+void
+ResultCache::invalidate(char const* p_table) noexcept
+{
+    ++m_generation;
+    if (m_entries.empty())
+    {
+        return;
+    }
+    try
+    {
+        auto const readers = m_readers.find(p_table);
+        if (readers == m_readers.end())
+        {
+            return;
+        }
+        // Move the keys out, as erase() modifies m_readers.
+        unordered_set<string> const keys = move(readers->second);
+        m_readers.erase(readers);
+        for (string const& key: keys)
+        {
+            Map::iterator const it = m_entries.find(key);
+            if (it != m_entries.end())
+            {
+                erase(it);
+                ++m_stats.invalidations;
+            }
+        }
+    }
+    catch (bad_alloc&)
+    {
+        // Could not construct the table name; be safe.
+        clear();
+    }
+    return;
+}
+
+void
+ResultCache::erase(Map::iterator p_it)
+{
+    for (string const& table: p_it->second.tables)
+    {
+        auto const readers = m_readers.find(table);
+        if (readers != m_readers.end())
+        {
+            readers->second.erase(p_it->first);
+            if (readers->second.empty())
+            {
+                m_readers.erase(readers);
+            }
+        }
+    }
+    JEWEL_ASSERT (m_size >= p_it->second.bytes);
+    m_size -= p_it->second.bytes;
+    m_entries.erase(p_it);
+    return;
+}
+
+ResultCache::Result::Result(int p_num_columns):
+    m_num_columns(p_num_columns)
+{
+}
+
+int
+ResultCache::Result::num_columns() const
+{
+    return m_num_columns;
+}
+
+size_t
+ResultCache::Result::num_rows() const
+{
+    return m_num_columns == 0? 0: m_cells.size() / m_num_columns;
+}
+
+size_t
+ResultCache::Result::bytes() const
+{
+    return
+        sizeof(Result) +
+        m_cells.capacity() * sizeof(Cell) +
+        m_buffer.capacity();
+}
+
+ResultCache::Result::Cell const&
+ResultCache::Result::cell(size_t p_row, int p_column) const
+{
+    JEWEL_ASSERT (p_column >= 0);
+    JEWEL_ASSERT (p_column < m_num_columns);
+    return m_cells[p_row * m_num_columns + p_column];
+}
+
+char const*
+ResultCache::Result::data(Cell const& p_cell) const
+{
+    return m_buffer.data() + p_cell.offset;
+}
+
+void
+ResultCache::Result::append_integer(long long p_value)
+{
+    Cell cell;
+    cell.type = SQLITE_INTEGER;
+    cell.size = 0;
+    cell.integer = p_value;
+    m_cells.push_back(cell);
+    return;
+}
+
+void
+ResultCache::Result::append_real(double p_value)
+{
+    Cell cell;
+    cell.type = SQLITE_FLOAT;
+    cell.size = 0;
+    cell.real = p_value;
+    m_cells.push_back(cell);
+    return;
+}
+
+void
+ResultCache::Result::append_data
+(   int p_type,
+    void const* p_data,
+    size_t p_size
+)
+{
+    Cell cell;
+    cell.type = p_type;
+    cell.size = p_size;
+    cell.offset = m_buffer.size();
+    if (p_size != 0)
+    {
+        m_buffer.append(static_cast<char const*>(p_data), p_size);
+    }
+    m_cells.push_back(cell);
+    return;
+}
+
+void
+ResultCache::Result::append_null()
+{
+    Cell cell;
+    cell.type = SQLITE_NULL;
+    cell.size = 0;
+    cell.integer = 0;
+    m_cells.push_back(cell);
+    return;
+}
+
+}  // namespace sqloxx
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "schema.hpp"
+#include "database_connection.hpp"
+#include "database_transaction.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "detail/deferred_log.hpp"
+#include "detail/pragma.hpp"
+#include <jewel/exception.hpp>
+#include <cstdint>
+#include <string>
+
+using std::int32_t;
+using std::string;
+using std::to_string;
+
+namespace sqloxx
+{
+
+Schema::Schema(int32_t p_application_id):
+    m_application_id(p_application_id)
+{
+}
+
+void
+Schema::add_migration(Migration const& p_migration)
+{
+    m_migrations.push_back(p_migration);
+    return;
+}
+
+int32_t
+Schema::application_id() const
+{
+    return m_application_id;
+}
+
+int32_t
+Schema::version() const
+{
+    return static_cast<int32_t>(m_migrations.size());
+}
+
+bool
+Schema::is_current(DatabaseConnection& p_connection) const
+{
+    return
+        (detail::read_pragma(p_connection, "user_version") == version()) &&
+        (   (m_application_id == 0) ||
+            (   detail::read_pragma(p_connection, "application_id") ==
+                m_application_id
+            )
+        );
+}
+
+int32_t
+Schema::migrate(DatabaseConnection& p_connection) const
+{
+    if (is_current(p_connection))
+    {
+        return 0;
+    }
+    // Holding the write lock, so that another connection migrating the
+    // database concurrently waits for this one, rather than failing.
+    DatabaseTransaction transaction
+    (   p_connection,
+        DatabaseTransaction::Lock::immediate
+    );
+
+    // Read again within the transaction, in case another connection
+    // has migrated the database in the meantime. Both pragmas are 32-bit
+    // integers.
+    int32_t const recorded_application_id = static_cast<int32_t>
+    (   detail::read_pragma(p_connection, "application_id")
+    );
+    if
+    (   (m_application_id != 0) &&
+        (recorded_application_id != 0) &&
+        (recorded_application_id != m_application_id)
+    )
+    {
+        SQLOXX_THROW
+        (   SchemaMismatch,
+            "Database records a different application id."
+        );
+    }
+    int32_t const recorded_version = static_cast<int32_t>
+    (   detail::read_pragma(p_connection, "user_version")
+    );
+    if (recorded_version > version())
+    {
+        SQLOXX_THROW
+        (   SchemaMismatch,
+            "Database records a later schema version than is known."
+        );
+    }
+    if (recorded_version < 0)
+    {
+        SQLOXX_THROW
+        (   SchemaMismatch,
+            "Database records a negative schema version."
+        );
+    }
+    for (int32_t i = recorded_version; i < version(); ++i)
+    {
+        m_migrations[i](p_connection);
+    }
+    if (m_application_id != 0)
+    {
+        p_connection.execute_sql
+        (   "pragma application_id = " + to_string(m_application_id)
+        );
+    }
+    p_connection.execute_sql("pragma user_version = " + to_string(version()));
+    transaction.commit();
+    return version() - recorded_version;
+}
+
+}  // namespace sqloxx
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "second_level_cache.hpp"
+#include "type_registry.hpp"
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <new>
+
+using std::bad_alloc;
+using std::hash;
+using std::lock_guard;
+using std::mutex;
+using std::size_t;
+
+namespace sqloxx
+{
+
+SecondLevelCache::Stats::Stats():
+    hits(0),
+    misses(0),
+    publications(0),
+    invalidations(0)
+{
+}
+
+SecondLevelCache::SecondLevelCache(size_t p_capacity):
+    m_capacity(p_capacity),
+    m_epoch(0),
+    m_map_epoch(0)
+{
+}
+
+SecondLevelCache::Epoch
+SecondLevelCache::epoch() const
+{
+    return m_epoch.load();
+}
+
+void
+SecondLevelCache::advance_epoch()
+{
+    ++m_epoch;
+    return;
+}
+
+SecondLevelCache::Snapshot
+SecondLevelCache::find(TypeTag const& p_type_tag, long long p_id) const
+{
+    lock_guard<mutex> const lock(m_mutex);
+    synchronize_epoch();
+    Map::const_iterator const it = m_map.find(Key(&p_type_tag, p_id));
+    if (it == m_map.end())
+    {
+        ++m_stats.misses;
+        return Snapshot();
+    }
+    ++m_stats.hits;
+    return it->second;
+}
+
+void
+SecondLevelCache::publish
+(   TypeTag const& p_type_tag,
+    long long p_id,
+    Epoch p_epoch,
+    Snapshot const& p_snapshot
+) noexcept
+{
+    lock_guard<mutex> const lock(m_mutex);
+    synchronize_epoch();
+    if (p_epoch != m_map_epoch || m_map.size() >= m_capacity)
+    {
+        return;
+    }
+    try
+    {
+        m_map[Key(&p_type_tag, p_id)] = p_snapshot;
+        ++m_stats.publications;
+    }
+    catch (bad_alloc&)
+    {
+    }
+    return;
+}
+
+SecondLevelCache::Stats
+SecondLevelCache::stats() const
+{
+    lock_guard<mutex> const lock(m_mutex);
+    return m_stats;
+}
+
+void
+SecondLevelCache::synchronize_epoch() const
+{
+    Epoch const current = m_epoch.load();
+    if (current != m_map_epoch)
+    {
+        if (!m_map.empty())
+        {
+            ++m_stats.invalidations;
+            m_map.clear();
+        }
+        m_map_epoch = current;
+    }
+    return;
+}
+
+size_t
+SecondLevelCache::KeyHash::operator()(Key const& p_key) const
+{
+    return
+        hash<TypeTag const*>()(p_key.first) ^
+        (hash<long long>()(p_key.second) * 31);
+}
+
+}  // namespace sqloxx
@@ -0,0 +1,426 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "detail/shim_vfs.hpp"
+#include "detail/sqlite3.h"  // Compiling directly into build
+#include <jewel/assert.hpp>
+#include <cstddef>
+#include <cstring>
+
+using std::memset;
+using std::size_t;
+
+namespace sqloxx
+{
+namespace detail
+{
+
+namespace
+{
+    // Rounds p_size up so that the wrapped file that follows it is
+    // suitably aligned.
+    size_t aligned_size(size_t p_size)
+    {
+        size_t const alignment = 8;
+        return (p_size + alignment - 1) / alignment * alignment;
+    }
+
+    sqlite3_io_methods const* real_methods(sqlite3_file* p_file)
+    {
+        return real_file(p_file)->pMethods;
+    }
+
+    // Forwarding io methods
+
+    int shim_close(sqlite3_file* p_file)
+    {
+        return real_methods(p_file)->xClose(real_file(p_file));
+    }
+
+    int shim_read
+    (   sqlite3_file* p_file,
+        void* p_buffer,
+        int p_amount,
+        sqlite3_int64 p_offset
+    )
+    {
+        return real_methods(p_file)->xRead
+        (   real_file(p_file),
+            p_buffer,
+            p_amount,
+            p_offset
+        );
+    }
+
+    int shim_write
+    (   sqlite3_file* p_file,
+        void const* p_buffer,
+        int p_amount,
+        sqlite3_int64 p_offset
+    )
+    {
+        return real_methods(p_file)->xWrite
+        (   real_file(p_file),
+            p_buffer,
+            p_amount,
+            p_offset
+        );
+    }
+
+    int shim_truncate(sqlite3_file* p_file, sqlite3_int64 p_size)
+    {
+        return real_methods(p_file)->xTruncate(real_file(p_file), p_size);
+    }
+
+    int shim_sync(sqlite3_file* p_file, int p_flags)
+    {
+        return real_methods(p_file)->xSync(real_file(p_file), p_flags);
+    }
+
+    int shim_file_size(sqlite3_file* p_file, sqlite3_int64* p_size)
+    {
+        return real_methods(p_file)->xFileSize(real_file(p_file), p_size);
+    }
+
+    int shim_lock(sqlite3_file* p_file, int p_level)
+    {
+        return real_methods(p_file)->xLock(real_file(p_file), p_level);
+    }
+
+    int shim_unlock(sqlite3_file* p_file, int p_level)
+    {
+        return real_methods(p_file)->xUnlock(real_file(p_file), p_level);
+    }
+
+    int shim_check_reserved_lock(sqlite3_file* p_file, int* p_result)
+    {
+        return real_methods(p_file)->xCheckReservedLock
+        (   real_file(p_file),
+            p_result
+        );
+    }
+
+    int shim_file_control(sqlite3_file* p_file, int p_op, void* p_arg)
+    {
+        return real_methods(p_file)->xFileControl
+        (   real_file(p_file),
+            p_op,
+            p_arg
+        );
+    }
+
+    int shim_sector_size(sqlite3_file* p_file)
+    {
+        return real_methods(p_file)->xSectorSize(real_file(p_file));
+    }
+
+    int shim_device_characteristics(sqlite3_file* p_file)
+    {
+        return real_methods(p_file)->xDeviceCharacteristics
+        (   real_file(p_file)
+        );
+    }
+
+    int shim_shm_map
+    (   sqlite3_file* p_file,
+        int p_page,
+        int p_page_size,
+        int p_extend,
+        void volatile** p_result
+    )
+    {
+        return real_methods(p_file)->xShmMap
+        (   real_file(p_file),
+            p_page,
+            p_page_size,
+            p_extend,
+            p_result
+        );
+    }
+
+    int shim_shm_lock
+    (   sqlite3_file* p_file,
+        int p_offset,
+        int p_n,
+        int p_flags
+    )
+    {
+        return real_methods(p_file)->xShmLock
+        (   real_file(p_file),
+            p_offset,
+            p_n,
+            p_flags
+        );
+    }
+
+    void shim_shm_barrier(sqlite3_file* p_file)
+    {
+        real_methods(p_file)->xShmBarrier(real_file(p_file));
+        return;
+    }
+
+    int shim_shm_unmap(sqlite3_file* p_file, int p_delete)
+    {
+        return real_methods(p_file)->xShmUnmap(real_file(p_file), p_delete);
+    }
+
+    int shim_fetch
+    (   sqlite3_file* p_file,
+        sqlite3_int64 p_offset,
+        int p_amount,
+        void** p_result
+    )
+    {
+        return real_methods(p_file)->xFetch
+        (   real_file(p_file),
+            p_offset,
+            p_amount,
+            p_result
+        );
+    }
+
+    int shim_unfetch
+    (   sqlite3_file* p_file,
+        sqlite3_int64 p_offset,
+        void* p_pointer
+    )
+    {
+        return real_methods(p_file)->xUnfetch
+        (   real_file(p_file),
+            p_offset,
+            p_pointer
+        );
+    }
+
+    // Forwarding VFS methods
+
+    int shim_delete(sqlite3_vfs* p_vfs, char const* p_name, int p_sync_dir)
+    {
+        return real_vfs(p_vfs)->xDelete(real_vfs(p_vfs), p_name, p_sync_dir);
+    }
+
+    int shim_access
+    (   sqlite3_vfs* p_vfs,
+        char const* p_name,
+        int p_flags,
+        int* p_result
+    )
+    {
+        return real_vfs(p_vfs)->xAccess
+        (   real_vfs(p_vfs),
+            p_name,
+            p_flags,
+            p_result
+        );
+    }
+
+    int shim_full_pathname
+    (   sqlite3_vfs* p_vfs,
+        char const* p_name,
+        int p_size,
+        char* p_result
+    )
+    {
+        return real_vfs(p_vfs)->xFullPathname
+        (   real_vfs(p_vfs),
+            p_name,
+            p_size,
+            p_result
+        );
+    }
+
+    void* shim_dl_open(sqlite3_vfs* p_vfs, char const* p_name)
+    {
+        return real_vfs(p_vfs)->xDlOpen(real_vfs(p_vfs), p_name);
+    }
+
+    void shim_dl_error(sqlite3_vfs* p_vfs, int p_size, char* p_message)
+    {
+        real_vfs(p_vfs)->xDlError(real_vfs(p_vfs), p_size, p_message);
+        return;
+    }
+
+    void (*shim_dl_sym
+    (   sqlite3_vfs* p_vfs,
+        void* p_handle,
+        char const* p_symbol
+    ))(void)
+    {
+        return real_vfs(p_vfs)->xDlSym(real_vfs(p_vfs), p_handle, p_symbol);
+    }
+
+    void shim_dl_close(sqlite3_vfs* p_vfs, void* p_handle)
+    {
+        real_vfs(p_vfs)->xDlClose(real_vfs(p_vfs), p_handle);
+        return;
+    }
+
+    int shim_randomness(sqlite3_vfs* p_vfs, int p_size, char* p_result)
+    {
+        return real_vfs(p_vfs)->xRandomness
+        (   real_vfs(p_vfs),
+            p_size,
+            p_result
+        );
+    }
+
+    int shim_sleep(sqlite3_vfs* p_vfs, int p_microseconds)
+    {
+        return real_vfs(p_vfs)->xSleep(real_vfs(p_vfs), p_microseconds);
+    }
+
+    int shim_current_time(sqlite3_vfs* p_vfs, double* p_result)
+    {
+        return real_vfs(p_vfs)->xCurrentTime(real_vfs(p_vfs), p_result);
+    }
+
+    int shim_get_last_error(sqlite3_vfs* p_vfs, int p_size, char* p_result)
+    {
+        return real_vfs(p_vfs)->xGetLastError
+        (   real_vfs(p_vfs),
+            p_size,
+            p_result
+        );
+    }
+
+    int shim_current_time_int64(sqlite3_vfs* p_vfs, sqlite3_int64* p_result)
+    {
+        return real_vfs(p_vfs)->xCurrentTimeInt64(real_vfs(p_vfs), p_result);
+    }
+
+}  // end anonymous namespace
+
+void
+init_shim_vfs
+(   sqlite3_vfs& p_vfs,
+    sqlite3_vfs& p_real,
+    char const* p_name,
+    size_t p_shim_file_size
+)
+{
+    memset(&p_vfs, 0, sizeof(p_vfs));
+    p_vfs.iVersion = (p_real.iVersion < 2? p_real.iVersion: 2);
+    p_vfs.szOsFile =
+        static_cast<int>(aligned_size(p_shim_file_size)) + p_real.szOsFile;
+    p_vfs.mxPathname = p_real.mxPathname;
+    p_vfs.zName = p_name;
+    p_vfs.pAppData = &p_real;
+    p_vfs.xDelete = &shim_delete;
+    p_vfs.xAccess = &shim_access;
+    p_vfs.xFullPathname = &shim_full_pathname;
+    p_vfs.xDlOpen = &shim_dl_open;
+    p_vfs.xDlError = &shim_dl_error;
+    p_vfs.xDlSym = &shim_dl_sym;
+    p_vfs.xDlClose = &shim_dl_close;
+    p_vfs.xRandomness = &shim_randomness;
+    p_vfs.xSleep = &shim_sleep;
+    p_vfs.xCurrentTime = &shim_current_time;
+    p_vfs.xGetLastError = &shim_get_last_error;
+    if (p_vfs.iVersion >= 2)
+    {
+        p_vfs.xCurrentTimeInt64 = &shim_current_time_int64;
+    }
+    return;
+}
+
+int
+open_shim_file
+(   sqlite3_vfs* p_vfs,
+    char const* p_name,
+    sqlite3_file* p_file,
+    int p_flags,
+    int* p_out_flags,
+    size_t p_shim_file_size,
+    ShimIoMethods const& p_methods
+)
+{
+    ShimFile* const shim = reinterpret_cast<ShimFile*>(p_file);
+    shim->real = reinterpret_cast<sqlite3_file*>
+    (   reinterpret_cast<char*>(p_file) + aligned_size(p_shim_file_size)
+    );
+    shim->real->pMethods = nullptr;
+    int const ret = real_vfs(p_vfs)->xOpen
+    (   real_vfs(p_vfs),
+        p_name,
+        shim->real,
+        p_flags,
+        p_out_flags
+    );
+    // If the wrapped file has no methods, SQLite will not call ours.
+    sqlite3_io_methods const* const real_methods = shim->real->pMethods;
+    p_file->pMethods = nullptr;
+    if (real_methods)
+    {
+        int version = real_methods->iVersion;
+        version = (version < 1)? 1: (version > 3)? 3: version;
+        p_file->pMethods = &p_methods.versions[version - 1];
+    }
+    return ret;
+}
+
+ShimIoMethods
+make_shim_io_methods(sqlite3_io_methods const& p_methods)
+{
+    ShimIoMethods ret;
+    for (int i = 0; i != 3; ++i)
+    {
+        sqlite3_io_methods& methods = ret.versions[i];
+        methods = p_methods;
+        methods.iVersion = i + 1;
+        if (methods.iVersion < 2)
+        {
+            methods.xShmMap = nullptr;
+            methods.xShmLock = nullptr;
+            methods.xShmBarrier = nullptr;
+            methods.xShmUnmap = nullptr;
+        }
+        if (methods.iVersion < 3)
+        {
+            methods.xFetch = nullptr;
+            methods.xUnfetch = nullptr;
+        }
+    }
+    return ret;
+}
+
+sqlite3_io_methods
+pass_through_io_methods()
+{
+    sqlite3_io_methods ret;
+    ret.iVersion = 3;
+    ret.xClose = &shim_close;
+    ret.xRead = &shim_read;
+    ret.xWrite = &shim_write;
+    ret.xTruncate = &shim_truncate;
+    ret.xSync = &shim_sync;
+    ret.xFileSize = &shim_file_size;
+    ret.xLock = &shim_lock;
+    ret.xUnlock = &shim_unlock;
+    ret.xCheckReservedLock = &shim_check_reserved_lock;
+    ret.xFileControl = &shim_file_control;
+    ret.xSectorSize = &shim_sector_size;
+    ret.xDeviceCharacteristics = &shim_device_characteristics;
+    ret.xShmMap = &shim_shm_map;
+    ret.xShmLock = &shim_shm_lock;
+    ret.xShmBarrier = &shim_shm_barrier;
+    ret.xShmUnmap = &shim_shm_unmap;
+    ret.xFetch = &shim_fetch;
+    ret.xUnfetch = &shim_unfetch;
+    return ret;
+}
+
+}  // namespace detail
+}  // namespace sqloxx
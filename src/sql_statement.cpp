@@ -32,6 +32,7 @@ SQLStatement::~SQLStatement()
 {
     m_sql_statement->reset();
     m_sql_statement->clear_bindings();
+    m_sql_statement->disable_result_cache();
     m_sql_statement->unlock();
 }
 
@@ -79,6 +80,14 @@ SQLStatement::extract<string>(int index)
     return m_sql_statement->extract<string>(index);
 }
 
+
+template <>
+Blob
+SQLStatement::extract<Blob>(int index)
+{
+    return m_sql_statement->extract<Blob>(index);
+}
+
 bool
 SQLStatement::step()
 {
@@ -110,5 +119,19 @@ SQLStatement::clear_bindings()
 }
 
 
+void
+SQLStatement::enable_result_cache()
+{
+    m_sql_statement->enable_result_cache();
+    return;
+}
+
+bool
+SQLStatement::is_read_only() const
+{
+    return m_sql_statement->is_read_only();
+}
+
+
 
 }  // namespace sqloxx
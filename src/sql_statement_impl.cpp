@@ -15,14 +15,26 @@
  */
 
 #include "detail/sql_statement_impl.hpp"
+#include "detail/deferred_log.hpp"
 #include "detail/sqlite3.h" // Compiling directly into build
 #include "detail/sqlite_dbconn.hpp"
 #include <jewel/assert.hpp>
 #include <jewel/exception.hpp>
 #include <jewel/log.hpp>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
 #include <string>
+#include <utility>
 
+using std::bad_alloc;
+using std::make_shared;
+using std::move;
+using std::shared_ptr;
+using std::size_t;
 using std::string;
+using std::strlen;
 
 namespace sqloxx
 {
@@ -30,6 +42,10 @@ namespace detail
 {
 
 
+TableAccess::TableAccess(): alters_schema(false)
+{
+}
+
 
 SQLStatementImpl::SQLStatementImpl
 (   SQLiteDBConn& p_sqlite_dbconn,
@@ -37,11 +53,18 @@ SQLStatementImpl::SQLStatementImpl
 ):
     m_statement(nullptr),
     m_sqlite_dbconn(p_sqlite_dbconn),
-    m_is_locked(false)
+    m_is_locked(false),
+    m_is_cacheable(false),
+    m_use_result_cache(false),
+    m_has_unrecorded_bindings(false),
+    m_result_key(str),
+    m_key_length(str.size() + 1),
+    m_replayed_rows(0),
+    m_capture_generation(0)
 {
     if (!p_sqlite_dbconn.is_valid())
     {
-        JEWEL_THROW
+        SQLOXX_THROW
         (   InvalidConnection,
             "Attempt to initialize SQLStatementImpl with invalid "
             "DatabaseConnection."
@@ -50,15 +73,16 @@ SQLStatementImpl::SQLStatementImpl
     char const* cstr = str.c_str();
     char const** tail = &cstr;
     JEWEL_ASSERT (p_sqlite_dbconn.is_valid());
-    throw_on_failure
-    (   sqlite3_prepare_v2
-        (   m_sqlite_dbconn.m_connection,
-            cstr,
-            str.length() + 1,
-            &m_statement,
-            tail
-        )
+    m_sqlite_dbconn.m_table_access = &m_table_access;
+    int const code = sqlite3_prepare_v2
+    (   m_sqlite_dbconn.m_connection,
+        cstr,
+        str.length() + 1,
+        &m_statement,
+        tail
     );
+    m_sqlite_dbconn.m_table_access = nullptr;
+    throw_on_failure(code);
     for (char const* it = *tail; *it != '\0'; ++it)
     {
         switch (*it)
@@ -73,13 +97,24 @@ SQLStatementImpl::SQLStatementImpl
             m_statement = nullptr;
             // Note this will have thrown already if first statement is
             // ungrammatical.
-            JEWEL_THROW
+            SQLOXX_THROW
             (   TooManyStatements,
                 "Compound SQL statement passed to constructor of "
                 "SQLStatementImpl - which can handle only single statements."
             );
         }
     }
+    if (m_statement)
+    {
+        m_is_cacheable =
+            sqlite3_stmt_readonly(m_statement) &&
+            (sqlite3_column_count(m_statement) > 0) &&
+            !m_table_access.read.empty();
+        m_recorded_bindings.resize
+        (   sqlite3_bind_parameter_count(m_statement)
+        );
+    }
+    m_result_key.push_back('\0');
     return;
 }
 
@@ -100,19 +135,19 @@ SQLStatementImpl::check_column(int index, int value_type)
     int const num_columns = sqlite3_column_count(m_statement);
     if (num_columns == 0)
     {
-        JEWEL_THROW(NoResultRowException, "Result row not available.");
+        SQLOXX_THROW(NoResultRowException, "Result row not available.");
     }
     if (index >= num_columns)
     {
-        JEWEL_THROW(ResultIndexOutOfRange, "Index is out of range.");
+        SQLOXX_THROW(ResultIndexOutOfRange, "Index is out of range.");
     }
     if (index < 0)
     {
-        JEWEL_THROW(ResultIndexOutOfRange, "Index is negative.");
+        SQLOXX_THROW(ResultIndexOutOfRange, "Index is negative.");
     }
     if (value_type != sqlite3_column_type(m_statement, index))
     {
-        JEWEL_THROW
+        SQLOXX_THROW
         (   ValueTypeException,
             "Value type at index does not match specified value type."
         );
@@ -133,13 +168,26 @@ SQLStatementImpl::step()
 {
     if (!m_sqlite_dbconn.is_valid())
     {
-        JEWEL_THROW(InvalidConnection, "Invalid database connection.");
+        SQLOXX_THROW(InvalidConnection, "Invalid database connection.");
+    }
+    if (m_replayed_result)
+    {
+        return step_replayed();
+    }
+    if (!sqlite3_stmt_busy(m_statement))
+    {
+        invalidate_written_tables();
+        if (m_use_result_cache && begin_cached_execution())
+        {
+            return step_replayed();
+        }
     }
     int code = SQLITE_OK;
     try
     {
-        // Intentional assignment
-        throw_on_failure(code = sqlite3_step(m_statement));
+        code = sqlite3_step(m_statement);
+        m_sqlite_dbconn.complete_commit();
+        throw_on_failure(code);
     }
     catch (SQLiteException&)
     {
@@ -157,8 +205,16 @@ SQLStatementImpl::step()
             sqlite3_reset(m_statement);
         #endif
 
+        if (m_captured_result)
+        {
+            finish_capture();
+        }
         return false;
     case SQLITE_ROW:
+        if (m_captured_result)
+        {
+            capture_row();
+        }
         return true;
     default:
         ;
@@ -175,7 +231,7 @@ SQLStatementImpl::step_final()
     if (step())
     {
         reset();
-        JEWEL_THROW
+        SQLOXX_THROW
         (   UnexpectedResultRow,
             "Statement yielded a result set when none was expected."
         );
@@ -195,13 +251,263 @@ SQLStatementImpl::parameter_index
     );
     if (ret == 0) 
     {
-        JEWEL_THROW(SQLiteException, "Could not find parameter index.");
+        SQLOXX_THROW(SQLiteException, "Could not find parameter index.");
     }
     JEWEL_ASSERT (ret > 0);
     return ret;
 }
 
 
+void
+SQLStatementImpl::enable_result_cache()
+{
+    if (m_has_unrecorded_bindings)
+    {
+        SQLOXX_THROW
+        (   LogicError,
+            "Result cache must be enabled before any parameters are bound."
+        );
+    }
+    m_use_result_cache = m_is_cacheable;
+    return;
+}
+
+
+void
+SQLStatementImpl::disable_result_cache()
+{
+    m_use_result_cache = false;
+    return;
+}
+
+bool
+SQLStatementImpl::is_read_only() const
+{
+    return sqlite3_stmt_readonly(m_statement) != 0;
+}
+
+
+void
+SQLStatementImpl::record_binding(string const& parameter_name, long long x)
+{
+    record_binding(parameter_name, 'i', &x, sizeof(x));
+    return;
+}
+
+
+void
+SQLStatementImpl::record_binding(string const& parameter_name, double x)
+{
+    record_binding(parameter_name, 'r', &x, sizeof(x));
+    return;
+}
+
+
+void
+SQLStatementImpl::record_binding(string const& parameter_name, char const* x)
+{
+    record_binding(parameter_name, 't', x, strlen(x));
+    return;
+}
+
+
+void
+SQLStatementImpl::record_binding(string const& parameter_name, Blob const& x)
+{
+    record_binding(parameter_name, 'b', x.data(), x.size());
+    return;
+}
+
+
+void
+SQLStatementImpl::record_binding
+(   string const& parameter_name,
+    char type,
+    void const* data,
+    size_t size
+) noexcept
+{
+    int const index = sqlite3_bind_parameter_index
+    (   m_statement,
+        parameter_name.c_str()
+    );
+    JEWEL_ASSERT (index > 0);
+    string& binding = m_recorded_bindings[index - 1];
+    try
+    {
+        // Prefix the length, so that the key is unambiguous.
+        binding.assign(reinterpret_cast<char const*>(&size), sizeof(size));
+        binding.push_back(type);
+        binding.append(static_cast<char const*>(data), size);
+    }
+    catch (bad_alloc&)
+    {
+        binding.clear();
+        m_has_unrecorded_bindings = true;
+    }
+    return;
+}
+
+
+bool
+SQLStatementImpl::begin_cached_execution()
+{
+    if 
+    (   m_has_unrecorded_bindings ||
+        !sqlite3_get_autocommit(m_sqlite_dbconn.m_connection)
+    )
+    {
+        // Results are not cached while a transaction is open.
+        return false;
+    }
+    m_result_key.resize(m_key_length);
+    for (string const& binding: m_recorded_bindings)
+    {
+        m_result_key += binding;
+        m_result_key.push_back('\0');
+    }
+    ResultCache& cache = m_sqlite_dbconn.result_cache();
+    m_replayed_result = cache.find(m_result_key);
+    if (m_replayed_result)
+    {
+        m_replayed_rows = 0;
+        return true;
+    }
+    m_captured_result = make_shared<ResultCache::Result>
+    (   sqlite3_column_count(m_statement)
+    );
+    m_capture_generation = cache.generation();
+    return false;
+}
+
+
+bool
+SQLStatementImpl::step_replayed()
+{
+    JEWEL_ASSERT (m_replayed_result);
+    if (m_replayed_rows < m_replayed_result->num_rows())
+    {
+        ++m_replayed_rows;
+        return true;
+    }
+    m_replayed_result.reset();
+    return false;
+}
+
+
+void
+SQLStatementImpl::capture_row()
+{
+    JEWEL_ASSERT (m_captured_result);
+    ResultCache::Result& result = *m_captured_result;
+    try
+    {
+        for (int i = 0; i != result.num_columns(); ++i)
+        {
+            int const type = sqlite3_column_type(m_statement, i);
+            switch (type)
+            {
+            case SQLITE_INTEGER:
+                result.append_integer(sqlite3_column_int64(m_statement, i));
+                break;
+            case SQLITE_FLOAT:
+                result.append_real(sqlite3_column_double(m_statement, i));
+                break;
+            case SQLITE_TEXT:
+            case SQLITE_BLOB:
+                {
+                    // Per the SQLite documentation, the data must be
+                    // obtained before its size.
+                    void const* const data =
+                    (   type == SQLITE_TEXT?
+                        static_cast<void const*>
+                        (   sqlite3_column_text(m_statement, i)
+                        ):
+                        sqlite3_column_blob(m_statement, i)
+                    );
+                    result.append_data
+                    (   type,
+                        data,
+                        sqlite3_column_bytes(m_statement, i)
+                    );
+                }
+                break;
+            default:
+                result.append_null();
+                break;
+            }
+        }
+    }
+    catch (bad_alloc&)
+    {
+        m_captured_result.reset();
+        return;
+    }
+    if (result.bytes() > m_sqlite_dbconn.result_cache().capacity())
+    {
+        m_captured_result.reset();
+    }
+    return;
+}
+
+
+void
+SQLStatementImpl::finish_capture()
+{
+    shared_ptr<ResultCache::Result const> const result =
+        move(m_captured_result);
+    m_sqlite_dbconn.result_cache().store
+    (   m_result_key,
+        m_table_access.read,
+        result,
+        m_capture_generation
+    );
+    return;
+}
+
+
+void
+SQLStatementImpl::invalidate_written_tables()
+{
+    ResultCache& cache = m_sqlite_dbconn.result_cache();
+    if (m_table_access.alters_schema)
+    {
+        cache.clear();
+    }
+    for (string const& table: m_table_access.written)
+    {
+        cache.invalidate(table.c_str());
+    }
+    return;
+}
+
+
+ResultCache::Result::Cell const&
+SQLStatementImpl::replayed_cell(int index, int value_type)
+{
+    JEWEL_ASSERT (m_replayed_result);
+    JEWEL_ASSERT (m_replayed_rows > 0);
+    if (index >= m_replayed_result->num_columns())
+    {
+        SQLOXX_THROW(ResultIndexOutOfRange, "Index is out of range.");
+    }
+    if (index < 0)
+    {
+        SQLOXX_THROW(ResultIndexOutOfRange, "Index is negative.");
+    }
+    ResultCache::Result::Cell const& ret =
+        m_replayed_result->cell(m_replayed_rows - 1, index);
+    if (ret.type != value_type)
+    {
+        SQLOXX_THROW
+        (   ValueTypeException,
+            "Value type at index does not match specified value type."
+        );
+    }
+    return ret;
+}
+
+
 
 }  // namespace detail
 }  // namespace sqloxx
@@ -14,24 +14,36 @@
  * limitations under the License.
  */
 
+#include "page_cache.hpp"
+#include "result_cache.hpp"
 #include "sqloxx_exceptions.hpp"
+#include "detail/deferred_log.hpp"
 #include "detail/sqlite_dbconn.hpp"
 #include "detail/sqlite3.h" // Compiling directly into build
 #include <boost/filesystem.hpp>
 #include <jewel/assert.hpp>
 #include <jewel/exception.hpp>
 #include <exception>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <new>
 #include <stdexcept>
 #include <string>
 #include <vector>
 
+using std::bad_alloc;
+using std::find;
 using std::terminate;
 using std::clog;
 using std::endl;
 using std::logic_error;
 using std::runtime_error;
+using std::size_t;
+using std::strcmp;
 using std::string;
+using std::to_string;
 using std::vector;
 
 namespace sqloxx
@@ -48,27 +60,28 @@ namespace
     private:
         SQLiteController()
         {
-            JEWEL_LOG_TRACE();
+            SQLOXX_LOG_TRACE();
+            initialize_page_cache();
             if (sqlite3_initialize() != SQLITE_OK)
             {
-                JEWEL_LOG_TRACE();
-                JEWEL_THROW
+                SQLOXX_LOG_TRACE();
+                SQLOXX_THROW
                 (   SQLiteInitializationError,
                     "SQLite could not be initialized."
                 );
             }
-            JEWEL_LOG_TRACE();
+            SQLOXX_LOG_TRACE();
         }
         ~SQLiteController()
         {
-            JEWEL_LOG_TRACE();
+            SQLOXX_LOG_TRACE();
             if (sqlite3_shutdown() != SQLITE_OK)
             {
-                JEWEL_LOG_TRACE();
+                SQLOXX_LOG_TRACE();
                 clog << "SQLite3 shutdown failed." << endl;
                 terminate();
             }
-            JEWEL_LOG_TRACE();
+            SQLOXX_LOG_TRACE();
         }
     public:
         static void register_connection()
@@ -79,9 +92,22 @@ namespace
         }
     };
 
+    void add_table(vector<string>& p_tables, char const* p_table)
+    {
+        if (find(p_tables.begin(), p_tables.end(), p_table) == p_tables.end())
+        {
+            p_tables.push_back(p_table);
+        }
+        return;
+    }
+
 }  // end anonymous namespace
 
-SQLiteDBConn::SQLiteDBConn(): m_connection(nullptr)
+SQLiteDBConn::SQLiteDBConn():
+    m_is_commit_pending(false),
+    m_is_result_cache_enabled(false),
+    m_table_access(nullptr),
+    m_connection(nullptr)
 {
     SQLiteController::register_connection();
 }
@@ -107,16 +133,41 @@ SQLiteDBConn::is_valid() const
 }
 
 void
-SQLiteDBConn::open(boost::filesystem::path const& filepath)
+SQLiteDBConn::open
+(   boost::filesystem::path const& filepath,
+    OpenOptions const& p_options
+)
 {
     if (filepath.string().empty())
     {
-        JEWEL_THROW(InvalidFilename, "Cannot open file with empty filename.");
+        SQLOXX_THROW(InvalidFilename, "Cannot open file with empty filename.");
     }
     // Throw if already connected or if filename is empty
     if (m_connection)
     {
-        JEWEL_THROW(MultipleConnectionException, "Database already connected.");
+        SQLOXX_THROW
+        (   MultipleConnectionException,
+            "Database already connected."
+        );
+    }
+    if
+    (   (p_options.chunk_size < 0) ||
+        !(p_options.page_count_warning > 0) ||
+        (p_options.page_count_warning > 1)
+    )
+    {
+        SQLOXX_THROW(LogicError, "Invalid storage options.");
+    }
+    char const* vfs =
+        (p_options.vfs.empty()? nullptr: p_options.vfs.c_str());
+    if (vfs && !sqlite3_vfs_find(vfs))
+    {
+        SQLOXX_THROW(NoSuchVFS, "No SQLite VFS is registered by that name.");
+    }
+    if (p_options.io_stats)
+    {
+        m_io_stats_vfs.reset(new IoStatsVfs(p_options.vfs));
+        vfs = m_io_stats_vfs->name();
     }
     // Open the connection
     throw_on_failure    
@@ -124,10 +175,392 @@ SQLiteDBConn::open(boost::filesystem::path const& filepath)
         (   filepath.generic_string().c_str(),
             &m_connection,
             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
-            nullptr
+            vfs
         )
     );
     execute_sql("pragma foreign_keys = on;");
+    apply_storage_options(p_options);
+    sqlite3_commit_hook(m_connection, &SQLiteDBConn::on_commit, this);
+    install_hooks();
+    return;
+}
+
+void
+SQLiteDBConn::install_hooks()
+{
+    if (!m_connection)
+    {
+        return;
+    }
+    if (m_is_result_cache_enabled)
+    {
+        sqlite3_set_authorizer
+        (   m_connection,
+            &SQLiteDBConn::on_authorize,
+            this
+        );
+    }
+    if (m_is_result_cache_enabled || !m_update_listeners.empty())
+    {
+        sqlite3_update_hook(m_connection, &SQLiteDBConn::on_update, this);
+    }
+    return;
+}
+
+void
+SQLiteDBConn::apply_storage_options(OpenOptions const& p_options)
+{
+    if (p_options.chunk_size > 0)
+    {
+        int chunk_size = p_options.chunk_size;
+        file_control(SQLITE_FCNTL_CHUNK_SIZE, &chunk_size);
+    }
+    if (p_options.persist_wal)
+    {
+        int persist = 1;
+        file_control(SQLITE_FCNTL_PERSIST_WAL, &persist);
+    }
+    if (p_options.journal_size_limit >= 0)
+    {
+        execute_sql
+        (   "pragma journal_size_limit = " +
+            to_string(p_options.journal_size_limit)
+        );
+    }
+    if (p_options.max_page_count > 0)
+    {
+        execute_sql
+        (   "pragma max_page_count = " +
+            to_string(p_options.max_page_count)
+        );
+    }
+    return;
+}
+
+void
+SQLiteDBConn::file_control(int p_op, void* p_arg)
+{
+    int const ret = sqlite3_file_control(m_connection, "main", p_op, p_arg);
+    // A VFS that does not recognize the operation returns SQLITE_NOTFOUND;
+    // the options concerned are hints, which it may ignore.
+    if (ret != SQLITE_NOTFOUND)
+    {
+        throw_on_failure(ret);
+    }
+    return;
+}
+
+void
+SQLiteDBConn::add_commit_listener
+(   std::function<void(bool)> const& p_listener
+)
+{
+    m_commit_listeners.push_back(p_listener);
+    return;
+}
+
+void
+SQLiteDBConn::complete_commit() noexcept
+{
+    if (m_is_commit_pending)
+    {
+        m_is_commit_pending = false;
+        for (auto const& listener: m_commit_listeners)
+        {
+            listener(true);
+        }
+    }
+    return;
+}
+
+void
+SQLiteDBConn::add_update_listener
+(   std::function<void(char const*)> const& p_listener
+)
+{
+    m_update_listeners.push_back(p_listener);
+    install_hooks();
+    return;
+}
+
+void
+SQLiteDBConn::set_wal_listener(std::function<void(int)> const& p_listener)
+{
+    if (!is_valid())
+    {
+        SQLOXX_THROW(InvalidConnection, "Database connection is invalid.");
+    }
+    m_wal_listener = p_listener;
+    sqlite3_wal_hook(m_connection, &SQLiteDBConn::on_wal, this);
+    return;
+}
+
+void
+SQLiteDBConn::checkpoint()
+{
+    throw_on_failure
+    (   sqlite3_wal_checkpoint_v2
+        (   m_connection,
+            "main",
+            SQLITE_CHECKPOINT_PASSIVE,
+            nullptr,
+            nullptr
+        )
+    );
+    return;
+}
+
+int
+SQLiteDBConn::on_wal
+(   void* p_self,
+    sqlite3*,
+    char const* p_database,
+    int p_frames
+)
+{
+    SQLiteDBConn* const self = static_cast<SQLiteDBConn*>(p_self);
+    if (self->m_wal_listener && (strcmp(p_database, "main") == 0))
+    {
+        self->m_wal_listener(p_frames);
+    }
+    return SQLITE_OK;
+}
+
+int
+SQLiteDBConn::on_commit(void* p_self)
+{
+    SQLiteDBConn* const self = static_cast<SQLiteDBConn*>(p_self);
+    self->m_is_commit_pending = true;
+    for (auto const& listener: self->m_commit_listeners)
+    {
+        listener(false);
+    }
+    return 0;  // Nonzero would turn the commit into a rollback.
+}
+
+IoStats
+SQLiteDBConn::io_stats() const
+{
+    return m_io_stats_vfs? m_io_stats_vfs->stats(): IoStats();
+}
+
+void
+SQLiteDBConn::backup_to(SQLiteDBConn& p_destination)
+{
+    if (!is_valid() || !p_destination.is_valid())
+    {
+        SQLOXX_THROW(InvalidConnection, "Database connection is invalid.");
+    }
+    sqlite3_backup* const backup = sqlite3_backup_init
+    (   p_destination.m_connection,
+        "main",
+        m_connection,
+        "main"
+    );
+    if (!backup)
+    {
+        p_destination.throw_on_failure
+        (   sqlite3_errcode(p_destination.m_connection)
+        );
+    }
+    sqlite3_backup_step(backup, -1);
+
+    // This rolls back the destination if the copy is incomplete, and
+    // leaves the error, if any, on the destination connection.
+    p_destination.throw_on_failure(sqlite3_backup_finish(backup));
+    return;
+}
+
+string
+SQLiteDBConn::commit_marker(bool p_is_wal)
+{
+    if (!is_valid())
+    {
+        SQLOXX_THROW(InvalidConnection, "Database connection is invalid.");
+    }
+
+    // The first character records where the rest was read from, so that
+    // backup_to_if_unchanged can read a marker to compare from the same
+    // place.
+    string ret(p_is_wal? "w": "r");
+    sqlite3_file* file = nullptr;
+    sqlite3_file_control
+    (   m_connection,
+        "main",
+        SQLITE_FCNTL_FILE_POINTER,
+        &file
+    );
+    if (!file || !file->pMethods)
+    {
+        return ret;
+    }
+    if (p_is_wal)
+    {
+        // The header of the WAL index, at the start of its first region,
+        // includes a count of transactions committed, and the size and
+        // salts of the WAL. It is read without a lock, so a read made
+        // while another connection commits may be torn; but a torn
+        // marker can only compare unequal to a later one.
+        int const region_size = 32768;
+        size_t const header_size = 48;
+        void volatile* region = nullptr;
+        if
+        (   (file->pMethods->iVersion >= 2) &&
+            (   file->pMethods->xShmMap(file, 0, region_size, 0, &region) ==
+                SQLITE_OK
+            ) &&
+            region
+        )
+        {
+            char const volatile* const header =
+                static_cast<char const volatile*>(region);
+            for (size_t i = 0; i != header_size; ++i)
+            {
+                ret.push_back(header[i]);
+            }
+        }
+    }
+    else
+    {
+        // The file change counter, at offset 24 of the database header, is
+        // incremented by every transaction committed through a rollback
+        // journal. A short read, of an empty file, fills with zeroes.
+        char counter[4] = { 0, 0, 0, 0 };
+        file->pMethods->xRead(file, counter, sizeof(counter), 24);
+        ret.append(counter, sizeof(counter));
+    }
+    return ret;
+}
+
+bool
+SQLiteDBConn::backup_to_if_unchanged
+(   SQLiteDBConn& p_destination,
+    string const& p_destination_marker
+)
+{
+    if (!is_valid() || !p_destination.is_valid())
+    {
+        SQLOXX_THROW(InvalidConnection, "Database connection is invalid.");
+    }
+    sqlite3_backup* const backup = sqlite3_backup_init
+    (   p_destination.m_connection,
+        "main",
+        m_connection,
+        "main"
+    );
+    if (!backup)
+    {
+        p_destination.throw_on_failure
+        (   sqlite3_errcode(p_destination.m_connection)
+        );
+    }
+
+    // Copying no pages, this takes the write lock on the destination,
+    // which is then held until the backup is finished; so no other
+    // connection can commit between the comparison and the copy.
+    if (sqlite3_backup_step(backup, 0) == SQLITE_OK)
+    {
+        bool const is_wal =
+            !p_destination_marker.empty() && (p_destination_marker[0] == 'w');
+        string marker;
+        try
+        {
+            marker = p_destination.commit_marker(is_wal);
+        }
+        catch (...)
+        {
+            sqlite3_backup_finish(backup);
+            throw;
+        }
+        if (marker != p_destination_marker)
+        {
+            // This releases the lock, leaving the destination unchanged.
+            sqlite3_backup_finish(backup);
+            return false;
+        }
+        sqlite3_backup_step(backup, -1);
+    }
+
+    // As in backup_to, this rolls back the destination if the copy is
+    // incomplete, and leaves the error, if any, on the destination.
+    p_destination.throw_on_failure(sqlite3_backup_finish(backup));
+    return true;
+}
+
+ResultCache&
+SQLiteDBConn::result_cache()
+{
+    return m_result_cache;
+}
+
+void
+SQLiteDBConn::enable_result_cache()
+{
+    m_is_result_cache_enabled = true;
+    install_hooks();
+    return;
+}
+
+int
+SQLiteDBConn::on_authorize
+(   void* p_self,
+    int p_action,
+    char const* p_arg1,
+    char const*,
+    char const*,
+    char const*
+)
+{
+    SQLiteDBConn* const self = static_cast<SQLiteDBConn*>(p_self);
+    TableAccess* const access = self->m_table_access;
+    try
+    {
+        switch (p_action)
+        {
+        case SQLITE_READ:
+            if (access && p_arg1) add_table(access->read, p_arg1);
+            break;
+        case SQLITE_INSERT:
+        case SQLITE_UPDATE:
+        case SQLITE_DELETE:
+            if (access) add_table(access->written, p_arg1);
+            else self->m_result_cache.invalidate(p_arg1);
+            break;
+        case SQLITE_DROP_TABLE:
+        case SQLITE_DROP_TEMP_TABLE:
+        case SQLITE_DROP_VIEW:
+        case SQLITE_DROP_TEMP_VIEW:
+        case SQLITE_ALTER_TABLE:
+            if (access) access->alters_schema = true;
+            else self->m_result_cache.clear();
+            break;
+        default:
+            break;
+        }
+    }
+    catch (bad_alloc&)
+    {
+        // An incomplete record would be unsafe; fail the preparation.
+        return SQLITE_DENY;
+    }
+    return SQLITE_OK;
+}
+
+void
+SQLiteDBConn::on_update
+(   void* p_self,
+    int,
+    char const*,
+    char const* p_table,
+    sqlite3_int64
+)
+{
+    SQLiteDBConn* const self = static_cast<SQLiteDBConn*>(p_self);
+    self->m_result_cache.invalidate(p_table);
+    for (auto const& listener: self->m_update_listeners)
+    {
+        listener(p_table);
+    }
     return;
 }
 
@@ -136,7 +569,7 @@ SQLiteDBConn::throw_on_failure(int errcode)
 {
     if (!is_valid())
     {
-        JEWEL_THROW(InvalidConnection, "Database connection is invalid.");
+        SQLOXX_THROW(InvalidConnection, "Database connection is invalid.");
     }
     switch (errcode)
     {
@@ -158,38 +591,38 @@ SQLiteDBConn::throw_on_failure(int errcode)
     char const* msg = sqlite3_errmsg(m_connection);
     if (!msg)
     {
-        JEWEL_THROW(SQLiteException, "");  // Keep it minimal in this case.
+        SQLOXX_THROW(SQLiteException, "");  // Keep it minimal in this case.
     }
     JEWEL_ASSERT (msg != nullptr);
     JEWEL_ASSERT (errcode == sqlite3_errcode(m_connection));
     switch (errcode)
     {
-    case SQLITE_ERROR:         JEWEL_THROW(SQLiteError, msg);
-    case SQLITE_INTERNAL:      JEWEL_THROW(SQLiteInternal, msg);
-    case SQLITE_PERM:          JEWEL_THROW(SQLitePerm, msg);
-    case SQLITE_ABORT:         JEWEL_THROW(SQLiteAbort, msg);
-    case SQLITE_BUSY:          JEWEL_THROW(SQLiteBusy, msg);
-    case SQLITE_LOCKED:        JEWEL_THROW(SQLiteLocked, msg);
-    case SQLITE_NOMEM:         JEWEL_THROW(SQLiteNoMem, msg);
-    case SQLITE_READONLY:      JEWEL_THROW(SQLiteReadOnly, msg);
-    case SQLITE_INTERRUPT:     JEWEL_THROW(SQLiteInterrupt, msg);
-    case SQLITE_IOERR:         JEWEL_THROW(SQLiteIOErr, msg);
-    case SQLITE_CORRUPT:       JEWEL_THROW(SQLiteCorrupt, msg);
-    case SQLITE_NOTFOUND:      JEWEL_THROW(SQLiteNotFound, msg);
-    case SQLITE_FULL:          JEWEL_THROW(SQLiteFull, msg);
-    case SQLITE_CANTOPEN:      JEWEL_THROW(SQLiteCantOpen, msg);
-    case SQLITE_PROTOCOL:      JEWEL_THROW(SQLiteProtocol, msg);
-    case SQLITE_EMPTY:         JEWEL_THROW(SQLiteEmpty, msg);
-    case SQLITE_SCHEMA:        JEWEL_THROW(SQLiteSchema, msg);
-    case SQLITE_TOOBIG:        JEWEL_THROW(SQLiteTooBig, msg);
-    case SQLITE_CONSTRAINT:    JEWEL_THROW(SQLiteConstraint, msg);
-    case SQLITE_MISMATCH:      JEWEL_THROW(SQLiteMismatch, msg);
-    case SQLITE_MISUSE:        JEWEL_THROW(SQLiteMisuse, msg);
-    case SQLITE_NOLFS:         JEWEL_THROW(SQLiteNoLFS, msg);
-    case SQLITE_AUTH:          JEWEL_THROW(SQLiteAuth, msg);
-    case SQLITE_FORMAT:        JEWEL_THROW(SQLiteFormat, msg);
-    case SQLITE_RANGE:         JEWEL_THROW(SQLiteRange, msg);
-    case SQLITE_NOTADB:        JEWEL_THROW(SQLiteNotADB, msg);
+    case SQLITE_ERROR:         SQLOXX_THROW(SQLiteError, msg);
+    case SQLITE_INTERNAL:      SQLOXX_THROW(SQLiteInternal, msg);
+    case SQLITE_PERM:          SQLOXX_THROW(SQLitePerm, msg);
+    case SQLITE_ABORT:         SQLOXX_THROW(SQLiteAbort, msg);
+    case SQLITE_BUSY:          SQLOXX_THROW(SQLiteBusy, msg);
+    case SQLITE_LOCKED:        SQLOXX_THROW(SQLiteLocked, msg);
+    case SQLITE_NOMEM:         SQLOXX_THROW(SQLiteNoMem, msg);
+    case SQLITE_READONLY:      SQLOXX_THROW(SQLiteReadOnly, msg);
+    case SQLITE_INTERRUPT:     SQLOXX_THROW(SQLiteInterrupt, msg);
+    case SQLITE_IOERR:         SQLOXX_THROW(SQLiteIOErr, msg);
+    case SQLITE_CORRUPT:       SQLOXX_THROW(SQLiteCorrupt, msg);
+    case SQLITE_NOTFOUND:      SQLOXX_THROW(SQLiteNotFound, msg);
+    case SQLITE_FULL:          SQLOXX_THROW(SQLiteFull, msg);
+    case SQLITE_CANTOPEN:      SQLOXX_THROW(SQLiteCantOpen, msg);
+    case SQLITE_PROTOCOL:      SQLOXX_THROW(SQLiteProtocol, msg);
+    case SQLITE_EMPTY:         SQLOXX_THROW(SQLiteEmpty, msg);
+    case SQLITE_SCHEMA:        SQLOXX_THROW(SQLiteSchema, msg);
+    case SQLITE_TOOBIG:        SQLOXX_THROW(SQLiteTooBig, msg);
+    case SQLITE_CONSTRAINT:    SQLOXX_THROW(SQLiteConstraint, msg);
+    case SQLITE_MISMATCH:      SQLOXX_THROW(SQLiteMismatch, msg);
+    case SQLITE_MISUSE:        SQLOXX_THROW(SQLiteMisuse, msg);
+    case SQLITE_NOLFS:         SQLOXX_THROW(SQLiteNoLFS, msg);
+    case SQLITE_AUTH:          SQLOXX_THROW(SQLiteAuth, msg);
+    case SQLITE_FORMAT:        SQLOXX_THROW(SQLiteFormat, msg);
+    case SQLITE_RANGE:         SQLOXX_THROW(SQLiteRange, msg);
+    case SQLITE_NOTADB:        SQLOXX_THROW(SQLiteNotADB, msg);
 
 #   ifndef NDEBUG
         case SQLITE_OK:        JEWEL_HARD_ASSERT (false);
@@ -197,7 +630,7 @@ SQLiteDBConn::throw_on_failure(int errcode)
         case SQLITE_DONE:      JEWEL_HARD_ASSERT (false);
 #   endif
 
-    default:                   JEWEL_THROW(SQLiteUnknownErrorCode, msg);
+    default:                   SQLOXX_THROW(SQLiteUnknownErrorCode, msg);
     }
     JEWEL_HARD_ASSERT (false);  // Execution should never reach here.
 }
@@ -205,9 +638,10 @@ SQLiteDBConn::throw_on_failure(int errcode)
 void
 SQLiteDBConn::execute_sql(string const& str)
 {
-    throw_on_failure
-    (   sqlite3_exec(m_connection,str.c_str(), nullptr, nullptr, nullptr)
-    );
+    int const code =
+        sqlite3_exec(m_connection, str.c_str(), nullptr, nullptr, nullptr);
+    complete_commit();
+    throw_on_failure(code);
     return;
 }
 
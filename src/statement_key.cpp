@@ -0,0 +1,61 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "statement_key.hpp"
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+using std::lock_guard;
+using std::mutex;
+using std::string;
+using std::unordered_set;
+
+namespace sqloxx
+{
+
+StatementKey::HashValue const StatementKey::s_hash_offset;
+StatementKey::HashValue const StatementKey::s_hash_prime;
+
+namespace
+{
+    // Interned texts are never removed. Elements of an unordered_set are
+    // not relocated on rehashing, so pointers to their characters remain
+    // valid for the life of the process.
+    unordered_set<string>& interned_texts()
+    {
+        static unordered_set<string> ret;
+        return ret;
+    }
+
+    mutex& interned_texts_mutex()
+    {
+        static mutex ret;
+        return ret;
+    }
+
+}  // end anonymous namespace
+
+StatementKey
+StatementKey::intern(string const& p_text)
+{
+    HashValue const hash_value = runtime_hash(p_text.data(), p_text.size());
+    lock_guard<mutex> const lock(interned_texts_mutex());
+    string const& interned = *(interned_texts().insert(p_text).first);
+    return StatementKey(interned.c_str(), interned.size(), hash_value);
+}
+
+}  // namespace sqloxx
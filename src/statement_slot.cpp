@@ -0,0 +1,43 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "statement_slot.hpp"
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+using std::atomic;
+using std::size_t;
+using std::string;
+
+namespace sqloxx
+{
+
+namespace
+{
+    // StatementSlots may be constructed (as function-local statics) on
+    // any thread, so the counter is atomic.
+    atomic<size_t> s_next_slot_index(0);
+
+}  // end anonymous namespace
+
+StatementSlot::StatementSlot(string const& p_text):
+    m_index(s_next_slot_index++),
+    m_text(p_text)
+{
+}
+
+}  // namespace sqloxx
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "type_registry.hpp"
+#include <string>
+
+using std::string;
+
+namespace sqloxx
+{
+
+TypeTag::TypeTag
+(   TypeTag const* p_parent,
+    string const& p_exclusive_table_name,
+    string const& p_primary_key_name
+):
+    m_parent(p_parent),
+    m_exclusive_table_name(p_exclusive_table_name),
+    m_primary_key_name(p_primary_key_name),
+    m_join_text(p_exclusive_table_name)
+{
+    if (m_parent)
+    {
+        TypeTag const* base = m_parent;
+        while (base->m_parent)
+        {
+            base = base->m_parent;
+        }
+        m_join_text =
+            m_parent->join_text() + " join " + m_exclusive_table_name;
+        if (m_primary_key_name == base->m_primary_key_name)
+        {
+            m_join_text += " using(" + m_primary_key_name + ")";
+        }
+        else
+        {
+            m_join_text +=
+                " on " + base->m_exclusive_table_name + "." +
+                base->m_primary_key_name + " = " + m_exclusive_table_name +
+                "." + m_primary_key_name;
+        }
+    }
+}
+
+}  // namespace sqloxx
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "wal_archive.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "detail/deferred_log.hpp"
+#include "detail/wal_archiver.hpp"
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <jewel/exception.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using sqloxx::detail::WalArchiveFormat;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::system_clock;
+using std::int64_t;
+using std::ios;
+using std::memcmp;
+using std::numeric_limits;
+using std::size_t;
+using std::uint32_t;
+using std::vector;
+
+namespace sqloxx
+{
+
+WalArchivePolicy::WalArchivePolicy():
+    checkpoint_frames(1000)
+{
+}
+
+WalArchiveStats::WalArchiveStats():
+    commits(0),
+    frames(0),
+    bytes(0),
+    checkpoints(0),
+    failures(0),
+    latency(0)
+{
+}
+
+void
+restore_wal_archive
+(   boost::filesystem::path const& p_directory,
+    boost::filesystem::path const& p_target,
+    system_clock::time_point p_until
+)
+{
+    if (boost::filesystem::exists(p_target))
+    {
+        SQLOXX_THROW(LogicError, "Restore target already exists.");
+    }
+    boost::system::error_code error;
+    boost::filesystem::copy_file
+    (   WalArchiveFormat::base(p_directory),
+        p_target,
+        error
+    );
+    if (error)
+    {
+        SQLOXX_THROW
+        (   WalArchiveException,
+            "Could not copy base snapshot of WAL archive."
+        );
+    }
+    int64_t const limit =
+    (   (p_until == system_clock::time_point::max())?
+        numeric_limits<int64_t>::max():
+        duration_cast<microseconds>(p_until.time_since_epoch()).count()
+    );
+    boost::filesystem::fstream target
+    (   p_target,
+        ios::in | ios::out | ios::binary
+    );
+    long long database_pages = -1;
+    uint32_t page_size = 0;
+    bool is_done = false;
+    for (int generation = 1; !is_done; ++generation)
+    {
+        boost::filesystem::path const filepath =
+            WalArchiveFormat::segment(p_directory, generation);
+        if (!boost::filesystem::exists(filepath))
+        {
+            break;
+        }
+        boost::filesystem::ifstream segment(filepath, ios::binary);
+        unsigned char header[WalArchiveFormat::segment_header_size];
+        if
+        (   !segment.read
+            (   reinterpret_cast<char*>(header),
+                sizeof(header)
+            ) ||
+            (   memcmp
+                (   header,
+                    WalArchiveFormat::magic,
+                    WalArchiveFormat::magic_size
+                ) != 0
+            )
+        )
+        {
+            SQLOXX_THROW(WalArchiveException, "WAL archive is corrupt.");
+        }
+        page_size = WalArchiveFormat::decode_uint32
+        (   header + WalArchiveFormat::magic_size
+        );
+        vector<unsigned char> record;
+        for (;;)
+        {
+            unsigned char head[WalArchiveFormat::record_header_size];
+            segment.read(reinterpret_cast<char*>(head), sizeof(head));
+            if (segment.gcount() == 0)
+            {
+                break;  // End of segment
+            }
+            int64_t const time =
+                (int64_t(WalArchiveFormat::decode_uint32(head)) << 32) |
+                WalArchiveFormat::decode_uint32(head + 4);
+            uint32_t const frames =
+                WalArchiveFormat::decode_uint32(head + 12);
+            record.resize(frames * (4 + size_t(page_size)));
+            if
+            (   !segment ||
+                (time > limit) ||
+                !segment.read
+                (   reinterpret_cast<char*>(&record[0]),
+                    record.size()
+                )
+            )
+            {
+                // Past p_until, or partially written.
+                is_done = true;
+                break;
+            }
+            for
+            (   size_t offset = 0;
+                offset != record.size();
+                offset += 4 + page_size
+            )
+            {
+                uint32_t const page =
+                    WalArchiveFormat::decode_uint32(&record[offset]);
+                target.seekp((page - 1) * static_cast<long long>(page_size));
+                target.write
+                (   reinterpret_cast<char const*>(&record[offset + 4]),
+                    page_size
+                );
+            }
+            database_pages = WalArchiveFormat::decode_uint32(head + 8);
+        }
+    }
+    target.close();
+    if (!target)
+    {
+        SQLOXX_THROW(WalArchiveException, "Could not write restored file.");
+    }
+    if (database_pages >= 0)
+    {
+        boost::filesystem::resize_file
+        (   p_target,
+            database_pages * page_size,
+            error
+        );
+        if (error)
+        {
+            SQLOXX_THROW
+            (   WalArchiveException,
+                "Could not write restored file."
+            );
+        }
+    }
+    return;
+}
+
+}  // namespace sqloxx
@@ -0,0 +1,480 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "detail/wal_archiver.hpp"
+#include "open_options.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "wal_archive.hpp"
+#include "detail/deferred_log.hpp"
+#include "detail/sqlite_dbconn.hpp"
+#include <boost/filesystem.hpp>
+#include <jewel/exception.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#   include <unistd.h>
+#endif
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+using std::chrono::system_clock;
+using std::fclose;
+using std::fflush;
+using std::fopen;
+using std::fread;
+using std::fseek;
+using std::FILE;
+using std::fwrite;
+using std::int64_t;
+using std::ostringstream;
+using std::setfill;
+using std::setw;
+using std::size_t;
+using std::string;
+using std::uint32_t;
+using std::unique_ptr;
+using std::vector;
+
+namespace sqloxx
+{
+namespace detail
+{
+
+namespace
+{
+    // The layout of the WAL file, as documented at
+    // http://www.sqlite.org/fileformat2.html#walformat.
+    size_t const wal_header_size = 32;
+    size_t const frame_header_size = 24;
+    uint32_t const wal_magic = 0x377f0682;
+
+    typedef unique_ptr<FILE, int(*)(FILE*)> FileCloser;
+
+    void put_uint32(vector<unsigned char>& p_bytes, uint32_t p_value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            p_bytes.push_back(static_cast<unsigned char>(p_value >> shift));
+        }
+        return;
+    }
+
+    void put_int64(vector<unsigned char>& p_bytes, int64_t p_value)
+    {
+        put_uint32(p_bytes, static_cast<uint32_t>(p_value >> 32));
+        put_uint32(p_bytes, static_cast<uint32_t>(p_value));
+        return;
+    }
+
+    long frame_offset(int p_frame, uint32_t p_page_size)
+    {
+        return static_cast<long>
+        (   wal_header_size +
+            static_cast<long long>(p_frame) *
+                (frame_header_size + p_page_size)
+        );
+    }
+
+}  // end anonymous namespace
+
+char const WalArchiveFormat::magic[8] =
+    {'S', 'Q', 'X', 'W', 'A', 'L', '0', '1'};
+size_t const WalArchiveFormat::magic_size;
+size_t const WalArchiveFormat::segment_header_size;
+size_t const WalArchiveFormat::record_header_size;
+
+boost::filesystem::path
+WalArchiveFormat::base(boost::filesystem::path const& p_directory)
+{
+    return p_directory / "base";
+}
+
+boost::filesystem::path
+WalArchiveFormat::segment
+(   boost::filesystem::path const& p_directory,
+    int p_generation
+)
+{
+    ostringstream oss;
+    oss << "wal-" << setw(8) << setfill('0') << p_generation;
+    return p_directory / oss.str();
+}
+
+uint32_t
+WalArchiveFormat::decode_uint32(unsigned char const* p_bytes)
+{
+    return
+        (uint32_t(p_bytes[0]) << 24) |
+        (uint32_t(p_bytes[1]) << 16) |
+        (uint32_t(p_bytes[2]) << 8) |
+        uint32_t(p_bytes[3]);
+}
+
+WalArchiver::WalArchiver
+(   SQLiteDBConn& p_connection,
+    boost::filesystem::path const& p_filepath,
+    string const& p_vfs,
+    boost::filesystem::path const& p_directory,
+    WalArchivePolicy const& p_policy
+):
+    m_connection(p_connection),
+    m_filepath(p_filepath),
+    m_vfs(p_vfs),
+    m_wal_filepath(p_filepath.string() + "-wal"),
+    m_directory(p_directory),
+    m_policy(p_policy),
+    m_has_generation(false),
+    m_salt1(0),
+    m_salt2(0),
+    m_frames(0),
+    m_generation(0),
+    m_segment(nullptr),
+    m_segment_size(0)
+{
+    FILE* const wal = fopen(m_wal_filepath.string().c_str(), "rb");
+    if (!wal)
+    {
+        return;  // There is no WAL yet.
+    }
+    FileCloser const closer(wal, &fclose);
+    uint32_t page_size = 0;
+    if (!read_header(wal, page_size, m_salt1, m_salt2))
+    {
+        return;
+    }
+    m_has_generation = true;
+    m_frames = committed_frames(wal, page_size, m_salt1, m_salt2);
+}
+
+WalArchiver::~WalArchiver()
+{
+    close_segment(false);
+}
+
+void
+WalArchiver::on_commit(int p_frames) noexcept
+{
+    steady_clock::time_point const start = steady_clock::now();
+    try
+    {
+        archive(p_frames);
+        if (p_frames >= m_policy.checkpoint_frames)
+        {
+            archive_and_checkpoint();
+        }
+    }
+    catch (SQLiteBusy&)
+    {
+        // Another connection is writing; checkpoint on a later commit.
+    }
+    catch (...)
+    {
+        ++m_stats.failures;
+    }
+    m_stats.latency += steady_clock::now() - start;
+    return;
+}
+
+WalArchiveStats const&
+WalArchiver::stats() const
+{
+    return m_stats;
+}
+
+bool
+WalArchiver::read_header
+(   FILE* p_wal,
+    uint32_t& p_page_size,
+    uint32_t& p_salt1,
+    uint32_t& p_salt2
+)
+{
+    unsigned char header[wal_header_size];
+    if
+    (   (fread(header, 1, wal_header_size, p_wal) != wal_header_size) ||
+        ((WalArchiveFormat::decode_uint32(header) & 0xfffffffe) != wal_magic)
+    )
+    {
+        return false;
+    }
+    p_page_size = WalArchiveFormat::decode_uint32(header + 8);
+    p_salt1 = WalArchiveFormat::decode_uint32(header + 16);
+    p_salt2 = WalArchiveFormat::decode_uint32(header + 20);
+    return true;
+}
+
+int
+WalArchiver::committed_frames
+(   FILE* p_wal,
+    uint32_t p_page_size,
+    uint32_t p_salt1,
+    uint32_t p_salt2
+)
+{
+    // The committed frames of this generation end with the last commit
+    // frame bearing its salts.
+    int ret = 0;
+    vector<unsigned char> header(frame_header_size);
+    for (int frame = 0; ; ++frame)
+    {
+        if
+        (   (fread(&header[0], 1, frame_header_size, p_wal) !=
+                frame_header_size) ||
+            (WalArchiveFormat::decode_uint32(&header[8]) != p_salt1) ||
+            (WalArchiveFormat::decode_uint32(&header[12]) != p_salt2)
+        )
+        {
+            break;
+        }
+        if (WalArchiveFormat::decode_uint32(&header[4]) != 0)
+        {
+            ret = frame + 1;
+        }
+        if (fseek(p_wal, static_cast<long>(p_page_size), SEEK_CUR) != 0)
+        {
+            break;
+        }
+    }
+    return ret;
+}
+
+void
+WalArchiver::archive_and_checkpoint()
+{
+    if (!m_lock_connection)
+    {
+        OpenOptions options;
+        options.vfs = m_vfs;
+        unique_ptr<SQLiteDBConn> lock_connection(new SQLiteDBConn);
+        lock_connection->open(m_filepath, options);
+        m_lock_connection = std::move(lock_connection);
+    }
+    m_lock_connection->execute_sql("begin immediate");
+    try
+    {
+        // No frame can now be appended to the WAL.
+        FILE* const wal = fopen(m_wal_filepath.string().c_str(), "rb");
+        if (!wal)
+        {
+            SQLOXX_THROW(WalArchiveException, "Could not open WAL.");
+        }
+        FileCloser const closer(wal, &fclose);
+        uint32_t page_size = 0;
+        uint32_t salt1 = 0;
+        uint32_t salt2 = 0;
+        if (!read_header(wal, page_size, salt1, salt2))
+        {
+            SQLOXX_THROW(WalArchiveException, "Could not read WAL header.");
+        }
+        archive(committed_frames(wal, page_size, salt1, salt2));
+        m_connection.checkpoint();
+        ++m_stats.checkpoints;
+        m_lock_connection->execute_sql("commit");
+    }
+    catch (...)
+    {
+        try
+        {
+            m_lock_connection->execute_sql("rollback");
+        }
+        catch (...)
+        {
+            // The transaction has already been rolled back.
+        }
+        throw;
+    }
+    return;
+}
+
+void
+WalArchiver::archive(int p_frames)
+{
+    FILE* const wal = fopen(m_wal_filepath.string().c_str(), "rb");
+    if (!wal)
+    {
+        SQLOXX_THROW(WalArchiveException, "Could not open WAL.");
+    }
+    FileCloser const closer(wal, &fclose);
+    uint32_t page_size = 0;
+    uint32_t salt1 = 0;
+    uint32_t salt2 = 0;
+    if (!read_header(wal, page_size, salt1, salt2))
+    {
+        SQLOXX_THROW(WalArchiveException, "Could not read WAL header.");
+    }
+    if (!m_has_generation || (salt1 != m_salt1) || (salt2 != m_salt2))
+    {
+        // The WAL has been restarted since we last read it, following a
+        // checkpoint, which we make only once every frame is archived.
+        close_segment(false);
+        m_segment_size = 0;
+        m_has_generation = true;
+        m_salt1 = salt1;
+        m_salt2 = salt2;
+        m_frames = 0;
+    }
+    if
+    (   (p_frames <= m_frames) ||
+        (fseek(wal, frame_offset(m_frames, page_size), SEEK_SET) != 0)
+    )
+    {
+        return;
+    }
+
+    // Gather the frames into a record for each commit.
+    int64_t const time = duration_cast<microseconds>
+    (   system_clock::now().time_since_epoch()
+    ).count();
+    vector<unsigned char> records;
+    vector<unsigned char> pending;
+    vector<unsigned char> frame(frame_header_size + page_size);
+    uint32_t pending_frames = 0;
+    int archived = m_frames;
+    size_t commits = 0;
+    for (int i = m_frames; i != p_frames; ++i)
+    {
+        if
+        (   (fread(&frame[0], 1, frame.size(), wal) != frame.size()) ||
+            (WalArchiveFormat::decode_uint32(&frame[8]) != salt1) ||
+            (WalArchiveFormat::decode_uint32(&frame[12]) != salt2)
+        )
+        {
+            SQLOXX_THROW(WalArchiveException, "Could not read WAL frame.");
+        }
+        put_uint32(pending, WalArchiveFormat::decode_uint32(&frame[0]));
+        pending.insert
+        (   pending.end(),
+            frame.begin() + frame_header_size,
+            frame.end()
+        );
+        ++pending_frames;
+        uint32_t const database_pages =
+            WalArchiveFormat::decode_uint32(&frame[4]);
+        if (database_pages != 0)
+        {
+            put_int64(records, time);
+            put_uint32(records, database_pages);
+            put_uint32(records, pending_frames);
+            records.insert(records.end(), pending.begin(), pending.end());
+            pending.clear();
+            pending_frames = 0;
+            archived = i + 1;
+            ++commits;
+        }
+    }
+    if (records.empty())
+    {
+        return;
+    }
+    if (!m_segment)
+    {
+        open_segment(page_size);
+    }
+    bool is_written =
+        (fwrite(&records[0], 1, records.size(), m_segment) ==
+            records.size()) &&
+        (fflush(m_segment) == 0);
+#   if defined(__unix__) || defined(__APPLE__)
+        is_written = is_written && (fsync(fileno(m_segment)) == 0);
+#   endif
+    if (!is_written)
+    {
+        close_segment(true);
+        SQLOXX_THROW(WalArchiveException, "Could not write WAL archive.");
+    }
+    m_segment_size += records.size();
+    m_stats.commits += commits;
+    m_stats.frames += archived - m_frames;
+    m_stats.bytes += (archived - m_frames) * size_t(page_size);
+    m_frames = archived;
+    return;
+}
+
+void
+WalArchiver::open_segment(uint32_t p_page_size)
+{
+    if (m_segment_size != 0)
+    {
+        m_segment = fopen
+        (   WalArchiveFormat::segment(m_directory, m_generation).
+                string().c_str(),
+            "ab"
+        );
+        if (!m_segment)
+        {
+            SQLOXX_THROW(WalArchiveException, "Could not open WAL archive.");
+        }
+        return;
+    }
+    boost::filesystem::path const filepath =
+        WalArchiveFormat::segment(m_directory, m_generation + 1);
+    FILE* const segment = fopen(filepath.string().c_str(), "wb");
+    if (!segment)
+    {
+        SQLOXX_THROW(WalArchiveException, "Could not create WAL archive.");
+    }
+    vector<unsigned char> header
+    (   WalArchiveFormat::magic,
+        WalArchiveFormat::magic + WalArchiveFormat::magic_size
+    );
+    put_uint32(header, p_page_size);
+    if (fwrite(&header[0], 1, header.size(), segment) != header.size())
+    {
+        fclose(segment);
+        boost::system::error_code ignored;
+        boost::filesystem::remove(filepath, ignored);
+        SQLOXX_THROW(WalArchiveException, "Could not write WAL archive.");
+    }
+    m_segment = segment;
+    m_segment_size = header.size();
+    ++m_generation;
+    return;
+}
+
+void
+WalArchiver::close_segment(bool p_discard_tail) noexcept
+{
+    if (!m_segment)
+    {
+        return;
+    }
+    fclose(m_segment);
+    m_segment = nullptr;
+    if (p_discard_tail)
+    {
+        boost::system::error_code ignored;
+        boost::filesystem::resize_file
+        (   WalArchiveFormat::segment(m_directory, m_generation),
+            m_segment_size,
+            ignored
+        );
+    }
+    return;
+}
+
+}  // namespace detail
+}  // namespace sqloxx
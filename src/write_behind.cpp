@@ -0,0 +1,46 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "write_behind.hpp"
+#include <chrono>
+
+using std::chrono::seconds;
+using std::chrono::steady_clock;
+
+namespace sqloxx
+{
+
+WriteBehindPolicy::WriteBehindPolicy():
+    max_delay(seconds(1)),
+    max_backlog(1000)
+{
+}
+
+WriteBehindStats::WriteBehindStats():
+    deferred_saves(0),
+    flushes(0),
+    objects_flushed(0),
+    failed_flushes(0),
+    objects_discarded(0),
+    backlog(0),
+    peak_backlog(0),
+    last_flush_latency(steady_clock::duration::zero()),
+    max_flush_latency(steady_clock::duration::zero()),
+    max_staleness(steady_clock::duration::zero())
+{
+}
+
+}  // namespace sqloxx
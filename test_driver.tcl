@@ -50,6 +50,10 @@ catch { exec {*}$argv ./test_engine $filename 2>@ stderr >@ stdout }
 # reacted as expected; and then we perform the other unit tests.
 catch { exec {*}$argv ./test_engine $filename 2>@ stderr >@ stdout }
 
+# The unit tests are run again with a page cache arena configured, so that
+# they exercise it; the atomicity test is skipped in this run.
+catch { exec {*}$argv ./test_engine --page-cache-arena 2>@ stderr >@ stdout }
+
 # And clean up left over files
 catch { file delete $filename }
 catch { file delete ${filename}-journal }
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "chunked_migration.hpp"
+#include "database_connection.hpp"
+#include "database_transaction.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cstddef>
+
+namespace sqloxx
+{
+namespace tests
+{
+
+namespace
+{
+    boost::filesystem::path const chunked_migration_filepath
+    (   "Testfile_chunked_migration"
+    );
+
+    void create_people(DatabaseConnection& dbc, int rows)
+    {
+        dbc.execute_sql
+        (   "create table people(person_id integer primary key, name text)"
+        );
+        DatabaseTransaction transaction(dbc);
+        SQLStatement insertion(dbc, "insert into people(name) values('Bob')");
+        for (int i = 0; i != rows; ++i)
+        {
+            insertion.step_final();
+            insertion.reset();
+        }
+        transaction.commit();
+        return;
+    }
+
+    // A policy with chunks of fixed size.
+    ChunkedMigrationPolicy fixed_policy(std::size_t p_chunk_rows)
+    {
+        ChunkedMigrationPolicy ret;
+        ret.initial_chunk_rows = p_chunk_rows;
+        ret.min_chunk_rows = p_chunk_rows;
+        ret.max_chunk_rows = p_chunk_rows;
+        return ret;
+    }
+
+    // Rebuilds "people" with an additional "visits" column, counting the
+    // visits to each row.
+    ChunkedMigration rebuild_people()
+    {
+        ChunkedMigration ret
+        (   "rebuild_people",
+            "people",
+            "person_id",
+            "insert into people_new(person_id, name, visits) "
+            "select person_id, name, 1 from people "
+            "where person_id > :low and person_id <= :high",
+            fixed_policy(40)
+        );
+        ret.set_setup
+        (   [](DatabaseConnection& p_connection)
+            {
+                p_connection.execute_sql
+                (   "create table people_new(person_id integer primary key, "
+                    "name text, visits integer not null)"
+                );
+            }
+        );
+        ret.set_cutover
+        (   [](DatabaseConnection& p_connection)
+            {
+                p_connection.execute_sql("drop table people");
+                p_connection.execute_sql
+                (   "alter table people_new rename to people"
+                );
+            }
+        );
+        return ret;
+    }
+
+}  // end anonymous namespace
+
+TEST(chunked_migration_backfills_in_chunks)
+{
+    abort_if_exists(chunked_migration_filepath);
+    {
+        DatabaseConnection dbc;
+        dbc.open(chunked_migration_filepath);
+        create_people(dbc, 250);
+        ChunkedMigration migration
+        (   "lower_names",
+            "people",
+            "person_id",
+            "update people set name_lower = lower(name) "
+            "where person_id > :low and person_id <= :high",
+            fixed_policy(100)
+        );
+        migration.set_setup
+        (   [](DatabaseConnection& p_connection)
+            {
+                p_connection.execute_sql
+                (   "alter table people add column name_lower text"
+                );
+            }
+        );
+        migration.set_cutover
+        (   [](DatabaseConnection& p_connection)
+            {
+                p_connection.execute_sql
+                (   "create index people_name_lower on people(name_lower)"
+                );
+            }
+        );
+        CHECK(!ChunkedMigration::is_complete(dbc, "lower_names"));
+        CHECK(migration.step(dbc));  // setup
+        CHECK_EQUAL(migration.stats().chunks, 0U);
+        CHECK(migration.step(dbc));
+        CHECK_EQUAL
+        (   query_scalar(dbc, "select count(*) from people where name_lower = 'bob'"),
+            100
+        );
+        CHECK(migration.step(dbc));
+        CHECK(migration.step(dbc));
+        CHECK_EQUAL(migration.stats().chunks, 3U);
+        CHECK(!ChunkedMigration::is_complete(dbc, "lower_names"));
+        CHECK(!migration.step(dbc));  // cutover
+        CHECK(ChunkedMigration::is_complete(dbc, "lower_names"));
+        CHECK(!migration.step(dbc));
+        CHECK_EQUAL
+        (   query_scalar(dbc, "select count(*) from people where name_lower = 'bob'"),
+            250
+        );
+        CHECK_EQUAL
+        (   query_scalar
+            (   dbc,
+                "select count(*) from sqlite_master "
+                "where name = 'people_name_lower'"
+            ),
+            1
+        );
+        CHECK_EQUAL(migration.stats().chunks, 3U);
+    }
+    boost::filesystem::remove(chunked_migration_filepath);
+}
+
+TEST(chunked_migration_resumes_from_checkpoint)
+{
+    abort_if_exists(chunked_migration_filepath);
+    {
+        DatabaseConnection dbc;
+        dbc.open(chunked_migration_filepath);
+        create_people(dbc, 130);
+        ChunkedMigration migration = rebuild_people();
+        CHECK(migration.step(dbc));
+        CHECK(migration.step(dbc));
+        CHECK(migration.step(dbc));
+
+        // Simulate a crash part way through a chunk.
+        DatabaseTransaction transaction(dbc);
+        dbc.execute_sql
+        (   "update sqloxx_chunked_migrations set last_key = 1000"
+        );
+        dbc.execute_sql("delete from people_new");
+    }
+    {
+        DatabaseConnection dbc;
+        dbc.open(chunked_migration_filepath);
+        CHECK_EQUAL(query_scalar(dbc, "select count(*) from people_new"), 80);
+        ChunkedMigration migration = rebuild_people();
+        migration.run(dbc);
+        CHECK(ChunkedMigration::is_complete(dbc, "rebuild_people"));
+        CHECK_EQUAL(migration.stats().chunks, 2U);
+        CHECK_EQUAL(query_scalar(dbc, "select count(*) from people"), 130);
+        CHECK_EQUAL(query_scalar(dbc, "select max(visits) from people"), 1);
+        CHECK_EQUAL(query_scalar(dbc, "select min(visits) from people"), 1);
+        CHECK_EQUAL
+        (   query_scalar
+            (   dbc,
+                "select count(*) from sqlite_master where name = 'people_new'"
+            ),
+            0
+        );
+    }
+    boost::filesystem::remove(chunked_migration_filepath);
+}
+
+TEST(chunked_migration_refuses_enclosing_transaction)
+{
+    abort_if_exists(chunked_migration_filepath);
+    {
+        DatabaseConnection dbc;
+        dbc.open(chunked_migration_filepath);
+        create_people(dbc, 10);
+        ChunkedMigration migration = rebuild_people();
+        DatabaseTransaction transaction(dbc);
+        CHECK_THROW(migration.step(dbc), LogicError);
+        transaction.cancel();
+        CHECK(!ChunkedMigration::is_complete(dbc, "rebuild_people"));
+    }
+    boost::filesystem::remove(chunked_migration_filepath);
+}
+
+TEST(chunked_migration_adapts_chunk_size)
+{
+    ChunkedMigrationPolicy policy;
+    policy.initial_chunk_rows = 10;
+    policy.min_chunk_rows = 10;
+    policy.max_chunk_rows = 35;
+    policy.target_chunk_time = std::chrono::hours(1);
+    abort_if_exists(chunked_migration_filepath);
+    {
+        DatabaseConnection dbc;
+        dbc.open(chunked_migration_filepath);
+        create_people(dbc, 100);
+        ChunkedMigration migration
+        (   "noop",
+            "people",
+            "person_id",
+            "update people set name = name "
+            "where person_id > :low and person_id <= :high",
+            policy
+        );
+        CHECK_EQUAL(migration.stats().chunk_rows, 10U);
+        migration.step(dbc);
+        migration.step(dbc);
+        CHECK_EQUAL(migration.stats().chunk_rows, 20U);
+        migration.run(dbc);
+
+        // Chunks of 10, 20, 35 and the remaining 35.
+        CHECK_EQUAL(migration.stats().chunks, 4U);
+        CHECK_EQUAL(migration.stats().chunk_rows, 35U);
+    }
+    boost::filesystem::remove(chunked_migration_filepath);
+}
+
+}  // namespace tests
+}  // namespace sqloxx
@@ -0,0 +1,197 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "codec.hpp"
+#include "database_connection.hpp"
+#include "fixed_point.hpp"
+#include "result_cache.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <boost/uuid/uuid.hpp>
+#include <jewel/decimal.hpp>
+#include <jewel/decimal_exceptions.hpp>
+#include <chrono>
+#include <string>
+
+using boost::uuids::uuid;
+using jewel::Decimal;
+using jewel::DecimalRangeException;
+using std::chrono::microseconds;
+using std::chrono::system_clock;
+using std::chrono::time_point;
+using std::string;
+
+namespace sqloxx
+{
+
+// A user-defined type with its own Codec, stored as text.
+namespace tests
+{
+    enum class Colour
+    {
+        red,
+        green
+    };
+
+}  // namespace tests
+
+template <>
+struct Codec<tests::Colour>
+{
+    typedef std::string Stored;
+    static std::string encode(tests::Colour p_value)
+    {
+        return p_value == tests::Colour::red? "red": "green";
+    }
+    static tests::Colour decode(std::string const& p_stored)
+    {
+        return p_stored == "red"? tests::Colour::red: tests::Colour::green;
+    }
+};
+
+namespace tests
+{
+
+namespace
+{
+    typedef time_point<system_clock, microseconds> TimePoint;
+
+    uuid make_uuid()
+    {
+        uuid ret;
+        for (uuid::size_type i = 0; i != ret.size(); ++i)
+        {
+            ret.data[i] = static_cast<uuid::value_type>(i * 17);
+        }
+        return ret;
+    }
+
+}  // end anonymous namespace
+
+TEST_FIXTURE(DatabaseConnectionFixture, codec_blob)
+{
+    DatabaseConnection& dbc = *pdbc;
+    dbc.execute_sql("create table dummy(dummy_id integer primary key, b)");
+    Blob const blob{0, 1, 2, 255, 0};
+    SQLStatement insertion(dbc, "insert into dummy(b) values(:b)");
+    insertion.bind(":b", blob);
+    insertion.step_final();
+    insertion.reset();
+    insertion.bind(":b", Blob());
+    insertion.step_final();
+    SQLStatement selection
+    (   dbc,
+        "select b, typeof(b) from dummy order by dummy_id"
+    );
+    CHECK(selection.step());
+    CHECK(selection.extract<Blob>(0) == blob);
+    CHECK(selection.step());
+
+    // An empty blob is not NULL.
+    CHECK(selection.extract<Blob>(0).empty());
+    CHECK_EQUAL(selection.extract<string>(1), "blob");
+    CHECK_THROW(selection.extract<string>(0), ValueTypeException);
+    CHECK(!selection.step());
+}
+
+TEST_FIXTURE(DatabaseConnectionFixture, codec_builtin_types)
+{
+    DatabaseConnection& dbc = *pdbc;
+    dbc.execute_sql
+    (   "create table dummy(dummy_id integer primary key, u, t, d, c)"
+    );
+    uuid const u = make_uuid();
+    TimePoint const t(microseconds(1382054400123456LL));
+    FixedPoint<2> const d(-12345);
+    SQLStatement insertion
+    (   dbc,
+        "insert into dummy(u, t, d, c) values(:u, :t, :d, :c)"
+    );
+    insertion.bind(":u", u);
+    insertion.bind(":t", t);
+    insertion.bind(":d", d);
+    insertion.bind(":c", Colour::green);
+    insertion.step_final();
+
+    // Stored compactly, in the native types.
+    SQLStatement types
+    (   dbc,
+        "select typeof(u), length(u), typeof(t), t, typeof(d), d, c "
+        "from dummy"
+    );
+    CHECK(types.step());
+    CHECK_EQUAL(types.extract<string>(0), "blob");
+    CHECK_EQUAL(types.extract<int>(1), 16);
+    CHECK_EQUAL(types.extract<string>(2), "integer");
+    CHECK_EQUAL(types.extract<long long>(3), 1382054400123456LL);
+    CHECK_EQUAL(types.extract<string>(4), "integer");
+    CHECK_EQUAL(types.extract<long long>(5), -12345);
+    CHECK_EQUAL(types.extract<string>(6), "green");
+    types.reset();
+
+    SQLStatement selection(dbc, "select u, t, d, c from dummy where u = :u");
+    selection.bind(":u", u);
+    CHECK(selection.step());
+    CHECK(selection.extract<uuid>(0) == u);
+    CHECK(selection.extract<TimePoint>(1) == t);
+    CHECK(selection.extract<FixedPoint<2> >(2) == d);
+    CHECK(selection.extract<Colour>(3) == Colour::green);
+    CHECK_THROW(selection.extract<uuid>(1), ValueTypeException);
+    selection.reset();
+
+    dbc.execute_sql("update dummy set u = x'0102'");
+    SQLStatement truncated(dbc, "select u from dummy");
+    CHECK(truncated.step());
+    CHECK_THROW(truncated.extract<uuid>(0), ValueTypeException);
+}
+
+TEST(codec_fixed_point_decimal)
+{
+    FixedPoint<2> const d(-12345);
+    CHECK(d.to_decimal() == Decimal(-12345, 2));
+    CHECK_EQUAL(d.to_decimal().places(), 2);
+    CHECK(FixedPoint<2>(Decimal(-12345, 2)) == d);
+    CHECK(FixedPoint<2>(Decimal(-1234, 1)) == FixedPoint<2>(-12340));
+    CHECK(FixedPoint<2>(Decimal(-123454, 3)) == d);
+    CHECK(FixedPoint<0>(Decimal(7, 0)).to_decimal() == Decimal(7, 0));
+    CHECK_THROW(FixedPoint<18>(Decimal(10, 0)), DecimalRangeException);
+}
+
+TEST_FIXTURE(DatabaseConnectionFixture, codec_blob_result_cache)
+{
+    DatabaseConnection& dbc = *pdbc;
+    dbc.enable_result_cache();
+    dbc.execute_sql("create table dummy(dummy_id integer primary key, u)");
+    uuid const u = make_uuid();
+    SQLStatement insertion(dbc, "insert into dummy(u) values(:u)");
+    insertion.bind(":u", u);
+    insertion.step_final();
+    for (int i = 0; i != 2; ++i)
+    {
+        SQLStatement selection(dbc, "select u from dummy where u = :u");
+        selection.enable_result_cache();
+        selection.bind(":u", u);
+        CHECK(selection.step());
+        CHECK(selection.extract<uuid>(0) == u);
+        CHECK(!selection.step());
+    }
+    CHECK_EQUAL(dbc.result_cache().stats().hits, 1U);
+}
+
+}  // namespace tests
+}  // namespace sqloxx
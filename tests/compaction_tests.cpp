@@ -0,0 +1,215 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compaction.hpp"
+#include "database_connection.hpp"
+#include "database_transaction.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <boost/filesystem.hpp>
+#include <cstddef>
+#include <string>
+
+using std::size_t;
+using std::string;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+namespace
+{
+    boost::filesystem::path const compaction_filepath
+    (   "Testfile_compaction"
+    );
+
+    // Creates a table of 2000 rows and deletes every other one, leaving
+    // the table fragmented and pages on the free list.
+    void create_fragmented_table(DatabaseConnection& dbc)
+    {
+        dbc.execute_sql
+        (   "create table dummy(dummy_id integer primary key, data blob)"
+        );
+        DatabaseTransaction transaction(dbc);
+        SQLStatement insertion
+        (   dbc,
+            "insert into dummy(data) values(zeroblob(500))"
+        );
+        for (int i = 0; i != 2000; ++i)
+        {
+            insertion.step_final();
+            insertion.reset();
+        }
+        dbc.execute_sql("delete from dummy where dummy_id % 2 = 0");
+        transaction.commit();
+        return;
+    }
+
+    void check_compacted
+    (   DatabaseConnection& dbc,
+        CompactionStats const& stats
+    )
+    {
+        CHECK(stats.free_pages_before > 0);
+        CHECK_EQUAL(stats.free_pages_after, 0);
+        CHECK(stats.pages_after < stats.pages_before);
+        CHECK_EQUAL(query_scalar(dbc, "pragma page_count"), stats.pages_after);
+        SQLStatement check(dbc, "pragma integrity_check");
+        check.step();
+        CHECK_EQUAL(check.extract<string>(0), "ok");
+        CHECK_EQUAL(query_scalar(dbc, "select count(*) from dummy"), 1000);
+        CHECK
+        (   !boost::filesystem::exists
+            (   compaction_filepath.string() + "-compact"
+            )
+        );
+        return;
+    }
+
+}  // end anonymous namespace
+
+TEST(compaction_rollback_journal)
+{
+    abort_if_exists(compaction_filepath);
+    {
+        DatabaseConnection dbc;
+        dbc.open(compaction_filepath);
+        create_fragmented_table(dbc);
+        DatabaseConnection other;
+        other.open(compaction_filepath);
+        CHECK_EQUAL(query_scalar(other, "select count(*) from dummy"), 1000);
+
+        CompactionStats const stats = compact_database(dbc);
+        check_compacted(dbc, stats);
+        CHECK_EQUAL(stats.discarded_copies, 0U);
+
+        // Other connections see the compacted database without reopening,
+        // and can go on writing to it.
+        CHECK_EQUAL(query_scalar(other, "pragma freelist_count"), 0);
+        CHECK_EQUAL(query_scalar(other, "select count(*) from dummy"), 1000);
+        other.execute_sql("insert into dummy(data) values(zeroblob(10))");
+        CHECK_EQUAL(query_scalar(dbc, "select count(*) from dummy"), 1001);
+    }
+    boost::filesystem::remove(compaction_filepath);
+}
+
+TEST(compaction_write_ahead_log_with_change_tracking)
+{
+    abort_if_exists(compaction_filepath);
+    {
+        DatabaseConnection dbc;
+        dbc.open(compaction_filepath);
+        dbc.execute_sql("pragma journal_mode = wal");
+        dbc.enable_change_tracking();
+        create_fragmented_table(dbc);
+        DatabaseConnection other;
+        other.open(compaction_filepath);
+        other.enable_change_tracking();
+        CHECK_EQUAL(query_scalar(other, "select count(*) from dummy"), 1000);
+
+        CompactionStats const stats = compact_database(dbc);
+        check_compacted(dbc, stats);
+        CHECK_EQUAL(stats.discarded_copies, 0U);
+        SQLStatement journal_mode(dbc, "pragma journal_mode");
+        journal_mode.step();
+        CHECK_EQUAL(journal_mode.extract<string>(0), "wal");
+        journal_mode.reset();
+
+        DatabaseTransaction transaction(other);
+        CHECK_EQUAL(query_scalar(other, "select count(*) from dummy"), 1000);
+        other.execute_sql("insert into dummy(data) values(zeroblob(10))");
+        transaction.commit();
+        CHECK_EQUAL(query_scalar(dbc, "select count(*) from dummy"), 1001);
+    }
+    remove_database(compaction_filepath);
+}
+
+TEST(compaction_discards_copy_after_concurrent_commit)
+{
+    abort_if_exists(compaction_filepath);
+    for (int is_wal = 0; is_wal != 2; ++is_wal)
+    {
+        {
+            DatabaseConnection dbc;
+            dbc.open(compaction_filepath);
+            if (is_wal)
+            {
+                dbc.execute_sql("pragma journal_mode = wal");
+            }
+            create_fragmented_table(dbc);
+            dbc.execute_sql
+            (   "create table keyed(keyed_id integer primary key) "
+                "without rowid"
+            );
+            dbc.execute_sql("insert into keyed(keyed_id) values(1)");
+
+            // Neither connection tracks changes. On the first copy only,
+            // the other connection commits, in autocommit mode, an
+            // unqualified delete from a table without rowids and an
+            // insertion; the copy must then be discarded, lest these be
+            // lost.
+            DatabaseConnection other;
+            other.open(compaction_filepath);
+            CompactionPolicy policy;
+            policy.copy_callback = [&other](size_t p_copies)
+            {
+                if (p_copies == 1)
+                {
+                    other.execute_sql("delete from keyed");
+                    other.execute_sql
+                    (   "insert into dummy(data) values(zeroblob(10))"
+                    );
+                }
+                return;
+            };
+            CompactionStats const stats = compact_database(dbc, policy);
+            CHECK_EQUAL(stats.discarded_copies, 1U);
+            CHECK_EQUAL(stats.free_pages_after, 0);
+            CHECK(stats.pages_after < stats.pages_before);
+            SQLStatement check(dbc, "pragma integrity_check");
+            check.step();
+            CHECK_EQUAL(check.extract<string>(0), "ok");
+            check.reset();
+            CHECK_EQUAL(query_scalar(dbc, "select count(*) from dummy"), 1001);
+            CHECK_EQUAL(query_scalar(other, "select count(*) from dummy"), 1001);
+            CHECK_EQUAL(query_scalar(dbc, "select count(*) from keyed"), 0);
+        }
+        remove_database(compaction_filepath);
+    }
+}
+
+TEST(compaction_in_transaction)
+{
+    abort_if_exists(compaction_filepath);
+    {
+        DatabaseConnection dbc;
+        dbc.open(compaction_filepath);
+        create_fragmented_table(dbc);
+        DatabaseTransaction transaction(dbc);
+        CHECK_THROW(compact_database(dbc), LogicError);
+        transaction.commit();
+        CompactionPolicy policy;
+        policy.max_online_attempts = 0;
+        check_compacted(dbc, compact_database(dbc, policy));
+    }
+    boost::filesystem::remove(compaction_filepath);
+}
+
+}  // namespace tests
+}  // namespace sqloxx
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "connection_manager.hpp"
+#include "database_connection.hpp"
+#include "example.hpp"
+#include "info.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <boost/filesystem.hpp>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>
+
+using std::size_t;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::unique_ptr;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+namespace
+{
+    boost::filesystem::path tenant_filepath(int p_tenant)
+    {
+        return
+            boost::filesystem::path("Testfile_tenant_" + to_string(p_tenant));
+    }
+
+    void remove_tenant_files(int p_tenants)
+    {
+        for (int i = 0; i != p_tenants; ++i)
+        {
+            remove_database(tenant_filepath(i));
+        }
+        return;
+    }
+
+    // Records, on destruction, how many connections its manager reports
+    // open; which it can only do if the manager does not hold its lock
+    // while closing connections.
+    class ObservingConnection: public DatabaseConnection
+    {
+    public:
+        ObservingConnection
+        (   ConnectionManager const* const& p_manager,
+            size_t& p_open_when_destroyed
+        ):
+            m_manager(p_manager),
+            m_open_when_destroyed(p_open_when_destroyed)
+        {
+        }
+        ~ObservingConnection()
+        {
+            m_open_when_destroyed = m_manager->stats().open_connections;
+        }
+    private:
+        ConnectionManager const* const& m_manager;
+        size_t& m_open_when_destroyed;
+    };
+
+}  // end anonymous namespace
+
+TEST(connection_manager_evicts_least_recently_used)
+{
+    ConnectionManagerPolicy policy;
+    policy.max_connections = 2;
+    {
+        ConnectionManager manager(policy);
+        CHECK_EQUAL(manager.capacity(), 2U);
+        DatabaseConnection* first = nullptr;
+        {
+            ConnectionManager::Lease lease = manager.lease(tenant_filepath(0));
+            first = &lease.connection();
+            CHECK(first->is_valid());
+            first->execute_sql("create table dummy(dummy_id integer)");
+        }
+        {
+            ConnectionManager::Lease lease = manager.lease(tenant_filepath(0));
+            CHECK_EQUAL(&lease.connection(), first);
+        }
+        manager.lease(tenant_filepath(1));
+        manager.lease(tenant_filepath(0));
+
+        // Tenant 1 is now the least recently used, so is closed to make
+        // room for tenant 2.
+        manager.lease(tenant_filepath(2));
+        manager.lease(tenant_filepath(0));
+        ConnectionManager::Stats stats = manager.stats();
+        CHECK_EQUAL(stats.misses, 3U);
+        CHECK_EQUAL(stats.hits, 3U);
+        CHECK_EQUAL(stats.opens, 3U);
+        CHECK_EQUAL(stats.evictions, 1U);
+        CHECK_EQUAL(stats.open_connections, 2U);
+        CHECK(stats.max_open_latency >= stats.last_open_latency);
+
+        manager.lease(tenant_filepath(1));
+        stats = manager.stats();
+        CHECK_EQUAL(stats.misses, 4U);
+        CHECK_EQUAL(stats.evictions, 2U);
+
+        CHECK(manager.close(tenant_filepath(1)));
+        CHECK(!manager.close(tenant_filepath(1)));
+        CHECK_EQUAL(manager.stats().open_connections, 1U);
+    }
+    remove_tenant_files(3);
+}
+
+TEST(connection_manager_file_handle_budget)
+{
+    ConnectionManagerPolicy policy;
+    policy.max_connections = 10;
+    policy.max_file_handles = 7;
+    policy.file_handles_per_connection = 3;
+    ConnectionManager const manager(policy);
+    CHECK_EQUAL(manager.capacity(), 2U);
+    policy.max_file_handles = 2;
+    CHECK_THROW(ConnectionManager failing(policy), LogicError);
+}
+
+TEST(connection_manager_waits_for_leased_connections)
+{
+    if (!Info::sqlite_is_thread_safe())
+    {
+        return;  // Connections cannot then be used on other threads.
+    }
+    ConnectionManagerPolicy policy;
+    policy.max_connections = 2;
+    {
+        ConnectionManager manager(policy);
+        unique_ptr<ConnectionManager::Lease> lease_0
+        (   new ConnectionManager::Lease(manager.lease(tenant_filepath(0)))
+        );
+        ConnectionManager::Lease lease_1 = manager.lease(tenant_filepath(1));
+        bool is_leased = false;
+        thread waiter
+        (   [&manager, &is_leased]()
+            {
+                ConnectionManager::Lease lease =
+                    manager.lease(tenant_filepath(2));
+                is_leased = lease.connection().is_valid();
+            }
+        );
+        while (manager.stats().waits == 0)
+        {
+            std::this_thread::yield();
+        }
+        lease_0.reset();
+        waiter.join();
+        CHECK(is_leased);
+        ConnectionManager::Stats const stats = manager.stats();
+        CHECK_EQUAL(stats.evictions, 1U);
+        CHECK_EQUAL(stats.open_connections, 2U);
+    }
+    remove_tenant_files(3);
+}
+
+TEST(connection_manager_factory)
+{
+    int created = 0;
+    {
+        ConnectionManager manager
+        (   ConnectionManagerPolicy(),
+            OpenOptions(),
+            [&created]()
+            {
+                ++created;
+                return unique_ptr<DatabaseConnection>
+                (   new DerivedDatabaseConnection
+                );
+            }
+        );
+        ConnectionManager::Lease lease = manager.lease(tenant_filepath(0));
+        CHECK
+        (   dynamic_cast<DerivedDatabaseConnection*>(&lease.connection())
+        );
+    }
+    CHECK_EQUAL(created, 1);
+    remove_tenant_files(1);
+}
+
+TEST(connection_manager_closes_outside_lock)
+{
+    ConnectionManagerPolicy policy;
+    policy.max_connections = 1;
+    size_t open_when_destroyed = 99;
+    {
+        ConnectionManager const* manager_pointer = nullptr;
+        ConnectionManager manager
+        (   policy,
+            OpenOptions(),
+            [&manager_pointer, &open_when_destroyed]()
+            {
+                return unique_ptr<DatabaseConnection>
+                (   new ObservingConnection
+                    (   manager_pointer,
+                        open_when_destroyed
+                    )
+                );
+            }
+        );
+        manager_pointer = &manager;
+        manager.lease(tenant_filepath(0));
+
+        // Evicts tenant 0.
+        manager.lease(tenant_filepath(1));
+        CHECK_EQUAL(open_when_destroyed, 0U);
+
+        open_when_destroyed = 99;
+        CHECK(manager.close(tenant_filepath(1)));
+        CHECK_EQUAL(open_when_destroyed, 0U);
+    }
+    remove_tenant_files(2);
+}
+
+}  // namespace tests
+}  // namespace sqloxx
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "connection_router.hpp"
+#include "database_connection.hpp"
+#include "info.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <boost/filesystem.hpp>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+using std::atomic;
+using std::future;
+using std::thread;
+using std::vector;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+namespace
+{
+    boost::filesystem::path const router_filepath("Testfile_router");
+
+    int count_rows(ConnectionRouter& p_router)
+    {
+        int ret = -1;
+        p_router.execute
+        (   "select count(*) from dummy",
+            [&ret](SQLStatement& p_statement)
+            {
+                p_statement.step();
+                ret = p_statement.extract<int>(0);
+                p_statement.reset();
+            }
+        ).get();
+        return ret;
+    }
+
+    void insert_row(ConnectionRouter& p_router, int p_value)
+    {
+        p_router.execute
+        (   "insert into dummy(value) values(:value)",
+            [p_value](SQLStatement& p_statement)
+            {
+                p_statement.bind(":value", p_value);
+                p_statement.step_final();
+            }
+        ).get();
+        return;
+    }
+
+}  // end anonymous namespace
+
+TEST(connection_router_routes_by_statement)
+{
+    if (!Info::sqlite_is_thread_safe())
+    {
+        return;  // See connection_router_requires_thread_safe_sqlite.
+    }
+    abort_if_exists(router_filepath);
+    {
+        ConnectionRouter router(router_filepath, 2);
+        CHECK_EQUAL(router.readers(), 2U);
+        router.submit_write
+        (   [](DatabaseConnection& p_writer)
+            {
+                p_writer.execute_sql
+                (   "create table dummy"
+                    "(dummy_id integer primary key, value integer)"
+                );
+            }
+        ).get();
+        insert_row(router, 1);
+        insert_row(router, 2);
+        CHECK_EQUAL(count_rows(router), 2);
+
+        ConnectionRouter::Stats const stats = router.stats();
+        CHECK_EQUAL(stats.writes, 3U);
+        CHECK_EQUAL(stats.reads, 1U);
+        CHECK_EQUAL(stats.backlog, 0U);
+
+        // Reader connections cannot write, even directly.
+        ConnectionRouter::ReaderLease lease = router.lease_reader();
+        CHECK_THROW
+        (   lease.connection().execute_sql
+            (   "insert into dummy(value) values(3)"
+            ),
+            SQLiteException
+        );
+    }
+    remove_database(router_filepath);
+}
+
+TEST(connection_router_propagates_exceptions)
+{
+    if (!Info::sqlite_is_thread_safe())
+    {
+        return;  // See connection_router_requires_thread_safe_sqlite.
+    }
+    abort_if_exists(router_filepath);
+    {
+        ConnectionRouter router(router_filepath, 1);
+        future<void> failed = router.submit_write
+        (   [](DatabaseConnection& p_writer)
+            {
+                p_writer.execute_sql("insert into no_such_table values(1)");
+            }
+        );
+        CHECK_THROW(failed.get(), SQLiteException);
+        CHECK_THROW
+        (   router.execute
+            (   "select * from no_such_table",
+                [](SQLStatement&) {}
+            ),
+            SQLiteException
+        );
+    }
+    remove_database(router_filepath);
+    CHECK_THROW(ConnectionRouter(router_filepath, 0), LogicError);
+}
+
+TEST(connection_router_concurrent_readers)
+{
+    if (!Info::sqlite_is_thread_safe())
+    {
+        return;  // See connection_router_requires_thread_safe_sqlite.
+    }
+    abort_if_exists(router_filepath);
+    {
+        ConnectionRouter router(router_filepath, 2);
+        router.submit_write
+        (   [](DatabaseConnection& p_writer)
+            {
+                p_writer.execute_sql
+                (   "create table dummy"
+                    "(dummy_id integer primary key, value integer)"
+                );
+            }
+        ).get();
+        int const writes = 50;
+        atomic<bool> writing(true);
+        atomic<int> errors(0);
+        vector<thread> readers;
+        for (int i = 0; i != 4; ++i)
+        {
+            readers.push_back
+            (   thread
+                (   [&router, &writing, &errors]()
+                    {
+                        int last = 0;
+                        while (writing)
+                        {
+                            int const count = count_rows(router);
+                            if (count < last) ++errors;
+                            last = count;
+                        }
+                    }
+                )
+            );
+        }
+        vector<future<void> > pending;
+        for (int i = 0; i != writes; ++i)
+        {
+            pending.push_back
+            (   router.submit_write
+                (   [i](DatabaseConnection& p_writer)
+                    {
+                        SQLStatement statement
+                        (   p_writer,
+                            "insert into dummy(value) values(:value)"
+                        );
+                        statement.bind(":value", i);
+                        statement.step_final();
+                    }
+                )
+            );
+        }
+        for (auto& write: pending)
+        {
+            write.get();
+        }
+        writing = false;
+        for (auto& reader: readers)
+        {
+            reader.join();
+        }
+        CHECK_EQUAL(errors, 0);
+        CHECK_EQUAL(count_rows(router), writes);
+    }
+    remove_database(router_filepath);
+}
+
+TEST(connection_router_requires_thread_safe_sqlite)
+{
+    if (Info::sqlite_is_thread_safe())
+    {
+        return;
+    }
+    abort_if_exists(router_filepath);
+    CHECK_THROW(ConnectionRouter(router_filepath, 1), LogicError);
+    CHECK(!file_exists(router_filepath));
+}
+
+}  // namespace tests
+}  // namespace sqloxx
@@ -15,6 +15,8 @@
  */
 
 #include "database_connection.hpp"
+#include "database_transaction.hpp"
+#include "open_options.hpp"
 #include "sql_statement.hpp"
 #include "sqloxx_exceptions.hpp"
 #include "sqloxx_tests_common.hpp"
@@ -28,6 +30,7 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 using std::cerr;
 using std::endl;
@@ -37,6 +40,7 @@ using std::multiset;
 using std::set;
 using std::shared_ptr;
 using std::string;
+using std::vector;
 
 namespace sqloxx
 {
@@ -168,11 +172,189 @@ TEST_FIXTURE(DatabaseConnectionFixture, test_setup_boolean_table)
     CHECK_THROW(invaliddb.setup_boolean_table(), InvalidConnection);
 }
 
+TEST_FIXTURE(DatabaseConnectionFixture, test_change_tracking)
+{
+    DatabaseConnection& dbc = *pdbc;
+    CHECK_THROW(dbc.check_for_changes(), LogicError);
+    dbc.execute_sql("create table dummy(dummy_id integer primary key, x)");
+    dbc.enable_change_tracking();
+    vector<string> changed;
+    dbc.add_change_listener
+    (   [&changed](string const& p_table)
+        {
+            changed.push_back(p_table);
+        }
+    );
+    DatabaseConnection other;
+    other.open(db_filepath);
+    other.enable_change_tracking();
+    CHECK(!dbc.check_for_changes());
+    {
+        DatabaseTransaction transaction(other);
+        other.execute_sql("insert into dummy(x) values(1)");
+        transaction.commit();
+    }
+    CHECK(!other.check_for_changes());  // Its own change
+    CHECK(dbc.check_for_changes());
+    CHECK_EQUAL(changed.size(), 1U);
+    CHECK_EQUAL(changed.at(0), "dummy");
+    CHECK(!dbc.check_for_changes());
+
+    // Changes are checked for on beginning a transaction.
+    {
+        DatabaseTransaction transaction(other);
+        other.execute_sql("update dummy set x = 2");
+        transaction.commit();
+    }
+    {
+        DatabaseTransaction transaction(dbc);
+        CHECK_EQUAL(changed.size(), 2U);
+        transaction.commit();
+    }
+
+    // Cancelled writes are not published.
+    {
+        DatabaseTransaction transaction(other);
+        other.execute_sql("delete from dummy where x = 2");
+        transaction.cancel();
+    }
+    CHECK(!dbc.check_for_changes());
+
+    // Removed listeners are not called.
+    int const id = dbc.add_change_listener
+    (   [](string const&)
+        {
+            CHECK(false);
+        }
+    );
+    dbc.remove_change_listener(id);
+    {
+        DatabaseTransaction transaction(other);
+        other.execute_sql("delete from dummy where x = 2");
+        transaction.commit();
+    }
+    CHECK(dbc.check_for_changes());
+    CHECK_EQUAL(changed.size(), 3U);
+}
+
+TEST(test_storage_options)
+{
+    boost::filesystem::path const filepath("Testfile_storage_options");
+    abort_if_exists(filepath);
+    boost::filesystem::path const wal_filepath("Testfile_storage_options-wal");
+    {
+        OpenOptions options;
+        options.chunk_size = -1;
+        DatabaseConnection dbc;
+        CHECK_THROW(dbc.open(filepath, options), LogicError);
+        options.chunk_size = 0;
+        options.page_count_warning = 0;
+        CHECK_THROW(dbc.open(filepath, options), LogicError);
+        CHECK(!dbc.is_valid());
+    }
+    {
+        OpenOptions options;
+        options.persist_wal = true;
+        options.journal_size_limit = 65536;
+        DatabaseConnection dbc;
+        dbc.open(filepath, options);
+        SQLStatement limit(dbc, "pragma journal_size_limit");
+        limit.step();
+        CHECK_EQUAL(limit.extract<long long>(0), 65536);
+        dbc.execute_sql("pragma journal_mode = wal");
+        dbc.execute_sql("create table dummy(dummy_id integer primary key)");
+    }
+    // The WAL survives the closing of the last connection.
+    CHECK(boost::filesystem::exists(wal_filepath));
+    remove_database(filepath);
+}
+
+TEST(test_page_count_warning)
+{
+    boost::filesystem::path const filepath("Testfile_page_count_warning");
+    abort_if_exists(filepath);
+    {
+        int warnings = 0;
+        long long last_max_page_count = 0;
+        OpenOptions options;
+        options.max_page_count = 20;
+        options.page_count_warning = 0.5;
+        options.page_count_handler =
+            [&](long long p_page_count, long long p_max_page_count)
+            {
+                CHECK(p_page_count >= 10);
+                last_max_page_count = p_max_page_count;
+                ++warnings;
+            };
+        DatabaseConnection dbc;
+        dbc.open(filepath, options);
+        dbc.execute_sql("create table dummy(data blob)");
+        SQLStatement insertion
+        (   dbc,
+            "insert into dummy(data) values(zeroblob(2000))"
+        );
+        auto insert_row = [&]()
+        {
+            DatabaseTransaction transaction(dbc);
+            insertion.step_final();
+            insertion.reset();
+            transaction.commit();
+        };
+        for (int i = 0; i != 3; ++i) insert_row();
+        CHECK_EQUAL(warnings, 0);
+        for (int i = 0; i != 5; ++i) insert_row();
+        CHECK_EQUAL(warnings, 1);
+        CHECK_EQUAL(last_max_page_count, 20);
+
+        // The limit itself is enforced by SQLite. (A statement failing
+        // with SQLITE_FULL may roll back the enclosing transaction, so
+        // these are made outside of one.)
+        bool is_full = false;
+        for (int i = 0; (i != 20) && !is_full; ++i)
+        {
+            try
+            {
+                insertion.step_final();
+                insertion.reset();
+            }
+            catch (SQLiteFull&)
+            {
+                insertion.reset();
+                is_full = true;
+            }
+        }
+        CHECK(is_full);
+        CHECK_EQUAL(warnings, 1);
+
+        // Once the database has shrunk below the threshold, the warning is
+        // rearmed.
+        dbc.execute_sql("delete from dummy");
+        dbc.execute_sql("vacuum");
+        insert_row();
+        CHECK_EQUAL(warnings, 1);
+        for (int i = 0; i != 8; ++i) insert_row();
+        CHECK_EQUAL(warnings, 2);
+    }
+    boost::filesystem::remove(filepath);
+}
+
 TEST_FIXTURE(DatabaseConnectionFixture, self_test)
 {
     // Tests max_nesting()
     CHECK_EQUAL(pdbc->self_test(), 0);
 }
 
+TEST(database_connection_open_unregistered_vfs)
+{
+    boost::filesystem::path const filepath("Testfile_unregistered_vfs");
+    abort_if_exists(filepath);
+    OpenOptions options;
+    options.vfs = "no-such-vfs";
+    DatabaseConnection dbc;
+    CHECK_THROW(dbc.open(filepath, options), NoSuchVFS);
+    CHECK(!dbc.is_valid());
+    CHECK(!file_exists(filepath));
+}
+
 }  // namespace tests
 }  // namespace sqloxx
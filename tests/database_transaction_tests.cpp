@@ -19,6 +19,8 @@
 #include "sqloxx_exceptions.hpp"
 #include "sqloxx_tests_common.hpp"
 #include <UnitTest++/UnitTest++.h>
+#include <stdexcept>
+#include <string>
 
 namespace sqloxx
 {
@@ -221,6 +223,113 @@ TEST_FIXTURE(DatabaseConnectionFixture, test_cancel_transaction_B)
     CHECK_EQUAL(s3.step(), false);
 }
 
+TEST_FIXTURE(DatabaseConnectionFixture, test_transaction_callbacks_commit)
+{
+    std::string log;
+    DatabaseTransaction transaction1(*pdbc);
+    transaction1.on_commit([&log]() { log += "a"; });
+    transaction1.on_rollback([&log]() { log += "x"; });
+    DatabaseTransaction transaction2(*pdbc);
+    pdbc->on_commit([&log]() { log += "b"; });
+    transaction2.commit();
+    CHECK_EQUAL(log, "");
+    transaction1.on_commit([&log]() { log += "c"; });
+    transaction1.commit();
+    CHECK_EQUAL(log, "abc");
+    CHECK_THROW
+    (   transaction1.on_commit([&log]() { log += "d"; }),
+        TransactionNestingException
+    );
+
+    // Outside any transaction, on_commit callbacks run immediately and
+    // on_rollback callbacks are discarded.
+    pdbc->on_commit([&log]() { log += "e"; });
+    pdbc->on_rollback([&log]() { log += "y"; });
+    CHECK_EQUAL(log, "abce");
+}
+
+TEST_FIXTURE(DatabaseConnectionFixture, test_transaction_callbacks_rollback)
+{
+    std::string log;
+    DatabaseTransaction transaction1(*pdbc);
+    transaction1.on_commit([&log]() { log += "x"; });
+    transaction1.on_rollback([&log]() { log += "a"; });
+    {
+        DatabaseTransaction transaction2(*pdbc);
+        transaction2.on_commit([&log]() { log += "y"; });
+        transaction2.on_rollback([&log]() { log += "b"; });
+        transaction2.cancel();
+        CHECK_EQUAL(log, "b");
+        DatabaseTransaction transaction3(*pdbc);
+        transaction3.on_commit([&log]() { log += "z"; });
+        transaction3.on_rollback([&log]() { log += "c"; });
+        transaction3.commit();
+        CHECK_EQUAL(log, "b");
+
+        // Cancelled by destructor
+        DatabaseTransaction transaction4(*pdbc);
+        transaction4.on_rollback([&log]() { log += "d"; });
+    }
+    CHECK_EQUAL(log, "bd");
+    transaction1.cancel();
+    CHECK_EQUAL(log, "bdac");
+}
+
+TEST_FIXTURE(DatabaseConnectionFixture, test_transaction_callbacks_throwing)
+{
+    std::string log;
+    DatabaseTransaction transaction1(*pdbc);
+    pdbc->execute_sql("create table dummy(col_A)");
+    transaction1.on_commit
+    (   []() { throw std::runtime_error("Callback failed."); }
+    );
+    transaction1.on_commit([&log]() { log += "x"; });
+    CHECK_THROW(transaction1.commit(), std::runtime_error);
+    CHECK_EQUAL(log, "");
+
+    // The commit stands, and the remaining callback is discarded.
+    SQLStatement statement(*pdbc, "select * from dummy");
+    CHECK_EQUAL(statement.step(), false);
+    DatabaseTransaction transaction2(*pdbc);
+    transaction2.commit();
+    CHECK_EQUAL(log, "");
+
+    // Callbacks may begin further transactions.
+    DatabaseTransaction transaction3(*pdbc);
+    transaction3.on_commit
+    (   [this, &log]()
+        {
+            DatabaseTransaction transaction4(*pdbc);
+            pdbc->execute_sql("insert into dummy(col_A) values(1)");
+            transaction4.on_commit([&log]() { log += "a"; });
+            transaction4.commit();
+        }
+    );
+    transaction3.commit();
+    CHECK_EQUAL(log, "a");
+
+    // A throwing on_rollback callback, called by the destructor during
+    // unwinding, is dropped, and the remaining callbacks discarded.
+    bool is_caught = false;
+    try
+    {
+        DatabaseTransaction transaction5(*pdbc);
+        transaction5.on_rollback
+        (   []() { throw std::runtime_error("Callback failed."); }
+        );
+        transaction5.on_rollback([&log]() { log += "b"; });
+        throw std::logic_error("Unrelated failure.");
+    }
+    catch (std::logic_error&)
+    {
+        is_caught = true;
+    }
+    CHECK(is_caught);
+    CHECK_EQUAL(log, "a");
+    DatabaseTransaction transaction6(*pdbc);
+    transaction6.commit();
+}
+
 
 }  // namespace tests
 }  // namespace sqloxx
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "detail/deferred_log.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using std::ostream;
+using std::ostringstream;
+using std::string;
+using std::thread;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+using detail::DeferredLog;
+
+TEST(deferred_log_record_and_flush)
+{
+    ostringstream oss;
+    ostream* const original_sink = DeferredLog::set_sink(&oss);
+    DeferredLog::record
+    (   DeferredLog::trace,
+        "file_a.cpp",
+        10,
+        "function_a",
+        nullptr,
+        nullptr
+    );
+    thread other
+    (   []()
+        {
+            DeferredLog::record
+            (   DeferredLog::exception,
+                "file_b.cpp",
+                20,
+                "function_b",
+                "SomeException",
+                "Something went wrong."
+            );
+        }
+    );
+    other.join();
+
+    // Long messages are truncated.
+    string const long_message(1000, 'z');
+    DeferredLog::record
+    (   DeferredLog::exception,
+        "file_c.cpp",
+        30,
+        "function_c",
+        "OtherException",
+        long_message.c_str()
+    );
+    DeferredLog::flush();
+    DeferredLog::set_sink(original_sink);
+
+    string const output = oss.str();
+    CHECK(output.find("TRACE (function_a, file_a.cpp:10)") != string::npos);
+    CHECK
+    (   output.find
+        (   "EXCEPTION SomeException: Something went wrong. "
+            "(function_b, file_b.cpp:20)"
+        ) != string::npos
+    );
+    CHECK(output.find("OtherException: zzz") != string::npos);
+    CHECK(output.find(long_message) == string::npos);
+}
+
+TEST(deferred_log_null_sink)
+{
+    ostream* const original_sink = DeferredLog::set_sink(nullptr);
+    DeferredLog::record
+    (   DeferredLog::trace,
+        "file_d.cpp",
+        40,
+        "function_d",
+        nullptr,
+        nullptr
+    );
+    DeferredLog::flush();
+    CHECK(DeferredLog::set_sink(original_sink) == nullptr);
+}
+
+
+}  // namespace tests
+}  // namespace sqloxx
@@ -30,12 +30,21 @@
 #include "database_connection.hpp"
 #include "example.hpp"
 #include "handle.hpp"
+#include "key_traits.hpp"
 #include "persistent_object.hpp"
 #include "sql_statement.hpp"
 #include "sqloxx_tests_common.hpp"
+#include "statement_slot.hpp"
+#include "type_registry.hpp"
+#include <boost/any.hpp>
 #include <memory>
 #include <string>
+#include <tuple>
+#include <utility>
 
+using std::get;
+using std::make_tuple;
+using std::pair;
 using std::shared_ptr;
 using std::string;
 
@@ -154,10 +163,10 @@ ExampleA::set_y(double p_y)
 void
 ExampleA::do_load()
 {
-    SQLStatement selector
-    (   database_connection(),
-        "select x, y from example_as where example_a_id = :p"
+    static StatementSlot const slot
+    (   "select x, y from example_as where example_a_id = :p"
     );
+    SQLStatement selector(database_connection(), slot);
     selector.bind(":p", id());
     selector.step();
     int temp_x = selector.extract<int>(0);
@@ -171,10 +180,10 @@ ExampleA::do_load()
 void
 ExampleA::do_save_existing()
 {
-    SQLStatement updater
-    (   database_connection(),
-        "update example_as set x = :x, y = :y where example_a_id = :id"
+    static StatementSlot const slot
+    (   "update example_as set x = :x, y = :y where example_a_id = :id"
     );
+    SQLStatement updater(database_connection(), slot);
     updater.bind(":x", m_x);
     updater.bind(":y", m_y);
     updater.bind(":id", id());
@@ -185,16 +194,42 @@ ExampleA::do_save_existing()
 void
 ExampleA::do_save_new()
 {
-    SQLStatement inserter
-    (   database_connection(),
-        "insert into example_as(x, y) values(:x, :y)"
+    static StatementSlot const slot
+    (   "insert into example_as(x, y) values(:x, :y)"
     );
+    SQLStatement inserter(database_connection(), slot);
     inserter.bind(":x", m_x);
     inserter.bind(":y", m_y);
     inserter.step_final();
     return;
 }
 
+void
+ExampleA::do_load_row(SQLStatement& p_row, int p_first_column)
+{
+    int const temp_x = p_row.extract<int>(p_first_column);
+    double const temp_y = p_row.extract<double>(p_first_column + 1);
+    m_x = temp_x;
+    m_y = temp_y;
+    return;
+}
+
+boost::any
+ExampleA::do_snapshot() const
+{
+    return pair<int, double>(m_x, m_y);
+}
+
+void
+ExampleA::do_restore(boost::any const& p_snapshot)
+{
+    pair<int, double> const& snapshot =
+        boost::any_cast<pair<int, double> const&>(p_snapshot);
+    m_x = snapshot.first;
+    m_y = snapshot.second;
+    return;
+}
+
 string
 ExampleA::exclusive_table_name()
 {
@@ -207,6 +242,12 @@ ExampleA::primary_key_name()
     return "example_a_id";
 }
 
+string
+ExampleA::load_columns()
+{
+    return "x, y";
+}
+
 void
 ExampleB::setup_tables(DatabaseConnection& dbc)
 {
@@ -278,6 +319,19 @@ ExampleB::load_core()
     return;
 }
 
+string
+ExampleB::core_columns()
+{
+    return "s";
+}
+
+void
+ExampleB::load_core(SQLStatement& p_selector)
+{
+    m_s = p_selector.extract<string>(0);
+    return;
+}
+
 void
 ExampleB::save_existing_core()
 {
@@ -390,15 +444,19 @@ ExampleC::exclusive_table_name()
 void
 ExampleC::do_load()
 {
-    load_core();
-    SQLStatement selector
-    (   database_connection(),
-        "select p, q from example_cs where example_b_id = :p"
+    // Base and derived columns are loaded together, in a single select
+    // over the join of example_bs and example_cs.
+    static StatementSlot const slot
+    (   "select " + core_columns() + ", p, q from " +
+        TypeRegistry<ExampleC>::tag().join_text() +
+        " where example_b_id = :p"
     );
+    SQLStatement selector(database_connection(), slot);
     selector.bind(":p", id());
     selector.step();
-    m_p = selector.extract<int>(0);
-    m_q = selector.extract<int>(1);
+    load_core(selector);
+    m_p = selector.extract<int>(1);
+    m_q = selector.extract<int>(2);
     return;
 }
 
@@ -446,10 +504,368 @@ ExampleC::do_remove()
     return;
 }
 
+void
+ExampleD::setup_tables(DatabaseConnection& dbc)
+{
+    dbc.execute_sql
+    (   "create table example_ds"
+        "(example_d_id integer primary key autoincrement, "
+        "z integer not null)"
+    );
+    return;
+}
+
+ExampleD::ExampleD
+(   IdentityMap& p_identity_map,
+    IdentityMap::Signature const& p_sig
+):
+    DPersistentObject(p_identity_map),
+    m_z(0)
+{
+    (void)p_sig;  // silence compiler re. unused param.
+}
+
+ExampleD::ExampleD
+(   IdentityMap& p_identity_map,
+    Id p_id,
+    IdentityMap::Signature const& p_sig
+):
+    DPersistentObject(p_identity_map, p_id),
+    m_z(0)
+{
+    (void)p_sig;  // silence compiler re. unused param.
+}
+
+int
+ExampleD::z()
+{
+    load();
+    return m_z;
+}
+
+void
+ExampleD::set_z(int p_z)
+{
+    load();
+    m_z = p_z;
+    return;
+}
+
+void
+ExampleD::do_load()
+{
+    static StatementSlot const slot
+    (   "select z from example_ds where example_d_id = :p"
+    );
+    SQLStatement selector(database_connection(), slot);
+    selector.bind(":p", id());
+    selector.step();
+    int const temp_z = selector.extract<int>(0);
+    selector.step_final();
+    m_z = temp_z;
+    return;
+}
+
+void
+ExampleD::do_save_existing()
+{
+    static StatementSlot const slot
+    (   "update example_ds set z = :z where example_d_id = :id"
+    );
+    SQLStatement updater(database_connection(), slot);
+    updater.bind(":z", m_z);
+    updater.bind(":id", id());
+    updater.step_final();
+    return;
+}
+
+void
+ExampleD::do_save_new()
+{
+    static StatementSlot const slot
+    (   "insert into example_ds(z) values(:z)"
+    );
+    SQLStatement inserter(database_connection(), slot);
+    inserter.bind(":z", m_z);
+    inserter.step_final();
+    return;
+}
+
+string
+ExampleD::exclusive_table_name()
+{
+    return "example_ds";
+}
+
+string
+ExampleD::primary_key_name()
+{
+    return "example_d_id";
+}
+
+void
+ExampleE::setup_tables(DatabaseConnection& dbc)
+{
+    dbc.execute_sql
+    (   "create table example_es"
+        "(series text not null, seq integer not null, "
+        "value integer not null, primary key(series, seq)) without rowid"
+    );
+    return;
+}
+
+ExampleE::ExampleE
+(   IdentityMap& p_identity_map,
+    IdentityMap::Signature const& p_sig
+):
+    DPersistentObject(p_identity_map),
+    m_seq(0),
+    m_value(0)
+{
+    (void)p_sig;  // silence compiler re. unused param.
+}
+
+ExampleE::ExampleE
+(   IdentityMap& p_identity_map,
+    Id p_id,
+    IdentityMap::Signature const& p_sig
+):
+    DPersistentObject(p_identity_map, p_id),
+    m_series(get<0>(p_id)),
+    m_seq(get<1>(p_id)),
+    m_value(0)
+{
+    (void)p_sig;  // silence compiler re. unused param.
+}
+
+void
+ExampleE::set_key(string const& p_series, int p_seq)
+{
+    m_series = p_series;
+    m_seq = p_seq;
+    return;
+}
+
+int
+ExampleE::value()
+{
+    load();
+    return m_value;
+}
+
+void
+ExampleE::set_value(int p_value)
+{
+    load();
+    m_value = p_value;
+    return;
+}
+
+ExampleE::Id
+ExampleE::do_calculate_prospective_key() const
+{
+    return make_tuple(m_series, m_seq);
+}
+
+void
+ExampleE::do_load()
+{
+    static StatementSlot const slot
+    (   "select value from example_es where series = :p0 and seq = :p1"
+    );
+    SQLStatement selector(database_connection(), slot);
+    KeyTraits<Id>::bind(selector, id());
+    selector.step();
+    int const temp_value = selector.extract<int>(0);
+    selector.step_final();
+    m_value = temp_value;
+    return;
+}
+
+void
+ExampleE::do_save_existing()
+{
+    static StatementSlot const slot
+    (   "update example_es set value = :value "
+        "where series = :p0 and seq = :p1"
+    );
+    SQLStatement updater(database_connection(), slot);
+    updater.bind(":value", m_value);
+    KeyTraits<Id>::bind(updater, id());
+    updater.step_final();
+    return;
+}
+
+void
+ExampleE::do_save_new()
+{
+    static StatementSlot const slot
+    (   "insert into example_es(series, seq, value) "
+        "values(:series, :seq, :value)"
+    );
+    SQLStatement inserter(database_connection(), slot);
+    inserter.bind(":series", m_series);
+    inserter.bind(":seq", m_seq);
+    inserter.bind(":value", m_value);
+    inserter.step_final();
+    return;
+}
+
+string
+ExampleE::exclusive_table_name()
+{
+    return "example_es";
+}
+
+string
+ExampleE::primary_key_name()
+{
+    return "series, seq";
+}
+
+void
+ExampleF::setup_tables(DatabaseConnection& dbc)
+{
+    dbc.execute_sql
+    (   "create table example_fs"
+        "(example_f_id integer primary key autoincrement, "
+        "example_a_id integer not null references example_as, "
+        "w integer not null)"
+    );
+    return;
+}
+
+ExampleF::ExampleF
+(   IdentityMap& p_identity_map,
+    IdentityMap::Signature const& p_sig
+):
+    DPersistentObject(p_identity_map),
+    m_example_a_id(0),
+    m_w(0)
+{
+    (void)p_sig;  // silence compiler re. unused param.
+}
+
+ExampleF::ExampleF
+(   IdentityMap& p_identity_map,
+    Id p_id,
+    IdentityMap::Signature const& p_sig
+):
+    DPersistentObject(p_identity_map, p_id),
+    m_example_a_id(0),
+    m_w(0)
+{
+    (void)p_sig;  // silence compiler re. unused param.
+}
+
+sqloxx::Id
+ExampleF::example_a_id()
+{
+    load();
+    return m_example_a_id;
+}
+
+int
+ExampleF::w()
+{
+    load();
+    return m_w;
+}
+
+void
+ExampleF::set_example_a_id(sqloxx::Id p_example_a_id)
+{
+    load();
+    m_example_a_id = p_example_a_id;
+    return;
+}
+
+void
+ExampleF::set_w(int p_w)
+{
+    load();
+    m_w = p_w;
+    return;
+}
+
+void
+ExampleF::do_load()
+{
+    static StatementSlot const slot
+    (   "select example_a_id, w from example_fs where example_f_id = :p"
+    );
+    SQLStatement selector(database_connection(), slot);
+    selector.bind(":p", id());
+    selector.step();
+    do_load_row(selector, 0);
+    selector.step_final();
+    return;
+}
+
+void
+ExampleF::do_load_row(SQLStatement& p_row, int p_first_column)
+{
+    sqloxx::Id const temp_example_a_id =
+        p_row.extract<sqloxx::Id>(p_first_column);
+    int const temp_w = p_row.extract<int>(p_first_column + 1);
+    m_example_a_id = temp_example_a_id;
+    m_w = temp_w;
+    return;
+}
+
+void
+ExampleF::do_save_existing()
+{
+    static StatementSlot const slot
+    (   "update example_fs set example_a_id = :a, w = :w "
+        "where example_f_id = :id"
+    );
+    SQLStatement updater(database_connection(), slot);
+    updater.bind(":a", m_example_a_id);
+    updater.bind(":w", m_w);
+    updater.bind(":id", id());
+    updater.step_final();
+    return;
+}
+
+void
+ExampleF::do_save_new()
+{
+    static StatementSlot const slot
+    (   "insert into example_fs(example_a_id, w) values(:a, :w)"
+    );
+    SQLStatement inserter(database_connection(), slot);
+    inserter.bind(":a", m_example_a_id);
+    inserter.bind(":w", m_w);
+    inserter.step_final();
+    return;
+}
+
+string
+ExampleF::exclusive_table_name()
+{
+    return "example_fs";
+}
+
+string
+ExampleF::primary_key_name()
+{
+    return "example_f_id";
+}
+
+string
+ExampleF::load_columns()
+{
+    return "example_a_id, w";
+}
+
 DerivedDatabaseConnection::DerivedDatabaseConnection():
     DatabaseConnection(),
     m_example_a_map(*this),
-    m_example_b_map(*this)
+    m_example_b_map(*this),
+    m_example_d_map(*this),
+    m_example_e_map(*this),
+    m_example_f_map(*this)
 {
 }
 
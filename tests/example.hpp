@@ -33,8 +33,11 @@
 #include "database_connection.hpp"
 #include "identity_map.hpp"
 #include "persistent_object.hpp"
+#include "sql_statement.hpp"
 #include "sqloxx_tests_common.hpp"
+#include <boost/any.hpp>
 #include <string>
+#include <tuple>
 
 namespace sqloxx
 {
@@ -82,8 +85,14 @@ public:
     static std::string exclusive_table_name();
     static std::string primary_key_name();
 
+    // Columns read by do_load_row, for sqloxx::prefetch.
+    static std::string load_columns();
+
 private:
     void do_load() override;
+    void do_load_row(SQLStatement& p_row, int p_first_column) override;
+    boost::any do_snapshot() const override;
+    void do_restore(boost::any const& p_snapshot) override;
     // Uses default version of do_calculate_prospective_key
     void do_save_existing() override;
     void do_save_new() override;
@@ -125,6 +134,14 @@ public:
 
 protected:
     void load_core();
+
+    // For use by derived classes loading base and derived columns in a
+    // single select. core_columns() returns the base columns, which
+    // must come first in the select; load_core(p_selector) extracts
+    // them from a selector that has been stepped to the relevant row.
+    static std::string core_columns();
+    void load_core(SQLStatement& p_selector);
+
     void save_existing_core();
     Id save_new_core();
 
@@ -191,6 +208,150 @@ private:
 };
 
 
+// Dummy class with a 64-bit primary key, for testing PersistentObject
+// with an IdT other than sqloxx::Id.
+
+class ExampleD:
+    public PersistentObject<ExampleD, DerivedDatabaseConnection, long long>
+{
+public:
+    typedef
+        PersistentObject<ExampleD, DerivedDatabaseConnection, long long>
+        DPersistentObject;
+
+    static void setup_tables(DatabaseConnection& dbc);
+
+    ExampleD
+    (   IdentityMap& p_identity_map,
+        IdentityMap::Signature const& p_sig
+    );
+
+    ExampleD
+    (   IdentityMap& p_identity_map,
+        Id p_id,
+        IdentityMap::Signature const& p_sig
+    );
+
+    ExampleD& operator=(ExampleD const&) = delete;
+    ExampleD& operator=(ExampleD&&) = delete;
+
+    ~ExampleD() = default;
+
+    int z();
+    void set_z(int p_z);
+
+    static std::string exclusive_table_name();
+    static std::string primary_key_name();
+
+private:
+    void do_load() override;
+    void do_save_existing() override;
+    void do_save_new() override;
+    int m_z;
+};
+
+
+// Dummy class with a composite primary key, stored in a "without rowid"
+// table, for testing PersistentObject with a natural key.
+
+class ExampleE:
+    public PersistentObject
+    <   ExampleE,
+        DerivedDatabaseConnection,
+        std::tuple<std::string, int>
+    >
+{
+public:
+    typedef PersistentObject
+    <   ExampleE,
+        DerivedDatabaseConnection,
+        std::tuple<std::string, int>
+    >   DPersistentObject;
+
+    static void setup_tables(DatabaseConnection& dbc);
+
+    ExampleE
+    (   IdentityMap& p_identity_map,
+        IdentityMap::Signature const& p_sig
+    );
+
+    ExampleE
+    (   IdentityMap& p_identity_map,
+        Id p_id,
+        IdentityMap::Signature const& p_sig
+    );
+
+    ExampleE& operator=(ExampleE const&) = delete;
+    ExampleE& operator=(ExampleE&&) = delete;
+
+    ~ExampleE() = default;
+
+    // Sets the key to be used when the object is first saved.
+    void set_key(std::string const& p_series, int p_seq);
+
+    int value();
+    void set_value(int p_value);
+
+    static std::string exclusive_table_name();
+    static std::string primary_key_name();
+
+private:
+    Id do_calculate_prospective_key() const override;
+    void do_load() override;
+    void do_save_existing() override;
+    void do_save_new() override;
+    std::string m_series;
+    int m_seq;
+    int m_value;
+};
+
+
+// Dummy class with a foreign key referring to ExampleA, for testing
+// sqloxx::prefetch.
+
+class ExampleF: public PersistentObject<ExampleF, DerivedDatabaseConnection>
+{
+public:
+    typedef PersistentObject<ExampleF, DerivedDatabaseConnection>
+        DPersistentObject;
+
+    static void setup_tables(DatabaseConnection& dbc);
+
+    ExampleF
+    (   IdentityMap& p_identity_map,
+        IdentityMap::Signature const& p_sig
+    );
+
+    ExampleF
+    (   IdentityMap& p_identity_map,
+        Id p_id,
+        IdentityMap::Signature const& p_sig
+    );
+
+    ExampleF& operator=(ExampleF const&) = delete;
+    ExampleF& operator=(ExampleF&&) = delete;
+
+    ~ExampleF() = default;
+
+    sqloxx::Id example_a_id();
+    int w();
+    void set_example_a_id(sqloxx::Id p_example_a_id);
+    void set_w(int p_w);
+
+    static std::string exclusive_table_name();
+    static std::string primary_key_name();
+    static std::string load_columns();
+
+private:
+    void do_load() override;
+    void do_load_row(SQLStatement& p_row, int p_first_column) override;
+    void do_save_existing() override;
+    void do_save_new() override;
+    sqloxx::Id m_example_a_id;
+    int m_w;
+};
+
+
 // Dummy class derived from DatabaseConnection, for testing
 // purposes
 
@@ -207,6 +368,9 @@ private:
 
     IdentityMap<ExampleA> m_example_a_map;
     IdentityMap<ExampleB> m_example_b_map;
+    IdentityMap<ExampleD> m_example_d_map;
+    IdentityMap<ExampleE> m_example_e_map;
+    IdentityMap<ExampleF> m_example_f_map;
 };
 
 
@@ -226,6 +390,30 @@ DerivedDatabaseConnection::identity_map<ExampleB>()
     return m_example_b_map;
 }
 
+template <>
+inline
+IdentityMap<ExampleD>&
+DerivedDatabaseConnection::identity_map<ExampleD>()
+{
+    return m_example_d_map;
+}
+
+template <>
+inline
+IdentityMap<ExampleE>&
+DerivedDatabaseConnection::identity_map<ExampleE>()
+{
+    return m_example_e_map;
+}
+
+template <>
+inline
+IdentityMap<ExampleF>&
+DerivedDatabaseConnection::identity_map<ExampleF>()
+{
+    return m_example_f_map;
+}
+
 
 }  // namespace tests
 }  // namespace sqloxx
@@ -169,6 +169,25 @@ TEST_FIXTURE(ExampleFixture, handle_assignment_and_indirection)
     CHECK(dpo4);
 }
 
+TEST_FIXTURE(ExampleFixture, handle_move_assignment_releases_object)
+{
+    Handle<ExampleA> dpo1(*pdbc);
+    dpo1->set_x(31);
+    dpo1->set_y(2.5);
+    dpo1->save();
+    dpo1 = Handle<ExampleA>();
+
+    Handle<ExampleA> dpo2(*pdbc, 1);
+    dpo2->set_x(-6);  // not saved
+    dpo2 = Handle<ExampleA>(*pdbc);  // move assignment
+
+    // Caching is not enabled, so the object with id 1 should have been
+    // released when dpo2 was assigned over, and its unsaved change lost.
+    Handle<ExampleA> const dpo3(*pdbc, 1);
+    CHECK_EQUAL(dpo3->x(), 31);
+    CHECK_EQUAL(dpo3->y(), 2.5);
+}
+
 TEST_FIXTURE(ExampleFixture, handle_dereferencing)
 {
     Handle<ExampleA> dpo1(*pdbc);
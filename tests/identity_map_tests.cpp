@@ -62,6 +62,61 @@ TEST_FIXTURE(ExampleFixture, identity_map_connection)
     CHECK_EQUAL(&(idm.connection()), &dbc);
 }
 
+TEST_FIXTURE(ExampleFixture, identity_map_change_tracking)
+{
+    DerivedDatabaseConnection& dbc = *pdbc;
+    dbc.enable_change_tracking();
+    dbc.identity_map<ExampleA>().enable_caching();
+    {
+        Handle<ExampleA> dpo(dbc);
+        dpo->set_x(10);
+        dpo->set_y(1.5);
+        dpo->save();
+    }
+    DerivedDatabaseConnection other;
+    other.open(db_filepath);
+    other.enable_change_tracking();
+    {
+        Handle<ExampleA> dpo(other, 1);
+        dpo->set_x(20);
+        dpo->save();
+    }
+
+    // The cached object is stale until changes are checked for.
+    CHECK_EQUAL(Handle<ExampleA>(dbc, 1)->x(), 10);
+    CHECK(dbc.check_for_changes());
+    CHECK_EQUAL(Handle<ExampleA>(dbc, 1)->x(), 20);
+}
+
+TEST_FIXTURE(ExampleFixture, identity_map_change_tracking_held_object)
+{
+    DerivedDatabaseConnection& dbc = *pdbc;
+    dbc.enable_change_tracking();
+    dbc.identity_map<ExampleA>().enable_caching();
+    {
+        Handle<ExampleA> dpo(dbc);
+        dpo->set_x(10);
+        dpo->set_y(1.5);
+        dpo->save();
+    }
+    DerivedDatabaseConnection other;
+    other.open(db_filepath);
+    other.enable_change_tracking();
+    {
+        // The object is held by a Handle while the change is detected.
+        Handle<ExampleA> const held(dbc, 1);
+        CHECK_EQUAL(held->x(), 10);
+        {
+            Handle<ExampleA> dpo(other, 1);
+            dpo->set_x(20);
+            dpo->save();
+        }
+        CHECK(dbc.check_for_changes());
+    }
+
+    // Once released, it is not retained by caching, but reloaded.
+    CHECK_EQUAL(Handle<ExampleA>(dbc, 1)->x(), 20);
+}
 
 }  // namespace tests
 }  // namespace sqloxx
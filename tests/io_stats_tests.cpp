@@ -0,0 +1,209 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "database_connection.hpp"
+#include "database_transaction.hpp"
+#include "io_stats.hpp"
+#include "open_options.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <boost/filesystem.hpp>
+#include <string>
+
+namespace sqloxx
+{
+namespace tests
+{
+
+namespace
+{
+    char const* const io_stats_insertion =
+        "insert into dummy(text) values('Hello')";
+
+}  // end anonymous namespace
+
+TEST(io_stats_rollback_journal)
+{
+    boost::filesystem::path const filepath("Testfile_io_stats");
+    abort_if_exists(filepath);
+    {
+        OpenOptions options;
+        options.io_stats = true;
+        DatabaseConnection dbc;
+        dbc.open(filepath, options);
+        dbc.execute_sql
+        (   "create table dummy(dummy_id integer primary key, text text)"
+        );
+        IoStats const before = dbc.io_stats();
+        CHECK(before.main_db.writes > 0);
+        CHECK(before.main_db.locks > 0);
+
+        DatabaseTransaction transaction(dbc);
+        insert_rows(dbc, io_stats_insertion, 10);
+        transaction.commit();
+        IoStats const during = transaction.io_stats();
+        CHECK(during.main_db.writes > 0);
+        CHECK(during.main_db.bytes_written > 0);
+        CHECK(during.main_db.syncs > 0);
+        CHECK(during.journal.writes > 0);
+        CHECK(during.journal.syncs > 0);
+        CHECK_EQUAL(during.wal.writes, 0U);
+
+        IoStats const after = dbc.io_stats();
+        CHECK_EQUAL
+        (   after.main_db.writes,
+            before.main_db.writes + during.main_db.writes
+        );
+        CHECK_EQUAL
+        (   after.journal.syncs,
+            before.journal.syncs + during.journal.syncs
+        );
+    }
+    boost::filesystem::remove(filepath);
+}
+
+TEST(io_stats_write_ahead_log)
+{
+    boost::filesystem::path const filepath("Testfile_io_stats");
+    abort_if_exists(filepath);
+    {
+        OpenOptions options;
+        options.io_stats = true;
+        DatabaseConnection dbc;
+        dbc.open(filepath, options);
+        dbc.execute_sql("pragma journal_mode = wal");
+        dbc.execute_sql
+        (   "create table dummy(dummy_id integer primary key, text text)"
+        );
+        DatabaseTransaction transaction(dbc);
+        insert_rows(dbc, io_stats_insertion, 10);
+        transaction.commit();
+        IoStats const during = transaction.io_stats();
+        CHECK(during.wal.writes > 0);
+        CHECK(during.wal.bytes_written > 0);
+        CHECK_EQUAL(during.journal.writes, 0U);
+        CHECK_EQUAL(during.main_db.writes, 0U);
+    }
+    boost::filesystem::remove(filepath);
+}
+
+TEST(io_stats_extends)
+{
+    boost::filesystem::path const filepath("Testfile_io_stats");
+    abort_if_exists(filepath);
+    {
+        OpenOptions options;
+        options.io_stats = true;
+        DatabaseConnection dbc;
+        dbc.open(filepath, options);
+        dbc.execute_sql
+        (   "create table dummy(dummy_id integer primary key, text text)"
+        );
+        FileIoStats const created = dbc.io_stats().main_db;
+        CHECK(created.extends > 0);
+        CHECK_EQUAL
+        (   created.bytes_extended,
+            boost::filesystem::file_size(filepath)
+        );
+    }
+    boost::filesystem::remove(filepath);
+    {
+        OpenOptions options;
+        options.io_stats = true;
+        options.chunk_size = 65536;
+        DatabaseConnection dbc;
+        dbc.open(filepath, options);
+        dbc.execute_sql
+        (   "create table dummy(dummy_id integer primary key, text text)"
+        );
+        // The file is grown by whole chunks...
+        FileIoStats const created = dbc.io_stats().main_db;
+        CHECK_EQUAL(created.extends, 1U);
+        CHECK_EQUAL(created.bytes_extended, 65536U);
+        CHECK_EQUAL(boost::filesystem::file_size(filepath), 65536U);
+
+        // ... so that transactions writing within the chunk do not
+        // extend it.
+        DatabaseTransaction transaction(dbc);
+        insert_rows(dbc, io_stats_insertion, 100);
+        transaction.commit();
+        CHECK_EQUAL(transaction.io_stats().main_db.extends, 0U);
+    }
+    boost::filesystem::remove(filepath);
+}
+
+TEST(io_stats_not_counted_by_default)
+{
+    boost::filesystem::path const filepath("Testfile_io_stats");
+    abort_if_exists(filepath);
+    {
+        DatabaseConnection dbc;
+        dbc.open(filepath);
+        dbc.execute_sql
+        (   "create table dummy(dummy_id integer primary key, text text)"
+        );
+        insert_rows(dbc, io_stats_insertion, 2);
+        IoStats const stats = dbc.io_stats();
+        CHECK_EQUAL(stats.main_db.writes, 0U);
+        CHECK_EQUAL(stats.main_db.reads, 0U);
+        CHECK_EQUAL(stats.journal.syncs, 0U);
+    }
+    boost::filesystem::remove(filepath);
+}
+
+TEST(io_stats_version_1_vfs)
+{
+    // The files of "unix-dotfile" have io methods of version 1, without
+    // shared memory, so the shim must not offer WAL mode either.
+    boost::filesystem::path const filepath("Testfile_io_stats");
+    abort_if_exists(filepath);
+    {
+        OpenOptions options;
+        options.vfs = "unix-dotfile";
+        options.io_stats = true;
+        DatabaseConnection dbc;
+        dbc.open(filepath, options);
+        SQLStatement journal_mode(dbc, "pragma journal_mode = wal");
+        CHECK(journal_mode.step());
+        CHECK(journal_mode.extract<std::string>(0) != "wal");
+        journal_mode.reset();
+        dbc.execute_sql("pragma mmap_size = 1048576");
+        dbc.execute_sql
+        (   "create table dummy(dummy_id integer primary key, text text)"
+        );
+        insert_rows(dbc, io_stats_insertion, 10);
+        CHECK_EQUAL(query_scalar(dbc, "select count(*) from dummy"), 10);
+        CHECK(dbc.io_stats().main_db.reads > 0);
+    }
+    boost::filesystem::remove(filepath);
+}
+
+TEST(io_stats_unregistered_vfs)
+{
+    boost::filesystem::path const filepath("Testfile_io_stats");
+    abort_if_exists(filepath);
+    OpenOptions options;
+    options.vfs = "no-such-vfs";
+    options.io_stats = true;
+    DatabaseConnection dbc;
+    CHECK_THROW(dbc.open(filepath, options), NoSuchVFS);
+    CHECK(!dbc.is_valid());
+}
+
+}  // namespace tests
+}  // namespace sqloxx
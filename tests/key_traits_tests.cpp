@@ -0,0 +1,138 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "database_connection.hpp"
+#include "example.hpp"
+#include "handle.hpp"
+#include "key_traits.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include "table_iterator.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <string>
+#include <tuple>
+
+using std::make_tuple;
+using std::string;
+using std::tuple;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+TEST(key_traits_condition)
+{
+    typedef tuple<string, int> Key;
+    CHECK_EQUAL(KeyTraits<int>::condition("a_id"), "a_id = :p");
+    CHECK_EQUAL
+    (   KeyTraits<Key>::condition("series,  seq"),
+        "series = :p0 and seq = :p1"
+    );
+    CHECK_THROW(KeyTraits<Key>::condition("series"), LogicError);
+    CHECK_THROW(KeyTraits<Key>::condition("series, seq, x"), LogicError);
+    CHECK_THROW(KeyTraits<Key>::condition("series, "), LogicError);
+    CHECK(KeyTraits<int>::auto_increment);
+    CHECK(!KeyTraits<Key>::auto_increment);
+}
+
+TEST(key_traits_hash)
+{
+    typedef tuple<string, int> Key;
+    KeyTraits<Key>::Hash const hasher;
+    CHECK_EQUAL
+    (   hasher(make_tuple(string("a"), 1)),
+        hasher(make_tuple(string("a"), 1))
+    );
+    CHECK
+    (   hasher(make_tuple(string("a"), 1)) !=
+        hasher(make_tuple(string("a"), 2))
+    );
+}
+
+TEST_FIXTURE(DatabaseConnectionFixture, key_traits_bind_and_extract)
+{
+    typedef tuple<string, int> Key;
+    DatabaseConnection& dbc = *pdbc;
+    dbc.execute_sql
+    (   "create table dummy(a text, b integer, primary key(a, b)) "
+        "without rowid"
+    );
+    dbc.execute_sql("insert into dummy(a, b) values('x', 3)");
+    SQLStatement statement
+    (   dbc,
+        "select a, b from dummy where " + KeyTraits<Key>::condition("a, b")
+    );
+    KeyTraits<Key>::bind(statement, make_tuple(string("x"), 3));
+    CHECK(statement.step());
+    Key const key = KeyTraits<Key>::extract(statement, 0);
+    CHECK(key == make_tuple(string("x"), 3));
+    statement.step_final();
+}
+
+TEST_FIXTURE(ExampleFixture, key_traits_composite_key_persistence)
+{
+    typedef ExampleE::Id Key;
+    Key const key0("alpha", 2);
+    Key const key1("alpha", 1);
+    Key const key2("beta", 1);
+
+    Handle<ExampleE> e0(*pdbc);
+    e0->set_key("alpha", 2);
+    e0->set_value(20);
+    e0->save();
+    CHECK(e0->id() == key0);
+    Handle<ExampleE> e1(*pdbc);
+    e1->set_key("alpha", 1);
+    e1->set_value(10);
+    e1->save();
+    Handle<ExampleE> e2(*pdbc);
+    e2->set_key("beta", 1);
+    e2->set_value(30);
+    e2->save();
+
+    CHECK(ExampleE::exists(*pdbc, key0));
+    CHECK(!ExampleE::exists(*pdbc, Key("alpha", 3)));
+
+    Handle<ExampleE> e3(*pdbc, key1);
+    CHECK(e3 == e1);
+    CHECK_EQUAL(e3->value(), 10);
+    e3->set_value(11);
+    e3->save();
+
+    // Rows sharing a key prefix are read in key order.
+    TableIterator<Handle<ExampleE> > it
+    (   *pdbc,
+        "select series, seq from example_es where series = 'alpha'"
+    );
+    TableIterator<Handle<ExampleE> > const end;
+    CHECK(it != end);
+    CHECK((*it)->id() == key1);
+    CHECK_EQUAL((*it)->value(), 11);
+    ++it;
+    CHECK(it != end);
+    CHECK((*it)->id() == key0);
+    ++it;
+    CHECK(it == end);
+
+    e2->remove();
+    CHECK(!ExampleE::exists(*pdbc, key2));
+    CHECK(ExampleE::exists(*pdbc, key1));
+}
+
+}  // namespace tests
+}  // namespace sqloxx
@@ -141,6 +141,42 @@ TEST_FIXTURE(DatabaseConnectionFixture, test_next_auto_key_normal)
     pdbc->execute_sql("drop table test_table");
 }
 
+TEST_FIXTURE(DatabaseConnectionFixture, test_next_auto_key_wide_keys)
+{
+    pdbc->execute_sql
+    (   "create table test_table"
+        "(column_A integer primary key autoincrement, column_B text)"
+    );
+    long long const big = 1LL + numeric_limits<int>::max();
+    SQLStatement statement
+    (   *pdbc,
+        "insert into test_table(column_A, column_B) values(:A, 'Hello')"
+    );
+    statement.bind(":A", big);
+    statement.step_final();
+
+    // Note CHECK_EQUAL and CHECK get confused by multiple template args
+    bool ok =
+    (   next_auto_key<DatabaseConnection, long long>(*pdbc, "test_table") ==
+        big + 1
+    );
+    CHECK(ok);
+
+    // A sequence value beyond the range of KeyType is detected, rather
+    // than truncated.
+    ok = false;
+    try
+    {
+        next_auto_key<DatabaseConnection, int>(*pdbc, "test_table");
+    }
+    catch (TableSizeException&)
+    {
+        ok = true;
+    }
+    CHECK(ok);
+    pdbc->execute_sql("drop table test_table");
+}
+
 
 
 }  // namespace tests
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "database_connection.hpp"
+#include "page_cache.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include <UnitTest++/UnitTest++.h>
+
+namespace sqloxx
+{
+namespace tests
+{
+
+// The arena is configured in main(), in test.cpp, before SQLite is
+// initialized, only when the tests are run with "--page-cache-arena", as
+// test_driver.tcl does after running them without it.
+
+TEST(page_cache_cannot_be_configured_late)
+{
+    DatabaseConnection dbc;  // Ensures SQLite is initialized
+    CHECK_THROW(configure_page_cache(PageCacheConfig()), LogicError);
+    PageCacheConfig empty;
+    empty.pages = 0;
+    CHECK_THROW(configure_page_cache(empty), LogicError);
+}
+
+TEST_FIXTURE(DatabaseConnectionFixture, page_cache_stats)
+{
+    DatabaseConnection& dbc = *pdbc;
+    dbc.execute_sql("create table dummy(dummy_id integer primary key, x)");
+    SQLStatement insertion(dbc, "insert into dummy(x) values(:x)");
+    for (int i = 0; i != 100; ++i)
+    {
+        insertion.bind(":x", i);
+        insertion.step_final();
+        insertion.reset();
+    }
+    PageCacheStats const stats = page_cache_stats();
+    if (stats.arena_pages == 0)
+    {
+        // Every page is allocated individually.
+        CHECK_EQUAL(stats.slot_size, 0U);
+        CHECK_EQUAL(stats.peak_pages_used, 0U);
+        CHECK(stats.peak_overflow_bytes > 0);
+        return;
+    }
+    CHECK_EQUAL(stats.arena_pages, 500U);
+    CHECK(stats.pages_used > 0);
+    CHECK(stats.peak_pages_used >= stats.pages_used);
+    CHECK(stats.peak_pages_used <= stats.arena_pages);
+    CHECK(stats.peak_overflow_bytes >= stats.overflow_bytes);
+
+    // The slots are large enough for pages of the default size.
+    CHECK(stats.largest_request > 0);
+    CHECK(stats.largest_request <= stats.slot_size);
+}
+
+}  // namespace tests
+}  // namespace sqloxx
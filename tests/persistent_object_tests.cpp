@@ -30,6 +30,7 @@
 #include <typeinfo>
 #include <UnitTest++/UnitTest++.h>
 #include <stdexcept>
+#include <string>
 
 using jewel::UninitializedOptionalException;
 using std::cerr;
@@ -410,6 +411,32 @@ TEST_FIXTURE(ExampleFixture, test_example_a_id_getter)
     CHECK_THROW(dpo2->id(), UninitializedOptionalException);
 }
 
+TEST_FIXTURE(ExampleFixture, test_wide_id_beyond_int_range)
+{
+    // ExampleD has a long long Id, so its table can outgrow sqloxx::Id.
+    long long const big = 1LL + numeric_limits<int>::max();
+    pdbc->execute_sql
+    (   "insert into example_ds(example_d_id, z) values(" +
+        std::to_string(big) + ", 5)"
+    );
+    CHECK(ExampleD::exists(*pdbc, big));
+    CHECK(!ExampleD::exists(*pdbc, big + 1));
+
+    Handle<ExampleD> dpo1(*pdbc);
+    dpo1->set_z(10);
+    dpo1->save();
+    CHECK_EQUAL(dpo1->id(), big + 1);
+
+    Handle<ExampleD> dpo2(*pdbc, big);
+    CHECK_EQUAL(dpo2->id(), big);
+    CHECK_EQUAL(dpo2->z(), 5);
+    Handle<ExampleD> dpo3(*pdbc, big + 1);
+    CHECK(dpo3 == dpo1);
+    CHECK_EQUAL(dpo3->z(), 10);
+    dpo3->remove();
+    CHECK(!ExampleD::exists(*pdbc, big + 1));
+}
+
 TEST_FIXTURE(ExampleFixture, test_load_indirectly)
 {
     // load is protected method but we here we test it indirectly
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "example.hpp"
+#include "handle.hpp"
+#include "prefetch.hpp"
+#include "sqloxx_tests_common.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <memory>
+#include <vector>
+
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+namespace
+{
+    // Saves three ExampleAs, with x equal to their id, and num_fs
+    // ExampleFs distributed among them, with w equal to their id.
+    void populate(DerivedDatabaseConnection& dbc, int num_fs)
+    {
+        for (int i = 1; i <= 3; ++i)
+        {
+            Handle<ExampleA> a(dbc);
+            a->set_x(i);
+            a->set_y(0.5);
+            a->save();
+        }
+        for (int i = 1; i <= num_fs; ++i)
+        {
+            Handle<ExampleF> f(dbc);
+            f->set_example_a_id(1 + i % 3);
+            f->set_w(i);
+            f->save();
+        }
+        return;
+    }
+
+}  // end anonymous namespace
+
+TEST_FIXTURE(ExampleFixture, prefetch_to_many)
+{
+    int const num_fs = 150;  // more than one chunk
+    populate(*pdbc, num_fs);
+    vector<shared_ptr<Relationship<ExampleA> > > relationships;
+    relationships.push_back
+    (   make_shared<ToMany<ExampleA, ExampleF> >("example_a_id")
+    );
+    PrefetchedObjects const prefetched =
+        prefetch<ExampleA>(*pdbc, vector<Id>{1, 2, 3}, relationships);
+    CHECK_EQUAL(prefetched.size(), 3U + num_fs);
+
+    // Everything is now loaded, so no further reads are needed: we
+    // remove the rows to prove it.
+    pdbc->execute_sql("delete from example_fs");
+    pdbc->execute_sql("delete from example_as");
+    for (int i = 1; i <= num_fs; ++i)
+    {
+        Handle<ExampleF> const f =
+            Handle<ExampleF>::create_unchecked(*pdbc, i);
+        CHECK_EQUAL(f->w(), i);
+        CHECK_EQUAL(f->example_a_id(), 1 + i % 3);
+    }
+    for (int i = 1; i <= 3; ++i)
+    {
+        CHECK_EQUAL(Handle<ExampleA>::create_unchecked(*pdbc, i)->x(), i);
+    }
+}
+
+TEST_FIXTURE(ExampleFixture, prefetch_to_one_chained)
+{
+    populate(*pdbc, 10);
+    shared_ptr<ToMany<ExampleA, ExampleF> > const to_fs =
+        make_shared<ToMany<ExampleA, ExampleF> >("example_a_id");
+    to_fs->then(make_shared<ToOne<ExampleF, ExampleA> >("example_a_id"));
+    vector<shared_ptr<Relationship<ExampleA> > > relationships;
+    relationships.push_back(to_fs);
+
+    // Starting only from ExampleA 2, the second level finds its
+    // ExampleFs, and the third level finds ExampleA 2 again.
+    PrefetchedObjects const prefetched =
+        prefetch<ExampleA>(*pdbc, vector<Id>{2}, relationships);
+    CHECK_EQUAL(prefetched.size(), 1U + 4U + 1U);
+
+    vector<shared_ptr<Relationship<ExampleF> > > to_a;
+    to_a.push_back(make_shared<ToOne<ExampleF, ExampleA> >("example_a_id"));
+    PrefetchedObjects const prefetched_fs =
+        prefetch<ExampleF>(*pdbc, vector<Id>{1, 2, 3, 4, 5, 99}, to_a);
+    CHECK_EQUAL(prefetched_fs.size(), 5U + 3U);
+    pdbc->execute_sql("delete from example_fs");
+    pdbc->execute_sql("delete from example_as");
+    CHECK_EQUAL(Handle<ExampleA>::create_unchecked(*pdbc, 3)->x(), 3);
+}
+
+TEST_FIXTURE(ExampleFixture, prefetch_empty)
+{
+    PrefetchedObjects const prefetched =
+        prefetch<ExampleA>(*pdbc, vector<Id>());
+    CHECK_EQUAL(prefetched.size(), 0U);
+}
+
+}  // namespace tests
+}  // namespace sqloxx
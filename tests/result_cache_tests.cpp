@@ -0,0 +1,234 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "database_connection.hpp"
+#include "database_transaction.hpp"
+#include "result_cache.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <string>
+
+using std::string;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+namespace
+{
+    string colour_name(DatabaseConnection& dbc, int id)
+    {
+        SQLStatement statement
+        (   dbc,
+            "select name from colours where colour_id = :id"
+        );
+        statement.enable_result_cache();
+        statement.bind(":id", id);
+        string ret;
+        while (statement.step())
+        {
+            ret += statement.extract<string>(0);
+        }
+        return ret;
+    }
+
+    void setup_colours(DatabaseConnection& dbc)
+    {
+        dbc.execute_sql
+        (   "create table colours(colour_id integer primary key, "
+            "name text, weight real); "
+            "create table sizes(size_id integer primary key, size text); "
+            "insert into colours(colour_id, name, weight) "
+            "values(1, 'red', 0.5); "
+            "insert into colours(colour_id, name) values(2, 'green'); "
+            "insert into sizes(size) values('large');"
+        );
+        return;
+    }
+
+}  // end anonymous namespace
+
+TEST_FIXTURE(DatabaseConnectionFixture, result_cache_disabled_by_default)
+{
+    DatabaseConnection& dbc = *pdbc;
+    setup_colours(dbc);
+    CHECK_EQUAL(colour_name(dbc, 1), "red");
+    CHECK_EQUAL(colour_name(dbc, 1), "red");
+    CHECK_EQUAL(dbc.result_cache().stats().stores, 0U);
+
+    // Statements prepared before the cache was enabled are prepared
+    // afresh, and so are cached thereafter.
+    dbc.enable_result_cache();
+    CHECK_EQUAL(colour_name(dbc, 1), "red");
+    CHECK_EQUAL(colour_name(dbc, 1), "red");
+    CHECK_EQUAL(dbc.result_cache().stats().stores, 1U);
+    CHECK_EQUAL(dbc.result_cache().stats().hits, 1U);
+}
+
+TEST_FIXTURE(DatabaseConnectionFixture, result_cache_hits_and_invalidation)
+{
+    DatabaseConnection& dbc = *pdbc;
+    dbc.enable_result_cache();
+    setup_colours(dbc);
+    ResultCache& cache = dbc.result_cache();
+
+    CHECK_EQUAL(colour_name(dbc, 1), "red");
+    CHECK_EQUAL(colour_name(dbc, 1), "red");
+    CHECK_EQUAL(colour_name(dbc, 2), "green");
+    CHECK_EQUAL(cache.stats().misses, 2U);
+    CHECK_EQUAL(cache.stats().hits, 1U);
+    CHECK_EQUAL(cache.stats().stores, 2U);
+    CHECK(cache.size() > 0);
+
+    // A write to a table not read leaves the results in place.
+    dbc.execute_sql("insert into sizes(size) values('small')");
+    CHECK_EQUAL(colour_name(dbc, 2), "green");
+    CHECK_EQUAL(cache.stats().hits, 2U);
+
+    // A write through an SQLStatement drops the results read from the
+    // table written.
+    {
+        SQLStatement statement
+        (   dbc,
+            "update colours set name = 'blue' where colour_id = 1"
+        );
+        statement.step_final();
+    }
+    CHECK_EQUAL(cache.stats().invalidations, 2U);
+    CHECK_EQUAL(cache.size(), 0U);
+    CHECK_EQUAL(colour_name(dbc, 1), "blue");
+    CHECK_EQUAL(colour_name(dbc, 1), "blue");
+    CHECK_EQUAL(cache.stats().hits, 3U);
+
+    // Likewise a write through execute_sql.
+    dbc.execute_sql("update colours set name = 'cyan' where colour_id = 1");
+    CHECK_EQUAL(colour_name(dbc, 1), "cyan");
+
+    // Likewise a write by a trigger.
+    dbc.execute_sql
+    (   "create trigger size_trigger after insert on sizes begin "
+        "update colours set name = 'grey'; end"
+    );
+    CHECK_EQUAL(colour_name(dbc, 2), "green");
+    {
+        SQLStatement statement
+        (   dbc,
+            "insert into sizes(size) values('medium')"
+        );
+        statement.step_final();
+    }
+    CHECK_EQUAL(colour_name(dbc, 2), "grey");
+
+    // Dropping a table clears the cache.
+    CHECK(cache.size() > 0);
+    dbc.execute_sql("drop trigger size_trigger; drop table sizes");
+    CHECK_EQUAL(cache.size(), 0U);
+}
+
+TEST_FIXTURE(DatabaseConnectionFixture, result_cache_and_transactions)
+{
+    DatabaseConnection& dbc = *pdbc;
+    dbc.enable_result_cache();
+    setup_colours(dbc);
+    ResultCache& cache = dbc.result_cache();
+    CHECK_EQUAL(colour_name(dbc, 1), "red");
+    CHECK_EQUAL(colour_name(dbc, 2), "green");
+
+    // Within a transaction the cache is bypassed, and writes drop
+    // results, so that rolling back cannot leave stale results.
+    ResultCache::Stats const before = cache.stats();
+    {
+        DatabaseTransaction transaction(dbc);
+        CHECK_EQUAL(colour_name(dbc, 1), "red");
+        dbc.execute_sql("update colours set name = 'pink'");
+        CHECK_EQUAL(colour_name(dbc, 1), "pink");
+        transaction.cancel();
+    }
+    CHECK_EQUAL(cache.stats().hits, before.hits);
+    CHECK_EQUAL(cache.stats().misses, before.misses);
+    CHECK_EQUAL(cache.size(), 0U);
+    CHECK_EQUAL(colour_name(dbc, 1), "red");
+    CHECK_EQUAL(colour_name(dbc, 1), "red");
+    CHECK_EQUAL(cache.stats().hits, before.hits + 1);
+}
+
+TEST_FIXTURE(DatabaseConnectionFixture, result_cache_replay)
+{
+    DatabaseConnection& dbc = *pdbc;
+    dbc.enable_result_cache();
+    setup_colours(dbc);
+    ResultCache& cache = dbc.result_cache();
+    string const text =
+        "select colour_id, name, weight from colours order by colour_id";
+    for (int i = 0; i != 2; ++i)
+    {
+        SQLStatement statement(dbc, text);
+        statement.enable_result_cache();
+        CHECK(statement.step());
+        CHECK_EQUAL(statement.extract<int>(0), 1);
+        CHECK_EQUAL(statement.extract<long long>(0), 1);
+        CHECK_EQUAL(statement.extract<string>(1), "red");
+        CHECK_EQUAL(statement.extract<double>(2), 0.5);
+        CHECK_THROW(statement.extract<string>(0), ValueTypeException);
+        CHECK_THROW(statement.extract<int>(3), ResultIndexOutOfRange);
+        CHECK(statement.step());
+        CHECK_EQUAL(statement.extract<string>(1), "green");
+        CHECK_THROW(statement.extract<double>(2), ValueTypeException);
+        CHECK(!statement.step());
+    }
+    CHECK_EQUAL(cache.stats().hits, 1U);
+
+    // A result not stepped through to the end is not stored.
+    {
+        SQLStatement statement
+        (   dbc,
+            "select name from colours order by name"
+        );
+        statement.enable_result_cache();
+        CHECK(statement.step());
+        CHECK_EQUAL(statement.extract<string>(0), "green");
+    }
+    CHECK_EQUAL(cache.stats().stores, 1U);
+
+    // Results too large for the capacity are not stored.
+    cache.set_capacity(0);
+    CHECK_EQUAL(cache.size(), 0U);
+    CHECK_EQUAL(colour_name(dbc, 1), "red");
+    CHECK_EQUAL(cache.stats().stores, 1U);
+    cache.set_capacity(1024 * 1024);
+
+    // The cache must be enabled before binding.
+    SQLStatement statement
+    (   dbc,
+        "select name from colours where colour_id = :id"
+    );
+    statement.bind(":id", 1);
+    CHECK_THROW(statement.enable_result_cache(), LogicError);
+    statement.clear_bindings();
+    statement.enable_result_cache();
+
+    // Enabling the cache for a statement that writes has no effect.
+    SQLStatement update(dbc, "update colours set weight = 1.0");
+    update.enable_result_cache();
+    update.step_final();
+    CHECK_EQUAL(cache.stats().stores, 1U);
+}
+
+}  // namespace tests
+}  // namespace sqloxx
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "database_connection.hpp"
+#include "schema.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <boost/filesystem.hpp>
+#include <stdexcept>
+
+using std::runtime_error;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+namespace
+{
+    boost::filesystem::path const schema_filepath("Testfile_schema");
+
+    // Counts the migrations executed, and the calls to do_setup().
+    class SchemaDatabaseConnection: public DatabaseConnection
+    {
+    public:
+        explicit SchemaDatabaseConnection(int p_versions = 2):
+            migrations(0),
+            setups(0)
+        {
+            Schema schema(0x5158);
+            schema.add_migration
+            (   [this](DatabaseConnection& p_connection)
+                {
+                    ++migrations;
+                    p_connection.execute_sql
+                    (   "create table if not exists dummy"
+                        "(dummy_id integer primary key)"
+                    );
+                }
+            );
+            if (p_versions > 1)
+            {
+                schema.add_migration
+                (   [this](DatabaseConnection& p_connection)
+                    {
+                        ++migrations;
+                        p_connection.execute_sql
+                        (   "create index dummy_index on dummy(dummy_id)"
+                        );
+                    }
+                );
+            }
+            set_schema(schema);
+        }
+        int migrations;
+        int setups;
+    private:
+        void do_setup() override
+        {
+            ++setups;
+            return;
+        }
+    };
+
+    char const* const index_count =
+        "select count(*) from sqlite_master where type = 'index'";
+
+}  // end anonymous namespace
+
+TEST(schema_migrates_only_when_fingerprint_differs)
+{
+    abort_if_exists(schema_filepath);
+    {
+        SchemaDatabaseConnection dbc(1);
+        dbc.open(schema_filepath);
+        CHECK_EQUAL(dbc.migrations, 1);
+        CHECK_EQUAL(dbc.setups, 1);
+        CHECK_EQUAL(query_scalar(dbc, index_count), 0);
+    }
+    {
+        SchemaDatabaseConnection dbc(1);
+        dbc.open(schema_filepath);
+        CHECK_EQUAL(dbc.migrations, 0);
+        CHECK_EQUAL(dbc.setups, 1);
+    }
+    {
+        // Only the new migration is executed.
+        SchemaDatabaseConnection dbc(2);
+        dbc.open(schema_filepath);
+        CHECK_EQUAL(dbc.migrations, 1);
+        CHECK_EQUAL(query_scalar(dbc, index_count), 1);
+    }
+    {
+        SchemaDatabaseConnection dbc(2);
+        dbc.open(schema_filepath);
+        CHECK_EQUAL(dbc.migrations, 0);
+        Schema schema(0x5158);
+        CHECK(!schema.is_current(dbc));
+    }
+    {
+        // The database is now at a later version than this connection
+        // knows of.
+        SchemaDatabaseConnection dbc(1);
+        CHECK_THROW(dbc.open(schema_filepath), SchemaMismatch);
+        CHECK_EQUAL(dbc.setups, 0);
+    }
+    boost::filesystem::remove(schema_filepath);
+}
+
+TEST(schema_rejects_other_application)
+{
+    abort_if_exists(schema_filepath);
+    {
+        SchemaDatabaseConnection dbc;
+        dbc.open(schema_filepath);
+    }
+    {
+        DatabaseConnection dbc;
+        dbc.open(schema_filepath);
+        Schema other(0x1234);
+        CHECK(!other.is_current(dbc));
+        CHECK_THROW(other.migrate(dbc), SchemaMismatch);
+    }
+    boost::filesystem::remove(schema_filepath);
+}
+
+TEST(schema_failed_migration_is_rolled_back)
+{
+    abort_if_exists(schema_filepath);
+    {
+        DatabaseConnection dbc;
+        dbc.open(schema_filepath);
+        Schema schema;
+        schema.add_migration
+        (   [](DatabaseConnection& p_connection)
+            {
+                p_connection.execute_sql("create table dummy(dummy_id)");
+            }
+        );
+        schema.add_migration
+        (   [](DatabaseConnection&)
+            {
+                throw runtime_error("Migration failed.");
+            }
+        );
+        CHECK_EQUAL(schema.version(), 2);
+        CHECK_THROW(schema.migrate(dbc), runtime_error);
+        CHECK_EQUAL(dbc.transaction_nesting_level(), 0);
+        CHECK_EQUAL
+        (   query_scalar
+            (   dbc,
+                "select count(*) from sqlite_master where name = 'dummy'"
+            ),
+            0
+        );
+    }
+    boost::filesystem::remove(schema_filepath);
+}
+
+TEST(schema_rejects_negative_version)
+{
+    abort_if_exists(schema_filepath);
+    {
+        DatabaseConnection dbc;
+        dbc.open(schema_filepath);
+        dbc.execute_sql("pragma user_version = -1");
+        Schema schema;
+        schema.add_migration([](DatabaseConnection&) {});
+        CHECK(!schema.is_current(dbc));
+        CHECK_THROW(schema.migrate(dbc), SchemaMismatch);
+        CHECK_EQUAL(dbc.transaction_nesting_level(), 0);
+    }
+    boost::filesystem::remove(schema_filepath);
+}
+
+TEST(schema_migrates_holding_write_lock)
+{
+    abort_if_exists(schema_filepath);
+    {
+        DatabaseConnection dbc;
+        dbc.open(schema_filepath);
+        DatabaseConnection other;
+        other.open(schema_filepath);
+        bool is_other_locked_out = false;
+        Schema schema;
+        schema.add_migration
+        (   [&other, &is_other_locked_out](DatabaseConnection& p_connection)
+            {
+                // Nothing has yet been written, but another connection
+                // migrating concurrently must still wait.
+                try
+                {
+                    other.execute_sql("begin immediate");
+                    other.execute_sql("rollback");
+                }
+                catch (SQLiteBusy&)
+                {
+                    is_other_locked_out = true;
+                }
+                p_connection.execute_sql("create table dummy(dummy_id)");
+            }
+        );
+        CHECK_EQUAL(schema.migrate(dbc), 1);
+        CHECK(is_other_locked_out);
+        CHECK(schema.is_current(other));
+    }
+    boost::filesystem::remove(schema_filepath);
+}
+
+}  // namespace tests
+}  // namespace sqloxx
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "database_connection.hpp"
+#include "database_transaction.hpp"
+#include "example.hpp"
+#include "handle.hpp"
+#include "second_level_cache.hpp"
+#include "sqloxx_tests_common.hpp"
+#include "type_registry.hpp"
+#include <boost/any.hpp>
+#include <UnitTest++/UnitTest++.h>
+#include <memory>
+
+using std::make_shared;
+using std::shared_ptr;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+TEST(second_level_cache_epochs)
+{
+    SecondLevelCache cache(2);
+    TypeTag const& tag = TypeRegistry<ExampleA>::tag();
+    SecondLevelCache::Snapshot const snapshot =
+        make_shared<boost::any const>(3);
+    CHECK(!cache.find(tag, 1));
+    SecondLevelCache::Epoch const epoch = cache.epoch();
+    cache.publish(tag, 1, epoch, snapshot);
+    CHECK(cache.find(tag, 1) == snapshot);
+    CHECK(!cache.find(tag, 2));
+    CHECK(!cache.find(TypeRegistry<ExampleF>::tag(), 1));
+
+    // Capacity is respected.
+    cache.publish(tag, 2, epoch, snapshot);
+    cache.publish(tag, 3, epoch, snapshot);
+    CHECK(cache.find(tag, 2));
+    CHECK(!cache.find(tag, 3));
+
+    // Advancing the epoch invalidates everything, and snapshots taken
+    // in an earlier epoch are not published.
+    cache.advance_epoch();
+    CHECK(cache.epoch() != epoch);
+    CHECK(!cache.find(tag, 1));
+    cache.publish(tag, 1, epoch, snapshot);
+    CHECK(!cache.find(tag, 1));
+    cache.publish(tag, 1, cache.epoch(), snapshot);
+    CHECK(cache.find(tag, 1));
+
+    SecondLevelCache::Stats const stats = cache.stats();
+    CHECK_EQUAL(stats.publications, 3U);
+    CHECK_EQUAL(stats.invalidations, 1U);
+    CHECK_EQUAL(stats.hits, 3U);
+}
+
+TEST_FIXTURE(ExampleFixture, second_level_cache_shared_by_connections)
+{
+    shared_ptr<SecondLevelCache> const cache =
+        make_shared<SecondLevelCache>();
+    DerivedDatabaseConnection dbc2;
+    dbc2.open(pdbc->filepath());
+    DatabaseConnection unattached;
+    unattached.open(pdbc->filepath());
+    pdbc->set_second_level_cache(cache);
+    dbc2.set_second_level_cache(cache);
+    CHECK(pdbc->second_level_cache() == cache.get());
+
+    Handle<ExampleA> a(*pdbc);
+    a->set_x(5);
+    a->set_y(0.5);
+    a->save();
+    a = Handle<ExampleA>();
+
+    // Loaded from the database via dbc2, and published.
+    CHECK_EQUAL(Handle<ExampleA>(dbc2, 1)->x(), 5);
+    CHECK_EQUAL(cache->stats().publications, 1U);
+
+    // A write through a connection that is not attached is not detected,
+    // so pdbc is served the snapshot published via dbc2.
+    unattached.execute_sql("update example_as set x = 7");
+    CHECK_EQUAL(Handle<ExampleA>(*pdbc, 1)->x(), 5);
+    CHECK_EQUAL(cache->stats().hits, 1U);
+
+    // A write through an attached connection advances the epoch, both
+    // as the commit begins and once it is complete.
+    SecondLevelCache::Epoch const epoch = cache->epoch();
+    dbc2.execute_sql("update example_as set x = 8");
+    CHECK_EQUAL(cache->epoch(), epoch + 2);
+    CHECK_EQUAL(Handle<ExampleA>(*pdbc, 1)->x(), 8);
+
+    // Within a transaction, the cache is bypassed.
+    SecondLevelCache::Stats const before = cache->stats();
+    {
+        DatabaseTransaction transaction(*pdbc);
+        CHECK_EQUAL(Handle<ExampleA>(*pdbc, 1)->x(), 8);
+        transaction.commit();
+    }
+    CHECK_EQUAL(cache->stats().hits, before.hits);
+    CHECK_EQUAL(cache->stats().misses, before.misses);
+
+    pdbc->set_second_level_cache(shared_ptr<SecondLevelCache>());
+    CHECK(pdbc->second_level_cache() == nullptr);
+}
+
+}  // namespace tests
+}  // namespace sqloxx
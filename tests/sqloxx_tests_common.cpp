@@ -15,9 +15,15 @@
  */
 
 #include "sqloxx_tests_common.hpp"
+#include "compaction.hpp"
 #include "database_connection.hpp"
+#include "database_transaction.hpp"
 #include "example.hpp"
+#include "handle.hpp"
+#include "info.hpp"
 #include "sql_statement.hpp"
+#include "statement_key.hpp"
+#include "table_iterator.hpp"
 #include "detail/sql_statement_impl.hpp"
 #include "detail/sqlite_dbconn.hpp"
 #include <boost/filesystem.hpp>
@@ -32,17 +38,22 @@
 #include <jewel/assert.hpp>
 #include <cstdlib>
 #include <exception>
+#include <functional>
 #include <iostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 using jewel::Stopwatch;
 using std::cout;
 using std::cerr;
 using std::endl;
+using std::hash;
 using std::remove;
 using std::string;
 using std::terminate;
+using std::to_string;
+using std::unordered_map;
 using std::vector;
 using sqloxx::detail::SQLStatementImpl;
 using sqloxx::detail::SQLiteDBConn;
@@ -109,6 +120,49 @@ void abort_if_exists(filesystem::path const& filepath)
     return;
 }
 
+
+void remove_database(filesystem::path const& filepath)
+{
+    string const base = filepath.string();
+    vector<string> const names{base, base + "-wal", base + "-shm"};
+    for (string const& name: names)
+    {
+        if (file_exists(name))
+        {
+            windows_friendly_remove(name);
+        }
+    }
+    return;
+}
+
+
+long long query_scalar(DatabaseConnection& dbc, string const& p_sql)
+{
+    SQLStatement statement(dbc, p_sql);
+    statement.step();
+    long long const ret = statement.extract<long long>(0);
+    statement.reset();
+    return ret;
+}
+
+
+void insert_rows
+(   DatabaseConnection& dbc,
+    string const& p_insertion,
+    int p_rows
+)
+{
+    DatabaseTransaction transaction(dbc);
+    SQLStatement insertion(dbc, p_insertion);
+    for (int i = 0; i != p_rows; ++i)
+    {
+        insertion.step_final();
+        insertion.reset();
+    }
+    transaction.commit();
+    return;
+}
+
 void
 do_speed_test()
 {
@@ -178,6 +232,288 @@ do_speed_test()
 
     
 
+void
+do_id_width_speed_test()
+{
+    string const filename("aaksjh237nsam");
+    int const rows = 1000;
+    int const loops = 200;
+
+    DerivedDatabaseConnection db;
+    db.open(filename);
+    ExampleA::setup_tables(db);
+    ExampleD::setup_tables(db);
+    db.execute_sql("begin");
+    for (int i = 0; i != rows; ++i)
+    {
+        db.execute_sql("insert into example_as(x, y) values(1, 1.0)");
+        db.execute_sql("insert into example_ds(z) values(1)");
+    }
+    db.execute_sql("end");
+    db.identity_map<ExampleA>().enable_caching();
+    db.identity_map<ExampleD>().enable_caching();
+
+    // Compare Handle lookups through an IdentityMap keyed on int (ExampleA)
+    // with one keyed on long long (ExampleD).
+    cout << "Timing Handle lookups with int Id." << endl;
+    long long total = 0;
+    Stopwatch sw0;
+    for (int i = 0; i != loops; ++i)
+    {
+        for (int id = 1; id <= rows; ++id)
+        {
+            total += Handle<ExampleA>(db, id)->x();
+        }
+    }
+    sw0.log();
+
+    cout << "Timing Handle lookups with long long Id." << endl;
+    Stopwatch sw1;
+    for (int i = 0; i != loops; ++i)
+    {
+        for (long long id = 1; id <= rows; ++id)
+        {
+            total += Handle<ExampleD>(db, id)->z();
+        }
+    }
+    sw1.log();
+    JEWEL_ASSERT (total == 2LL * rows * loops);
+    (void)total;  // silence compiler re. unused variable in release.
+
+    db.identity_map<ExampleA>().disable_caching();
+    db.identity_map<ExampleD>().disable_caching();
+    windows_friendly_remove(filename);
+    return;
+}
+
+void
+do_sqlite_profile_speed_test()
+{
+    string const filename("aaksjh237nsao");
+    int const rows = 100000;
+    cout << "SQLite build profile: " << Info::sqlite_profile() << endl;
+    DatabaseConnection db;
+    db.open(filename);
+    db.execute_sql
+    (   "create table dummy(dummy_id integer primary key, x integer)"
+    );
+
+    cout << "Timing inserts." << endl;
+    Stopwatch sw0;
+    db.execute_sql("begin");
+    for (int i = 0; i != rows; ++i)
+    {
+        SQLStatement insertion(db, "insert into dummy(x) values(:x)");
+        insertion.bind(":x", i);
+        insertion.step_final();
+    }
+    db.execute_sql("end");
+    sw0.log();
+
+    cout << "Timing point queries." << endl;
+    long long total = 0;
+    Stopwatch sw1;
+    for (int i = 1; i <= rows; ++i)
+    {
+        SQLStatement selection
+        (   db,
+            "select x from dummy where dummy_id = :p"
+        );
+        selection.bind(":p", i);
+        selection.step();
+        total += selection.extract<long long>(0);
+    }
+    sw1.log();
+
+    cout << "Timing table scan." << endl;
+    Stopwatch sw2;
+    SQLStatement scan(db, "select x from dummy");
+    while (scan.step())
+    {
+        total += scan.extract<long long>(0);
+    }
+    sw2.log();
+    JEWEL_ASSERT (total == 2LL * rows * (rows - 1) / 2);
+    (void)total;  // silence compiler re. unused variable in release.
+
+    windows_friendly_remove(filename);
+    return;
+}
+
+namespace
+{
+    long long scan_example_as(string const& p_filename)
+    {
+        DerivedDatabaseConnection db;
+        db.open(p_filename);
+        TableIterator< Handle<ExampleA> > const null_iter;
+        long long ret = 0;
+        for
+        (   TableIterator< Handle<ExampleA> > it
+            (   db,
+                "select example_a_id from example_as"
+            );
+            it != null_iter;
+            ++it
+        )
+        {
+            ret += (*it)->x();
+        }
+        return ret;
+    }
+
+}  // end anonymous namespace
+
+void
+do_compaction_speed_test()
+{
+    string const filename("aaksjh237nsap");
+    int const rows = 200000;
+    {
+        DerivedDatabaseConnection db;
+        db.open(filename);
+        ExampleA::setup_tables(db);
+        ExampleB::setup_tables(db);
+
+        // Interleave the rows of example_as with those of example_bs, then
+        // delete the latter and every other row of the former, leaving
+        // example_as spread thinly across the file.
+        SQLStatement insertion_a
+        (   db,
+            "insert into example_as(x, y) values(1, 1.0)"
+        );
+        SQLStatement insertion_b(db, "insert into example_bs(s) values(:s)");
+        string const text(200, 'x');
+        db.execute_sql("begin");
+        for (int i = 0; i != rows; ++i)
+        {
+            insertion_a.step_final();
+            insertion_a.reset();
+            insertion_b.bind(":s", text);
+            insertion_b.step_final();
+            insertion_b.reset();
+        }
+        db.execute_sql("end");
+        db.execute_sql("delete from example_bs");
+        db.execute_sql("delete from example_as where example_a_id % 2 = 0");
+    }
+
+    // Each scan is made through a new connection, so that it starts with
+    // an empty page cache.
+    cout << "Timing TableIterator scan of fragmented table." << endl;
+    Stopwatch sw0;
+    long long total = scan_example_as(filename);
+    sw0.log();
+
+    {
+        DerivedDatabaseConnection db;
+        db.open(filename);
+        CompactionStats const stats = compact_database(db);
+        cout << "Compacted from " << stats.pages_before << " pages ("
+             << stats.free_pages_before << " free) to "
+             << stats.pages_after << " pages." << endl;
+    }
+
+    cout << "Timing TableIterator scan of compacted table." << endl;
+    Stopwatch sw1;
+    total += scan_example_as(filename);
+    sw1.log();
+    JEWEL_ASSERT (total == 2LL * (rows / 2));
+    (void)total;  // silence compiler re. unused variable in release.
+
+    windows_friendly_remove(filename);
+    return;
+}
+
+void
+do_statement_key_speed_test()
+{
+    // Enough texts to fill a typical statement cache, and to stop
+    // unordered_map from searching linearly, as it may for a small table.
+    vector<string> const patterns
+    {   "select x, y from table_# where table_#_id = :p",
+        "insert into table_#(x, y) values(:x, :y)",
+        "update table_# set x = :x, y = :y where table_#_id = :p",
+        "delete from table_# where table_#_id = :p",
+        "select table_#_id from table_#",
+        "select s from table_# where table_#_id = :p"
+    };
+    vector<string> texts;
+    for (int i = 0; i != 20; ++i)
+    {
+        for (string const& pattern: patterns)
+        {
+            string text;
+            for (char c: pattern)
+            {
+                if (c == '#')
+                {
+                    text += to_string(i);
+                }
+                else
+                {
+                    text += c;
+                }
+            }
+            texts.push_back(text);
+        }
+    }
+    unordered_map<string, int> string_map;
+    unordered_map<StatementKey, int, StatementKey::Hash> key_map;
+    for (vector<string>::size_type i = 0; i != texts.size(); ++i)
+    {
+        string_map[texts[i]] = static_cast<int>(i);
+        key_map[StatementKey::intern(texts[i])] = static_cast<int>(i);
+    }
+    int const loops = 2000000;
+    std::size_t string_hash_total = 0;
+    StatementKey::HashValue key_hash_total = 0;
+    long long string_total = 0;
+    long long key_total = 0;
+
+    cout << "Timing std::hash of statement texts." << endl;
+    Stopwatch sw_string_hash;
+    hash<string> const string_hash = hash<string>();
+    for (int i = 0; i != loops; ++i)
+    {
+        string_hash_total += string_hash(texts[i % texts.size()]);
+    }
+    sw_string_hash.log();
+
+    cout << "Timing StatementKey hash of statement texts." << endl;
+    Stopwatch sw_key_hash;
+    for (int i = 0; i != loops; ++i)
+    {
+        key_hash_total +=
+            StatementKey::lookup_key(texts[i % texts.size()]).hash_value();
+    }
+    sw_key_hash.log();
+
+    cout << "Timing lookups keyed by std::string." << endl;
+    Stopwatch sw0;
+    for (int i = 0; i != loops; ++i)
+    {
+        string_total += string_map.find(texts[i % texts.size()])->second;
+    }
+    sw0.log();
+
+    cout << "Timing lookups keyed by StatementKey." << endl;
+    Stopwatch sw1;
+    for (int i = 0; i != loops; ++i)
+    {
+        key_total += key_map.find
+        (   StatementKey::lookup_key(texts[i % texts.size()])
+        )->second;
+    }
+    sw1.log();
+    JEWEL_ASSERT (string_total == key_total);
+    (void)string_total;  // silence compiler re. unused variable in release.
+    (void)key_total;
+    cout << "(Hash totals: " << string_hash_total << ", "
+         << key_hash_total << ")" << endl;
+    return;
+}
+
 DatabaseConnectionFixture::DatabaseConnectionFixture():
     db_filepath("Testfile_01"),
     pdbc(0)
@@ -208,6 +544,9 @@ ExampleFixture::ExampleFixture():
     ExampleA::setup_tables(*pdbc);
     ExampleB::setup_tables(*pdbc);
     ExampleC::setup_tables(*pdbc);
+    ExampleD::setup_tables(*pdbc);
+    ExampleE::setup_tables(*pdbc);
+    ExampleF::setup_tables(*pdbc);
 }
 
 ExampleFixture::~ExampleFixture()
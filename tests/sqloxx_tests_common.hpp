@@ -32,6 +32,7 @@
 #include <UnitTest++/UnitTest++.h>
 #include <boost/filesystem.hpp>
 #include <iostream>
+#include <string>
 
 
 namespace sqloxx
@@ -46,10 +47,42 @@ void catch_check_ok(DatabaseConnection& dbc);
 
 void abort_if_exists(boost::filesystem::path const& filepath);
 
+// Removes the database file at filepath, with any WAL and shared-memory
+// files beside it.
+void remove_database(boost::filesystem::path const& filepath);
+
+// Returns the first column of the first row yielded by the SQL p_sql.
+long long query_scalar(DatabaseConnection& dbc, std::string const& p_sql);
+
+// Steps the insertion p_insertion p_rows times, in one transaction.
+void insert_rows
+(   DatabaseConnection& dbc,
+    std::string const& p_insertion,
+    int p_rows
+);
+
 // To compare speed of SQLStatementImpl with SQLStatement, to
 // evaluate effectiveness of caching in latter.
 void do_speed_test();
 
+// To compare the speed of Handle lookups for a PersistentObject with an
+// int Id against one with a long long Id.
+void do_id_width_speed_test();
+
+// To compare the SQLITE_PROFILE build profiles of the bundled SQLite, by
+// timing inserts, point queries and a table scan. Run this in a build of
+// each profile.
+void do_sqlite_profile_speed_test();
+
+// To compare the speed of a TableIterator scan of a fragmented table
+// before and after compact_database.
+void do_compaction_speed_test();
+
+// To compare the speed of hashing statement texts known only at runtime
+// with StatementKey against std::hash, and of looking them up in a table
+// keyed by StatementKey against one keyed by std::string.
+void do_statement_key_speed_test();
+
 
 // Fixture that creates a DatabaseConnection and database file for
 // reuse in tests.
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "database_connection.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_tests_common.hpp"
+#include "statement_key.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <string>
+
+using std::string;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+namespace
+{
+    constexpr StatementKey select_key("select 1");
+
+    // Known values, the first being the FNV-1a offset basis.
+    static_assert
+    (   StatementKey::hash("", 0) == 14695981039346656037ULL,
+        "Unexpected hash of empty string."
+    );
+    static_assert
+    (   StatementKey::hash("a", 1) == 0xaf63dc4c296230c0ULL,
+        "Unexpected hash of \"a\"."
+    );
+    static_assert
+    (   select_key.length() == 8,
+        "Unexpected length of StatementKey."
+    );
+
+}  // end anonymous namespace
+
+TEST(statement_key_hash_and_equality)
+{
+    string const text("select 1");
+    StatementKey const lookup = StatementKey::lookup_key(text);
+    CHECK(lookup.hash_value() == select_key.hash_value());
+    CHECK(lookup == select_key);
+    CHECK(lookup.text() != select_key.text());
+    CHECK(StatementKey::lookup_key("select 2") != select_key);
+    CHECK(StatementKey("select 2") != select_key);
+    CHECK(StatementKey("select 1") == select_key);
+
+    // A text of several words, with a partial word at the end.
+    constexpr StatementKey long_key("select x, y from example_as where z = 1");
+    string const long_text("select x, y from example_as where z = 1");
+    CHECK
+    (   StatementKey::lookup_key(long_text).hash_value() ==
+        long_key.hash_value()
+    );
+    CHECK(StatementKey::lookup_key(long_text) == long_key);
+    CHECK
+    (   StatementKey::lookup_key("select x, y from example_as where z = 2") !=
+        long_key
+    );
+}
+
+TEST(statement_key_intern)
+{
+    string text = "select ";
+    text += "3";
+    StatementKey const key0 = StatementKey::intern(text);
+    StatementKey const key1 = StatementKey::intern(string("select 3"));
+    CHECK(key0.text() == key1.text());
+    CHECK(key0.text() != text.c_str());
+    CHECK_EQUAL(string(key0.text()), "select 3");
+    CHECK(key0 == StatementKey("select 3"));
+    CHECK(key0 != StatementKey::intern("select 4"));
+}
+
+TEST_FIXTURE(DatabaseConnectionFixture, statement_key_sql_statement)
+{
+    DatabaseConnection& dbc = *pdbc;
+    dbc.execute_sql("create table dummy(col_a integer)");
+    dbc.execute_sql("insert into dummy(col_a) values(5)");
+    static constexpr StatementKey key("select col_a from dummy");
+    {
+        SQLStatement statement0(dbc, key);
+        CHECK(statement0.step());
+        CHECK_EQUAL(statement0.extract<int>(0), 5);
+
+        // Same text, looked up via std::string, while statement0 is
+        // still in use.
+        SQLStatement statement1(dbc, string("select col_a from dummy"));
+        CHECK(statement1.step());
+        CHECK_EQUAL(statement1.extract<int>(0), 5);
+    }
+    SQLStatement statement2
+    (   dbc,
+        StatementKey::intern("select col_a from dummy")
+    );
+    CHECK(statement2.step());
+    CHECK_EQUAL(statement2.extract<int>(0), 5);
+    CHECK(!statement2.step());
+}
+
+
+}  // namespace tests
+}  // namespace sqloxx
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "database_connection.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include "statement_slot.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <string>
+
+using std::string;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+TEST(statement_slot_indices)
+{
+    StatementSlot const slot0("select 1");
+    StatementSlot const slot1("select 1");
+    CHECK(slot0.index() != slot1.index());
+    CHECK_EQUAL(slot0.text(), "select 1");
+    CHECK_EQUAL(slot1.text(), slot0.text());
+}
+
+TEST_FIXTURE(DatabaseConnectionFixture, statement_slot_sql_statement)
+{
+    DatabaseConnection& dbc = *pdbc;
+    dbc.execute_sql("create table dummy(col_a integer, col_b text)");
+    static StatementSlot const inserter_slot
+    (   "insert into dummy(col_a, col_b) values(:a, :b)"
+    );
+    static StatementSlot const selector_slot
+    (   "select col_b from dummy where col_a = :a"
+    );
+    for (int i = 0; i != 3; ++i)
+    {
+        SQLStatement inserter(dbc, inserter_slot);
+        inserter.bind(":a", i);
+        inserter.bind(":b", string(i + 1, 'x'));
+        inserter.step_final();
+    }
+    SQLStatement selector0(dbc, selector_slot);
+    selector0.bind(":a", 2);
+    CHECK(selector0.step());
+    CHECK_EQUAL(selector0.extract<string>(0), "xxx");
+
+    // Slot is in use by selector0, so this must use a separate
+    // statement.
+    SQLStatement selector1(dbc, selector_slot);
+    selector1.bind(":a", 0);
+    CHECK(selector1.step());
+    CHECK_EQUAL(selector1.extract<string>(0), "x");
+    CHECK_EQUAL(selector0.extract<string>(0), "xxx");
+    CHECK(!selector0.step());
+    CHECK(!selector1.step());
+
+    // Invalid connection
+    DatabaseConnection temp_dbc;
+    CHECK_THROW
+    (   SQLStatement unconnected(temp_dbc, selector_slot),
+        InvalidConnection
+    );
+
+    // Syntax error is reported on use, and does not occupy the slot.
+    StatementSlot const bad_slot("unsyntactical gobbledigook");
+    CHECK_THROW(SQLStatement bad0(dbc, bad_slot), SQLiteException);
+    CHECK_THROW(SQLStatement bad1(dbc, bad_slot), SQLiteException);
+}
+
+
+}  // namespace tests
+}  // namespace sqloxx
@@ -28,15 +28,22 @@
 
 
 #include "atomicity_test.hpp"
+#include "page_cache.hpp"
 #include "sqloxx_tests_common.hpp"
 #include <UnitTest++/UnitTest++.h>
 #include <stdexcept>
 #include <iostream>
 
+using sqloxx::configure_page_cache;
 using sqloxx::DatabaseConnection;
+using sqloxx::PageCacheConfig;
 using sqloxx::SQLStatement;
 using sqloxx::tests::do_atomicity_test;
+using sqloxx::tests::do_compaction_speed_test;
+using sqloxx::tests::do_id_width_speed_test;
 using sqloxx::tests::do_speed_test;
+using sqloxx::tests::do_sqlite_profile_speed_test;
+using sqloxx::tests::do_statement_key_speed_test;
 using std::cout;
 using std::endl;
 using std::string;
@@ -44,12 +51,31 @@ using std::terminate;
 
 int main(int argc, char** argv)
 {
-    (void)argc;  // silence compiler warning re. unused parameter
     try
     {
+        // When run with "--page-cache-arena" in place of the database file,
+        // the atomicity test is skipped and the unit tests are run with
+        // a page cache arena configured, so that they exercise it. This
+        // must precede any use of SQLite.
+        bool const is_arena_run =
+            (argc > 1) && (string(argv[1]) == "--page-cache-arena");
+        if (is_arena_run)
+        {
+            PageCacheConfig page_cache_config;
+            page_cache_config.pages = 500;
+            configure_page_cache(page_cache_config);
+        }
+
         // do_speed_test();
+        // do_id_width_speed_test();
+        // do_sqlite_profile_speed_test();
+        // do_compaction_speed_test();
+        // do_statement_key_speed_test();
         int failures = 0;
-        failures += do_atomicity_test(argv[1]);
+        if (!is_arena_run)
+        {
+            failures += do_atomicity_test(argv[1]);
+        }
         cout << "Now running various unit tests using UnitTest++..."
              << endl;
         failures += UnitTest::RunAllTests();
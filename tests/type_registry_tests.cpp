@@ -0,0 +1,93 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "example.hpp"
+#include "handle.hpp"
+#include "sqloxx_tests_common.hpp"
+#include "type_registry.hpp"
+#include <UnitTest++/UnitTest++.h>
+
+namespace sqloxx
+{
+namespace tests
+{
+
+TEST(type_registry_tags)
+{
+    TypeTag const& a = TypeRegistry<ExampleA>::tag();
+    TypeTag const& b = TypeRegistry<ExampleB>::tag();
+    TypeTag const& c = TypeRegistry<ExampleC>::tag();
+
+    CHECK(&a == &TypeRegistry<ExampleA>::tag());
+    CHECK(a.parent() == nullptr);
+    CHECK(b.parent() == nullptr);
+    CHECK(c.parent() == &b);
+
+    CHECK(a.is_a(a));
+    CHECK(!a.is_a(b));
+    CHECK(!b.is_a(c));
+    CHECK(c.is_a(b));
+    CHECK(c.is_a(c));
+
+    CHECK_EQUAL(a.exclusive_table_name(), "example_as");
+    CHECK_EQUAL(a.join_text(), "example_as");
+    CHECK_EQUAL(c.exclusive_table_name(), "example_cs");
+    CHECK_EQUAL
+    (   c.join_text(),
+        "example_bs join example_cs using(example_b_id)"
+    );
+}
+
+TEST(type_registry_join_on_derived_key)
+{
+    TypeTag const base(nullptr, "people", "person_id");
+    TypeTag const staff(&base, "staff", "staff_id");
+    TypeTag const manager(&staff, "managers", "person_id");
+    CHECK_EQUAL(staff.primary_key_name(), "staff_id");
+    CHECK_EQUAL
+    (   staff.join_text(),
+        "people join staff on people.person_id = staff.staff_id"
+    );
+    CHECK_EQUAL
+    (   manager.join_text(),
+        "people join staff on people.person_id = staff.staff_id "
+        "join managers using(person_id)"
+    );
+}
+
+TEST_FIXTURE(ExampleFixture, type_registry_derived_load)
+{
+    Handle<ExampleC> dpoc1(*pdbc);
+    dpoc1->set_s("abc");
+    dpoc1->set_p(7);
+    dpoc1->set_q(-8);
+    dpoc1->save();
+    dpoc1 = Handle<ExampleC>();
+
+    // Caching is not enabled, so this loads afresh from the database.
+    Handle<ExampleC> const dpoc2(*pdbc, 1);
+    CHECK_EQUAL(dpoc2->s(), "abc");
+    CHECK_EQUAL(dpoc2->p(), 7);
+    CHECK_EQUAL(dpoc2->q(), -8);
+
+    Handle<ExampleB> const dpob1 = handle_cast<ExampleB>(dpoc2);
+    Handle<ExampleC> const dpoc3 = handle_cast<ExampleC>(dpob1);
+    CHECK(dpoc3 == dpoc2);
+}
+
+
+}  // namespace tests
+}  // namespace sqloxx
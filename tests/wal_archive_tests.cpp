@@ -0,0 +1,166 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wal_archive.hpp"
+#include "database_connection.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using std::chrono::milliseconds;
+using std::chrono::system_clock;
+using std::string;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+namespace
+{
+    boost::filesystem::path const wal_archive_filepath
+    (   "Testfile_wal_archive"
+    );
+    boost::filesystem::path const wal_archive_directory
+    (   "Testfile_wal_archive_directory"
+    );
+    boost::filesystem::path const wal_archive_restored
+    (   "Testfile_wal_archive_restored"
+    );
+
+    char const* const wal_archive_insertion =
+        "insert into dummy(data) values(randomblob(100))";
+
+    // Restores the archive as at p_until, returning the number of rows
+    // in the restored database.
+    long long restored_rows(system_clock::time_point p_until)
+    {
+        remove_database(wal_archive_restored);
+        restore_wal_archive
+        (   wal_archive_directory,
+            wal_archive_restored,
+            p_until
+        );
+        DatabaseConnection dbc;
+        dbc.open(wal_archive_restored);
+        SQLStatement check(dbc, "pragma integrity_check");
+        check.step();
+        CHECK_EQUAL(check.extract<string>(0), "ok");
+        return query_scalar(dbc, "select count(*) from dummy");
+    }
+
+    // Removes the files of the tests once their connections are closed.
+    struct WalArchiveFiles
+    {
+        WalArchiveFiles()
+        {
+            abort_if_exists(wal_archive_filepath);
+            abort_if_exists(wal_archive_directory);
+            abort_if_exists(wal_archive_restored);
+        }
+        ~WalArchiveFiles()
+        {
+            remove_database(wal_archive_filepath);
+            remove_database(wal_archive_restored);
+            boost::filesystem::remove_all(wal_archive_directory);
+        }
+    };
+
+    struct WalArchiveFixture
+    {
+        WalArchiveFixture()
+        {
+            dbc.open(wal_archive_filepath);
+            dbc.execute_sql("pragma journal_mode = wal");
+            dbc.execute_sql
+            (   "create table dummy(dummy_id integer primary key, data blob)"
+            );
+        }
+        WalArchiveFiles files;
+        DatabaseConnection dbc;
+    };
+
+}  // end anonymous namespace
+
+TEST_FIXTURE(WalArchiveFixture, wal_archive_point_in_time)
+{
+    insert_rows(dbc, wal_archive_insertion, 5);
+    dbc.enable_wal_archiving(wal_archive_directory);
+    CHECK(boost::filesystem::exists(wal_archive_directory / "base"));
+    CHECK_THROW(dbc.enable_wal_archiving(wal_archive_directory), LogicError);
+
+    insert_rows(dbc, wal_archive_insertion, 10);
+    system_clock::time_point const between = system_clock::now();
+    std::this_thread::sleep_for(milliseconds(5));
+    insert_rows(dbc, wal_archive_insertion, 20);
+    WalArchiveStats const stats = dbc.wal_archive_stats();
+    CHECK_EQUAL(stats.commits, 2U);
+    CHECK(stats.frames >= 2);
+    CHECK_EQUAL(stats.failures, 0U);
+
+    CHECK_EQUAL(restored_rows(system_clock::time_point()), 5);
+    CHECK_EQUAL(restored_rows(between), 15);
+    CHECK_EQUAL(restored_rows(system_clock::time_point::max()), 35);
+    CHECK_THROW
+    (   restore_wal_archive(wal_archive_directory, wal_archive_restored),
+        LogicError
+    );
+}
+
+TEST_FIXTURE(WalArchiveFixture, wal_archive_checkpoints)
+{
+    WalArchivePolicy policy;
+    policy.checkpoint_frames = 5;
+    dbc.enable_wal_archiving(wal_archive_directory, policy);
+
+    // Commits by another connection are archived by the archiving
+    // connection's next commit, provided the other does not checkpoint.
+    DatabaseConnection other;
+    other.open(wal_archive_filepath);
+    other.execute_sql("pragma wal_autocheckpoint = 0");
+    for (int i = 0; i != 30; ++i)
+    {
+        insert_rows(dbc, wal_archive_insertion, 1);
+        insert_rows(other, wal_archive_insertion, 1);
+    }
+    insert_rows(dbc, wal_archive_insertion, 1);
+    WalArchiveStats const stats = dbc.wal_archive_stats();
+    CHECK_EQUAL(stats.commits, 61U);
+    CHECK(stats.checkpoints > 0);
+    CHECK_EQUAL(stats.failures, 0U);
+    CHECK(boost::filesystem::exists(wal_archive_directory / "wal-00000002"));
+    CHECK_EQUAL(restored_rows(system_clock::time_point::max()), 61);
+}
+
+TEST_FIXTURE(WalArchiveFixture, wal_archive_preconditions)
+{
+    boost::filesystem::create_directory(wal_archive_directory);
+    boost::filesystem::ofstream(wal_archive_directory / "stray");
+    CHECK_THROW(dbc.enable_wal_archiving(wal_archive_directory), LogicError);
+    boost::filesystem::remove_all(wal_archive_directory);
+
+    dbc.execute_sql("pragma journal_mode = delete");
+    CHECK_THROW(dbc.enable_wal_archiving(wal_archive_directory), LogicError);
+    CHECK_EQUAL(dbc.wal_archive_stats().commits, 0U);
+}
+
+}  // namespace tests
+}  // namespace sqloxx
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2013 Matthew Harvey
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "database_connection.hpp"
+#include "database_transaction.hpp"
+#include "example.hpp"
+#include "handle.hpp"
+#include "identity_map.hpp"
+#include "sql_statement.hpp"
+#include "sqloxx_exceptions.hpp"
+#include "sqloxx_tests_common.hpp"
+#include "write_behind.hpp"
+#include <UnitTest++/UnitTest++.h>
+#include <chrono>
+
+using std::chrono::hours;
+using std::chrono::steady_clock;
+
+namespace sqloxx
+{
+namespace tests
+{
+
+namespace
+{
+    // Reads x of the ExampleA with id p_id directly from the database.
+    int stored_x(DatabaseConnection& dbc, Id p_id)
+    {
+        SQLStatement statement
+        (   dbc,
+            "select x from example_as where example_a_id = :p"
+        );
+        statement.bind(":p", p_id);
+        statement.step();
+        return statement.extract<int>(0);
+    }
+
+    void save_new_as(DerivedDatabaseConnection& dbc, int p_num)
+    {
+        for (int i = 0; i != p_num; ++i)
+        {
+            Handle<ExampleA> a(dbc);
+            a->set_x(0);
+            a->set_y(0.5);
+            a->save();
+        }
+        return;
+    }
+
+    WriteBehindPolicy policy(std::size_t p_max_backlog)
+    {
+        WriteBehindPolicy ret;
+        ret.max_delay = hours(1);
+        ret.max_backlog = p_max_backlog;
+        return ret;
+    }
+
+}  // end anonymous namespace
+
+TEST_FIXTURE(ExampleFixture, write_behind_defers_saves)
+{
+    DerivedDatabaseConnection& dbc = *pdbc;
+    IdentityMap<ExampleA>& map = dbc.identity_map<ExampleA>();
+    save_new_as(dbc, 3);
+    map.enable_write_behind(policy(3));
+
+    // Saving new objects is not deferred.
+    Handle<ExampleA> d(dbc);
+    d->set_x(4);
+    d->set_y(0.5);
+    d->save();
+    CHECK_EQUAL(stored_x(dbc, 4), 4);
+    CHECK_EQUAL(map.write_behind_stats().deferred_saves, 0U);
+
+    // The object is retained though no Handle refers to it.
+    {
+        Handle<ExampleA> a(dbc, 1);
+        a->set_x(10);
+        a->save();
+    }
+    CHECK_EQUAL(stored_x(dbc, 1), 0);
+    CHECK_EQUAL(Handle<ExampleA>(dbc, 1)->x(), 10);
+    CHECK_EQUAL(map.write_behind_stats().backlog, 1U);
+
+    // Saving again does not add to the backlog.
+    Handle<ExampleA>(dbc, 1)->save();
+    Handle<ExampleA> b(dbc, 2);
+    b->set_x(20);
+    b->save();
+    CHECK_EQUAL(map.write_behind_stats().backlog, 2U);
+    CHECK_EQUAL(stored_x(dbc, 2), 0);
+
+    // Reaching max_backlog flushes.
+    Handle<ExampleA> c(dbc, 3);
+    c->set_x(30);
+    c->save();
+    CHECK_EQUAL(stored_x(dbc, 1), 10);
+    CHECK_EQUAL(stored_x(dbc, 2), 20);
+    CHECK_EQUAL(stored_x(dbc, 3), 30);
+
+    WriteBehindStats const stats = map.write_behind_stats();
+    CHECK_EQUAL(stats.deferred_saves, 4U);
+    CHECK_EQUAL(stats.flushes, 1U);
+    CHECK_EQUAL(stats.objects_flushed, 3U);
+    CHECK_EQUAL(stats.backlog, 0U);
+    CHECK_EQUAL(stats.peak_backlog, 3U);
+    CHECK(stats.max_staleness >= stats.last_flush_latency);
+
+    // Within a transaction, saves are not deferred.
+    {
+        DatabaseTransaction transaction(dbc);
+        b->set_x(21);
+        b->save();
+        transaction.commit();
+    }
+    CHECK_EQUAL(stored_x(dbc, 2), 21);
+    CHECK_EQUAL(map.write_behind_stats().backlog, 0U);
+
+    // Explicit flush, and flush on disabling write-behind.
+    b->set_x(22);
+    b->save();
+    map.flush();
+    CHECK_EQUAL(stored_x(dbc, 2), 22);
+    b->set_x(23);
+    b->save();
+    map.disable_write_behind();
+    CHECK_EQUAL(stored_x(dbc, 2), 23);
+    b->set_x(24);
+    b->save();
+    CHECK_EQUAL(stored_x(dbc, 2), 24);
+    CHECK_EQUAL(map.write_behind_stats().flushes, 3U);
+}
+
+TEST_FIXTURE(ExampleFixture, write_behind_delay_and_shutdown)
+{
+    save_new_as(*pdbc, 2);
+    {
+        DerivedDatabaseConnection dbc;
+        dbc.open(db_filepath);
+        IdentityMap<ExampleA>& map = dbc.identity_map<ExampleA>();
+
+        // A zero max_delay means each save is flushed at once.
+        WriteBehindPolicy immediate = policy(100);
+        immediate.max_delay = steady_clock::duration::zero();
+        map.enable_write_behind(immediate);
+        Handle<ExampleA> a(dbc, 1);
+        a->set_x(5);
+        a->save();
+        CHECK_EQUAL(stored_x(*pdbc, 1), 5);
+
+        // Otherwise flush_if_due() does nothing until a limit is reached.
+        map.enable_write_behind(policy(100));
+        a->set_x(6);
+        a->save();
+        map.flush_if_due();
+        CHECK_EQUAL(stored_x(*pdbc, 1), 5);
+
+        // A removed object is no longer awaiting saving.
+        Handle<ExampleA> b(dbc, 2);
+        b->set_x(7);
+        b->save();
+        CHECK_EQUAL(map.write_behind_stats().backlog, 2U);
+        b->remove();
+        CHECK_EQUAL(map.write_behind_stats().backlog, 1U);
+    }
+    // Deferred saves are flushed on destruction of the IdentityMap.
+    CHECK_EQUAL(stored_x(*pdbc, 1), 6);
+}
+
+TEST_FIXTURE(ExampleFixture, write_behind_failed_flush)
+{
+    DerivedDatabaseConnection& dbc = *pdbc;
+    IdentityMap<ExampleA>& map = dbc.identity_map<ExampleA>();
+    save_new_as(dbc, 2);
+    map.enable_write_behind(policy(100));
+    Handle<ExampleA> a(dbc, 1);
+    Handle<ExampleA> b(dbc, 2);
+    a->set_x(1);
+    a->save();
+    b->set_x(2);
+    b->save();
+    dbc.execute_sql
+    (   "create trigger example_a_guard before update on example_as "
+        "when new.x = 2 begin select raise(abort, 'refused'); end"
+    );
+
+    // Neither object is saved, and both revert to their stored state.
+    CHECK_THROW(map.flush(), SQLiteException);
+    CHECK_EQUAL(stored_x(dbc, 1), 0);
+    CHECK_EQUAL(a->x(), 0);
+    CHECK_EQUAL(b->x(), 0);
+    WriteBehindStats const stats = map.write_behind_stats();
+    CHECK_EQUAL(stats.failed_flushes, 1U);
+    CHECK_EQUAL(stats.objects_discarded, 2U);
+    CHECK_EQUAL(stats.backlog, 0U);
+}
+
+}  // namespace tests
+}  // namespace sqloxx